@@ -0,0 +1,153 @@
+/*
+ * File      : tickless_test.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2006 - 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-06-22     agent        the first version
+ */
+
+/*
+ * The tickless idle test on simulator. It checks the accuracy of thread delay
+ * and timer against the host clock, and counts the wakeups of idle thread per
+ * second, which shall follow the timer events instead of the tick rate.
+ */
+#include <rtthread.h>
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif
+
+#if defined(RT_USING_TICKLESS) && !defined(_WIN32)
+#include <time.h>
+
+/* the allowed error between OS time and host time, in millisecond */
+#define TICKLESS_TEST_ERROR_MS      (2 * 1000 / RT_TICK_PER_SECOND + 5)
+
+static volatile rt_uint32_t idle_wakeups;
+static volatile rt_uint32_t timer_events;
+
+static void tickless_idle_hook(void)
+{
+    /* each loop of idle thread is a wakeup from tickless sleep */
+    idle_wakeups ++;
+}
+
+static void tickless_timeout(void *parameter)
+{
+    timer_events ++;
+}
+
+static long host_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static int tickless_delay_check(rt_tick_t delay)
+{
+    long ms, expect;
+    rt_tick_t tick;
+
+    ms = host_ms();
+    tick = rt_tick_get();
+    rt_thread_delay(delay);
+    tick = rt_tick_get() - tick;
+    ms = host_ms() - ms;
+
+    expect = delay * 1000L / RT_TICK_PER_SECOND;
+    rt_kprintf("delay %5d ticks: passed %5d ticks, %6d ms on host (expect %d ms)\n",
+               delay, tick, ms, expect);
+
+    if (tick != delay || ms - expect > TICKLESS_TEST_ERROR_MS ||
+        expect - ms > TICKLESS_TEST_ERROR_MS)
+        return -1;
+
+    return 0;
+}
+
+static rt_uint32_t tickless_wakeups(rt_tick_t period, rt_uint32_t seconds)
+{
+    rt_timer_t timer = RT_NULL;
+    rt_uint32_t wakeups;
+
+    if (period != 0)
+    {
+        timer = rt_timer_create("tless", tickless_timeout, RT_NULL,
+                                period, RT_TIMER_FLAG_PERIODIC);
+        rt_timer_start(timer);
+    }
+
+    idle_wakeups = 0;
+    timer_events = 0;
+    rt_thread_idle_sethook(tickless_idle_hook);
+    rt_thread_delay(seconds * RT_TICK_PER_SECOND);
+    rt_thread_idle_sethook(RT_NULL);
+    wakeups = idle_wakeups / seconds;
+
+    if (timer != RT_NULL)
+    {
+        rt_timer_delete(timer);
+        rt_kprintf("timer period %4d ticks: %d timer events, ", period, timer_events);
+    }
+    else
+    {
+        rt_kprintf("no timer: ");
+    }
+    rt_kprintf("%d idle wakeups per second (tick rate %d)\n",
+               wakeups, RT_TICK_PER_SECOND);
+
+    return wakeups;
+}
+
+int tickless_test(void)
+{
+    int index, result = 0;
+    const rt_tick_t delays[] = {1, 3, 17, RT_TICK_PER_SECOND, RT_TICK_PER_SECOND * 3 + 7};
+    const rt_tick_t periods[] = {0, RT_TICK_PER_SECOND / 10, RT_TICK_PER_SECOND / 2};
+
+    for (index = 0; index < sizeof(delays) / sizeof(delays[0]); index ++)
+    {
+        if (tickless_delay_check(delays[index]) != 0)
+            result = -1;
+    }
+
+    for (index = 0; index < sizeof(periods) / sizeof(periods[0]); index ++)
+    {
+        rt_uint32_t expect;
+
+        /* one wakeup for each timer event, and the test thread itself */
+        expect = 1;
+        if (periods[index] != 0)
+            expect += RT_TICK_PER_SECOND / periods[index];
+
+        if (tickless_wakeups(periods[index], 3) > expect + 1)
+            result = -1;
+    }
+
+    rt_kprintf("tickless test %s\n", result == 0 ? "passed" : "failed");
+
+    return result;
+}
+#ifdef RT_USING_FINSH
+FINSH_FUNCTION_EXPORT(tickless_test, tickless idle test);
+MSH_CMD_EXPORT(tickless_test, tickless idle test);
+#endif
+#endif
@@ -242,7 +242,7 @@ int32_t osSemaphoreWait(osSemaphoreId semaphore_id, uint32_t millisec)
     ticks = rt_tick_from_millisecond(millisec);
     rt_sem_take(semaphore_id, ticks);
 
-    return semaphore_id->value;
+    return RT_SEM_VALUE(semaphore_id);
 }
 
 /// Release a Semaphore
@@ -20,6 +20,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2016/10/1      Bernard      The first version
+ * 2017/06/29     agent        add the zero-copy reserve/commit and borrow/release
  */
 
 #pragma once
@@ -67,7 +68,7 @@ public:
       @param   millisec  timeout value or 0 in case of no time-out. (default: osWaitForever).
       @return  bool .
     */
-    bool get(T& data, int32_t millisec = WAIT_FOREVER)
+    bool get(T& data, int32_t millisec = -1)
     {
         rt_int32_t tick;
 
@@ -79,6 +80,59 @@ public:
         return rt_mq_recv(&mID, &data, sizeof(data), tick) == RT_EOK;
     }
 
+    /** Reserve a message in a Queue, which is filled in place and put by
+        commit() without copy.
+      @return  the reserved message, or NULL if the Queue is full.
+    */
+    T* reserve()
+    {
+        void *buffer;
+
+        if (rt_mq_reserve(&mID, &buffer) != RT_EOK)
+            return NULL;
+
+        return (T*)buffer;
+    }
+
+    /** Put a message reserved by reserve() in a Queue.
+      @param   data      the reserved message.
+      @return  status code that indicates the execution status of the function.
+    */
+    rt_err_t commit(T* data)
+    {
+        return rt_mq_commit(&mID, data);
+    }
+
+    /** Borrow the message at the head of a Queue without copy, or Wait for a
+        message. The message shall be given back by release().
+      @param   millisec  timeout value or 0 in case of no time-out. (default: osWaitForever).
+      @return  the borrowed message, or NULL on time-out.
+    */
+    T* borrow(int32_t millisec = -1)
+    {
+        void *buffer;
+        rt_int32_t tick;
+
+        if (millisec < 0)
+            tick = -1;
+        else
+            tick = rt_tick_from_millisecond(millisec);
+
+        if (rt_mq_borrow(&mID, &buffer, tick) != RT_EOK)
+            return NULL;
+
+        return (T*)buffer;
+    }
+
+    /** Give back a message borrowed by borrow(), or a reserved message which
+        is not put.
+      @param   data      the message.
+    */
+    void release(T* data)
+    {
+        rt_mq_release(&mID, data);
+    }
+
 private:
     struct rt_messagequeue mID;
 
@@ -19,6 +19,7 @@
  *
  * Change Logs:
  * Date           Author       Notes
+ * 2017-07-15     agent        add positional and vectored I/O.
  */
 
 #include <rtthread.h>
@@ -94,6 +95,57 @@ int dfs_device_fs_write(struct dfs_fd *file, const void *buf, rt_size_t count)
     return result;
 }
 
+/* the offset is passed to device as the position of read() and write() */
+int dfs_device_fs_preadv(struct dfs_fd *file, const struct dfs_iovec *iov, int iovcnt, rt_off_t offset)
+{
+    int index;
+    rt_size_t length, count = 0;
+    rt_device_t dev_id;
+
+    RT_ASSERT(file != RT_NULL);
+
+    /* get device handler */
+    dev_id = (rt_device_t)file->data;
+    RT_ASSERT(dev_id != RT_NULL);
+
+    for (index = 0; index < iovcnt; index ++)
+    {
+        length = rt_device_read(dev_id, offset, iov[index].iov_base, iov[index].iov_len);
+        offset += length;
+        count  += length;
+
+        if (length < iov[index].iov_len)
+            break;
+    }
+
+    return count;
+}
+
+int dfs_device_fs_pwritev(struct dfs_fd *file, const struct dfs_iovec *iov, int iovcnt, rt_off_t offset)
+{
+    int index;
+    rt_size_t length, count = 0;
+    rt_device_t dev_id;
+
+    RT_ASSERT(file != RT_NULL);
+
+    /* get device handler */
+    dev_id = (rt_device_t)file->data;
+    RT_ASSERT(dev_id != RT_NULL);
+
+    for (index = 0; index < iovcnt; index ++)
+    {
+        length = rt_device_write(dev_id, offset, iov[index].iov_base, iov[index].iov_len);
+        offset += length;
+        count  += length;
+
+        if (length < iov[index].iov_len)
+            break;
+    }
+
+    return count;
+}
+
 int dfs_device_fs_close(struct dfs_fd *file)
 {
     rt_err_t result;
@@ -297,6 +349,8 @@ static const struct dfs_filesystem_operation _device_fs =
     RT_NULL,
     dfs_device_fs_stat,
     RT_NULL,
+    dfs_device_fs_preadv,
+    dfs_device_fs_pwritev,
 };
 
 int devfs_init(void)
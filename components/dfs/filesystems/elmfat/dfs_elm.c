@@ -29,6 +29,7 @@
  * 2017-02-13     Hichard      Update Fatfs version to 0.12b, support exFAT.
  * 2017-04-11     Bernard      fix the st_blksize issue.
  * 2017-05-26     Urey         fix f_mount error when mount more fats
+ * 2017-07-15     agent        add positional and vectored I/O.
  */
 
 #include <rtthread.h>
@@ -45,6 +46,19 @@
 
 static rt_device_t disk[_VOLUMES] = {0};
 
+/*
+ * the lock of a file object, which makes the seek and read/write of file and
+ * the update of position as one operation. It's the recursive mutex of volume
+ * which is taken by FatFs too.
+ */
+#if _FS_REENTRANT
+#define elm_file_lock(fd)       ff_req_grant((fd)->obj.fs->sobj)
+#define elm_file_unlock(fd)     ff_rel_grant((fd)->obj.fs->sobj)
+#else
+#define elm_file_lock(fd)       1
+#define elm_file_unlock(fd)
+#endif
+
 static int elm_result_to_dfs(FRESULT result)
 {
     int status = DFS_STATUS_OK;
@@ -488,9 +502,12 @@ int dfs_elm_read(struct dfs_fd *file, void *buf, rt_size_t len)
     fd = (FIL *)(file->data);
     RT_ASSERT(fd != RT_NULL);
 
+    if (!elm_file_lock(fd))
+        return elm_result_to_dfs(FR_TIMEOUT);
     result = f_read(fd, buf, len, &byte_read);
     /* update position */
     file->pos  = fd->fptr;
+    elm_file_unlock(fd);
     if (result == FR_OK)
         return byte_read;
 
@@ -511,16 +528,140 @@ int dfs_elm_write(struct dfs_fd *file, const void *buf, rt_size_t len)
     fd = (FIL *)(file->data);
     RT_ASSERT(fd != RT_NULL);
 
+    if (!elm_file_lock(fd))
+        return elm_result_to_dfs(FR_TIMEOUT);
     result = f_write(fd, buf, len, &byte_write);
     /* update position and file size */
     file->pos  = fd->fptr;
     file->size = f_size(fd);
+    elm_file_unlock(fd);
     if (result == FR_OK)
         return byte_write;
 
     return elm_result_to_dfs(result);
 }
 
+/*
+ * the positional I/O seeks to the offset, transfers each buffer and seeks
+ * back under the lock of file, so the position is not changed for others.
+ * The whole sectors in a buffer are transferred between the buffer and disk
+ * directly by FatFs.
+ *
+ * The seek after the end of file extends a file opened for write in FatFs,
+ * so the read after the end of file returns 0 without seek, and the write
+ * after the end of file fills the hole with zero first.
+ */
+int dfs_elm_preadv(struct dfs_fd *file, const struct dfs_iovec *iov, int iovcnt, rt_off_t offset)
+{
+    FIL *fd;
+    FSIZE_t fptr;
+    FRESULT result;
+    UINT byte_read;
+    int index, count = 0;
+
+    if (file->type == FT_DIRECTORY)
+    {
+        return -DFS_STATUS_EISDIR;
+    }
+
+    fd = (FIL *)(file->data);
+    RT_ASSERT(fd != RT_NULL);
+
+    if (!elm_file_lock(fd))
+        return elm_result_to_dfs(FR_TIMEOUT);
+
+    /* end of file */
+    if (offset >= f_size(fd))
+    {
+        elm_file_unlock(fd);
+        return 0;
+    }
+
+    fptr = fd->fptr;
+    result = f_lseek(fd, offset);
+    for (index = 0; index < iovcnt && result == FR_OK; index ++)
+    {
+        result = f_read(fd, iov[index].iov_base, iov[index].iov_len, &byte_read);
+        if (result == FR_OK)
+            count += byte_read;
+        /* end of file */
+        if (byte_read < iov[index].iov_len)
+            break;
+    }
+    /* restore the position */
+    f_lseek(fd, fptr);
+    elm_file_unlock(fd);
+
+    if (result == FR_OK || count > 0)
+        return count;
+
+    return elm_result_to_dfs(result);
+}
+
+int dfs_elm_pwritev(struct dfs_fd *file, const struct dfs_iovec *iov, int iovcnt, rt_off_t offset)
+{
+    FIL *fd;
+    FSIZE_t fptr, size;
+    FRESULT result;
+    UINT byte_write;
+    int index, count = 0;
+
+    if (file->type == FT_DIRECTORY)
+    {
+        return -DFS_STATUS_EISDIR;
+    }
+
+    fd = (FIL *)(file->data);
+    RT_ASSERT(fd != RT_NULL);
+
+    if (!elm_file_lock(fd))
+        return elm_result_to_dfs(FR_TIMEOUT);
+
+    fptr = fd->fptr;
+    if (offset > f_size(fd))
+    {
+        rt_uint8_t zero[32];
+
+        /* fill the hole after the end of file with zero */
+        rt_memset(zero, 0, sizeof(zero));
+        result = f_lseek(fd, f_size(fd));
+        while (result == FR_OK && f_size(fd) < offset)
+        {
+            size = offset - f_size(fd);
+            if (size > sizeof(zero))
+                size = sizeof(zero);
+
+            result = f_write(fd, zero, size, &byte_write);
+            /* the disk is full */
+            if (byte_write < size)
+                break;
+        }
+    }
+    else
+        result = f_lseek(fd, offset);
+
+    if (result == FR_OK && f_size(fd) < offset)
+        count = -DFS_STATUS_ENOSPC;
+    for (index = 0; index < iovcnt && result == FR_OK && count >= 0; index ++)
+    {
+        result = f_write(fd, iov[index].iov_base, iov[index].iov_len, &byte_write);
+        if (result == FR_OK)
+            count += byte_write;
+        /* the disk is full */
+        if (byte_write < iov[index].iov_len)
+            break;
+    }
+    /* restore the position and update file size */
+    f_lseek(fd, fptr);
+    file->size = f_size(fd);
+    elm_file_unlock(fd);
+
+    if (result == FR_OK || count > 0)
+        return count;
+
+    return elm_result_to_dfs(result);
+}
+
 int dfs_elm_flush(struct dfs_fd *file)
 {
     FIL *fd;
@@ -544,13 +685,17 @@ int dfs_elm_lseek(struct dfs_fd *file, rt_off_t offset)
         fd = (FIL *)(file->data);
         RT_ASSERT(fd != RT_NULL);
 
+        if (!elm_file_lock(fd))
+            return elm_result_to_dfs(FR_TIMEOUT);
         result = f_lseek(fd, offset);
         if (result == FR_OK)
         {
             /* return current position */
             file->pos = fd->fptr;
-            return fd->fptr;
+            elm_file_unlock(fd);
+            return file->pos;
         }
+        elm_file_unlock(fd);
     }
     else if (file->type == FT_DIRECTORY)
     {
@@ -793,6 +938,8 @@ static const struct dfs_filesystem_operation dfs_elm =
     dfs_elm_unlink,
     dfs_elm_stat,
     dfs_elm_rename,
+    dfs_elm_preadv,
+    dfs_elm_pwritev,
 };
 
 int elm_init(void)
@@ -22,6 +22,8 @@
  * 2013-04-15     Bernard      the first version
  * 2013-05-05     Bernard      remove CRC for ramfs persistence
  * 2013-05-22     Bernard      fix the no entry issue.
+ * 2017-07-14     agent        fix the name of renamed file.
+ * 2017-07-15     agent        add positional and vectored I/O.
  */
 
 #include <rtthread.h>
@@ -107,11 +109,16 @@ struct ramfs_dirent *dfs_ramfs_lookup(struct dfs_ramfs *ramfs,
 int dfs_ramfs_read(struct dfs_fd *file, void *buf, rt_size_t count)
 {
     rt_size_t length;
+    struct dfs_ramfs *ramfs;
     struct ramfs_dirent *dirent;
 
+    ramfs = (struct dfs_ramfs *)file->fs->data;
+    RT_ASSERT(ramfs != RT_NULL);
     dirent = (struct ramfs_dirent *)file->data;
     RT_ASSERT(dirent != RT_NULL);
 
+    /* the data may be moved by a positional write of others */
+    rt_mutex_take(&ramfs->lock, RT_WAITING_FOREVER);
     if (count < file->size - file->pos)
         length = count;
     else
@@ -119,6 +126,7 @@ int dfs_ramfs_read(struct dfs_fd *file, void *buf, rt_size_t count)
 
     if (length > 0)
         memcpy(buf, &(dirent->data[file->pos]), length);
+    rt_mutex_release(&ramfs->lock);
 
     /* update file current position */
     file->pos += length;
@@ -136,12 +144,16 @@ int dfs_ramfs_write(struct dfs_fd *fd, const void *buf, rt_size_t count)
     dirent = (struct ramfs_dirent*)fd->data;
     RT_ASSERT(dirent != RT_NULL);
 
+    /* the data may be moved by a positional write of others */
+    rt_mutex_take(&ramfs->lock, RT_WAITING_FOREVER);
     if (count + fd->pos > fd->size)
     {
         rt_uint8_t *ptr;
+
         ptr = rt_memheap_realloc(&(ramfs->memheap), dirent->data, fd->pos + count);
         if (ptr == RT_NULL)
         {
+            rt_mutex_release(&ramfs->lock);
             rt_set_errno(-RT_ENOMEM);
 
             return 0;
@@ -155,6 +167,7 @@ int dfs_ramfs_write(struct dfs_fd *fd, const void *buf, rt_size_t count)
 
     if (count > 0)
         memcpy(dirent->data + fd->pos, buf, count);
+    rt_mutex_release(&ramfs->lock);
 
     /* update file current position */
     fd->pos += count;
@@ -162,6 +175,89 @@ int dfs_ramfs_write(struct dfs_fd *fd, const void *buf, rt_size_t count)
     return count;
 }
 
+int dfs_ramfs_preadv(struct dfs_fd *file,
+                     const struct dfs_iovec *iov,
+                     int iovcnt,
+                     rt_off_t offset)
+{
+    int index;
+    rt_size_t length, count = 0;
+    struct dfs_ramfs *ramfs;
+    struct ramfs_dirent *dirent;
+
+    ramfs = (struct dfs_ramfs *)file->fs->data;
+    RT_ASSERT(ramfs != RT_NULL);
+    dirent = (struct ramfs_dirent *)file->data;
+    RT_ASSERT(dirent != RT_NULL);
+
+    /* the data may be moved by a positional write of others */
+    rt_mutex_take(&ramfs->lock, RT_WAITING_FOREVER);
+    for (index = 0; index < iovcnt && offset < (rt_off_t)dirent->size; index ++)
+    {
+        length = dirent->size - offset;
+        if (iov[index].iov_len < length)
+            length = iov[index].iov_len;
+
+        memcpy(iov[index].iov_base, &(dirent->data[offset]), length);
+        offset += length;
+        count  += length;
+    }
+    rt_mutex_release(&ramfs->lock);
+
+    return count;
+}
+
+int dfs_ramfs_pwritev(struct dfs_fd *fd,
+                      const struct dfs_iovec *iov,
+                      int iovcnt,
+                      rt_off_t offset)
+{
+    int index;
+    rt_size_t count = 0;
+    struct dfs_ramfs *ramfs;
+    struct ramfs_dirent *dirent;
+
+    ramfs = (struct dfs_ramfs*)fd->fs->data;
+    RT_ASSERT(ramfs != RT_NULL);
+    dirent = (struct ramfs_dirent*)fd->data;
+    RT_ASSERT(dirent != RT_NULL);
+
+    for (index = 0; index < iovcnt; index ++)
+        count += iov[index].iov_len;
+
+    rt_mutex_take(&ramfs->lock, RT_WAITING_FOREVER);
+    /* grow the file once for all buffers */
+    if (count + offset > dirent->size)
+    {
+        rt_uint8_t *ptr;
+        ptr = rt_memheap_realloc(&(ramfs->memheap), dirent->data, offset + count);
+        if (ptr == RT_NULL)
+        {
+            rt_mutex_release(&ramfs->lock);
+
+            return -DFS_STATUS_ENOSPC;
+        }
+
+        /* the hole before offset is filled with zero */
+        if ((rt_size_t)offset > dirent->size)
+            memset(ptr + dirent->size, 0, offset - dirent->size);
+
+        /* update dirent and file size */
+        dirent->data = ptr;
+        dirent->size = offset + count;
+        fd->size = dirent->size;
+    }
+
+    for (index = 0; index < iovcnt; index ++)
+    {
+        memcpy(dirent->data + offset, iov[index].iov_base, iov[index].iov_len);
+        offset += iov[index].iov_len;
+    }
+    rt_mutex_release(&ramfs->lock);
+
+    return count;
+}
+
 int dfs_ramfs_lseek(struct dfs_fd *file, rt_off_t offset)
 {
     if (offset <= (rt_off_t)file->size)
@@ -379,6 +475,9 @@ int dfs_ramfs_rename(struct dfs_filesystem *fs,
     if (dirent == RT_NULL)
         return -DFS_STATUS_ENOENT;
 
+    /* remove '/' separator */
+    while (*newpath == '/' && *newpath)
+        newpath ++;
     strncpy(dirent->name, newpath, RAMFS_NAME_MAX);
 
     return DFS_STATUS_OK;
@@ -387,7 +486,7 @@ int dfs_ramfs_rename(struct dfs_filesystem *fs,
 static const struct dfs_filesystem_operation _ramfs =
 {
     "ram",
-    DFS_FS_FLAG_DEFAULT,
+    DFS_FS_FLAG_DENTRY,
     dfs_ramfs_mount,
     dfs_ramfs_unmount,
     RT_NULL, /* mkfs */
@@ -404,6 +503,8 @@ static const struct dfs_filesystem_operation _ramfs =
     dfs_ramfs_unlink,
     dfs_ramfs_stat,
     dfs_ramfs_rename,
+    dfs_ramfs_preadv,
+    dfs_ramfs_pwritev,
 };
 
 int dfs_ramfs_init(void)
@@ -436,6 +537,9 @@ struct dfs_ramfs* dfs_ramfs_create(rt_uint8_t *pool, rt_size_t size)
 
     /* initialize ramfs object */
     ramfs->magic = RAMFS_MAGIC;
+    rt_mutex_init(&ramfs->lock, "ramfs", RT_IPC_FLAG_FIFO);
+    /* detach this mutex object from the system too */
+    rt_object_detach((rt_object_t)&(ramfs->lock));
 
     /* initialize root directory */
     memset(&(ramfs->root), 0x00, sizeof(ramfs->root));
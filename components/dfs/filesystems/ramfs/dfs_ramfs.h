@@ -50,6 +50,9 @@ struct dfs_ramfs
 
     struct rt_memheap memheap;
     struct ramfs_dirent root;
+
+    /* the lock of file data, which is moved when the file grows */
+    struct rt_mutex lock;
 };
 
 int dfs_ramfs_init(void);
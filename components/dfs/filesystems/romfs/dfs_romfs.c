@@ -19,6 +19,7 @@
  *
  * Change Logs:
  * Date           Author       Notes
+ * 2017-07-15     agent        add positional and vectored read.
  */
 
 #include <rtthread.h>
@@ -167,6 +168,34 @@ int dfs_romfs_read(struct dfs_fd *file, void *buf, rt_size_t count)
 	return length;
 }
 
+int dfs_romfs_preadv(struct dfs_fd *file, const struct dfs_iovec *iov, int iovcnt, rt_off_t offset)
+{
+	int index;
+	rt_size_t length, count = 0;
+	struct romfs_dirent *dirent;
+
+	dirent = (struct romfs_dirent *)file->data;
+	RT_ASSERT(dirent != RT_NULL);
+
+    if (check_dirent(dirent) != 0)
+    {
+        return -DFS_STATUS_EIO;
+    }
+
+	for (index = 0; index < iovcnt && offset < (rt_off_t)dirent->size; index ++)
+	{
+		length = dirent->size - offset;
+		if (iov[index].iov_len < length)
+			length = iov[index].iov_len;
+
+		memcpy(iov[index].iov_base, &(dirent->data[offset]), length);
+		offset += length;
+		count  += length;
+	}
+
+	return count;
+}
+
 int dfs_romfs_lseek(struct dfs_fd *file, rt_off_t offset)
 {
 	if (offset <= file->size)
@@ -298,7 +327,7 @@ int dfs_romfs_getdents(struct dfs_fd *file, struct dirent *dirp, rt_uint32_t cou
 static const struct dfs_filesystem_operation _romfs =
 {
 	"rom",
-	DFS_FS_FLAG_DEFAULT,
+	DFS_FS_FLAG_DENTRY,
 	dfs_romfs_mount,
 	dfs_romfs_unmount,
 	RT_NULL,
@@ -315,6 +344,8 @@ static const struct dfs_filesystem_operation _romfs =
 	RT_NULL,
 	dfs_romfs_stat,
 	RT_NULL,
+	dfs_romfs_preadv,
+	RT_NULL,
 };
 
 int dfs_romfs_init(void)
@@ -22,6 +22,7 @@
  * 2004-10-01     Beranard     The first version.
  * 2004-10-14     Beranard     Clean up the code.
  * 2005-01-22     Beranard     Clean up the code, port to MinGW
+ * 2017-07-15     agent        add I/O vector for vectored I/O.
  */
  
 #ifndef __DFS_DEF_H__
@@ -294,6 +295,13 @@ struct dirent
 };
 #endif
 
+/* I/O vector, it's the same layout as the struct iovec of readv/writev */
+struct dfs_iovec
+{
+    void *iov_base;              /* base address of buffer */
+    rt_size_t iov_len;           /* length of buffer */
+};
+
 /* file descriptor */
 #define DFS_FD_MAGIC	 0xfdfd
 struct dfs_fd
@@ -301,7 +309,7 @@ struct dfs_fd
     rt_uint16_t magic;           /* file descriptor magic number */
     rt_uint16_t type;            /* Type (regular or socket) */
     char *path;                  /* Name (below mount point) */
-    int ref_count;               /* Descriptor reference count */
+    volatile rt_uint32_t ref_count;  /* Descriptor reference count */
 
     struct dfs_filesystem *fs;   /* Resident file system */
 
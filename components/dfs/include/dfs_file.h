@@ -20,6 +20,8 @@
  * Change Logs:
  * Date           Author       Notes
  * 2005-01-26     Bernard      The first version.
+ * 2017-07-14     agent        add dentry cache.
+ * 2017-07-15     agent        add vectored and positional I/O.
  */
 
 #ifndef __DFS_FILE_H__
@@ -40,6 +42,25 @@ int dfs_file_flush(struct dfs_fd *fd);
 int dfs_file_lseek(struct dfs_fd *fd, rt_off_t offset);
 int dfs_file_stat(const char *path, struct stat *buf);
 int dfs_file_rename(const char *oldpath, const char *newpath);
+int dfs_file_readv(struct dfs_fd *fd, const struct dfs_iovec *iov, int iovcnt);
+int dfs_file_writev(struct dfs_fd *fd, const struct dfs_iovec *iov, int iovcnt);
+int dfs_file_preadv(struct dfs_fd *fd, const struct dfs_iovec *iov, int iovcnt, rt_off_t offset);
+int dfs_file_pwritev(struct dfs_fd *fd, const struct dfs_iovec *iov, int iovcnt, rt_off_t offset);
+
+#ifdef DFS_USING_DENTRY_CACHE
+/* the result of dentry cache lookup */
+#define DFS_DENTRY_MISS         0
+#define DFS_DENTRY_FOUND        1
+#define DFS_DENTRY_NEGATIVE     2
+
+void dfs_dentry_init(void);
+int dfs_dentry_lookup(const char *path, struct stat *buf, rt_uint32_t *generation);
+int dfs_dentry_is_negative(const char *path);
+void dfs_dentry_insert(const char *path, const struct stat *buf, rt_uint32_t generation);
+void dfs_dentry_invalidate(const char *path, int children);
+void dfs_dentry_invalidate_fd(struct dfs_fd *fd);
+void dfs_dentry_flush(void);
+#endif
 
 #endif
 
@@ -20,6 +20,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2005-02-22     Bernard      The first version.
+ * 2017-07-15     agent        add positional and vectored I/O operations.
  */
  
 #ifndef __DFS_FS_H__
@@ -29,6 +30,8 @@
 
 #define DFS_FS_FLAG_DEFAULT     0x00    /* default flag */
 #define DFS_FS_FLAG_FULLPATH    0x01    /* set full path to underlaying file system */
+#define DFS_FS_FLAG_DENTRY      0x02    /* the names are case sensitive and only
+                                         * changed by DFS, so they are cached */
 
 /* Pre-declaration */
 struct dfs_filesystem;
@@ -60,6 +63,10 @@ struct dfs_filesystem_operation
     int (*unlink)   (struct dfs_filesystem *fs, const char *pathname);
     int (*stat)     (struct dfs_filesystem *fs, const char *filename, struct stat *buf);
     int (*rename)   (struct dfs_filesystem *fs, const char *oldpath, const char *newpath);
+
+    /* the positional I/O of vector, it doesn't change the file position */
+    int (*preadv)   (struct dfs_fd *fd, const struct dfs_iovec *iov, int iovcnt, rt_off_t offset);
+    int (*pwritev)  (struct dfs_fd *fd, const struct dfs_iovec *iov, int iovcnt, rt_off_t offset);
 };
 
 /* Mounted file system */
@@ -22,6 +22,7 @@
  * 2009-05-27     Yi.qiu       The first version.
  * 2010-07-18     Bernard      add stat and statfs structure definitions. 
  * 2011-05-16     Yi.qiu       Change parameter name of rename, "new" is C++ key word.
+ * 2017-07-15     agent        add readv/writev and pread/pwrite.
  */
  
 #ifndef __DFS_POSIX_H__
@@ -118,6 +119,16 @@ int closedir(DIR* d);
 
 struct stat;
 
+/* I/O vector, it's the same layout as struct dfs_iovec */
+#if !defined(iovec) && !defined(LWIP_HDR_SOCKETS_H)
+struct iovec
+{
+    void  *iov_base;
+    size_t iov_len;
+};
+#define iovec iovec
+#endif
+
 /* file api*/
 int open(const char *file, int flags, int mode);
 int close(int d);
@@ -129,6 +140,12 @@ int read(int fd, void *buf, size_t len);
 int write(int fd, const void *buf, size_t len);
 #endif
 off_t lseek(int fd, off_t offset, int whence);
+int readv(int fd, const struct iovec *iov, int iovcnt);
+int writev(int fd, const struct iovec *iov, int iovcnt);
+int preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+int pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset);
+int pread(int fd, void *buf, size_t len, off_t offset);
+int pwrite(int fd, const void *buf, size_t len, off_t offset);
 int rename(const char *from, const char *to);
 int unlink(const char *pathname);
 int stat(const char *file, struct stat *buf);
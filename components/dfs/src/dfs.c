@@ -20,8 +20,11 @@
  * Change Logs:
  * Date           Author       Notes
  * 2005-02-22     Bernard      The first version.
+ * 2017-07-13     agent        lock-free and growable file descriptor table.
+ * 2017-07-14     agent        initialize the dentry cache.
  */
 
+#include <rthw.h>
 #include <dfs.h>
 #include <dfs_fs.h>
 #include <dfs_file.h>
@@ -37,12 +40,142 @@ static struct rt_mutex fslock;
 char working_directory[DFS_PATH_MAX] = {"/"};
 #endif
 
+/*
+ * The file descriptor table is made of chunks of DFS_FD_MAX descriptors. The
+ * first chunk is static, the others are allocated when the ones before them
+ * are full, up to DFS_FD_CHUNK_MAX chunks. A chunk is never freed, so the
+ * descriptor pointer got by fd_get() is stable.
+ *
+ * A free descriptor is claimed by setting its bit in the bitmap of chunk, and
+ * the reference count is changed by compare and swap, so fd_new(), fd_get()
+ * and fd_put() don't take the dfs_lock. Only the growth of table takes it.
+ */
+#ifndef DFS_FD_CHUNK_MAX
+#define DFS_FD_CHUNK_MAX        1
+#endif
+
+#if (DFS_FD_CHUNK_MAX > 1) && !defined(RT_USING_HEAP)
+#error "the growth of file descriptor table needs RT_USING_HEAP"
+#endif
+
 #ifdef DFS_USING_STDIO
-struct dfs_fd fd_table[3 + DFS_FD_MAX];
+#define DFS_FD_OFFSET           3
 #else
-struct dfs_fd fd_table[DFS_FD_MAX];
+#define DFS_FD_OFFSET           0
+#endif
+
+#define FD_BITMAP_WORDS         ((DFS_FD_MAX + 31) / 32)
+
+struct dfs_fd_chunk
+{
+    volatile rt_uint32_t bitmap[FD_BITMAP_WORDS];   /* the claimed descriptors */
+    struct dfs_fd fds[DFS_FD_MAX];
+};
+
+static struct dfs_fd_chunk fd_chunk;
+static struct dfs_fd_chunk *volatile fd_chunks[DFS_FD_CHUNK_MAX] = {&fd_chunk};
+
+static void fd_chunk_init(struct dfs_fd_chunk *chunk)
+{
+    rt_memset(chunk, 0, sizeof(struct dfs_fd_chunk));
+
+#if DFS_FD_MAX % 32
+    /* the bits beyond DFS_FD_MAX are never free */
+    chunk->bitmap[FD_BITMAP_WORDS - 1] = ~((1ul << (DFS_FD_MAX % 32)) - 1);
+#endif
+}
+
+#if DFS_FD_CHUNK_MAX > 1
+static struct dfs_fd_chunk *fd_chunk_grow(int index)
+{
+    struct dfs_fd_chunk *chunk;
+
+    dfs_lock();
+    /* it may be allocated by others */
+    chunk = fd_chunks[index];
+    if (chunk == RT_NULL)
+    {
+        chunk = (struct dfs_fd_chunk *)rt_malloc(sizeof(struct dfs_fd_chunk));
+        if (chunk != RT_NULL)
+        {
+            fd_chunk_init(chunk);
+
+            /* publish the chunk after it's cleared */
+            rt_hw_dmb();
+            fd_chunks[index] = chunk;
+        }
+    }
+    dfs_unlock();
+
+    return chunk;
+}
 #endif
 
+/* claim a free descriptor of chunk, return -1 if it's full */
+static int fd_chunk_claim(struct dfs_fd_chunk *chunk)
+{
+    int word, bit;
+    rt_uint32_t map;
+
+    for (word = 0; word < FD_BITMAP_WORDS; word ++)
+    {
+        do
+        {
+            map = chunk->bitmap[word];
+            bit = rt_hw_ffs((int)~map) - 1;
+            if (bit < 0)
+                break;
+        } while (!rt_hw_cas(&chunk->bitmap[word], map, map | (1ul << bit)));
+
+        if (bit >= 0)
+            return word * 32 + bit;
+    }
+
+    return -1;
+}
+
+/* give the descriptor back to the bitmap of its chunk */
+static void fd_chunk_release(struct dfs_fd *fd)
+{
+    int index, word;
+    rt_uint32_t map, bit;
+    struct dfs_fd_chunk *chunk;
+
+    for (index = 0; index < DFS_FD_CHUNK_MAX; index ++)
+    {
+        chunk = fd_chunks[index];
+        if (chunk != RT_NULL && fd >= chunk->fds && fd < chunk->fds + DFS_FD_MAX)
+            break;
+    }
+    RT_ASSERT(index < DFS_FD_CHUNK_MAX);
+
+    rt_memset(fd, 0, sizeof(struct dfs_fd));
+    /* clear the entry before it's claimed by others */
+    rt_hw_dmb();
+
+    word = (fd - chunk->fds) / 32;
+    bit  = 1ul << ((fd - chunk->fds) % 32);
+    do
+    {
+        map = chunk->bitmap[word];
+    } while (!rt_hw_cas(&chunk->bitmap[word], map, map & ~bit));
+}
+
+/* increase the reference count unless the descriptor is closed */
+static int fd_ref_get(struct dfs_fd *fd)
+{
+    rt_uint32_t ref;
+
+    do
+    {
+        ref = fd->ref_count;
+        if (ref == 0)
+            return 0;
+    } while (!rt_hw_cas(&fd->ref_count, ref, ref + 1));
+
+    return 1;
+}
+
 /**
  * @addtogroup DFS
  */
@@ -59,11 +192,15 @@ int dfs_init(void)
     /* clear filesystem table */
     rt_memset(filesystem_table, 0, sizeof(filesystem_table));
     /* clean fd table */
-    rt_memset(fd_table, 0, sizeof(fd_table));
+    fd_chunk_init(&fd_chunk);
 
     /* create device filesystem lock */
     rt_mutex_init(&fslock, "fslock", RT_IPC_FLAG_FIFO);
 
+#ifdef DFS_USING_DENTRY_CACHE
+    dfs_dentry_init();
+#endif
+
 #ifdef DFS_USING_WORKDIR
     /* set current working directory */
     rt_memset(working_directory, 0, sizeof(working_directory));
@@ -107,37 +244,39 @@ void dfs_unlock(void)
  */
 int fd_new(void)
 {
+    int index, idx;
     struct dfs_fd *d;
-    int idx;
+    struct dfs_fd_chunk *chunk;
 
-    /* lock filesystem */
-    dfs_lock();
-
-    /* find an empty fd entry */
-#ifdef DFS_USING_STDIO
-    for (idx = 3; idx < DFS_FD_MAX + 3 && fd_table[idx].ref_count > 0; idx++);
-#else
-    for (idx = 0; idx < DFS_FD_MAX && fd_table[idx].ref_count > 0; idx++);
+    /* find an empty fd entry in the chunks, grow the table if they're full */
+    for (index = 0; index < DFS_FD_CHUNK_MAX; index ++)
+    {
+        chunk = fd_chunks[index];
+#if DFS_FD_CHUNK_MAX > 1
+        if (chunk == RT_NULL)
+        {
+            chunk = fd_chunk_grow(index);
+            if (chunk == RT_NULL)
+                break;
+        }
 #endif
 
-    /* can't find an empty fd entry */
-#ifdef DFS_USING_STDIO
-    if (idx == DFS_FD_MAX + 3)
-#else
-    if (idx == DFS_FD_MAX)
-#endif
-    {
-        idx = -1;
-        goto __result;
-    }
+        idx = fd_chunk_claim(chunk);
+        if (idx >= 0)
+        {
+            d = &(chunk->fds[idx]);
+            d->magic = DFS_FD_MAGIC;
 
-    d = &(fd_table[idx]);
-    d->ref_count = 1;
-    d->magic = DFS_FD_MAGIC;
+            /* the entry is got by fd_get() after it's initialized */
+            rt_hw_dmb();
+            d->ref_count = 1;
 
-__result:
-    dfs_unlock();
-    return idx;
+            return DFS_FD_OFFSET + index * DFS_FD_MAX + idx;
+        }
+    }
+
+    /* can't find an empty fd entry */
+    return -1;
 }
 
 /**
@@ -152,29 +291,28 @@ __result:
 struct dfs_fd *fd_get(int fd)
 {
     struct dfs_fd *d;
+    struct dfs_fd_chunk *chunk;
 
-#ifdef DFS_USING_STDIO
-    if (fd < 3 || fd >= DFS_FD_MAX + 3)
+    fd -= DFS_FD_OFFSET;
+    if (fd < 0 || fd >= DFS_FD_CHUNK_MAX * DFS_FD_MAX)
         return RT_NULL;
-#else
-    if (fd < 0 || fd >= DFS_FD_MAX)
+
+    chunk = fd_chunks[fd / DFS_FD_MAX];
+    if (chunk == RT_NULL)
         return RT_NULL;
-#endif
+    d = &(chunk->fds[fd % DFS_FD_MAX]);
 
-    dfs_lock();
-    d = &fd_table[fd];
+    /* increase the reference count */
+    if (!fd_ref_get(d))
+        return RT_NULL;
 
     /* check dfs_fd valid or not */
     if (d->magic != DFS_FD_MAGIC)
     {
-        dfs_unlock();
+        fd_put(d);
         return RT_NULL;
     }
 
-    /* increase the reference count */
-    d->ref_count ++;
-    dfs_unlock();
-
     return d;
 }
 
@@ -185,17 +323,21 @@ struct dfs_fd *fd_get(int fd)
  */
 void fd_put(struct dfs_fd *fd)
 {
+    rt_uint32_t ref;
+
     RT_ASSERT(fd != RT_NULL);
 
-    dfs_lock();
-    fd->ref_count --;
+    do
+    {
+        ref = fd->ref_count;
+        RT_ASSERT(ref > 0);
+    } while (!rt_hw_cas(&fd->ref_count, ref, ref - 1));
 
     /* clear this fd entry */
-    if (fd->ref_count == 0)
+    if (ref == 1)
     {
-        rt_memset(fd, 0, sizeof(struct dfs_fd));
+        fd_chunk_release(fd);
     }
-    dfs_unlock();
 };
 
 /**
@@ -210,7 +352,7 @@ void fd_put(struct dfs_fd *fd)
 int fd_is_open(const char *pathname)
 {
     char *fullpath;
-    unsigned int index;
+    int chunk, index, result = -1;
     struct dfs_filesystem *fs;
     struct dfs_fd *fd;
 
@@ -233,32 +375,33 @@ int fd_is_open(const char *pathname)
         else
             mountpath = fullpath + strlen(fs->path);
 
-        dfs_lock();
-#ifdef DFS_USING_STDIO
-        for (index = 3; index < DFS_FD_MAX+3; index++)
-#else
-        for (index = 0; index < DFS_FD_MAX; index++)
-#endif
+        for (chunk = 0; chunk < DFS_FD_CHUNK_MAX && result != 0; chunk ++)
         {
-            fd = &(fd_table[index]);
-            if (fd->fs == RT_NULL)
-                continue;
+            if (fd_chunks[chunk] == RT_NULL)
+                break;
 
-            if (fd->fs == fs && strcmp(fd->path, mountpath) == 0)
+            for (index = 0; index < DFS_FD_MAX && result != 0; index ++)
             {
-                /* found file in file descriptor table */
-                rt_free(fullpath);
-                dfs_unlock();
+                fd = &(fd_chunks[chunk]->fds[index]);
+
+                /* hold the entry to keep it from being cleared */
+                if (!fd_ref_get(fd))
+                    continue;
 
-                return 0;
+                if (fd->fs == fs && fd->path != RT_NULL &&
+                    strcmp(fd->path, mountpath) == 0)
+                {
+                    /* found file in file descriptor table */
+                    result = 0;
+                }
+                fd_put(fd);
             }
         }
-        dfs_unlock();
 
         rt_free(fullpath);
     }
 
-    return -1;
+    return result;
 }
 
 /**
@@ -0,0 +1,377 @@
+/*
+ * File      : dfs_dentry.c
+ * This file is part of Device File System in RT-Thread RTOS
+ * COPYRIGHT (C) 2004-2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-07-14     agent        the first version.
+ */
+
+#include <dfs.h>
+#include <dfs_fs.h>
+#include <dfs_file.h>
+
+#ifdef DFS_USING_DENTRY_CACHE
+
+/*
+ * The dentry cache keeps the result of stat by the normalized full path. A
+ * positive entry holds the stat of file, a negative entry records the path
+ * doesn't exist. Both of them save the walk of directories in file system,
+ * and the stat of a normalized path in cache doesn't build the full path.
+ *
+ * Only the file systems with DFS_FS_FLAG_DENTRY are cached, whose names are
+ * case sensitive and only changed by DFS, such as ramfs and romfs. The names
+ * of devfs or a FAT volume may be changed without DFS or in another case.
+ *
+ * The stat of an opened file is not cached, so the write doesn't touch the
+ * cache. The entries are invalidated when the file is opened for write and
+ * when it's closed, when the path or its parent is unlinked or renamed, and
+ * all of them are dropped when a file system is mounted, unmounted or made.
+ */
+#ifndef DFS_DENTRY_CACHE_SIZE
+#define DFS_DENTRY_CACHE_SIZE   32
+#endif
+
+#ifndef DFS_DENTRY_PATH_MAX
+#define DFS_DENTRY_PATH_MAX     64
+#endif
+
+#define DENTRY_HASH_SIZE        ((DFS_DENTRY_CACHE_SIZE + 1) / 2)
+
+#define DENTRY_FLAG_VALID       0x01
+#define DENTRY_FLAG_NEGATIVE    0x02
+
+struct dfs_dentry
+{
+    rt_list_t hlist;                /* the list of hash bucket */
+    rt_list_t list;                 /* the LRU list */
+
+    rt_uint32_t hash;
+    rt_uint32_t flags;
+
+    struct stat stat;               /* the stat of a positive entry */
+    char path[DFS_DENTRY_PATH_MAX]; /* the normalized full path */
+};
+
+static struct dfs_dentry dentry_table[DFS_DENTRY_CACHE_SIZE];
+static rt_list_t dentry_hash[DENTRY_HASH_SIZE];
+/* the most recently used entry is at the head */
+static rt_list_t dentry_lru;
+/* it's changed when entries are invalidated */
+static rt_uint32_t dentry_generation;
+/* the number of negative entries */
+static rt_uint32_t dentry_negatives;
+
+static struct rt_mutex dentry_lock;
+
+/* the hash of prefix and path, the prefix is the mount path of file system */
+static rt_uint32_t dentry_hash_path(const char *prefix, const char *path)
+{
+    rt_uint32_t hash = 5381;
+
+    while (*prefix)
+        hash = hash * 33 + (rt_uint8_t)*prefix++;
+    while (*path)
+        hash = hash * 33 + (rt_uint8_t)*path++;
+
+    return hash;
+}
+
+static struct dfs_dentry *dentry_find(rt_uint32_t hash, const char *prefix, const char *path)
+{
+    rt_size_t length;
+    struct dfs_dentry *dentry;
+
+    length = strlen(prefix);
+    rt_list_for_each_entry(dentry, &dentry_hash[hash % DENTRY_HASH_SIZE], hlist)
+    {
+        if (dentry->hash == hash &&
+            strncmp(dentry->path, prefix, length) == 0 &&
+            strcmp(dentry->path + length, path) == 0)
+            return dentry;
+    }
+
+    return RT_NULL;
+}
+
+static void dentry_remove(struct dfs_dentry *dentry)
+{
+    rt_list_remove(&dentry->hlist);
+    if (dentry->flags & DENTRY_FLAG_NEGATIVE)
+        dentry_negatives --;
+    dentry->flags = 0;
+
+    /* the free entry is used first */
+    rt_list_remove(&dentry->list);
+    rt_list_insert_before(&dentry_lru, &dentry->list);
+}
+
+/* whether the path is the same as the one made by dfs_normalize_path */
+static int dentry_path_is_normal(const char *path)
+{
+    const char *ptr;
+
+    if (path[0] != '/')
+        return 0;
+
+    for (ptr = path; *ptr; ptr ++)
+    {
+        if (*ptr != '/')
+            continue;
+
+        /* empty name or the tailing separator */
+        if (ptr[1] == '/' || (ptr[1] == '\0' && ptr != path))
+            return 0;
+        /* the "." or ".." name */
+        if (ptr[1] == '.' && (ptr[2] == '/' || ptr[2] == '\0' ||
+            (ptr[2] == '.' && (ptr[3] == '/' || ptr[3] == '\0'))))
+            return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * this function will initialize the dentry cache.
+ */
+void dfs_dentry_init(void)
+{
+    int index;
+
+    rt_list_init(&dentry_lru);
+    for (index = 0; index < DENTRY_HASH_SIZE; index ++)
+        rt_list_init(&dentry_hash[index]);
+
+    for (index = 0; index < DFS_DENTRY_CACHE_SIZE; index ++)
+    {
+        rt_list_init(&dentry_table[index].hlist);
+        dentry_table[index].flags = 0;
+        rt_list_insert_before(&dentry_lru, &dentry_table[index].list);
+    }
+    dentry_generation = 0;
+    dentry_negatives = 0;
+
+    rt_mutex_init(&dentry_lock, "dentry", RT_IPC_FLAG_FIFO);
+}
+
+/**
+ * this function will look up a path in the dentry cache.
+ *
+ * @param path the path, it's not in the cache if it's not normalized.
+ * @param buf the buffer to save the stat of a positive entry, or RT_NULL.
+ * @param generation the generation of cache to be passed to dfs_dentry_insert
+ * after the path is got from file system, or RT_NULL.
+ *
+ * @return DFS_DENTRY_FOUND on a positive entry, DFS_DENTRY_NEGATIVE on a
+ * negative entry, DFS_DENTRY_MISS if it's not in the cache.
+ */
+int dfs_dentry_lookup(const char *path, struct stat *buf, rt_uint32_t *generation)
+{
+    int result = DFS_DENTRY_MISS;
+    struct dfs_dentry *dentry;
+
+    /* it's taken before the stat of file system */
+    if (generation != RT_NULL)
+        *generation = dentry_generation;
+
+    if (!dentry_path_is_normal(path))
+        return DFS_DENTRY_MISS;
+
+    rt_mutex_take(&dentry_lock, RT_WAITING_FOREVER);
+
+    dentry = dentry_find(dentry_hash_path("", path), "", path);
+    if (dentry != RT_NULL)
+    {
+        if (dentry->flags & DENTRY_FLAG_NEGATIVE)
+            result = DFS_DENTRY_NEGATIVE;
+        else
+        {
+            if (buf != RT_NULL)
+                rt_memcpy(buf, &dentry->stat, sizeof(struct stat));
+            result = DFS_DENTRY_FOUND;
+        }
+
+        /* move to the head of LRU list */
+        rt_list_remove(&dentry->list);
+        rt_list_insert_after(&dentry_lru, &dentry->list);
+    }
+    rt_mutex_release(&dentry_lock);
+
+    return result;
+}
+
+/**
+ * this function will check whether a path is known to be not existing by the
+ * dentry cache. It returns at once if there is no negative entry.
+ *
+ * @param path the normalized full path.
+ *
+ * @return 1 on a negative entry, otherwise 0.
+ */
+int dfs_dentry_is_negative(const char *path)
+{
+    if (dentry_negatives == 0)
+        return 0;
+
+    return dfs_dentry_lookup(path, RT_NULL, RT_NULL) == DFS_DENTRY_NEGATIVE;
+}
+
+/**
+ * this function will add a path to the dentry cache.
+ *
+ * @param path the normalized full path.
+ * @param buf the stat of path, or RT_NULL if the path doesn't exist.
+ * @param generation the generation got by dfs_dentry_lookup before the stat
+ * of file system, the entry is not added if others are invalidated after it.
+ */
+void dfs_dentry_insert(const char *path, const struct stat *buf, rt_uint32_t generation)
+{
+    rt_uint32_t hash;
+    struct dfs_dentry *dentry;
+
+    if (strlen(path) >= DFS_DENTRY_PATH_MAX)
+        return;
+
+    rt_mutex_take(&dentry_lock, RT_WAITING_FOREVER);
+    if (generation != dentry_generation)
+    {
+        rt_mutex_release(&dentry_lock);
+        return;
+    }
+
+    hash = dentry_hash_path("", path);
+    dentry = dentry_find(hash, "", path);
+    if (dentry == RT_NULL)
+    {
+        /* take the least recently used one */
+        dentry = rt_list_entry(dentry_lru.prev, struct dfs_dentry, list);
+        if (dentry->flags & DENTRY_FLAG_VALID)
+            dentry_remove(dentry);
+
+        dentry->hash = hash;
+        strcpy(dentry->path, path);
+        rt_list_insert_after(&dentry_hash[hash % DENTRY_HASH_SIZE], &dentry->hlist);
+    }
+
+    if (dentry->flags & DENTRY_FLAG_NEGATIVE)
+        dentry_negatives --;
+
+    if (buf != RT_NULL)
+    {
+        dentry->flags = DENTRY_FLAG_VALID;
+        rt_memcpy(&dentry->stat, buf, sizeof(struct stat));
+    }
+    else
+    {
+        dentry->flags = DENTRY_FLAG_VALID | DENTRY_FLAG_NEGATIVE;
+        dentry_negatives ++;
+    }
+
+    rt_list_remove(&dentry->list);
+    rt_list_insert_after(&dentry_lru, &dentry->list);
+    rt_mutex_release(&dentry_lock);
+}
+
+/**
+ * this function will invalidate a path and the paths under it in the dentry
+ * cache, when it's created, unlinked or renamed.
+ *
+ * @param path the normalized full path.
+ * @param children whether the paths under it are invalidated.
+ */
+void dfs_dentry_invalidate(const char *path, int children)
+{
+    int index;
+    rt_size_t length;
+    struct dfs_dentry *dentry;
+
+    rt_mutex_take(&dentry_lock, RT_WAITING_FOREVER);
+    dentry_generation ++;
+
+    if (children)
+    {
+        length = strlen(path);
+        for (index = 0; index < DFS_DENTRY_CACHE_SIZE; index ++)
+        {
+            dentry = &dentry_table[index];
+            if ((dentry->flags & DENTRY_FLAG_VALID) &&
+                strncmp(dentry->path, path, length) == 0 &&
+                (dentry->path[length] == '\0' || dentry->path[length] == '/'))
+                dentry_remove(dentry);
+        }
+    }
+    else
+    {
+        dentry = dentry_find(dentry_hash_path("", path), "", path);
+        if (dentry != RT_NULL)
+            dentry_remove(dentry);
+    }
+    rt_mutex_release(&dentry_lock);
+}
+
+/**
+ * this function will invalidate the path of a file descriptor in the dentry
+ * cache, when the file is changed.
+ *
+ * @param fd the file descriptor.
+ */
+void dfs_dentry_invalidate_fd(struct dfs_fd *fd)
+{
+    const char *prefix, *path;
+    struct dfs_dentry *dentry;
+
+    if (fd->fs == RT_NULL || fd->path == RT_NULL)
+        return;
+
+    /* the full path is the mount path and the path under file system */
+    prefix = fd->fs->path;
+    path   = fd->path;
+    if ((fd->fs->ops->flags & DFS_FS_FLAG_FULLPATH) ||
+        (prefix[0] == '/' && prefix[1] == '\0'))
+        prefix = "";
+    else if (path[0] == '/' && path[1] == '\0')
+        path = "";
+
+    rt_mutex_take(&dentry_lock, RT_WAITING_FOREVER);
+    dentry_generation ++;
+
+    dentry = dentry_find(dentry_hash_path(prefix, path), prefix, path);
+    if (dentry != RT_NULL)
+        dentry_remove(dentry);
+    rt_mutex_release(&dentry_lock);
+}
+
+/**
+ * this function will drop all entries of the dentry cache.
+ */
+void dfs_dentry_flush(void)
+{
+    int index;
+
+    rt_mutex_take(&dentry_lock, RT_WAITING_FOREVER);
+    dentry_generation ++;
+
+    for (index = 0; index < DFS_DENTRY_CACHE_SIZE; index ++)
+    {
+        if (dentry_table[index].flags & DENTRY_FLAG_VALID)
+            dentry_remove(&dentry_table[index]);
+    }
+    rt_mutex_release(&dentry_lock);
+}
+
+#endif
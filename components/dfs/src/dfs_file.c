@@ -22,11 +22,18 @@
  * 2005-02-22     Bernard      The first version.
  * 2011-12-08     Bernard      Merges rename patch from iamcacy.
  * 2015-05-27     Bernard      Fix the fd clear issue.
+ * 2017-07-14     agent        look up and invalidate the dentry cache.
+ * 2017-07-15     agent        add vectored and positional I/O.
  */
 
 #include <dfs.h>
 #include <dfs_file.h>
 
+#ifdef DFS_USING_DENTRY_CACHE
+/* the open flags which may create or change the file */
+#define DFS_O_MODIFY_MASK   (DFS_O_WRONLY | DFS_O_RDWR | DFS_O_CREAT | DFS_O_TRUNC | DFS_O_APPEND)
+#endif
+
 /**
  * @addtogroup FileApi
  */
@@ -61,6 +68,16 @@ int dfs_file_open(struct dfs_fd *fd, const char *path, int flags)
 
     dfs_log(DFS_DEBUG_INFO, ("open file:%s", fullpath));
 
+#ifdef DFS_USING_DENTRY_CACHE
+    /* the file is known to be not existing */
+    if (!(flags & DFS_O_MODIFY_MASK) && dfs_dentry_is_negative(fullpath))
+    {
+        rt_free(fullpath);
+
+        return -DFS_STATUS_ENOENT;
+    }
+#endif
+
     /* find filesystem */
     fs = dfs_filesystem_lookup(fullpath);
     if (fs == RT_NULL)
@@ -121,6 +138,12 @@ int dfs_file_open(struct dfs_fd *fd, const char *path, int flags)
         fd->flags |= DFS_F_DIRECTORY;
     }
 
+#ifdef DFS_USING_DENTRY_CACHE
+    /* the file may be created or truncated */
+    if (flags & DFS_O_MODIFY_MASK)
+        dfs_dentry_invalidate_fd(fd);
+#endif
+
     dfs_log(DFS_DEBUG_INFO, ("open successful"));
     return 0;
 }
@@ -146,6 +169,12 @@ int dfs_file_close(struct dfs_fd *fd)
     if (result < 0)
         return result;
 
+#ifdef DFS_USING_DENTRY_CACHE
+    /* the size and time of file may be updated on close */
+    if (fd->flags & DFS_O_MODIFY_MASK)
+        dfs_dentry_invalidate_fd(fd);
+#endif
+
     rt_free(fd->path);
     fd->path = RT_NULL;
 
@@ -275,6 +304,11 @@ int dfs_file_unlink(const char *path)
     }
     else result = -DFS_STATUS_ENOSYS;
 
+#ifdef DFS_USING_DENTRY_CACHE
+    if (result == DFS_STATUS_OK)
+        dfs_dentry_invalidate(fullpath, 1);
+#endif
+
 __exit:
     rt_free(fullpath);
     return result;
@@ -303,6 +337,124 @@ int dfs_file_write(struct dfs_fd *fd, const void *buf, rt_size_t len)
     return fs->ops->write(fd, buf, len);
 }
 
+/**
+ * this function will read data from a file descriptor to the buffers of an I/O
+ * vector, the buffers are filled in order.
+ *
+ * @param fd the file descriptor.
+ * @param iov the I/O vector.
+ * @param iovcnt the number of buffers in the I/O vector.
+ *
+ * @return the actual read data bytes, or the negative error code if nothing
+ * is read.
+ */
+int dfs_file_readv(struct dfs_fd *fd, const struct dfs_iovec *iov, int iovcnt)
+{
+    int index, result, length = 0;
+
+    if (fd == RT_NULL || iov == RT_NULL || iovcnt < 0)
+        return -DFS_STATUS_EINVAL;
+
+    for (index = 0; index < iovcnt; index ++)
+    {
+        result = dfs_file_read(fd, iov[index].iov_base, iov[index].iov_len);
+        if (result < 0)
+            return length > 0 ? length : result;
+
+        length += result;
+        /* end of file */
+        if ((rt_size_t)result < iov[index].iov_len)
+            break;
+    }
+
+    return length;
+}
+
+/**
+ * this function will write the buffers of an I/O vector to a file descriptor,
+ * the buffers are written in order.
+ *
+ * @param fd the file descriptor.
+ * @param iov the I/O vector.
+ * @param iovcnt the number of buffers in the I/O vector.
+ *
+ * @return the actual written data bytes, or the negative error code if nothing
+ * is written.
+ */
+int dfs_file_writev(struct dfs_fd *fd, const struct dfs_iovec *iov, int iovcnt)
+{
+    int index, result, length = 0;
+
+    if (fd == RT_NULL || iov == RT_NULL || iovcnt < 0)
+        return -DFS_STATUS_EINVAL;
+
+    for (index = 0; index < iovcnt; index ++)
+    {
+        result = dfs_file_write(fd, iov[index].iov_base, iov[index].iov_len);
+        if (result < 0)
+            return length > 0 ? length : result;
+
+        length += result;
+        /* the file system is full */
+        if ((rt_size_t)result < iov[index].iov_len)
+            break;
+    }
+
+    return length;
+}
+
+/**
+ * this function will read data at an offset of file to the buffers of an I/O
+ * vector. The position of file descriptor is not used and not changed, so the
+ * threads can read a shared file descriptor at the same time.
+ *
+ * @param fd the file descriptor.
+ * @param iov the I/O vector.
+ * @param iovcnt the number of buffers in the I/O vector.
+ * @param offset the offset of file to be read.
+ *
+ * @return the actual read data bytes, or the negative error code.
+ */
+int dfs_file_preadv(struct dfs_fd *fd, const struct dfs_iovec *iov, int iovcnt, rt_off_t offset)
+{
+    struct dfs_filesystem *fs;
+
+    if (fd == RT_NULL || iov == RT_NULL || iovcnt < 0 || offset < 0)
+        return -DFS_STATUS_EINVAL;
+
+    fs = fd->fs;
+    if (fs->ops->preadv == RT_NULL)
+        return -DFS_STATUS_ENOSYS;
+
+    return fs->ops->preadv(fd, iov, iovcnt, offset);
+}
+
+/**
+ * this function will write the buffers of an I/O vector at an offset of file.
+ * The position of file descriptor is not used and not changed, so the threads
+ * can write a shared file descriptor at the same time.
+ *
+ * @param fd the file descriptor.
+ * @param iov the I/O vector.
+ * @param iovcnt the number of buffers in the I/O vector.
+ * @param offset the offset of file to be written.
+ *
+ * @return the actual written data bytes, or the negative error code.
+ */
+int dfs_file_pwritev(struct dfs_fd *fd, const struct dfs_iovec *iov, int iovcnt, rt_off_t offset)
+{
+    struct dfs_filesystem *fs;
+
+    if (fd == RT_NULL || iov == RT_NULL || iovcnt < 0 || offset < 0)
+        return -DFS_STATUS_EINVAL;
+
+    fs = fd->fs;
+    if (fs->ops->pwritev == RT_NULL)
+        return -DFS_STATUS_ENOSYS;
+
+    return fs->ops->pwritev(fd, iov, iovcnt, offset);
+}
+
 /**
  * this function will flush buffer on a file descriptor.
  *
@@ -367,6 +519,14 @@ int dfs_file_stat(const char *path, struct stat *buf)
     int result;
     char *fullpath;
     struct dfs_filesystem *fs;
+#ifdef DFS_USING_DENTRY_CACHE
+    rt_uint32_t generation;
+
+    /* a normalized path in cache doesn't need the full path */
+    result = dfs_dentry_lookup(path, buf, &generation);
+    if (result != DFS_DENTRY_MISS)
+        return (result == DFS_DENTRY_FOUND) ? DFS_STATUS_OK : -DFS_STATUS_ENOENT;
+#endif
 
     fullpath = dfs_normalize_path(RT_NULL, path);
     if (fullpath == RT_NULL)
@@ -374,6 +534,19 @@ int dfs_file_stat(const char *path, struct stat *buf)
         return -1;
     }
 
+#ifdef DFS_USING_DENTRY_CACHE
+    if (strcmp(fullpath, path) != 0)
+    {
+        result = dfs_dentry_lookup(fullpath, buf, &generation);
+        if (result != DFS_DENTRY_MISS)
+        {
+            rt_free(fullpath);
+
+            return (result == DFS_DENTRY_FOUND) ? DFS_STATUS_OK : -DFS_STATUS_ENOENT;
+        }
+    }
+#endif
+
     if ((fs = dfs_filesystem_lookup(fullpath)) == RT_NULL)
     {
         dfs_log(DFS_DEBUG_ERROR,
@@ -417,6 +590,17 @@ int dfs_file_stat(const char *path, struct stat *buf)
             result = fs->ops->stat(fs, fullpath, buf);
         else
             result = fs->ops->stat(fs, dfs_subdir(fs->path, fullpath), buf);
+
+#ifdef DFS_USING_DENTRY_CACHE
+        /* the opened file may be changing, it's cached after it's closed */
+        if (fs->ops->flags & DFS_FS_FLAG_DENTRY)
+        {
+            if (result == DFS_STATUS_OK && fd_is_open(fullpath) != 0)
+                dfs_dentry_insert(fullpath, buf, generation);
+            else if (result == -DFS_STATUS_ENOENT)
+                dfs_dentry_insert(fullpath, RT_NULL, generation);
+        }
+#endif
     }
 
     rt_free(fullpath);
@@ -475,6 +659,14 @@ int dfs_file_rename(const char *oldpath, const char *newpath)
                                             dfs_subdir(oldfs->path, oldfullpath),
                                             dfs_subdir(newfs->path, newfullpath));
         }
+
+#ifdef DFS_USING_DENTRY_CACHE
+        if (result == DFS_STATUS_OK)
+        {
+            dfs_dentry_invalidate(oldfullpath, 1);
+            dfs_dentry_invalidate(newfullpath, 1);
+        }
+#endif
     }
     else
     {
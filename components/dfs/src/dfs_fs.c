@@ -22,6 +22,7 @@
  * 2005-02-22     Bernard      The first version.
  * 2010-06-30     Bernard      Optimize for RT-Thread RTOS
  * 2011-03-12     Bernard      fix the filesystem lookup issue.
+ * 2017-07-14     agent        drop the dentry cache on mount and unmount.
  */
 
 #include <dfs_fs.h>
@@ -343,6 +344,11 @@ int dfs_mount(const char   *device_name,
         goto err1;
     }
 
+#ifdef DFS_USING_DENTRY_CACHE
+    /* the paths under mount point are on the new file system */
+    dfs_dentry_flush();
+#endif
+
     return 0;
 
 err1:
@@ -407,6 +413,10 @@ int dfs_unmount(const char *specialfile)
     dfs_unlock();
     rt_free(fullpath);
 
+#ifdef DFS_USING_DENTRY_CACHE
+    dfs_dentry_flush();
+#endif
+
     return 0;
 
 err1:
@@ -426,7 +436,7 @@ err1:
  */
 int dfs_mkfs(const char *fs_name, const char *device_name)
 {
-    int index;
+    int index, result;
     rt_device_t dev_id = RT_NULL;
 
     /* check device name, and it should not be NULL */
@@ -460,7 +470,13 @@ int dfs_mkfs(const char *fs_name, const char *device_name)
             return -1;
         }
 
-        return ops->mkfs(dev_id);
+        result = ops->mkfs(dev_id);
+#ifdef DFS_USING_DENTRY_CACHE
+        /* the device may be mounted */
+        dfs_dentry_flush();
+#endif
+
+        return result;
     }
 
     rt_kprintf("Can not find the file system which named as %s.\n", fs_name);
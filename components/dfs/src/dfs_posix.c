@@ -20,6 +20,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2009-05-27     Yi.qiu       The first version
+ * 2017-07-15     agent        add readv/writev and pread/pwrite.
  */
 
 #include <dfs.h>
@@ -201,6 +202,202 @@ int write(int fd, const void *buf, size_t len)
 }
 RTM_EXPORT(write);
 
+/**
+ * this function is a POSIX compliant version, which will read data from an
+ * open file descriptor to the buffers of an I/O vector.
+ *
+ * @param fd the file descriptor.
+ * @param iov the I/O vector.
+ * @param iovcnt the number of buffers in the I/O vector.
+ *
+ * @return the actual read data bytes, 0 on end of file, or -1 on failed.
+ */
+int readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    int result;
+    struct dfs_fd *d;
+
+    /* get the fd */
+    d = fd_get(fd);
+    if (d == RT_NULL)
+    {
+        rt_set_errno(-DFS_STATUS_EBADF);
+
+        return -1;
+    }
+
+    result = dfs_file_readv(d, (const struct dfs_iovec *)iov, iovcnt);
+    fd_put(d);
+    if (result < 0)
+    {
+        rt_set_errno(result);
+
+        return -1;
+    }
+
+    return result;
+}
+RTM_EXPORT(readv);
+
+/**
+ * this function is a POSIX compliant version, which will write the buffers
+ * of an I/O vector to an open file descriptor.
+ *
+ * @param fd the file descriptor.
+ * @param iov the I/O vector.
+ * @param iovcnt the number of buffers in the I/O vector.
+ *
+ * @return the actual written data bytes, or -1 on failed.
+ */
+int writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    int result;
+    struct dfs_fd *d;
+
+    /* get the fd */
+    d = fd_get(fd);
+    if (d == RT_NULL)
+    {
+        rt_set_errno(-DFS_STATUS_EBADF);
+
+        return -1;
+    }
+
+    result = dfs_file_writev(d, (const struct dfs_iovec *)iov, iovcnt);
+    fd_put(d);
+    if (result < 0)
+    {
+        rt_set_errno(result);
+
+        return -1;
+    }
+
+    return result;
+}
+RTM_EXPORT(writev);
+
+/**
+ * this function is a POSIX compliant version, which will read data at an
+ * offset of an open file to the buffers of an I/O vector. The position of
+ * file descriptor is not changed.
+ *
+ * @param fd the file descriptor.
+ * @param iov the I/O vector.
+ * @param iovcnt the number of buffers in the I/O vector.
+ * @param offset the offset of file to be read.
+ *
+ * @return the actual read data bytes, 0 on end of file, or -1 on failed.
+ */
+int preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    int result;
+    struct dfs_fd *d;
+
+    /* get the fd */
+    d = fd_get(fd);
+    if (d == RT_NULL)
+    {
+        rt_set_errno(-DFS_STATUS_EBADF);
+
+        return -1;
+    }
+
+    result = dfs_file_preadv(d, (const struct dfs_iovec *)iov, iovcnt, offset);
+    fd_put(d);
+    if (result < 0)
+    {
+        rt_set_errno(result);
+
+        return -1;
+    }
+
+    return result;
+}
+RTM_EXPORT(preadv);
+
+/**
+ * this function is a POSIX compliant version, which will write the buffers
+ * of an I/O vector at an offset of an open file. The position of file
+ * descriptor is not changed.
+ *
+ * @param fd the file descriptor.
+ * @param iov the I/O vector.
+ * @param iovcnt the number of buffers in the I/O vector.
+ * @param offset the offset of file to be written.
+ *
+ * @return the actual written data bytes, or -1 on failed.
+ */
+int pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    int result;
+    struct dfs_fd *d;
+
+    /* get the fd */
+    d = fd_get(fd);
+    if (d == RT_NULL)
+    {
+        rt_set_errno(-DFS_STATUS_EBADF);
+
+        return -1;
+    }
+
+    result = dfs_file_pwritev(d, (const struct dfs_iovec *)iov, iovcnt, offset);
+    fd_put(d);
+    if (result < 0)
+    {
+        rt_set_errno(result);
+
+        return -1;
+    }
+
+    return result;
+}
+RTM_EXPORT(pwritev);
+
+/**
+ * this function is a POSIX compliant version, which will read data at an
+ * offset of an open file. The position of file descriptor is not changed.
+ *
+ * @param fd the file descriptor.
+ * @param buf the buffer to save the read data.
+ * @param len the maximal length of data buffer
+ * @param offset the offset of file to be read.
+ *
+ * @return the actual read data bytes, 0 on end of file, or -1 on failed.
+ */
+int pread(int fd, void *buf, size_t len, off_t offset)
+{
+    struct iovec iov;
+
+    iov.iov_base = buf;
+    iov.iov_len  = len;
+
+    return preadv(fd, &iov, 1, offset);
+}
+RTM_EXPORT(pread);
+
+/**
+ * this function is a POSIX compliant version, which will write data at an
+ * offset of an open file. The position of file descriptor is not changed.
+ *
+ * @param fd the file descriptor.
+ * @param buf the data buffer to be written.
+ * @param len the data buffer length.
+ * @param offset the offset of file to be written.
+ *
+ * @return the actual written data bytes, or -1 on failed.
+ */
+int pwrite(int fd, const void *buf, size_t len, off_t offset)
+{
+    struct iovec iov;
+
+    iov.iov_base = (void *)buf;
+    iov.iov_len  = len;
+
+    return pwritev(fd, &iov, 1, offset);
+}
+RTM_EXPORT(pwrite);
+
 /**
  * this function is a POSIX compliant version, which will seek the offset for
  * an open file descriptor.
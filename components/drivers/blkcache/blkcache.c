@@ -0,0 +1,615 @@
+/*
+ * File      : blkcache.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-07-12     agent        first version.
+ */
+
+#include <rtthread.h>
+#include <rtdevice.h>
+
+/*
+ * The block cache between the file system and a block device.
+ *
+ * The read of a sector in the cache is a copy. The missed sectors are read by
+ * one request of the device, and when the reads are sequential, the sectors
+ * after the request are read ahead in the same request. The window of
+ * read-ahead is doubled for each sequential read up to the stage buffer.
+ *
+ * The write is kept in the buffer and the buffer is put to the dirty list,
+ * which is sorted by sector. The dirty buffers are written back by the flush
+ * thread in each RT_BLK_CACHE_FLUSH_INTERVAL, or when half of buffers are
+ * dirty, or on RT_DEVICE_CTRL_BLK_SYNC, and the consecutive sectors are
+ * written by one request. So the small appends of a file, which write the
+ * same sector again and again, are written to the device once.
+ *
+ * The requests not less than the stage buffer go to the device directly, and
+ * the cached sectors in them are kept coherent.
+ */
+
+#define BLK_CACHE_HASH(sector)  ((sector) & (RT_BLK_CACHE_HASH_SIZE - 1))
+
+static struct rt_blk_cache_buf *_blk_cache_find(struct rt_blk_cache_device *cache,
+                                                rt_uint32_t                 sector)
+{
+    struct rt_list_node *node;
+    struct rt_blk_cache_buf *buf;
+    rt_list_t *bucket = &(cache->hash[BLK_CACHE_HASH(sector)]);
+
+    for (node = bucket->next; node != bucket; node = node->next)
+    {
+        buf = rt_list_entry(node, struct rt_blk_cache_buf, hash_list);
+        if (buf->sector == sector)
+            return buf;
+    }
+
+    return RT_NULL;
+}
+
+/* move the buffer to the head of LRU list */
+rt_inline void _blk_cache_touch(struct rt_blk_cache_device *cache,
+                                struct rt_blk_cache_buf    *buf)
+{
+    rt_list_remove(&(buf->list));
+    rt_list_insert_after(&(cache->lru), &(buf->list));
+}
+
+rt_inline void _blk_cache_clean(struct rt_blk_cache_device *cache,
+                                struct rt_blk_cache_buf    *buf)
+{
+    if (buf->flag & RT_BLK_CACHE_BUF_DIRTY)
+    {
+        buf->flag &= ~RT_BLK_CACHE_BUF_DIRTY;
+        rt_list_remove(&(buf->dirty_list));
+        cache->ndirty --;
+    }
+}
+
+static void _blk_cache_dirty(struct rt_blk_cache_device *cache,
+                             struct rt_blk_cache_buf    *buf)
+{
+    struct rt_list_node *node;
+
+    if (buf->flag & RT_BLK_CACHE_BUF_DIRTY)
+        return;
+
+    /* keep the sectors in order for the write back */
+    for (node = cache->dirty.next; node != &(cache->dirty); node = node->next)
+    {
+        if (rt_list_entry(node, struct rt_blk_cache_buf, dirty_list)->sector > buf->sector)
+            break;
+    }
+    rt_list_insert_before(node, &(buf->dirty_list));
+
+    buf->flag |= RT_BLK_CACHE_BUF_DIRTY;
+    cache->ndirty ++;
+}
+
+/* drop the sector from the cache, the dirty data is dropped as well */
+static void _blk_cache_invalidate(struct rt_blk_cache_device *cache,
+                                  struct rt_blk_cache_buf    *buf)
+{
+    _blk_cache_clean(cache, buf);
+
+    buf->flag = 0;
+    rt_list_remove(&(buf->hash_list));
+
+    /* the first one to reuse */
+    rt_list_remove(&(buf->list));
+    rt_list_insert_before(&(cache->lru), &(buf->list));
+}
+
+/* write back all of dirty buffers, the consecutive sectors in one request */
+static rt_err_t _blk_cache_flush(struct rt_blk_cache_device *cache)
+{
+    rt_uint32_t count, bytes;
+    struct rt_list_node *node;
+    struct rt_blk_cache_buf *buf, *first;
+
+    bytes = cache->geometry.bytes_per_sector;
+    while (!rt_list_isempty(&(cache->dirty)))
+    {
+        first = rt_list_entry(cache->dirty.next, struct rt_blk_cache_buf, dirty_list);
+
+        /* the run of consecutive sectors */
+        count = 1;
+        for (node = first->dirty_list.next; node != &(cache->dirty); node = node->next)
+        {
+            buf = rt_list_entry(node, struct rt_blk_cache_buf, dirty_list);
+            if (buf->sector != first->sector + count || count == cache->stage_sectors)
+                break;
+
+            count ++;
+        }
+
+        if (count == 1)
+        {
+            if (rt_device_write(cache->device, first->sector, first->data, 1) != 1)
+                return -RT_EIO;
+        }
+        else
+        {
+            rt_uint32_t index;
+
+            node = &(first->dirty_list);
+            for (index = 0; index < count; index ++, node = node->next)
+            {
+                buf = rt_list_entry(node, struct rt_blk_cache_buf, dirty_list);
+                rt_memcpy(cache->stage + index * bytes, buf->data, bytes);
+            }
+
+            if (rt_device_write(cache->device, first->sector, cache->stage, count) != count)
+                return -RT_EIO;
+        }
+
+        while (count --)
+        {
+            buf = rt_list_entry(cache->dirty.next, struct rt_blk_cache_buf, dirty_list);
+            _blk_cache_clean(cache, buf);
+            cache->write_back ++;
+        }
+    }
+
+    return RT_EOK;
+}
+
+/*
+ * get the least recently used buffer for a sector, there shall not be dirty
+ * buffers in the next count ones to reuse.
+ */
+static struct rt_blk_cache_buf *_blk_cache_alloc(struct rt_blk_cache_device *cache,
+                                                 rt_uint32_t                 sector)
+{
+    struct rt_blk_cache_buf *buf;
+
+    buf = rt_list_entry(cache->lru.prev, struct rt_blk_cache_buf, list);
+    RT_ASSERT(!(buf->flag & RT_BLK_CACHE_BUF_DIRTY));
+
+    if (buf->flag & RT_BLK_CACHE_BUF_VALID)
+        rt_list_remove(&(buf->hash_list));
+
+    buf->sector = sector;
+    buf->flag   = RT_BLK_CACHE_BUF_VALID;
+    rt_list_insert_after(&(cache->hash[BLK_CACHE_HASH(sector)]), &(buf->hash_list));
+    _blk_cache_touch(cache, buf);
+
+    return buf;
+}
+
+/* write back the dirty buffers if there are some in the next count ones to reuse */
+static rt_err_t _blk_cache_reserve(struct rt_blk_cache_device *cache, rt_uint32_t count)
+{
+    struct rt_list_node *node;
+
+    for (node = cache->lru.prev; node != &(cache->lru) && count > 0; node = node->prev, count --)
+    {
+        if (rt_list_entry(node, struct rt_blk_cache_buf, list)->flag & RT_BLK_CACHE_BUF_DIRTY)
+            return _blk_cache_flush(cache);
+    }
+
+    return RT_EOK;
+}
+
+static rt_err_t rt_blk_cache_init(rt_device_t dev)
+{
+    return RT_EOK;
+}
+
+static rt_err_t rt_blk_cache_open(rt_device_t dev, rt_uint16_t oflag)
+{
+    return RT_EOK;
+}
+
+static rt_err_t rt_blk_cache_close(rt_device_t dev)
+{
+    return RT_EOK;
+}
+
+static rt_size_t rt_blk_cache_read(rt_device_t dev,
+                                   rt_off_t    pos,
+                                   void       *buffer,
+                                   rt_size_t   size)
+{
+    rt_uint32_t sector, end, count, extra, index, bytes;
+    rt_uint8_t *ptr = (rt_uint8_t *)buffer;
+    struct rt_blk_cache_buf *buf;
+    struct rt_blk_cache_device *cache = (struct rt_blk_cache_device *)dev;
+
+    bytes  = cache->geometry.bytes_per_sector;
+    sector = pos;
+    end    = pos + size;
+    if (end > cache->geometry.sector_count || end < sector)
+    {
+        rt_set_errno(-RT_EIO);
+        return 0;
+    }
+
+    rt_mutex_take(&(cache->lock), RT_WAITING_FOREVER);
+
+    /* the read-ahead window of sequential reads */
+    if (sector == cache->next_sector)
+    {
+        cache->ra_sectors = cache->ra_sectors ? cache->ra_sectors * 2 : 1;
+        if (cache->ra_sectors > cache->stage_sectors)
+            cache->ra_sectors = cache->stage_sectors;
+    }
+    else
+    {
+        cache->ra_sectors = 0;
+    }
+    cache->next_sector = end;
+
+    if (size >= cache->stage_sectors)
+    {
+        /* the large read goes to device, with the newer sectors in the cache */
+        if (rt_device_read(cache->device, sector, ptr, size) != size)
+            goto _error;
+
+        for (index = 0; index < size; index ++)
+        {
+            buf = _blk_cache_find(cache, sector + index);
+            if (buf != RT_NULL)
+                rt_memcpy(ptr + index * bytes, buf->data, bytes);
+        }
+        cache->miss += size;
+
+        rt_mutex_release(&(cache->lock));
+        return size;
+    }
+
+    while (sector < end)
+    {
+        buf = _blk_cache_find(cache, sector);
+        if (buf != RT_NULL)
+        {
+            rt_memcpy(ptr, buf->data, bytes);
+            _blk_cache_touch(cache, buf);
+            cache->hit ++;
+
+            sector ++;
+            ptr += bytes;
+            continue;
+        }
+
+        /* the missed sectors */
+        for (count = 1; sector + count < end; count ++)
+        {
+            if (_blk_cache_find(cache, sector + count) != RT_NULL)
+                break;
+        }
+
+        /* and the sectors after them */
+        extra = 0;
+        if (sector + count == end)
+        {
+            while (extra < cache->ra_sectors &&
+                   count + extra < cache->stage_sectors &&
+                   end + extra < cache->geometry.sector_count &&
+                   _blk_cache_find(cache, end + extra) == RT_NULL)
+                extra ++;
+        }
+        if (count + extra > cache->nbuf)
+            extra = 0;
+
+        if (_blk_cache_reserve(cache, count + extra) != RT_EOK)
+            goto _error;
+        if (rt_device_read(cache->device, sector, cache->stage, count + extra) != count + extra)
+            goto _error;
+
+        for (index = 0; index < count + extra; index ++)
+        {
+            buf = _blk_cache_alloc(cache, sector + index);
+            rt_memcpy(buf->data, cache->stage + index * bytes, bytes);
+        }
+        rt_memcpy(ptr, cache->stage, count * bytes);
+
+        cache->miss += count;
+        cache->read_ahead += extra;
+
+        sector += count;
+        ptr += count * bytes;
+    }
+
+    rt_mutex_release(&(cache->lock));
+    return size;
+
+_error:
+    rt_mutex_release(&(cache->lock));
+    rt_set_errno(-RT_EIO);
+    return 0;
+}
+
+static rt_size_t rt_blk_cache_write(rt_device_t dev,
+                                    rt_off_t    pos,
+                                    const void *buffer,
+                                    rt_size_t   size)
+{
+    rt_uint32_t sector, index, bytes;
+    const rt_uint8_t *ptr = (const rt_uint8_t *)buffer;
+    struct rt_blk_cache_buf *buf;
+    struct rt_blk_cache_device *cache = (struct rt_blk_cache_device *)dev;
+
+    bytes  = cache->geometry.bytes_per_sector;
+    sector = pos;
+    if (sector + size > cache->geometry.sector_count || sector + size < sector)
+    {
+        rt_set_errno(-RT_EIO);
+        return 0;
+    }
+
+    rt_mutex_take(&(cache->lock), RT_WAITING_FOREVER);
+
+    if (size >= cache->stage_sectors)
+    {
+        /* the large write goes to device, and updates the sectors in the cache */
+        if (rt_device_write(cache->device, sector, ptr, size) != size)
+            goto _error;
+
+        for (index = 0; index < size; index ++)
+        {
+            buf = _blk_cache_find(cache, sector + index);
+            if (buf != RT_NULL)
+            {
+                rt_memcpy(buf->data, ptr + index * bytes, bytes);
+                _blk_cache_clean(cache, buf);
+            }
+        }
+
+        rt_mutex_release(&(cache->lock));
+        return size;
+    }
+
+    for (index = 0; index < size; index ++)
+    {
+        buf = _blk_cache_find(cache, sector + index);
+        if (buf == RT_NULL)
+        {
+            if (_blk_cache_reserve(cache, 1) != RT_EOK)
+                goto _error;
+            buf = _blk_cache_alloc(cache, sector + index);
+        }
+        else
+        {
+            _blk_cache_touch(cache, buf);
+        }
+
+        rt_memcpy(buf->data, ptr + index * bytes, bytes);
+        _blk_cache_dirty(cache, buf);
+    }
+
+    /* too many dirty buffers, write back now */
+    if (cache->ndirty >= cache->nbuf / 2)
+        rt_sem_release(&(cache->flush_sem));
+
+    rt_mutex_release(&(cache->lock));
+    return size;
+
+_error:
+    rt_mutex_release(&(cache->lock));
+    rt_set_errno(-RT_EIO);
+    return 0;
+}
+
+static rt_err_t rt_blk_cache_control(rt_device_t dev, rt_uint8_t cmd, void *args)
+{
+    rt_err_t result;
+    struct rt_blk_cache_device *cache = (struct rt_blk_cache_device *)dev;
+
+    switch (cmd)
+    {
+    case RT_DEVICE_CTRL_BLK_GETGEOME:
+        if (args == RT_NULL)
+            return -RT_ERROR;
+        rt_memcpy(args, &(cache->geometry), sizeof(struct rt_device_blk_geometry));
+        return RT_EOK;
+
+    case RT_DEVICE_CTRL_BLK_SYNC:
+        rt_mutex_take(&(cache->lock), RT_WAITING_FOREVER);
+        result = _blk_cache_flush(cache);
+        rt_mutex_release(&(cache->lock));
+        if (result != RT_EOK)
+            return result;
+        break;
+
+    case RT_DEVICE_CTRL_BLK_ERASE:
+        if (args != RT_NULL)
+        {
+            rt_uint32_t sector;
+            struct rt_blk_cache_buf *buf;
+            struct rt_device_blk_sectors *sectors = (struct rt_device_blk_sectors *)args;
+
+            /* the erased sectors are not written back */
+            rt_mutex_take(&(cache->lock), RT_WAITING_FOREVER);
+            for (sector = sectors->sector_begin; sector <= sectors->sector_end; sector ++)
+            {
+                buf = _blk_cache_find(cache, sector);
+                if (buf != RT_NULL)
+                    _blk_cache_invalidate(cache, buf);
+            }
+            rt_mutex_release(&(cache->lock));
+        }
+        break;
+    }
+
+    return rt_device_control(cache->device, cmd, args);
+}
+
+static void rt_blk_cache_flush_entry(void *parameter)
+{
+    struct rt_blk_cache_device *cache = (struct rt_blk_cache_device *)parameter;
+
+    while (!cache->quit)
+    {
+        rt_sem_take(&(cache->flush_sem),
+                    rt_tick_from_millisecond(RT_BLK_CACHE_FLUSH_INTERVAL));
+
+        rt_mutex_take(&(cache->lock), RT_WAITING_FOREVER);
+        if (_blk_cache_flush(cache) != RT_EOK)
+            rt_kprintf("blkcache: write back %s failed\n", cache->device->parent.name);
+        rt_mutex_release(&(cache->lock));
+    }
+
+    rt_completion_done(&(cache->flush_exit));
+}
+
+/**
+ * This function creates a block cache device on a block device, and registers
+ * it by the name. The file system shall be mounted on the cache device, and
+ * the block device shall not be accessed by others.
+ *
+ * @param name the name of cache device
+ * @param device the block device
+ * @param nbuf the number of sector buffers
+ *
+ * @return the cache device, RT_NULL on error
+ */
+rt_device_t rt_blk_cache_create(const char *name, rt_device_t device, rt_uint32_t nbuf)
+{
+    rt_uint32_t index;
+    struct rt_blk_cache_device *cache;
+
+    RT_ASSERT(device != RT_NULL);
+
+    if (device->type != RT_Device_Class_Block || nbuf < 4)
+        return RT_NULL;
+
+    cache = (struct rt_blk_cache_device *)rt_malloc(sizeof(struct rt_blk_cache_device));
+    if (cache == RT_NULL)
+        return RT_NULL;
+    rt_memset(cache, 0, sizeof(struct rt_blk_cache_device));
+
+    if (rt_device_open(device, RT_DEVICE_OFLAG_RDWR) != RT_EOK)
+        goto _free_cache;
+
+    if (rt_device_control(device, RT_DEVICE_CTRL_BLK_GETGEOME, &(cache->geometry)) != RT_EOK ||
+        cache->geometry.bytes_per_sector == 0)
+        goto _close;
+
+    cache->device = device;
+    cache->nbuf   = nbuf;
+    cache->stage_sectors = nbuf / 4;
+
+    cache->bufs  = (struct rt_blk_cache_buf *)rt_malloc(nbuf * sizeof(struct rt_blk_cache_buf));
+    cache->pool  = (rt_uint8_t *)rt_malloc(nbuf * cache->geometry.bytes_per_sector);
+    cache->stage = (rt_uint8_t *)rt_malloc(cache->stage_sectors * cache->geometry.bytes_per_sector);
+    if (cache->bufs == RT_NULL || cache->pool == RT_NULL || cache->stage == RT_NULL)
+        goto _free_buf;
+
+    rt_list_init(&(cache->lru));
+    rt_list_init(&(cache->dirty));
+    for (index = 0; index < RT_BLK_CACHE_HASH_SIZE; index ++)
+        rt_list_init(&(cache->hash[index]));
+    for (index = 0; index < nbuf; index ++)
+    {
+        struct rt_blk_cache_buf *buf = &(cache->bufs[index]);
+
+        buf->flag = 0;
+        buf->data = cache->pool + index * cache->geometry.bytes_per_sector;
+        rt_list_init(&(buf->hash_list));
+        rt_list_init(&(buf->dirty_list));
+        rt_list_insert_before(&(cache->lru), &(buf->list));
+    }
+    cache->next_sector = (rt_uint32_t)-1;
+
+    rt_mutex_init(&(cache->lock), name, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&(cache->flush_sem), name, 0, RT_IPC_FLAG_FIFO);
+    rt_completion_init(&(cache->flush_exit));
+
+    cache->flush_thread = rt_thread_create(name, rt_blk_cache_flush_entry, cache,
+                                           RT_BLK_CACHE_THREAD_STACK_SIZE,
+                                           RT_BLK_CACHE_THREAD_PRIORITY, 10);
+    if (cache->flush_thread == RT_NULL)
+        goto _detach;
+
+    cache->parent.type    = RT_Device_Class_Block;
+    cache->parent.init    = rt_blk_cache_init;
+    cache->parent.open    = rt_blk_cache_open;
+    cache->parent.close   = rt_blk_cache_close;
+    cache->parent.read    = rt_blk_cache_read;
+    cache->parent.write   = rt_blk_cache_write;
+    cache->parent.control = rt_blk_cache_control;
+
+    if (rt_device_register(&(cache->parent), name,
+                           RT_DEVICE_FLAG_RDWR) != RT_EOK)
+    {
+        rt_thread_delete(cache->flush_thread);
+        goto _detach;
+    }
+    rt_thread_startup(cache->flush_thread);
+
+    return &(cache->parent);
+
+_detach:
+    rt_mutex_detach(&(cache->lock));
+    rt_sem_detach(&(cache->flush_sem));
+_free_buf:
+    if (cache->bufs != RT_NULL)
+        rt_free(cache->bufs);
+    if (cache->pool != RT_NULL)
+        rt_free(cache->pool);
+    if (cache->stage != RT_NULL)
+        rt_free(cache->stage);
+_close:
+    rt_device_close(device);
+_free_cache:
+    rt_free(cache);
+
+    return RT_NULL;
+}
+RTM_EXPORT(rt_blk_cache_create);
+
+/**
+ * This function writes back the dirty sectors, and deletes the block cache
+ * device. The file system on it shall be unmounted.
+ *
+ * @param cache the cache device
+ *
+ * @return RT_EOK on success, -RT_EIO if the write back failed
+ */
+rt_err_t rt_blk_cache_delete(rt_device_t dev)
+{
+    rt_err_t result;
+    struct rt_blk_cache_device *cache = (struct rt_blk_cache_device *)dev;
+
+    RT_ASSERT(cache != RT_NULL);
+
+    rt_device_unregister(&(cache->parent));
+
+    /* the flush thread writes back the dirty sectors before exit */
+    cache->quit = RT_TRUE;
+    rt_sem_release(&(cache->flush_sem));
+    rt_completion_wait(&(cache->flush_exit), RT_WAITING_FOREVER);
+
+    result = RT_EOK;
+    if (cache->ndirty != 0)
+        result = -RT_EIO;
+
+    rt_mutex_detach(&(cache->lock));
+    rt_sem_detach(&(cache->flush_sem));
+    rt_device_close(cache->device);
+
+    rt_free(cache->bufs);
+    rt_free(cache->pool);
+    rt_free(cache->stage);
+    rt_free(cache);
+
+    return result;
+}
+RTM_EXPORT(rt_blk_cache_delete);
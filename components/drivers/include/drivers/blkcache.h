@@ -0,0 +1,108 @@
+/*
+ * File      : blkcache.h
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-07-12     agent        first version.
+ */
+
+#ifndef __BLKCACHE_H__
+#define __BLKCACHE_H__
+
+#include <rtthread.h>
+
+#ifndef RT_BLK_CACHE_FLUSH_INTERVAL
+#define RT_BLK_CACHE_FLUSH_INTERVAL     1000    /* ms */
+#endif
+
+#ifndef RT_BLK_CACHE_THREAD_STACK_SIZE
+#define RT_BLK_CACHE_THREAD_STACK_SIZE  1024
+#endif
+
+#ifndef RT_BLK_CACHE_THREAD_PRIORITY
+#define RT_BLK_CACHE_THREAD_PRIORITY    (RT_THREAD_PRIORITY_MAX - 4)
+#endif
+
+#define RT_BLK_CACHE_HASH_SIZE          32
+
+#define RT_BLK_CACHE_BUF_VALID          0x01
+#define RT_BLK_CACHE_BUF_DIRTY          0x02
+
+/*
+ * the buffer of a sector
+ */
+struct rt_blk_cache_buf
+{
+    rt_list_t   list;                       /* LRU list, the most recent one first */
+    rt_list_t   hash_list;                  /* the hash bucket of sector */
+    rt_list_t   dirty_list;                 /* dirty list, sorted by sector */
+
+    rt_uint32_t sector;
+    rt_uint32_t flag;
+    rt_uint8_t *data;
+};
+
+/*
+ * The block cache device, it wraps a block device and is a block device. The
+ * sectors are kept in LRU buffers, the sequential reads are read ahead, and
+ * the writes are kept in the buffers and written back by the flush thread,
+ * or on RT_DEVICE_CTRL_BLK_SYNC.
+ */
+struct rt_blk_cache_device
+{
+    struct rt_device parent;
+
+    rt_device_t device;                     /* the cached block device */
+    struct rt_device_blk_geometry geometry;
+
+    rt_uint32_t nbuf;
+    struct rt_blk_cache_buf *bufs;
+    rt_uint8_t *pool;                       /* the data of buffers */
+
+    /* the buffer of multi-sector transfer, for read-ahead and write-back */
+    rt_uint8_t *stage;
+    rt_uint32_t stage_sectors;
+
+    rt_list_t lru;
+    rt_list_t dirty;
+    rt_list_t hash[RT_BLK_CACHE_HASH_SIZE];
+    rt_uint32_t ndirty;
+
+    /* the sequential read detection */
+    rt_uint32_t next_sector;
+    rt_uint32_t ra_sectors;
+
+    struct rt_mutex lock;
+
+    struct rt_semaphore flush_sem;
+    struct rt_completion flush_exit;
+    rt_thread_t flush_thread;
+    rt_bool_t   quit;
+
+    /* statistics */
+    rt_uint32_t hit;
+    rt_uint32_t miss;
+    rt_uint32_t read_ahead;
+    rt_uint32_t write_back;
+};
+
+rt_device_t rt_blk_cache_create(const char *name, rt_device_t device, rt_uint32_t nbuf);
+rt_err_t rt_blk_cache_delete(rt_device_t cache);
+
+#endif
@@ -20,6 +20,7 @@
  * Change Logs:
  * Date           Author		Notes
  * 2011-07-25     weety		first version
+ * 2017-07-16     agent		add the asynchronous request of block device.
  */
 
 #ifndef __CORE_H__
@@ -227,6 +228,8 @@ int mmcsd_wait_cd_changed(rt_int32_t timeout);
 void mmcsd_host_lock(struct rt_mmcsd_host *host);
 void mmcsd_host_unlock(struct rt_mmcsd_host *host);
 void mmcsd_req_complete(struct rt_mmcsd_host *host);
+void mmcsd_start_request(struct rt_mmcsd_host *host, struct rt_mmcsd_req *req);
+void mmcsd_wait_request(struct rt_mmcsd_host *host, struct rt_mmcsd_req *req);
 void mmcsd_send_request(struct rt_mmcsd_host *host, struct rt_mmcsd_req *req);
 rt_int32_t mmcsd_send_cmd(struct rt_mmcsd_host *host, struct rt_mmcsd_cmd *cmd, int retries);
 rt_int32_t mmcsd_go_idle(struct rt_mmcsd_host *host);
@@ -249,9 +252,34 @@ struct rt_mmcsd_host *mmcsd_alloc_host(void);
 void mmcsd_free_host(struct rt_mmcsd_host *host);
 void rt_mmcsd_core_init(void);
 
+/*
+ * The asynchronous request of a mmcsd block device. The done callback is
+ * invoked in the thread of request queue when the request is finished, the
+ * requests of adjacent sectors are merged to one multi-block transfer.
+ */
+struct rt_mmcsd_blk_req
+{
+    rt_list_t    list;
+    rt_uint32_t  sector;                /* the first sector in block device */
+    rt_uint32_t  blks;                  /* the number of sectors */
+    void        *buf;
+    rt_uint32_t  flags;
+#define MMCSD_BLK_REQ_WRITE     (1 << 0)
+    rt_err_t     result;                /* RT_EOK or -RT_EIO when it's done */
+
+    void (*done)(struct rt_mmcsd_blk_req *req);
+    void        *user_data;
+
+    /* the following fields are private */
+    rt_uint32_t  pos;                   /* the next sector of card to be transferred */
+    rt_uint32_t  left;                  /* the sectors left */
+    rt_uint8_t  *ptr;                   /* the buffer of next sector */
+};
+
 void rt_mmcsd_blk_init(void);
 rt_int32_t rt_mmcsd_blk_probe(struct rt_mmcsd_card *card);
 void rt_mmcsd_blk_remove(struct rt_mmcsd_card *card);
+rt_err_t rt_mmcsd_blk_submit(rt_device_t dev, struct rt_mmcsd_blk_req *req);
 
 
 #ifdef __cplusplus
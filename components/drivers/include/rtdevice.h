@@ -21,6 +21,11 @@
  * Date           Author       Notes
  * 2012-01-08     bernard      first version.
  * 2014-07-12     bernard      Add workqueue implementation.
+ * 2017-07-08     agent        Add worker pool, priority and delayed work of
+ *                             workqueue, and the system workqueue.
+ * 2017-07-09     agent        Add lock-free ring buffer of single producer
+ *                             and single consumer.
+ * 2017-07-12     agent        Add block cache device.
  */
 
 #ifndef __RT_DEVICE_H__
@@ -147,12 +152,51 @@ struct rt_data_queue
     void (*evt_notify)(struct rt_data_queue *queue, rt_uint32_t event);
 };
 
+/*
+ * Lock-free ring buffer of single producer and single consumer. The size is
+ * power of two, and the head and tail are free running indexes, so the data
+ * length is head - tail without mirror bit. The head is only written by the
+ * producer and the tail is only written by the consumer.
+ */
+struct rt_spsc_ring
+{
+    rt_uint8_t *buffer_ptr;
+    rt_uint32_t buffer_size;
+
+    volatile rt_uint32_t head;      /* write index of producer */
+    volatile rt_uint32_t tail;      /* read index of consumer */
+};
+
 /* workqueue implementation */
-struct rt_workqueue
+#define RT_WORK_STATE_PENDING       0x01    /* the work is in the pending list */
+#define RT_WORK_STATE_DELAYED       0x02    /* the work is in the delayed list */
+
+/* the works run in order of priority, the lower value the higher priority */
+#define RT_WORK_PRIORITY_DEFAULT    128
+
+struct rt_workqueue_worker
 {
-	rt_list_t      work_list;
+	rt_thread_t    thread;
 	struct rt_work *work_current; /* current work */
-	rt_thread_t    work_thread;
+	rt_uint8_t     requeue;       /* the current work is submitted again */
+	struct rt_workqueue *queue;
+};
+
+struct rt_workqueue
+{
+	rt_list_t      work_list;     /* pending works, in order of priority */
+	rt_list_t      delayed_list;  /* delayed works, in order of timeout */
+
+	struct rt_semaphore sem;      /* the number of pending works */
+	struct rt_semaphore flush_sem; /* the waiters of flush and cancel */
+	rt_uint16_t    flush_waiters;
+	struct rt_semaphore exit_sem; /* the exited workers */
+
+	struct rt_timer timer;        /* timer of the first delayed work */
+
+	rt_uint8_t     workers;
+	rt_uint8_t     quit;          /* the workers exit */
+	struct rt_workqueue_worker *worker;
 };
 
 struct rt_work
@@ -161,6 +205,10 @@ struct rt_work
 
 	void (*work_func)(struct rt_work* work, void* work_data);
 	void *work_data;
+
+	rt_uint8_t  priority;
+	rt_uint8_t  flags;
+	rt_tick_t   timeout_tick;     /* timeout of delayed work */
 };
 
 /**
@@ -243,6 +291,41 @@ rt_inline rt_uint16_t rt_ringbuffer_data_len(struct rt_ringbuffer *rb)
 /** return the size of empty space in rb */
 #define rt_ringbuffer_space_len(rb) ((rb)->buffer_size - rt_ringbuffer_data_len(rb))
 
+/**
+ * Lock-free ring buffer of single producer and single consumer
+ *
+ * The producer and consumer could be in thread or interrupt without
+ * interrupt disabled, only one of each at the same time. The producer could
+ * reserve a contiguous region, write it directly (such as by DMA) and commit
+ * it. The consumer could peek the contiguous data and release it after use.
+ */
+rt_err_t rt_spsc_ring_init(struct rt_spsc_ring *ring,
+                           rt_uint8_t          *pool,
+                           rt_uint32_t          size);
+void rt_spsc_ring_reset(struct rt_spsc_ring *ring);
+rt_size_t rt_spsc_ring_put(struct rt_spsc_ring *ring,
+                           const rt_uint8_t    *ptr,
+                           rt_size_t            length);
+rt_size_t rt_spsc_ring_get(struct rt_spsc_ring *ring,
+                           rt_uint8_t          *ptr,
+                           rt_size_t            length);
+rt_size_t rt_spsc_ring_reserve(struct rt_spsc_ring *ring, rt_uint8_t **ptr);
+void rt_spsc_ring_commit(struct rt_spsc_ring *ring, rt_size_t length);
+rt_size_t rt_spsc_ring_peek(struct rt_spsc_ring *ring, rt_uint8_t **ptr);
+void rt_spsc_ring_release(struct rt_spsc_ring *ring, rt_size_t length);
+
+/** return the size of data in ring */
+rt_inline rt_uint32_t rt_spsc_ring_data_len(struct rt_spsc_ring *ring)
+{
+    return ring->head - ring->tail;
+}
+
+/** return the size of empty space in ring */
+rt_inline rt_uint32_t rt_spsc_ring_space_len(struct rt_spsc_ring *ring)
+{
+    return ring->buffer_size - (ring->head - ring->tail);
+}
+
 /**
  * Pipe Device
  */
@@ -299,9 +382,16 @@ void rt_data_queue_reset(struct rt_data_queue *queue);
  * WorkQueue for DeviceDriver
  */
 struct rt_workqueue *rt_workqueue_create(const char* name, rt_uint16_t stack_size, rt_uint8_t priority);
+struct rt_workqueue *rt_workqueue_create_pool(const char* name, rt_uint8_t workers,
+                                              rt_uint16_t stack_size, rt_uint8_t priority);
 rt_err_t rt_workqueue_destroy(struct rt_workqueue* queue);
 rt_err_t rt_workqueue_dowork(struct rt_workqueue* queue, struct rt_work* work);
+rt_err_t rt_workqueue_submit_delayed(struct rt_workqueue* queue, struct rt_work* work, rt_tick_t time);
+rt_err_t rt_workqueue_critical_work(struct rt_workqueue* queue, struct rt_work* work);
 rt_err_t rt_workqueue_cancel_work(struct rt_workqueue* queue, struct rt_work* work);
+rt_err_t rt_workqueue_cancel_work_sync(struct rt_workqueue* queue, struct rt_work* work);
+rt_err_t rt_workqueue_cancel_all_work(struct rt_workqueue* queue);
+rt_err_t rt_workqueue_flush(struct rt_workqueue* queue);
 
 rt_inline void rt_work_init(struct rt_work* work, void (*work_func)(struct rt_work* work, void* work_data),
     void* work_data)
@@ -309,7 +399,20 @@ rt_inline void rt_work_init(struct rt_work* work, void (*work_func)(struct rt_wo
     rt_list_init(&(work->list));
     work->work_func = work_func;
     work->work_data = work_data;
+    work->priority  = RT_WORK_PRIORITY_DEFAULT;
+    work->flags     = 0;
+}
+
+rt_inline void rt_work_set_priority(struct rt_work* work, rt_uint8_t priority)
+{
+    work->priority = priority;
 }
+
+#ifdef RT_USING_SYSTEM_WORKQUEUE
+/* the works on the system workqueue shared by drivers */
+rt_err_t rt_work_submit(struct rt_work* work, rt_tick_t time);
+rt_err_t rt_work_cancel(struct rt_work* work);
+#endif
 #endif
 
 #ifdef RT_USING_RTC
@@ -362,6 +465,10 @@ rt_inline void rt_work_init(struct rt_work* work, void (*work_func)(struct rt_wo
 #include "drivers/watchdog.h"
 #endif
 
+#ifdef RT_USING_BLK_CACHE
+#include "drivers/blkcache.h"
+#endif
+
 #ifdef RT_USING_PIN
 #include "drivers/pin.h"
 #endif
@@ -20,15 +20,89 @@
  * Change Logs:
  * Date           Author        Notes
  * 2011-07-25     weety     first version
+ * 2017-07-16     agent     add request queue with merging and ACMD23.
  */
 
 #include <rtthread.h>
 #include <dfs_fs.h>
 
 #include <drivers/mmcsd_core.h>
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+#include <rtdevice.h>
+#endif
 
 static rt_list_t blk_devices = RT_LIST_OBJECT_INIT(blk_devices);
 
+#ifndef RT_MMCSD_MAX_PARTITION
+#define RT_MMCSD_MAX_PARTITION 16
+#endif
+
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+#ifndef RT_MMCSD_BLK_MERGE_SECTORS
+#define RT_MMCSD_BLK_MERGE_SECTORS      8
+#endif
+
+#ifndef RT_MMCSD_BLK_THREAD_STACK_SIZE
+#define RT_MMCSD_BLK_THREAD_STACK_SIZE  1024
+#endif
+
+#ifndef RT_MMCSD_BLK_THREAD_PRIORITY
+#if (RT_THREAD_PRIORITY_MAX == 32)
+#define RT_MMCSD_BLK_THREAD_PRIORITY    0x16
+#else
+#define RT_MMCSD_BLK_THREAD_PRIORITY    0x40
+#endif
+#endif
+
+/*
+ * a transfer of one multi-block command, it finishes the merged requests of
+ * adjacent sectors, or transfers a part of a request larger than the host
+ * can do in one command.
+ */
+struct mmcsd_blk_xfer
+{
+    rt_list_t reqs;                     /* the requests finished by this transfer */
+    struct rt_mmcsd_blk_req *part;      /* the request of which a part is transferred */
+
+    rt_uint32_t sector;                 /* the first sector of card */
+    rt_uint32_t blks;
+    rt_uint8_t  dir;                    /* 0: read, 1: write */
+    rt_uint8_t *buf;
+
+    /* the buffer of the merged requests which are not adjacent in memory */
+    rt_uint8_t *bounce;
+    rt_bool_t   bounced;
+
+    struct rt_mmcsd_req  req;
+    struct rt_mmcsd_cmd  cmd, stop;
+    struct rt_mmcsd_data data;
+};
+
+/*
+ * The request queue of a card, it's shared by the partitions of card. The
+ * thread of queue makes the next transfer while the current one is running
+ * on host, so the host starts the next one as soon as the current one is
+ * finished. A synchronous read or write serves the queue in the context of
+ * caller when the queue is idle, and the thread is woken for the requests
+ * left by it.
+ */
+struct mmcsd_blk_queue
+{
+    struct rt_mmcsd_card *card;
+
+    rt_list_t pending;                  /* the submitted requests, in order */
+    struct rt_mutex lock;
+    struct rt_semaphore sem;
+    rt_bool_t idle;                     /* no one serves the queue */
+    rt_bool_t quit;
+
+    struct mmcsd_blk_xfer xfer[2];
+
+    rt_thread_t thread;
+    struct rt_completion exit;
+};
+#endif
+
 struct mmcsd_blk_device
 {
     struct rt_mmcsd_card *card;
@@ -36,11 +110,10 @@ struct mmcsd_blk_device
     struct rt_device dev;
     struct dfs_partition part;
     struct rt_device_blk_geometry geometry;
-};
-
-#ifndef RT_MMCSD_MAX_PARTITION
-#define RT_MMCSD_MAX_PARTITION 16
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    struct mmcsd_blk_queue *queue;
 #endif
+};
 
 static rt_int32_t mmcsd_num_wr_blocks(struct rt_mmcsd_card *card)
 {
@@ -103,95 +176,145 @@ static rt_int32_t mmcsd_num_wr_blocks(struct rt_mmcsd_card *card)
     return blocks;
 }
 
-static rt_err_t rt_mmcsd_req_blk(struct rt_mmcsd_card *card,
-                                 rt_uint32_t           sector,
-                                 void                 *buf,
-                                 rt_size_t             blks,
-                                 rt_uint8_t            dir)
+/* pre-erase the sectors of a multi-block write of SD card, it's a hint only */
+static void mmcsd_set_wr_blk_erase_count(struct rt_mmcsd_card *card, rt_uint32_t blks)
 {
-    void *aligned_buf;
-    
-    struct rt_mmcsd_cmd  cmd, stop;
-    struct rt_mmcsd_data  data;
-    struct rt_mmcsd_req  req;
-    struct rt_mmcsd_host *host = card->host;
-    rt_uint32_t r_cmd, w_cmd;
+    struct rt_mmcsd_cmd cmd;
 
-    mmcsd_host_lock(host);
-    rt_memset(&req, 0, sizeof(struct rt_mmcsd_req));
     rt_memset(&cmd, 0, sizeof(struct rt_mmcsd_cmd));
-    rt_memset(&stop, 0, sizeof(struct rt_mmcsd_cmd));
-    rt_memset(&data, 0, sizeof(struct rt_mmcsd_data));
-    req.cmd = &cmd;
-    req.data = &data;
+
+    cmd.cmd_code = APP_CMD;
+    cmd.arg = card->rca << 16;
+    cmd.flags = RESP_SPI_R1 | RESP_R1 | CMD_AC;
+
+    if (mmcsd_send_cmd(card->host, &cmd, 0))
+        return;
+    if (!controller_is_spi(card->host) && !(cmd.resp[0] & R1_APP_CMD))
+        return;
+
+    rt_memset(&cmd, 0, sizeof(struct rt_mmcsd_cmd));
+
+    cmd.cmd_code = SD_APP_SET_WR_BLK_ERASE_COUNT;
+    cmd.arg = blks & 0x7FFFFF;
+    cmd.flags = RESP_SPI_R1 | RESP_R1 | CMD_AC;
+
+    mmcsd_send_cmd(card->host, &cmd, 0);
+}
+
+static void mmcsd_blk_req_init(struct rt_mmcsd_card *card,
+                               struct rt_mmcsd_req  *req,
+                               struct rt_mmcsd_cmd  *cmd,
+                               struct rt_mmcsd_cmd  *stop,
+                               struct rt_mmcsd_data *data,
+                               rt_uint32_t           sector,
+                               void                 *buf,
+                               rt_size_t             blks,
+                               rt_uint8_t            dir)
+{
+    rt_uint32_t r_cmd, w_cmd;
+
+    rt_memset(req, 0, sizeof(struct rt_mmcsd_req));
+    rt_memset(cmd, 0, sizeof(struct rt_mmcsd_cmd));
+    rt_memset(stop, 0, sizeof(struct rt_mmcsd_cmd));
+    rt_memset(data, 0, sizeof(struct rt_mmcsd_data));
+    req->cmd = cmd;
+    req->data = data;
     
-    cmd.arg = sector;
+    cmd->arg = sector;
     if (!(card->flags & CARD_FLAG_SDHC)) 
     {
-        cmd.arg <<= 9;
+        cmd->arg <<= 9;
     }
-    cmd.flags = RESP_SPI_R1 | RESP_R1 | CMD_ADTC;
+    cmd->flags = RESP_SPI_R1 | RESP_R1 | CMD_ADTC;
 
-    data.blksize = SECTOR_SIZE;
-    data.blks  = blks;
+    data->blksize = SECTOR_SIZE;
+    data->blks  = blks;
 
     if (blks > 1) 
     {
         if (!controller_is_spi(card->host) || !dir)
         {
-            req.stop = &stop;
-            stop.cmd_code = STOP_TRANSMISSION;
-            stop.arg = 0;
-            stop.flags = RESP_SPI_R1B | RESP_R1B | CMD_AC;
+            req->stop = stop;
+            stop->cmd_code = STOP_TRANSMISSION;
+            stop->arg = 0;
+            stop->flags = RESP_SPI_R1B | RESP_R1B | CMD_AC;
         }
         r_cmd = READ_MULTIPLE_BLOCK;
         w_cmd = WRITE_MULTIPLE_BLOCK;
     }
     else
     {
-        req.stop = RT_NULL;
+        req->stop = RT_NULL;
         r_cmd = READ_SINGLE_BLOCK;
         w_cmd = WRITE_BLOCK;
     }
 
     if (!dir) 
     {
-        cmd.cmd_code = r_cmd;
-        data.flags |= DATA_DIR_READ;
+        cmd->cmd_code = r_cmd;
+        data->flags |= DATA_DIR_READ;
     }
     else
     {
-        cmd.cmd_code = w_cmd;
-        data.flags |= DATA_DIR_WRITE;
+        cmd->cmd_code = w_cmd;
+        data->flags |= DATA_DIR_WRITE;
     }
 
-    mmcsd_set_data_timeout(&data, card);
-    data.buf = buf;
-    mmcsd_send_request(host, &req);
+    mmcsd_set_data_timeout(data, card);
+    data->buf = buf;
+}
 
-    if (!controller_is_spi(card->host) && dir != 0) 
+/* wait for the card to be ready for data after a write */
+static void mmcsd_blk_wait_ready(struct rt_mmcsd_card *card)
+{
+    struct rt_mmcsd_cmd cmd;
+
+    if (controller_is_spi(card->host))
+        return;
+
+    rt_memset(&cmd, 0, sizeof(struct rt_mmcsd_cmd));
+    do 
     {
-        do 
+        rt_int32_t err;
+
+        cmd.cmd_code = SEND_STATUS;
+        cmd.arg = card->rca << 16;
+        cmd.flags = RESP_R1 | CMD_AC;
+        err = mmcsd_send_cmd(card->host, &cmd, 5);
+        if (err) 
         {
-            rt_int32_t err;
+            rt_kprintf("error %d requesting status\n", err);
+            break;
+        }
+        /*
+         * Some cards mishandle the status bits,
+         * so make sure to check both the busy
+         * indication and the card state.
+         */
+     } while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
+        (R1_CURRENT_STATE(cmd.resp[0]) == 7));
+}
 
-            cmd.cmd_code = SEND_STATUS;
-            cmd.arg = card->rca << 16;
-            cmd.flags = RESP_R1 | CMD_AC;
-            err = mmcsd_send_cmd(card->host, &cmd, 5);
-            if (err) 
-            {
-                rt_kprintf("error %d requesting status\n", err);
-                break;
-            }
-            /*
-             * Some cards mishandle the status bits,
-             * so make sure to check both the busy
-             * indication and the card state.
-             */
-         } while (!(cmd.resp[0] & R1_READY_FOR_DATA) ||
-            (R1_CURRENT_STATE(cmd.resp[0]) == 7));
-    }
+static rt_err_t rt_mmcsd_req_blk(struct rt_mmcsd_card *card,
+                                 rt_uint32_t           sector,
+                                 void                 *buf,
+                                 rt_size_t             blks,
+                                 rt_uint8_t            dir)
+{
+    struct rt_mmcsd_cmd  cmd, stop;
+    struct rt_mmcsd_data  data;
+    struct rt_mmcsd_req  req;
+    struct rt_mmcsd_host *host = card->host;
+
+    mmcsd_host_lock(host);
+    if (dir && blks > 1 && card->card_type == CARD_TYPE_SD)
+        mmcsd_set_wr_blk_erase_count(card, blks);
+
+    mmcsd_blk_req_init(card, &req, &cmd, &stop, &data, sector, buf, blks, dir);
+    mmcsd_send_request(host, &req);
+
+    if (dir != 0) 
+        mmcsd_blk_wait_ready(card);
 
     mmcsd_host_unlock(host);
 
@@ -207,6 +330,487 @@ static rt_err_t rt_mmcsd_req_blk(struct rt_mmcsd_card *card,
     return RT_EOK;
 }
 
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+/* whether the request must be done before the other one */
+static rt_bool_t mmcsd_blk_req_ordered(struct rt_mmcsd_blk_req *req,
+                                       struct rt_mmcsd_blk_req *other)
+{
+    /* the request of 0 sector is the barrier of others */
+    if (req->left == 0 || other->left == 0)
+        return RT_TRUE;
+
+    /* two reads are in any order */
+    if (!(req->flags & MMCSD_BLK_REQ_WRITE) && !(other->flags & MMCSD_BLK_REQ_WRITE))
+        return RT_FALSE;
+
+    return req->pos < other->pos + other->left && other->pos < req->pos + req->left;
+}
+
+/*
+ * make a transfer from the pending requests, the first one and the following
+ * requests of the adjacent sectors, which are not ordered after the requests
+ * left in the queue.
+ */
+static rt_bool_t mmcsd_blk_xfer_make(struct mmcsd_blk_queue *queue,
+                                     struct mmcsd_blk_xfer  *xfer)
+{
+    rt_uint32_t max;
+    rt_list_t *node, *prev;
+    struct rt_mmcsd_blk_req *head, *req, *other;
+
+    rt_list_init(&xfer->reqs);
+    xfer->part    = RT_NULL;
+    xfer->blks    = 0;
+    xfer->bounced = RT_FALSE;
+
+    max = queue->card->host->max_blk_count;
+    if (max == 0)
+        max = 1;
+
+    rt_mutex_take(&queue->lock, RT_WAITING_FOREVER);
+    if (rt_list_isempty(&queue->pending))
+    {
+        rt_mutex_release(&queue->lock);
+
+        return RT_FALSE;
+    }
+
+    head = rt_list_entry(queue->pending.next, struct rt_mmcsd_blk_req, list);
+    xfer->dir    = (head->flags & MMCSD_BLK_REQ_WRITE) ? 1 : 0;
+    xfer->sector = head->pos;
+    xfer->buf    = head->ptr;
+    if (head->left > max)
+    {
+        /* the request is left in queue for the rest */
+        xfer->blks = max;
+        xfer->part = head;
+        head->pos  += max;
+        head->ptr  += max * SECTOR_SIZE;
+        head->left -= max;
+        rt_mutex_release(&queue->lock);
+
+        return RT_TRUE;
+    }
+
+    xfer->blks = head->left;
+    rt_list_remove(&head->list);
+    rt_list_insert_before(&xfer->reqs, &head->list);
+    /* the barrier is done after the transfers before it */
+    if (head->left == 0)
+    {
+        rt_mutex_release(&queue->lock);
+
+        return RT_TRUE;
+    }
+
+    for (node = queue->pending.next; node != &queue->pending; node = node->next)
+    {
+        req = rt_list_entry(node, struct rt_mmcsd_blk_req, list);
+        if (req->left == 0)
+            break;
+
+        if (((req->flags & MMCSD_BLK_REQ_WRITE) ? 1 : 0) != xfer->dir ||
+            req->pos != xfer->sector + xfer->blks ||
+            xfer->blks + req->left > max)
+            continue;
+
+        /* the buffer is adjacent, or the data is copied to bounce buffer */
+        if (xfer->bounced || req->ptr != xfer->buf + xfer->blks * SECTOR_SIZE)
+        {
+            if (xfer->bounce == RT_NULL ||
+                xfer->blks + req->left > RT_MMCSD_BLK_MERGE_SECTORS)
+                continue;
+        }
+
+        for (prev = queue->pending.next; prev != node; prev = prev->next)
+        {
+            other = rt_list_entry(prev, struct rt_mmcsd_blk_req, list);
+            if (mmcsd_blk_req_ordered(other, req))
+                break;
+        }
+        if (prev != node)
+            continue;
+
+        if (req->ptr != xfer->buf + xfer->blks * SECTOR_SIZE)
+            xfer->bounced = RT_TRUE;
+
+        xfer->blks += req->left;
+        node = node->prev;
+        rt_list_remove(&req->list);
+        rt_list_insert_before(&xfer->reqs, &req->list);
+    }
+    rt_mutex_release(&queue->lock);
+
+    if (xfer->bounced)
+    {
+        rt_uint8_t *ptr = xfer->bounce;
+
+        /* the data of requests is gathered in bounce buffer */
+        rt_list_for_each_entry(req, &xfer->reqs, list)
+        {
+            if (xfer->dir)
+                rt_memcpy(ptr, req->ptr, req->left * SECTOR_SIZE);
+            ptr += req->left * SECTOR_SIZE;
+        }
+        xfer->buf = xfer->bounce;
+    }
+
+    return RT_TRUE;
+}
+
+static void mmcsd_blk_xfer_start(struct mmcsd_blk_queue *queue,
+                                 struct mmcsd_blk_xfer  *xfer)
+{
+    struct rt_mmcsd_card *card = queue->card;
+
+    mmcsd_host_lock(card->host);
+    if (xfer->dir && xfer->blks > 1 && card->card_type == CARD_TYPE_SD)
+        mmcsd_set_wr_blk_erase_count(card, xfer->blks);
+
+    mmcsd_blk_req_init(card, &xfer->req, &xfer->cmd, &xfer->stop, &xfer->data,
+                       xfer->sector, xfer->buf, xfer->blks, xfer->dir);
+    mmcsd_start_request(card->host, &xfer->req);
+}
+
+static rt_err_t mmcsd_blk_xfer_wait(struct mmcsd_blk_queue *queue,
+                                   struct mmcsd_blk_xfer  *xfer)
+{
+    struct rt_mmcsd_card *card = queue->card;
+
+    mmcsd_wait_request(card->host, &xfer->req);
+    if (xfer->dir)
+        mmcsd_blk_wait_ready(card);
+    mmcsd_host_unlock(card->host);
+
+    if (xfer->cmd.err || xfer->data.err || xfer->stop.err)
+    {
+        rt_kprintf("mmcsd request blocks error\n");
+        rt_kprintf("%d,%d,%d, 0x%08x,0x%08x\n", xfer->cmd.err, xfer->data.err,
+                   xfer->stop.err, xfer->data.flags, xfer->sector);
+
+        return -RT_EIO;
+    }
+
+    return RT_EOK;
+}
+
+static void mmcsd_blk_xfer_done(struct mmcsd_blk_xfer *xfer, rt_err_t result)
+{
+    rt_uint8_t *ptr = xfer->bounce;
+    struct rt_mmcsd_blk_req *req;
+
+    if (xfer->part != RT_NULL && result != RT_EOK)
+        xfer->part->result = result;
+
+    while (!rt_list_isempty(&xfer->reqs))
+    {
+        req = rt_list_entry(xfer->reqs.next, struct rt_mmcsd_blk_req, list);
+        rt_list_remove(&req->list);
+
+        /* the data is scattered from bounce buffer */
+        if (xfer->bounced)
+        {
+            if (!xfer->dir && result == RT_EOK)
+                rt_memcpy(req->ptr, ptr, req->left * SECTOR_SIZE);
+            ptr += req->left * SECTOR_SIZE;
+        }
+
+        if (req->result == RT_EOK)
+            req->result = result;
+        if (req->done != RT_NULL)
+            req->done(req);
+    }
+}
+
+/* whether the request is finished by the transfer */
+static rt_bool_t mmcsd_blk_xfer_has(struct mmcsd_blk_xfer   *xfer,
+                                    struct rt_mmcsd_blk_req *req)
+{
+    rt_list_t *node;
+
+    for (node = xfer->reqs.next; node != &xfer->reqs; node = node->next)
+    {
+        if (node == &req->list)
+            return RT_TRUE;
+    }
+
+    return RT_FALSE;
+}
+
+/*
+ * finish the pending requests until the queue is empty, or until the request
+ * until is done if it's not RT_NULL. It's invoked by the one who serves the
+ * queue only.
+ */
+static void mmcsd_blk_queue_serve(struct mmcsd_blk_queue  *queue,
+                                  struct rt_mmcsd_blk_req *until)
+{
+    rt_err_t result;
+    rt_bool_t more;
+    struct mmcsd_blk_xfer *xfer, *next, *temp;
+
+    xfer = &queue->xfer[0];
+    next = &queue->xfer[1];
+
+    more = mmcsd_blk_xfer_make(queue, xfer);
+    while (more)
+    {
+        result = RT_EOK;
+        if (xfer->blks > 0)
+            mmcsd_blk_xfer_start(queue, xfer);
+
+        /* make the next one while the current one is running */
+        if (until != RT_NULL && mmcsd_blk_xfer_has(xfer, until))
+            more = RT_FALSE;
+        else
+            more = mmcsd_blk_xfer_make(queue, next);
+
+        if (xfer->blks > 0)
+            result = mmcsd_blk_xfer_wait(queue, xfer);
+        mmcsd_blk_xfer_done(xfer, result);
+
+        temp = xfer;
+        xfer = next;
+        next = temp;
+    }
+}
+
+static void mmcsd_blk_queue_entry(void *parameter)
+{
+    struct mmcsd_blk_queue *queue = (struct mmcsd_blk_queue *)parameter;
+
+    while (1)
+    {
+        rt_mutex_take(&queue->lock, RT_WAITING_FOREVER);
+        if (rt_list_isempty(&queue->pending))
+        {
+            if (queue->quit)
+            {
+                rt_mutex_release(&queue->lock);
+                break;
+            }
+
+            queue->idle = RT_TRUE;
+            rt_mutex_release(&queue->lock);
+
+            rt_sem_take(&queue->sem, RT_WAITING_FOREVER);
+            continue;
+        }
+        rt_mutex_release(&queue->lock);
+
+        mmcsd_blk_queue_serve(queue, RT_NULL);
+    }
+
+    rt_completion_done(&queue->exit);
+}
+
+/* serve the queue in the context of caller if it's idle */
+static rt_bool_t mmcsd_blk_queue_claim(struct mmcsd_blk_queue *queue)
+{
+    rt_bool_t idle;
+
+    rt_mutex_take(&queue->lock, RT_WAITING_FOREVER);
+    idle = queue->idle;
+    queue->idle = RT_FALSE;
+    rt_mutex_release(&queue->lock);
+
+    return idle;
+}
+
+/* the thread serves the requests left by the caller */
+static void mmcsd_blk_queue_unclaim(struct mmcsd_blk_queue *queue)
+{
+    rt_mutex_take(&queue->lock, RT_WAITING_FOREVER);
+    if (!rt_list_isempty(&queue->pending) || queue->quit)
+        rt_sem_release(&queue->sem);
+    else
+        queue->idle = RT_TRUE;
+    rt_mutex_release(&queue->lock);
+}
+
+static struct mmcsd_blk_queue *mmcsd_blk_queue_create(struct rt_mmcsd_card *card)
+{
+    int index;
+    struct mmcsd_blk_queue *queue;
+
+    queue = rt_calloc(1, sizeof(struct mmcsd_blk_queue));
+    if (queue == RT_NULL)
+        return RT_NULL;
+
+    queue->card = card;
+    queue->idle = RT_FALSE;
+    queue->quit = RT_FALSE;
+    rt_list_init(&queue->pending);
+    rt_mutex_init(&queue->lock, "sd_blkq", RT_IPC_FLAG_FIFO);
+    rt_sem_init(&queue->sem, "sd_blkq", 0, RT_IPC_FLAG_FIFO);
+    rt_completion_init(&queue->exit);
+
+    /* the requests are merged without bounce buffer if it's failed */
+    for (index = 0; index < 2 && RT_MMCSD_BLK_MERGE_SECTORS > 1; index ++)
+        queue->xfer[index].bounce = rt_malloc(RT_MMCSD_BLK_MERGE_SECTORS * SECTOR_SIZE);
+
+    queue->thread = rt_thread_create("sd_blkq", mmcsd_blk_queue_entry, queue,
+                                     RT_MMCSD_BLK_THREAD_STACK_SIZE,
+                                     RT_MMCSD_BLK_THREAD_PRIORITY, 20);
+    if (queue->thread == RT_NULL)
+    {
+        rt_mutex_detach(&queue->lock);
+        rt_sem_detach(&queue->sem);
+        rt_free(queue->xfer[0].bounce);
+        rt_free(queue->xfer[1].bounce);
+        rt_free(queue);
+
+        return RT_NULL;
+    }
+    rt_thread_startup(queue->thread);
+
+    return queue;
+}
+
+/* the pending requests are finished before it's destroyed */
+static void mmcsd_blk_queue_destroy(struct mmcsd_blk_queue *queue)
+{
+    rt_mutex_take(&queue->lock, RT_WAITING_FOREVER);
+    queue->quit = RT_TRUE;
+    if (queue->idle)
+    {
+        queue->idle = RT_FALSE;
+        rt_sem_release(&queue->sem);
+    }
+    rt_mutex_release(&queue->lock);
+
+    rt_completion_wait(&queue->exit, RT_WAITING_FOREVER);
+
+    rt_mutex_detach(&queue->lock);
+    rt_sem_detach(&queue->sem);
+    rt_free(queue->xfer[0].bounce);
+    rt_free(queue->xfer[1].bounce);
+    rt_free(queue);
+}
+
+static void mmcsd_blk_sync_done(struct rt_mmcsd_blk_req *req)
+{
+    rt_completion_done((struct rt_completion *)req->user_data);
+}
+#endif
+
+/**
+ * this function will submit a request to a mmcsd block device, the request
+ * is finished asynchronously and the done callback is invoked then. The
+ * request and its buffer shall be kept until it's done.
+ *
+ * A request of 0 sector is done after all of the requests submitted before
+ * it, and the requests after it are not merged with the ones before it.
+ *
+ * The request is finished before return if the request queue is disabled.
+ *
+ * @param dev the mmcsd block device.
+ * @param req the request.
+ *
+ * @return RT_EOK on successful submission.
+ */
+rt_err_t rt_mmcsd_blk_submit(rt_device_t dev, struct rt_mmcsd_blk_req *req)
+{
+    struct mmcsd_blk_device *blk_dev;
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    struct mmcsd_blk_queue *queue;
+#endif
+
+    RT_ASSERT(dev != RT_NULL);
+    RT_ASSERT(req != RT_NULL);
+
+    blk_dev = (struct mmcsd_blk_device *)dev->user_data;
+    RT_ASSERT(blk_dev != RT_NULL);
+
+    req->result = RT_EOK;
+    req->pos    = blk_dev->part.offset + req->sector;
+    req->left   = req->blks;
+    req->ptr    = (rt_uint8_t *)req->buf;
+
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    queue = blk_dev->queue;
+    if (queue != RT_NULL)
+    {
+        rt_mutex_take(&queue->lock, RT_WAITING_FOREVER);
+        rt_list_insert_before(&queue->pending, &req->list);
+        if (queue->idle)
+        {
+            queue->idle = RT_FALSE;
+            rt_sem_release(&queue->sem);
+        }
+        rt_mutex_release(&queue->lock);
+
+        return RT_EOK;
+    }
+#endif
+
+    if (req->blks > 0)
+    {
+        rt_sem_take(blk_dev->part.lock, RT_WAITING_FOREVER);
+        if (rt_mmcsd_req_blk(blk_dev->card, req->pos, req->buf, req->blks,
+                             (req->flags & MMCSD_BLK_REQ_WRITE) ? 1 : 0) != RT_EOK)
+            req->result = -RT_EIO;
+        rt_sem_release(blk_dev->part.lock);
+    }
+    if (req->done != RT_NULL)
+        req->done(req);
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_mmcsd_blk_submit);
+
+static rt_err_t mmcsd_blk_rw(struct mmcsd_blk_device *blk_dev,
+                             rt_uint32_t              sector,
+                             void                    *buf,
+                             rt_size_t                blks,
+                             rt_uint8_t               dir)
+{
+    rt_err_t err;
+
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    if (blk_dev->queue != RT_NULL)
+    {
+        rt_bool_t claimed;
+        struct rt_completion done;
+        struct rt_mmcsd_blk_req req;
+
+        /*
+         * The caller does the request itself if the queue is idle, without
+         * the switches to the thread of queue and the priority of it.
+         */
+        claimed = mmcsd_blk_queue_claim(blk_dev->queue);
+
+        rt_completion_init(&done);
+        rt_memset(&req, 0, sizeof(struct rt_mmcsd_blk_req));
+        req.sector    = sector;
+        req.blks      = blks;
+        req.buf       = buf;
+        req.flags     = dir ? MMCSD_BLK_REQ_WRITE : 0;
+        req.done      = mmcsd_blk_sync_done;
+        req.user_data = &done;
+
+        rt_mmcsd_blk_submit(&blk_dev->dev, &req);
+        if (claimed)
+        {
+            mmcsd_blk_queue_serve(blk_dev->queue, &req);
+            mmcsd_blk_queue_unclaim(blk_dev->queue);
+        }
+        rt_completion_wait(&done, RT_WAITING_FOREVER);
+
+        return req.result;
+    }
+#endif
+
+    if (blks == 0)
+        return RT_EOK;
+
+    rt_sem_take(blk_dev->part.lock, RT_WAITING_FOREVER);
+    err = rt_mmcsd_req_blk(blk_dev->card, blk_dev->part.offset + sector, buf, blks, dir);
+    rt_sem_release(blk_dev->part.lock);
+
+    return err;
+}
+
 static rt_err_t rt_mmcsd_init(rt_device_t dev)
 {
     return RT_EOK;
@@ -230,6 +834,9 @@ static rt_err_t rt_mmcsd_control(rt_device_t dev, rt_uint8_t cmd, void *args)
     case RT_DEVICE_CTRL_BLK_GETGEOME:
         rt_memcpy(args, &blk_dev->geometry, sizeof(struct rt_device_blk_geometry));
         break;
+    case RT_DEVICE_CTRL_BLK_SYNC:
+        /* wait for the submitted requests */
+        return mmcsd_blk_rw(blk_dev, 0, RT_NULL, 0, 1);
     default:
         break;
     }
@@ -243,7 +850,6 @@ static rt_size_t rt_mmcsd_read(rt_device_t dev,
 {
     rt_err_t err;
     struct mmcsd_blk_device *blk_dev = (struct mmcsd_blk_device *)dev->user_data;
-    struct dfs_partition *part = &blk_dev->part;
 
     if (dev == RT_NULL)
     {
@@ -252,9 +858,7 @@ static rt_size_t rt_mmcsd_read(rt_device_t dev,
         return 0;
     }
 
-    rt_sem_take(part->lock, RT_WAITING_FOREVER);
-    err = rt_mmcsd_req_blk(blk_dev->card, part->offset + pos, buffer, size, 0);
-    rt_sem_release(part->lock);
+    err = mmcsd_blk_rw(blk_dev, pos, buffer, size, 0);
 
     /* the length of reading must align to SECTOR SIZE */
     if (err) 
@@ -272,7 +876,6 @@ static rt_size_t rt_mmcsd_write(rt_device_t dev,
 {
     rt_err_t err;
     struct mmcsd_blk_device *blk_dev = (struct mmcsd_blk_device *)dev->user_data;
-    struct dfs_partition *part = &blk_dev->part;
 
     if (dev == RT_NULL)
     {
@@ -281,9 +884,7 @@ static rt_size_t rt_mmcsd_write(rt_device_t dev,
         return 0;
     }
 
-    rt_sem_take(part->lock, RT_WAITING_FOREVER);
-    err = rt_mmcsd_req_blk(blk_dev->card, part->offset + pos, (void *)buffer, size, 1);
-    rt_sem_release(part->lock);
+    err = mmcsd_blk_rw(blk_dev, pos, (void *)buffer, size, 1);
 
     /* the length of reading must align to SECTOR SIZE */
     if (err) 
@@ -329,6 +930,10 @@ rt_int32_t rt_mmcsd_blk_probe(struct rt_mmcsd_card *card)
     char dname[4];
     char sname[8];
     struct mmcsd_blk_device *blk_dev = RT_NULL;
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    struct mmcsd_blk_queue *queue;
+    rt_bool_t queue_used = RT_FALSE;
+#endif
 
     err = mmcsd_set_blksize(card);
     if(err) 
@@ -350,6 +955,13 @@ rt_int32_t rt_mmcsd_blk_probe(struct rt_mmcsd_card *card)
     status = rt_mmcsd_req_blk(card, 0, sector, 1, 0);
     if (status == RT_EOK)
     {
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+        /* the partitions share one request queue of card */
+        queue = mmcsd_blk_queue_create(card);
+        if (queue == RT_NULL)
+            rt_kprintf("mmcsd: create request queue failed!\n");
+#endif
+
         for (i = 0; i < RT_MMCSD_MAX_PARTITION; i++)
         {
             blk_dev = rt_calloc(1, sizeof(struct mmcsd_blk_device));
@@ -378,6 +990,10 @@ rt_int32_t rt_mmcsd_blk_probe(struct rt_mmcsd_card *card)
                 blk_dev->dev.user_data = blk_dev;
 
                 blk_dev->card = card;
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+                blk_dev->queue = queue;
+                queue_used = RT_TRUE;
+#endif
                 
                 blk_dev->geometry.bytes_per_sector = 1<<9;
                 blk_dev->geometry.block_size = card->card_blksize;
@@ -407,6 +1023,10 @@ rt_int32_t rt_mmcsd_blk_probe(struct rt_mmcsd_card *card)
                     blk_dev->dev.user_data = blk_dev;
 
                     blk_dev->card = card;
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+                    blk_dev->queue = queue;
+                    queue_used = RT_TRUE;
+#endif
 
                     blk_dev->geometry.bytes_per_sector = 1<<9;
                     blk_dev->geometry.block_size = card->card_blksize;
@@ -436,6 +1056,11 @@ rt_int32_t rt_mmcsd_blk_probe(struct rt_mmcsd_card *card)
             }
 #endif
         }
+
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+        if (queue != RT_NULL && !queue_used)
+            mmcsd_blk_queue_destroy(queue);
+#endif
     }
     else
     {
@@ -453,8 +1078,11 @@ void rt_mmcsd_blk_remove(struct rt_mmcsd_card *card)
 {
     rt_list_t *l, *n;
     struct mmcsd_blk_device *blk_dev;
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    struct mmcsd_blk_queue *queue = RT_NULL;
+#endif
 
-    for (l = (&blk_devices)->next, n = l->next; l != &blk_devices; l = n)
+    for (l = (&blk_devices)->next, n = l->next; l != &blk_devices; l = n, n = l->next)
     {
         blk_dev = (struct mmcsd_blk_device *)rt_list_entry(l, struct mmcsd_blk_device, list);
         if (blk_dev->card == card) 
@@ -468,9 +1096,18 @@ void rt_mmcsd_blk_remove(struct rt_mmcsd_card *card)
 
             rt_device_unregister(&blk_dev->dev);
             rt_list_remove(&blk_dev->list);
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+            queue = blk_dev->queue;
+#endif
             rt_free(blk_dev);
         }
     }
+
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    /* the partitions of card are removed */
+    if (queue != RT_NULL)
+        mmcsd_blk_queue_destroy(queue);
+#endif
 }
 
 /*
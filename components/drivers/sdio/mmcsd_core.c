@@ -20,6 +20,7 @@
  * Change Logs:
  * Date           Author        Notes
  * 2011-07-25     weety         first version
+ * 2017-07-16     agent         split the start and wait of request.
  */
 
 #include <rtthread.h>
@@ -62,31 +63,56 @@ void mmcsd_req_complete(struct rt_mmcsd_host *host)
     rt_sem_release(&host->sem_ack);
 }
 
-void mmcsd_send_request(struct rt_mmcsd_host *host, struct rt_mmcsd_req *req)
+/**
+ * this function will start a request on host, and return without waiting
+ * for it. The request shall be waited by mmcsd_wait_request before others
+ * are sent, the host lock is held by caller until then.
+ *
+ * @param host the host.
+ * @param req the request.
+ */
+void mmcsd_start_request(struct rt_mmcsd_host *host, struct rt_mmcsd_req *req)
 {
-    do {
-        req->cmd->retries--;
-        req->cmd->err = 0;
-        req->cmd->mrq = req;
-        if (req->data)
-        {   
-            req->cmd->data = req->data;
-            req->data->err = 0;
-            req->data->mrq = req;
-            if (req->stop)
-            {
-                req->data->stop = req->stop;
-                req->stop->err = 0;
-                req->stop->mrq = req;
-            }       
-        }
-        host->ops->request(host, req);
+    req->cmd->retries--;
+    req->cmd->err = 0;
+    req->cmd->mrq = req;
+    if (req->data)
+    {   
+        req->cmd->data = req->data;
+        req->data->err = 0;
+        req->data->mrq = req;
+        if (req->stop)
+        {
+            req->data->stop = req->stop;
+            req->stop->err = 0;
+            req->stop->mrq = req;
+        }       
+    }
+    host->ops->request(host, req);
+}
 
-        rt_sem_take(&host->sem_ack, RT_WAITING_FOREVER);
-          
-    } while(req->cmd->err && (req->cmd->retries > 0));
+/**
+ * this function will wait for the completion of a started request, it's
+ * started again on command error if there are retries left.
+ *
+ * @param host the host.
+ * @param req the request.
+ */
+void mmcsd_wait_request(struct rt_mmcsd_host *host, struct rt_mmcsd_req *req)
+{
+    rt_sem_take(&host->sem_ack, RT_WAITING_FOREVER);
 
+    while (req->cmd->err && (req->cmd->retries > 0))
+    {
+        mmcsd_start_request(host, req);
+        rt_sem_take(&host->sem_ack, RT_WAITING_FOREVER);
+    }
+}
 
+void mmcsd_send_request(struct rt_mmcsd_host *host, struct rt_mmcsd_req *req)
+{
+    mmcsd_start_request(host, req);
+    mmcsd_wait_request(host, req);
 }
 
 rt_int32_t mmcsd_send_cmd(struct rt_mmcsd_host *host,
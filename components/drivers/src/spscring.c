@@ -0,0 +1,243 @@
+/*
+ * File      : spscring.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-07-09     agent        first version.
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <string.h>
+
+/*
+ * The head is only written by the producer and the tail is only written by
+ * the consumer, so neither of them needs a lock or disabled interrupt.
+ *
+ * The producer reads the tail, then writes the data and publishes it by the
+ * head. The consumer reads the head, then reads the data and gives the space
+ * back by the tail. The barriers keep the data accesses between the index
+ * accesses, on the other CPU or bus master as well.
+ */
+
+/**
+ * initialize a lock-free ring buffer
+ *
+ * @param ring the ring buffer object
+ * @param pool the buffer pool
+ * @param size the size of pool, it shall be power of two
+ *
+ * @return RT_EOK on success, -RT_ERROR if the size is not power of two
+ */
+rt_err_t rt_spsc_ring_init(struct rt_spsc_ring *ring,
+                           rt_uint8_t          *pool,
+                           rt_uint32_t          size)
+{
+    RT_ASSERT(ring != RT_NULL);
+
+    if (size == 0 || (size & (size - 1)) != 0)
+        return -RT_ERROR;
+
+    ring->buffer_ptr  = pool;
+    ring->buffer_size = size;
+    ring->head = ring->tail = 0;
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_spsc_ring_init);
+
+/**
+ * reset the ring buffer to empty, neither the producer nor the consumer shall
+ * be running.
+ */
+void rt_spsc_ring_reset(struct rt_spsc_ring *ring)
+{
+    RT_ASSERT(ring != RT_NULL);
+
+    ring->head = ring->tail = 0;
+}
+RTM_EXPORT(rt_spsc_ring_reset);
+
+/**
+ * get the contiguous free space at the head of ring buffer, by the producer.
+ *
+ * @param ring the ring buffer object
+ * @param ptr the start of free space
+ *
+ * @return the length of contiguous free space, which may be less than the
+ * whole free space when it wraps around.
+ */
+rt_size_t rt_spsc_ring_reserve(struct rt_spsc_ring *ring, rt_uint8_t **ptr)
+{
+    rt_uint32_t head, space, offset;
+
+    RT_ASSERT(ring != RT_NULL);
+
+    head  = ring->head;
+    space = ring->buffer_size - (head - ring->tail);
+    /* the space is not written until the consumer has done with it */
+    rt_hw_dmb();
+
+    offset = head & (ring->buffer_size - 1);
+    if (space > ring->buffer_size - offset)
+        space = ring->buffer_size - offset;
+
+    *ptr = &ring->buffer_ptr[offset];
+    return space;
+}
+RTM_EXPORT(rt_spsc_ring_reserve);
+
+/**
+ * publish the data written to the reserved space, by the producer.
+ *
+ * @param ring the ring buffer object
+ * @param length the length of data, not more than the reserved one
+ */
+void rt_spsc_ring_commit(struct rt_spsc_ring *ring, rt_size_t length)
+{
+    RT_ASSERT(ring != RT_NULL);
+    RT_ASSERT(length <= rt_spsc_ring_space_len(ring));
+
+    /* the data is observed before the head */
+    rt_hw_dmb();
+    ring->head = ring->head + length;
+}
+RTM_EXPORT(rt_spsc_ring_commit);
+
+/**
+ * get the contiguous data at the tail of ring buffer, by the consumer.
+ *
+ * @param ring the ring buffer object
+ * @param ptr the start of data
+ *
+ * @return the length of contiguous data, which may be less than the whole
+ * data when it wraps around.
+ */
+rt_size_t rt_spsc_ring_peek(struct rt_spsc_ring *ring, rt_uint8_t **ptr)
+{
+    rt_uint32_t tail, length, offset;
+
+    RT_ASSERT(ring != RT_NULL);
+
+    tail   = ring->tail;
+    length = ring->head - tail;
+    /* the data is not read before the head */
+    rt_hw_dmb();
+
+    offset = tail & (ring->buffer_size - 1);
+    if (length > ring->buffer_size - offset)
+        length = ring->buffer_size - offset;
+
+    *ptr = &ring->buffer_ptr[offset];
+    return length;
+}
+RTM_EXPORT(rt_spsc_ring_peek);
+
+/**
+ * give the space of data back to the producer, by the consumer.
+ *
+ * @param ring the ring buffer object
+ * @param length the length of data, not more than the peeked one
+ */
+void rt_spsc_ring_release(struct rt_spsc_ring *ring, rt_size_t length)
+{
+    RT_ASSERT(ring != RT_NULL);
+    RT_ASSERT(length <= rt_spsc_ring_data_len(ring));
+
+    /* the data is read before the space is given back */
+    rt_hw_dmb();
+    ring->tail = ring->tail + length;
+}
+RTM_EXPORT(rt_spsc_ring_release);
+
+/**
+ * put a block of data into ring buffer, by the producer.
+ *
+ * @return the length of data put, which is less than length when the ring
+ * buffer is full.
+ */
+rt_size_t rt_spsc_ring_put(struct rt_spsc_ring *ring,
+                           const rt_uint8_t    *ptr,
+                           rt_size_t            length)
+{
+    rt_uint32_t head, space, offset, size;
+
+    RT_ASSERT(ring != RT_NULL);
+
+    head  = ring->head;
+    space = ring->buffer_size - (head - ring->tail);
+    rt_hw_dmb();
+
+    if (length > space)
+        length = space;
+    if (length == 0)
+        return 0;
+
+    /* copy in two parts when it wraps around */
+    offset = head & (ring->buffer_size - 1);
+    size   = ring->buffer_size - offset;
+    if (size > length)
+        size = length;
+    memcpy(&ring->buffer_ptr[offset], ptr, size);
+    memcpy(&ring->buffer_ptr[0], &ptr[size], length - size);
+
+    rt_hw_dmb();
+    ring->head = head + length;
+
+    return length;
+}
+RTM_EXPORT(rt_spsc_ring_put);
+
+/**
+ * get a block of data from ring buffer, by the consumer.
+ *
+ * @return the length of data got, which is less than length when there is
+ * not so much data.
+ */
+rt_size_t rt_spsc_ring_get(struct rt_spsc_ring *ring,
+                           rt_uint8_t          *ptr,
+                           rt_size_t            length)
+{
+    rt_uint32_t tail, data, offset, size;
+
+    RT_ASSERT(ring != RT_NULL);
+
+    tail = ring->tail;
+    data = ring->head - tail;
+    rt_hw_dmb();
+
+    if (length > data)
+        length = data;
+    if (length == 0)
+        return 0;
+
+    offset = tail & (ring->buffer_size - 1);
+    size   = ring->buffer_size - offset;
+    if (size > length)
+        size = length;
+    memcpy(ptr, &ring->buffer_ptr[offset], size);
+    memcpy(&ptr[size], &ring->buffer_ptr[0], length - size);
+
+    rt_hw_dmb();
+    ring->tail = tail + length;
+
+    return length;
+}
+RTM_EXPORT(rt_spsc_ring_get);
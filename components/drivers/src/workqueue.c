@@ -20,6 +20,8 @@
  * Change Logs:
  * Date           Author       Notes
  * 2017-02-27     bernard      fix the re-work issue.
+ * 2017-07-08     agent        add worker pool, priority, delayed work, flush
+ *                             and the system workqueue.
  */
 
 #include <rthw.h>
@@ -27,148 +29,573 @@
 #include <rtdevice.h>
 
 #ifdef RT_USING_HEAP
+/*
+ * The pending works are sorted by priority, and the workers of queue take
+ * them in turn. The semaphore of queue counts the pending works.
+ *
+ * A work is never run by two workers at the same time. When it's submitted
+ * while running, it's put to the pending list again after the run. A work
+ * submitted while it's pending or delayed is merged to the one pending.
+ *
+ * The delayed works are sorted by timeout, and the timer of queue is set to
+ * the timeout of the first one.
+ */
+
+/* the worker running the work, invoked with interrupt disabled */
+static struct rt_workqueue_worker *_workqueue_running(struct rt_workqueue *queue,
+                                                      struct rt_work *work)
+{
+    int index;
+
+    for (index = 0; index < queue->workers; index ++)
+    {
+        if (queue->worker[index].work_current == work)
+            return &(queue->worker[index]);
+    }
+
+    return RT_NULL;
+}
+
+/* the current thread is a worker of queue */
+static rt_bool_t _workqueue_is_worker(struct rt_workqueue *queue)
+{
+    int index;
+
+    for (index = 0; index < queue->workers; index ++)
+    {
+        if (queue->worker[index].thread == rt_thread_self())
+            return RT_TRUE;
+    }
+
+    return RT_FALSE;
+}
+
+/* the queue has pending or running works, invoked with interrupt disabled */
+static rt_bool_t _workqueue_is_busy(struct rt_workqueue *queue)
+{
+    int index;
+
+    if (!rt_list_isempty(&(queue->work_list)))
+        return RT_TRUE;
+
+    for (index = 0; index < queue->workers; index ++)
+    {
+        if (queue->worker[index].work_current != RT_NULL)
+            return RT_TRUE;
+    }
+
+    return RT_FALSE;
+}
+
+/*
+ * take the flush waiters if the queue is idle, invoked with interrupt
+ * disabled. They are woken up by _workqueue_wakeup after interrupt enabled.
+ */
+static rt_uint16_t _workqueue_idle_waiters(struct rt_workqueue *queue)
+{
+    rt_uint16_t waiters = 0;
+
+    if (!_workqueue_is_busy(queue))
+    {
+        waiters = queue->flush_waiters;
+        queue->flush_waiters = 0;
+    }
+
+    return waiters;
+}
+
+static void _workqueue_wakeup(struct rt_workqueue *queue, rt_uint16_t waiters)
+{
+    while (waiters --)
+        rt_sem_release(&(queue->flush_sem));
+}
+
+static void _workqueue_insert(struct rt_workqueue *queue, struct rt_work *work,
+                              rt_bool_t critical)
+{
+    struct rt_list_node *node;
+
+    node = queue->work_list.next;
+    if (!critical)
+    {
+        /* after the works of the same priority */
+        while (node != &(queue->work_list) &&
+               rt_list_entry(node, struct rt_work, list)->priority <= work->priority)
+            node = node->next;
+    }
+
+    rt_list_insert_before(node, &(work->list));
+    work->flags |= RT_WORK_STATE_PENDING;
+}
+
+/*
+ * submit the work, invoked with interrupt disabled. It returns RT_TRUE if the
+ * work is put to the pending list, the workers shall be woken up.
+ */
+static rt_bool_t _workqueue_submit(struct rt_workqueue *queue, struct rt_work *work,
+                                   rt_bool_t critical)
+{
+    struct rt_workqueue_worker *worker;
+
+    /* merged to the pending one */
+    if (work->flags & RT_WORK_STATE_PENDING)
+        return RT_FALSE;
+
+    if (work->flags & RT_WORK_STATE_DELAYED)
+    {
+        /* run it now */
+        rt_list_remove(&(work->list));
+        work->flags &= ~RT_WORK_STATE_DELAYED;
+    }
+
+    worker = _workqueue_running(queue, work);
+    if (worker != RT_NULL)
+    {
+        /* run it again after the current run */
+        worker->requeue = 1;
+        return RT_FALSE;
+    }
+
+    _workqueue_insert(queue, work, critical);
+
+    return RT_TRUE;
+}
+
+/*
+ * remove the work from queue, invoked with interrupt disabled. It returns the
+ * flush waiters to be woken up if the queue becomes idle.
+ */
+static rt_uint16_t _workqueue_cancel(struct rt_workqueue *queue, struct rt_work *work)
+{
+    struct rt_workqueue_worker *worker;
+
+    if (work->flags & (RT_WORK_STATE_PENDING | RT_WORK_STATE_DELAYED))
+    {
+        rt_list_remove(&(work->list));
+        work->flags &= ~(RT_WORK_STATE_PENDING | RT_WORK_STATE_DELAYED);
+    }
+
+    worker = _workqueue_running(queue, work);
+    if (worker != RT_NULL)
+        worker->requeue = 0;
+
+    return _workqueue_idle_waiters(queue);
+}
+
+/* wait for the work done or the queue idle, invoked with interrupt disabled */
+static rt_base_t _workqueue_wait(struct rt_workqueue *queue, struct rt_work *work,
+                                 rt_base_t level)
+{
+    while (work != RT_NULL ? _workqueue_running(queue, work) != RT_NULL :
+                             _workqueue_is_busy(queue))
+    {
+        queue->flush_waiters ++;
+        rt_hw_interrupt_enable(level);
+
+        rt_sem_take(&(queue->flush_sem), RT_WAITING_FOREVER);
+
+        level = rt_hw_interrupt_disable();
+    }
+
+    return level;
+}
+
+static void _workqueue_timeout(void *parameter)
+{
+    rt_base_t level;
+    rt_tick_t tick, time;
+    rt_uint32_t wakeup = 0;
+    struct rt_work *work;
+    struct rt_workqueue *queue;
+
+    queue = (struct rt_workqueue *)parameter;
+
+    level = rt_hw_interrupt_disable();
+
+    tick = rt_tick_get();
+    while (!rt_list_isempty(&(queue->delayed_list)))
+    {
+        work = rt_list_entry(queue->delayed_list.next, struct rt_work, list);
+        if (tick - work->timeout_tick >= RT_TICK_MAX / 2)
+            break;
+
+        rt_list_remove(&(work->list));
+        work->flags &= ~RT_WORK_STATE_DELAYED;
+        if (_workqueue_submit(queue, work, RT_FALSE))
+            wakeup ++;
+    }
+
+    if (rt_list_isempty(&(queue->delayed_list)))
+        rt_timer_stop(&(queue->timer));
+    else
+    {
+        /* the periodic timer restarts in the time of the next one */
+        work = rt_list_entry(queue->delayed_list.next, struct rt_work, list);
+        time = work->timeout_tick - tick;
+        rt_timer_control(&(queue->timer), RT_TIMER_CTRL_SET_TIME, &time);
+    }
+
+    rt_hw_interrupt_enable(level);
+
+    while (wakeup --)
+        rt_sem_release(&(queue->sem));
+}
+
 static void _workqueue_thread_entry(void* parameter)
 {
     rt_base_t level;
+    rt_bool_t requeue;
+    rt_uint16_t waiters;
     struct rt_work* work;
     struct rt_workqueue* queue;
+    struct rt_workqueue_worker* worker;
 
-    queue = (struct rt_workqueue*) parameter;
-    RT_ASSERT(queue != RT_NULL);
+    worker = (struct rt_workqueue_worker*) parameter;
+    RT_ASSERT(worker != RT_NULL);
+    queue = worker->queue;
 
     while (1)
     {
+        rt_sem_take(&(queue->sem), RT_WAITING_FOREVER);
+
+        level = rt_hw_interrupt_disable();
+        if (queue->quit)
+        {
+            rt_hw_interrupt_enable(level);
+
+            /* tell the destroyer */
+            rt_sem_release(&(queue->exit_sem));
+            break;
+        }
+
         if (rt_list_isempty(&(queue->work_list)))
         {
-            /* no software timer exist, suspend self. */
-            rt_thread_suspend(rt_thread_self());
-            rt_schedule();
+            /* the work is canceled, the queue may be idle */
+            waiters = _workqueue_idle_waiters(queue);
+            rt_hw_interrupt_enable(level);
+
+            _workqueue_wakeup(queue, waiters);
+            continue;
         }
 
         /* we have work to do with. */
-        level = rt_hw_interrupt_disable();
         work = rt_list_entry(queue->work_list.next, struct rt_work, list);
         rt_list_remove(&(work->list));
-        queue->work_current = work;
+        work->flags &= ~RT_WORK_STATE_PENDING;
+        worker->work_current = work;
         rt_hw_interrupt_enable(level);
 
         /* do work */
         work->work_func(work, work->work_data);
+
         level = rt_hw_interrupt_disable();
-        /* clean current work */
-        queue->work_current = RT_NULL;
+        /* clean current work, the work may be freed if it's not submitted again */
+        worker->work_current = RT_NULL;
+        requeue = RT_FALSE;
+        if (worker->requeue)
+        {
+            worker->requeue = 0;
+            if (!(work->flags & RT_WORK_STATE_PENDING))
+            {
+                _workqueue_insert(queue, work, RT_FALSE);
+                requeue = RT_TRUE;
+            }
+        }
+
+        waiters = queue->flush_waiters;
+        queue->flush_waiters = 0;
         rt_hw_interrupt_enable(level);
+
+        if (requeue)
+            rt_sem_release(&(queue->sem));
+        _workqueue_wakeup(queue, waiters);
     }
 }
 
-struct rt_workqueue *rt_workqueue_create(const char* name, rt_uint16_t stack_size, rt_uint8_t priority)
+/**
+ * This function will create a workqueue with a pool of worker threads.
+ *
+ * @param name the name of workqueue and its workers
+ * @param workers the number of worker threads
+ * @param stack_size the stack size of each worker
+ * @param priority the priority of workers
+ *
+ * @return the created workqueue, RT_NULL on error
+ */
+struct rt_workqueue *rt_workqueue_create_pool(const char* name, rt_uint8_t workers,
+                                              rt_uint16_t stack_size, rt_uint8_t priority)
 {
+    int index;
     struct rt_workqueue *queue = RT_NULL;
-
-    queue = (struct rt_workqueue*)RT_KERNEL_MALLOC(sizeof(struct rt_workqueue));
-    if (queue != RT_NULL)
+    struct rt_workqueue_worker *worker;
+
+    RT_ASSERT(workers > 0);
+
+    queue = (struct rt_workqueue*)RT_KERNEL_MALLOC(sizeof(struct rt_workqueue) +
+                                                   workers * sizeof(struct rt_workqueue_worker));
+    if (queue == RT_NULL)
+        return RT_NULL;
+
+    /* initialize work list */
+    rt_list_init(&(queue->work_list));
+    rt_list_init(&(queue->delayed_list));
+    rt_sem_init(&(queue->sem), name, 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&(queue->flush_sem), name, 0, RT_IPC_FLAG_FIFO);
+    queue->flush_waiters = 0;
+    rt_sem_init(&(queue->exit_sem), name, 0, RT_IPC_FLAG_FIFO);
+    rt_timer_init(&(queue->timer), name, _workqueue_timeout, queue, 1,
+                  RT_TIMER_FLAG_PERIODIC | RT_TIMER_FLAG_HARD_TIMER);
+    queue->workers = workers;
+    queue->quit    = 0;
+    queue->worker  = (struct rt_workqueue_worker*)(queue + 1);
+
+    /* create the work threads */
+    for (index = 0; index < workers; index ++)
     {
-        /* initialize work list */
-        rt_list_init(&(queue->work_list));
-        queue->work_current = RT_NULL;
-
-        /* create the work thread */
-        queue->work_thread = rt_thread_create(name, _workqueue_thread_entry, queue, stack_size, priority, 10);
-        if (queue->work_thread == RT_NULL)
+        worker = &(queue->worker[index]);
+        worker->work_current = RT_NULL;
+        worker->requeue = 0;
+        worker->queue   = queue;
+        worker->thread  = rt_thread_create(name, _workqueue_thread_entry, worker,
+                                           stack_size, priority, 10);
+        if (worker->thread == RT_NULL)
         {
+            while (index --)
+                rt_thread_delete(queue->worker[index].thread);
+            rt_timer_detach(&(queue->timer));
+            rt_sem_detach(&(queue->sem));
+            rt_sem_detach(&(queue->flush_sem));
+            rt_sem_detach(&(queue->exit_sem));
             RT_KERNEL_FREE(queue);
+
             return RT_NULL;
         }
-
-        rt_thread_startup(queue->work_thread);
     }
 
+    for (index = 0; index < workers; index ++)
+        rt_thread_startup(queue->worker[index].thread);
+
     return queue;
 }
 
+struct rt_workqueue *rt_workqueue_create(const char* name, rt_uint16_t stack_size, rt_uint8_t priority)
+{
+    return rt_workqueue_create_pool(name, 1, stack_size, priority);
+}
+
+/**
+ * This function will destroy the workqueue. The works not done are canceled,
+ * and it waits for the running works.
+ *
+ * @param queue the workqueue
+ *
+ * @return RT_EOK on OK, -RT_EBUSY if it's invoked by the worker of queue.
+ */
 rt_err_t rt_workqueue_destroy(struct rt_workqueue* queue)
 {
+    rt_base_t level;
+    int index;
+
     RT_ASSERT(queue != RT_NULL);
 
-    rt_thread_delete(queue->work_thread);
+    if (_workqueue_is_worker(queue))
+        return -RT_EBUSY;
+
+    rt_workqueue_cancel_all_work(queue);
+    rt_timer_detach(&(queue->timer));
+
+    level = rt_hw_interrupt_disable();
+    queue->quit = 1;
+    rt_hw_interrupt_enable(level);
+
+    /* the workers exit after their works */
+    for (index = 0; index < queue->workers; index ++)
+        rt_sem_release(&(queue->sem));
+    for (index = 0; index < queue->workers; index ++)
+        rt_sem_take(&(queue->exit_sem), RT_WAITING_FOREVER);
+
+    rt_sem_detach(&(queue->sem));
+    rt_sem_detach(&(queue->flush_sem));
+    rt_sem_detach(&(queue->exit_sem));
     RT_KERNEL_FREE(queue);
 
     return RT_EOK;
 }
 
+/**
+ * This function will submit a work to the workqueue. The work submitted while
+ * it's pending is merged, and the one submitted while it's running runs again
+ * after the current run.
+ *
+ * @param queue the workqueue
+ * @param work the initialized work
+ *
+ * @return RT_EOK
+ */
 rt_err_t rt_workqueue_dowork(struct rt_workqueue* queue, struct rt_work* work)
 {
     rt_base_t level;
+    rt_bool_t wakeup;
+
     RT_ASSERT(queue != RT_NULL);
     RT_ASSERT(work != RT_NULL);
 
     level = rt_hw_interrupt_disable();
-    if (queue->work_current == work)
+    wakeup = _workqueue_submit(queue, work, RT_FALSE);
+    rt_hw_interrupt_enable(level);
+
+    if (wakeup)
+        rt_sem_release(&(queue->sem));
+
+    return RT_EOK;
+}
+
+/**
+ * This function will submit a work to the workqueue after time ticks. The
+ * work already pending or delayed is not changed.
+ *
+ * @param queue the workqueue
+ * @param work the initialized work
+ * @param time the delay in ticks, 0 to submit it now
+ *
+ * @return RT_EOK
+ */
+rt_err_t rt_workqueue_submit_delayed(struct rt_workqueue* queue, struct rt_work* work, rt_tick_t time)
+{
+    rt_base_t level;
+    rt_tick_t delta;
+    struct rt_list_node *node;
+
+    RT_ASSERT(queue != RT_NULL);
+    RT_ASSERT(work != RT_NULL);
+    RT_ASSERT(time < RT_TICK_MAX / 2);
+
+    if (time == 0)
+        return rt_workqueue_dowork(queue, work);
+
+    level = rt_hw_interrupt_disable();
+    if (work->flags & (RT_WORK_STATE_PENDING | RT_WORK_STATE_DELAYED))
     {
         rt_hw_interrupt_enable(level);
-        return -RT_EBUSY;
+        return RT_EOK;
     }
 
-    /* NOTE: the work MUST be initialized firstly */
-    rt_list_remove(&(work->list));
+    work->timeout_tick = rt_tick_get() + time;
+    work->flags |= RT_WORK_STATE_DELAYED;
 
-    rt_list_insert_after(queue->work_list.prev, &(work->list));
-    /* whether the workqueue is doing work */
-    if (queue->work_current == RT_NULL)
+    /* after the works of the same timeout */
+    for (node = queue->delayed_list.next; node != &(queue->delayed_list); node = node->next)
     {
-        rt_hw_interrupt_enable(level);
-        /* resume work thread */
-        rt_thread_resume(queue->work_thread);
-        rt_schedule();
+        delta = rt_list_entry(node, struct rt_work, list)->timeout_tick - work->timeout_tick;
+        if (delta != 0 && delta < RT_TICK_MAX / 2)
+            break;
     }
-    else rt_hw_interrupt_enable(level);
+    rt_list_insert_before(node, &(work->list));
+
+    /* it's the first one */
+    if (queue->delayed_list.next == &(work->list))
+    {
+        rt_timer_control(&(queue->timer), RT_TIMER_CTRL_SET_TIME, &time);
+        rt_timer_start(&(queue->timer));
+    }
+    rt_hw_interrupt_enable(level);
 
     return RT_EOK;
 }
 
+/**
+ * This function will submit a work before all of pending works.
+ *
+ * @param queue the workqueue
+ * @param work the initialized work
+ *
+ * @return RT_EOK
+ */
 rt_err_t rt_workqueue_critical_work(struct rt_workqueue* queue, struct rt_work* work)
 {
     rt_base_t level;
+    rt_bool_t wakeup;
+
     RT_ASSERT(queue != RT_NULL);
     RT_ASSERT(work != RT_NULL);
 
     level = rt_hw_interrupt_disable();
-    if (queue->work_current == work)
+    /* it takes the head even if it's pending */
+    if (work->flags & RT_WORK_STATE_PENDING)
     {
-        rt_hw_interrupt_enable(level);
-        return -RT_EBUSY;
+        rt_list_remove(&(work->list));
+        work->flags &= ~RT_WORK_STATE_PENDING;
+        wakeup = RT_FALSE;
+        _workqueue_insert(queue, work, RT_TRUE);
     }
+    else
+        wakeup = _workqueue_submit(queue, work, RT_TRUE);
+    rt_hw_interrupt_enable(level);
 
-    /* NOTE: the work MUST be initialized firstly */
-    rt_list_remove(&(work->list));
-
-    rt_list_insert_after(queue->work_list.prev, &(work->list));
-    if (queue->work_current == RT_NULL)
-    {
-        rt_hw_interrupt_enable(level);
-        /* resume work thread */
-        rt_thread_resume(queue->work_thread);
-        rt_schedule();
-    }
-    else rt_hw_interrupt_enable(level);
+    if (wakeup)
+        rt_sem_release(&(queue->sem));
 
     return RT_EOK;
 }
 
+/**
+ * This function will cancel the pending or delayed work, it doesn't wait for
+ * the running one.
+ *
+ * @param queue the workqueue
+ * @param work the work
+ *
+ * @return RT_EOK on OK, -RT_EBUSY if the work is running.
+ */
 rt_err_t rt_workqueue_cancel_work(struct rt_workqueue* queue, struct rt_work* work)
 {
     rt_base_t level;
+    rt_uint16_t waiters;
+    rt_err_t result = RT_EOK;
 
     RT_ASSERT(queue != RT_NULL);
     RT_ASSERT(work != RT_NULL);
 
     level = rt_hw_interrupt_disable();
-    if (queue->work_current == work)
+    waiters = _workqueue_cancel(queue, work);
+    if (_workqueue_running(queue, work) != RT_NULL)
+        result = -RT_EBUSY;
+    rt_hw_interrupt_enable(level);
+
+    _workqueue_wakeup(queue, waiters);
+
+    return result;
+}
+
+/**
+ * This function will cancel the work, and wait for it done if it's running.
+ *
+ * @param queue the workqueue
+ * @param work the work
+ *
+ * @return RT_EOK on OK, -RT_EBUSY if it's invoked by the work itself.
+ */
+rt_err_t rt_workqueue_cancel_work_sync(struct rt_workqueue* queue, struct rt_work* work)
+{
+    rt_base_t level;
+    rt_uint16_t waiters;
+
+    RT_ASSERT(queue != RT_NULL);
+    RT_ASSERT(work != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    waiters = _workqueue_cancel(queue, work);
+    if (_workqueue_running(queue, work) != RT_NULL && _workqueue_is_worker(queue))
     {
         rt_hw_interrupt_enable(level);
+        _workqueue_wakeup(queue, waiters);
         return -RT_EBUSY;
     }
-    rt_list_remove(&(work->list));
+    rt_hw_interrupt_enable(level);
+    _workqueue_wakeup(queue, waiters);
+
+    level = rt_hw_interrupt_disable();
+    level = _workqueue_wait(queue, work, level);
     rt_hw_interrupt_enable(level);
 
     return RT_EOK;
@@ -176,19 +603,101 @@ rt_err_t rt_workqueue_cancel_work(struct rt_workqueue* queue, struct rt_work* wo
 
 rt_err_t rt_workqueue_cancel_all_work(struct rt_workqueue* queue)
 {
-    struct rt_list_node *node, *next;
+    rt_base_t level;
+    rt_uint16_t waiters = 0;
+    struct rt_work *work;
+    int index;
+
     RT_ASSERT(queue != RT_NULL);
 
-    rt_enter_critical();
-    for (node = queue->work_list.next; node != &(queue->work_list); node = next)
+    level = rt_hw_interrupt_disable();
+    while (!rt_list_isempty(&(queue->work_list)))
+    {
+        work = rt_list_entry(queue->work_list.next, struct rt_work, list);
+        waiters += _workqueue_cancel(queue, work);
+    }
+    while (!rt_list_isempty(&(queue->delayed_list)))
     {
-        next = node->next;
-        rt_list_remove(node);
+        work = rt_list_entry(queue->delayed_list.next, struct rt_work, list);
+        waiters += _workqueue_cancel(queue, work);
     }
-    rt_exit_critical();
+    for (index = 0; index < queue->workers; index ++)
+        queue->worker[index].requeue = 0;
+    rt_hw_interrupt_enable(level);
+
+    _workqueue_wakeup(queue, waiters);
+
+    return RT_EOK;
+}
+
+/**
+ * This function will wait until the workqueue has no pending or running
+ * work. The delayed works are not waited.
+ *
+ * @param queue the workqueue
+ *
+ * @return RT_EOK on OK, -RT_EBUSY if it's invoked by the worker of queue.
+ */
+rt_err_t rt_workqueue_flush(struct rt_workqueue* queue)
+{
+    rt_base_t level;
+
+    RT_ASSERT(queue != RT_NULL);
+
+    if (_workqueue_is_worker(queue))
+        return -RT_EBUSY;
+
+    level = rt_hw_interrupt_disable();
+    level = _workqueue_wait(queue, RT_NULL, level);
+    rt_hw_interrupt_enable(level);
 
     return RT_EOK;
 }
 
+#ifdef RT_USING_SYSTEM_WORKQUEUE
+/* the system workqueue shared by drivers */
+static struct rt_workqueue *sys_workq;
+
+/**
+ * This function will submit a work to the system workqueue.
+ *
+ * @param work the initialized work
+ * @param time the delay in ticks, 0 to submit it now
+ *
+ * @return RT_EOK on OK, -RT_ERROR if the system workqueue is not created.
+ */
+rt_err_t rt_work_submit(struct rt_work* work, rt_tick_t time)
+{
+    if (sys_workq == RT_NULL)
+        return -RT_ERROR;
+
+    return rt_workqueue_submit_delayed(sys_workq, work, time);
+}
+
+/**
+ * This function will cancel a work of the system workqueue.
+ *
+ * @param work the work
+ *
+ * @return RT_EOK on OK, -RT_EBUSY if the work is running.
+ */
+rt_err_t rt_work_cancel(struct rt_work* work)
+{
+    if (sys_workq == RT_NULL)
+        return -RT_ERROR;
+
+    return rt_workqueue_cancel_work(sys_workq, work);
+}
+
+int rt_work_sys_workqueue_init(void)
+{
+    sys_workq = rt_workqueue_create_pool("sys_work", RT_SYSTEM_WORKQUEUE_WORKERS,
+                                         RT_SYSTEM_WORKQUEUE_STACKSIZE,
+                                         RT_SYSTEM_WORKQUEUE_PRIORITY);
+
+    return sys_workq == RT_NULL ? -1 : 0;
+}
+INIT_DEVICE_EXPORT(rt_work_sys_workqueue_init);
 #endif
 
+#endif
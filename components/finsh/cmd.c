@@ -44,8 +44,12 @@
  * 2012-06-02     lgnq         add list_memheap
  * 2012-10-22     Bernard      add MS VC++ patch.
  * 2016-06-02     armink       beautify the list_thread command
+ * 2017-07-03     agent        add top command
+ * 2017-07-06     agent        add list_deadline command
+ * 2017-07-10     agent        add list_memregion command
  */
 
+#include <rthw.h>
 #include <rtthread.h>
 #include "finsh.h"
 
@@ -151,6 +155,175 @@ long list_thread(void)
 FINSH_FUNCTION_EXPORT(list_thread, list thread);
 MSH_CMD_EXPORT(list_thread, list thread);
 
+#if defined(RT_USING_CPU_USAGE) && defined(RT_USING_HEAP)
+struct top_sample
+{
+    struct rt_thread *thread;
+    rt_uint64_t cycles;
+};
+
+#ifdef RT_USING_SMP
+#define TOP_CPUS_NR     RT_CPUS_NR
+#else
+#define TOP_CPUS_NR     1
+#endif
+
+/* print the permillage as percentage */
+static void top_percent(rt_uint64_t cycles, rt_uint64_t total)
+{
+    rt_uint32_t permille = 0;
+
+    if (total != 0)
+        permille = (rt_uint32_t)(cycles * 1000 / total);
+
+    rt_kprintf(" %3d.%d%%", permille / 10, permille % 10);
+}
+
+/**
+ * This function shows the cpu usage of each cpu and thread in a period.
+ *
+ * @param ms the sampling period in millisecond
+ */
+long list_top(rt_uint32_t ms)
+{
+    int maxlen, cpu;
+    rt_uint32_t index, count;
+    rt_uint64_t total;
+    struct rt_thread *thread;
+    struct rt_list_node *node;
+    struct top_sample *samples;
+    struct rt_list_node *list = &rt_object_container[RT_Object_Class_Thread].object_list;
+    struct rt_cpu_usage before[TOP_CPUS_NR], after[TOP_CPUS_NR];
+
+    /* the threads created in the period are not sampled */
+    rt_enter_critical();
+    count = rt_list_len(list);
+    rt_exit_critical();
+
+    samples = (struct top_sample *)rt_malloc(count * sizeof(struct top_sample));
+    if (samples == RT_NULL)
+        return -RT_ENOMEM;
+
+    rt_enter_critical();
+    index = 0;
+    for (node = list->next; node != list && index < count; node = node->next)
+    {
+        thread = rt_list_entry(node, struct rt_thread, list);
+        samples[index].thread = thread;
+        samples[index].cycles = rt_thread_cycles_get(thread);
+        index ++;
+    }
+    count = index;
+    for (cpu = 0; cpu < TOP_CPUS_NR; cpu ++)
+        rt_cpu_usage_get(cpu, &before[cpu]);
+    rt_exit_critical();
+
+    rt_thread_delay(rt_tick_from_millisecond(ms));
+
+    /* the delta of cycles, the thread deleted in the period is dropped */
+    rt_enter_critical();
+    for (index = 0; index < count; index ++)
+    {
+        for (node = list->next; node != list; node = node->next)
+        {
+            if (rt_list_entry(node, struct rt_thread, list) == samples[index].thread)
+                break;
+        }
+
+        if (node == list)
+            samples[index].thread = RT_NULL;
+        else
+            samples[index].cycles = rt_thread_cycles_get(samples[index].thread) -
+                                    samples[index].cycles;
+    }
+    for (cpu = 0; cpu < TOP_CPUS_NR; cpu ++)
+        rt_cpu_usage_get(cpu, &after[cpu]);
+    rt_exit_critical();
+
+    total = 0;
+    rt_kprintf("cpu   usage     irq    idle  (%d Hz cycle)\n", rt_hw_cycle_frequency());
+    rt_kprintf("--- ------- ------- -------\n");
+    for (cpu = 0; cpu < TOP_CPUS_NR; cpu ++)
+    {
+        rt_uint64_t cpu_total = after[cpu].total - before[cpu].total;
+        rt_uint64_t idle = after[cpu].idle - before[cpu].idle;
+
+        total += cpu_total;
+        rt_kprintf("%3d", cpu);
+        top_percent(cpu_total - idle, cpu_total);
+        top_percent(after[cpu].irq - before[cpu].irq, cpu_total);
+        top_percent(idle, cpu_total);
+        rt_kprintf("\n");
+    }
+
+    maxlen = object_name_maxlen(list);
+    rt_kprintf("\n%-*.s pri   usage     cycles\n", maxlen, "thread"); object_split(maxlen);
+    rt_kprintf(     " --- ------- ----------\n");
+    for (index = 0; index < count; index ++)
+    {
+        thread = samples[index].thread;
+        if (thread == RT_NULL)
+            continue;
+
+        rt_kprintf("%-*.*s %3d", maxlen, RT_NAME_MAX, thread->name, thread->current_priority);
+        top_percent(samples[index].cycles, total);
+        rt_kprintf(" %10u\n", (rt_uint32_t)samples[index].cycles);
+    }
+
+    rt_free(samples);
+
+    return 0;
+}
+
+long top(void)
+{
+    return list_top(1000);
+}
+FINSH_FUNCTION_EXPORT(top, show the cpu usage of threads in one second);
+#endif
+
+#ifdef RT_USING_DEADLINE
+static long _list_deadline(struct rt_list_node *list)
+{
+    int maxlen, cpu = 0;
+    struct rt_thread *thread;
+    struct rt_list_node *node;
+
+    maxlen = object_name_maxlen(list);
+
+    rt_kprintf("%-*.s period budget deadline  released   misses throttled\n", maxlen, "thread"); object_split(maxlen);
+    rt_kprintf(     " ------ ------ -------- ---------- -------- ---------\n");
+    for (node = list->next; node != list; node = node->next)
+    {
+        thread = rt_list_entry(node, struct rt_thread, list);
+        if (thread->deadline.period == 0)
+            continue;
+
+        rt_kprintf("%-*.*s %6d %6d %8d %10d %8d %9d\n", maxlen, RT_NAME_MAX, thread->name,
+                   thread->deadline.period, thread->deadline.budget,
+                   thread->deadline.deadline, thread->deadline.released,
+                   thread->deadline.misses, thread->deadline.throttled);
+    }
+
+#ifdef RT_USING_SMP
+    for (cpu = 0; cpu < RT_CPUS_NR; cpu ++)
+#endif
+    {
+        rt_kprintf("cpu%d utilization: %d.%d%%\n", cpu,
+                   rt_deadline_utilization(cpu) / 10, rt_deadline_utilization(cpu) % 10);
+    }
+
+    return 0;
+}
+
+long list_deadline(void)
+{
+    return _list_deadline(&rt_object_container[RT_Object_Class_Thread].object_list);
+}
+FINSH_FUNCTION_EXPORT(list_deadline, list deadline thread);
+MSH_CMD_EXPORT(list_deadline, list deadline thread);
+#endif
+
 static void show_wait_queue(struct rt_list_node *list)
 {
     struct rt_thread *thread;
@@ -186,7 +359,7 @@ static long _list_sem(struct rt_list_node *list)
             rt_kprintf("%-*.*s %03d %d:",
                        maxlen, RT_NAME_MAX,
                        sem->parent.parent.name,
-                       sem->value,
+                       RT_SEM_VALUE(sem),
                        rt_list_len(&sem->parent.suspend_thread));
             show_wait_queue(&(sem->parent.suspend_thread));
             rt_kprintf("\n");
@@ -196,7 +369,7 @@ static long _list_sem(struct rt_list_node *list)
             rt_kprintf("%-*.*s %03d %d\n",
                        maxlen, RT_NAME_MAX,
                        sem->parent.parent.name,
-                       sem->value,
+                       RT_SEM_VALUE(sem),
                        rt_list_len(&sem->parent.suspend_thread));
         }
     }
@@ -419,6 +592,30 @@ long list_memheap(void)
 }
 FINSH_FUNCTION_EXPORT(list_memheap, list memory heap in system);
 MSH_CMD_EXPORT(list_memheap, list memory heap in system);
+
+#ifdef RT_USING_MEMHEAP_REGION
+long list_memregion(void)
+{
+    rt_uint8_t region;
+    struct rt_memory_region_info info;
+    static const char *names[RT_MEM_REGION_NR] = {"default", "fast", "large", "dma"};
+
+    rt_kprintf("region  total      used       max used   allocs     fallbacks  fails      fallback\n");
+    rt_kprintf("------- ---------- ---------- ---------- ---------- ---------- ---------- --------\n");
+    for (region = 0; region < RT_MEM_REGION_NR; region ++)
+    {
+        rt_memory_region_info(region, &info);
+        rt_kprintf("%-7s %-10d %-10d %-10d %-10d %-10d %-10d %s\n",
+                   names[region], info.total, info.used, info.max_used,
+                   info.alloc_count, info.fallback_count, info.fail_count,
+                   info.fallback == RT_MEM_NONE ? "none" : names[info.fallback]);
+    }
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(list_memregion, list memory regions of memory heap);
+MSH_CMD_EXPORT(list_memregion, list memory regions of memory heap);
+#endif
 #endif
 
 #ifdef RT_USING_MEMPOOL
@@ -26,6 +26,7 @@
  * Date           Author       Notes
  * 2013-03-30     Bernard      the first verion for FinSH
  * 2015-08-28     Bernard      Add mkfs command.
+ * 2017-07-03     agent        Add top command.
  */
 
 #include <rtthread.h>
@@ -382,6 +383,31 @@ int cmd_ps(int argc, char **argv)
 }
 FINSH_FUNCTION_EXPORT_ALIAS(cmd_ps, __cmd_ps, List threads in the system.);
 
+#if defined(RT_USING_CPU_USAGE) && defined(RT_USING_HEAP)
+int cmd_top(int argc, char **argv)
+{
+    extern long list_top(rt_uint32_t ms);
+    int seconds = 1;
+    const char *ptr;
+
+    if (argc == 2)
+    {
+        seconds = 0;
+        for (ptr = argv[1]; *ptr >= '0' && *ptr <= '9'; ptr ++)
+            seconds = seconds * 10 + *ptr - '0';
+    }
+    if (seconds <= 0)
+    {
+        rt_kprintf("Usage: top [seconds]\n");
+        return -1;
+    }
+
+    list_top(seconds * 1000);
+    return 0;
+}
+FINSH_FUNCTION_EXPORT_ALIAS(cmd_top, __cmd_top, Show the cpu usage of threads.);
+#endif
+
 int cmd_time(int argc, char **argv)
 {
     return 0;
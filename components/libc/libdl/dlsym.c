@@ -10,6 +10,7 @@
  * Change Logs:
  * Date           Author		Notes
  * 2010-11-17      yi.qiu	first version
+ * 2017-07-11      agent	find the symbol by the hash index of module
  */
 
 #include <rtthread.h>
@@ -17,20 +18,13 @@
 
 void* dlsym(void *handle, const char* symbol)
 {
-	int i;
 	rt_module_t module;
 	
 	RT_ASSERT(handle != RT_NULL);
 
 	module = (rt_module_t)handle;
 
-	for(i=0; i<module->nsym; i++)
-	{
-		if (rt_strcmp(module->symtab[i].name, symbol) == 0)
-			return (void*)module->symtab[i].addr;
-	}	
-
-	return RT_NULL;
+	return rt_module_find_symbol(module, symbol);
 }
 
 RTM_EXPORT(dlsym)
@@ -180,7 +180,7 @@ int sem_getvalue(sem_t *sem, int *sval)
 
         return -1;
     }
-    *sval = sem->sem->value;
+    *sval = RT_SEM_VALUE(sem->sem);
 
     return 0;
 }
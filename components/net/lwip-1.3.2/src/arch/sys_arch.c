@@ -52,7 +52,7 @@ void sys_sem_free(sys_sem_t sem)
 void sys_sem_signal(sys_sem_t sem)
 {
 	LWIP_DEBUGF(SYS_DEBUG, ("%s, Release signal: %s , %d\n", LWIP_THREAD_NAME,
-			sem->parent.parent.name, sem->value));
+			sem->parent.parent.name, RT_SEM_VALUE(sem)));
 
 	rt_sem_release(sem);
 
@@ -68,7 +68,7 @@ u32_t sys_arch_sem_wait(sys_sem_t sem, u32_t timeout)
 	/* get the begin tick */
 	tick = rt_tick_get();
 	LWIP_DEBUGF(SYS_DEBUG, ("%s, Wait sem: %s , %d\n", LWIP_THREAD_NAME,
-			sem->parent.parent.name, sem->value));
+			sem->parent.parent.name, RT_SEM_VALUE(sem)));
 
 	if(timeout == 0)
 		t = RT_WAITING_FOREVER;
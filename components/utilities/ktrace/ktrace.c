@@ -0,0 +1,620 @@
+/*
+ * File      : ktrace.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2006 - 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-07-02     agent        the first version
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include "ktrace.h"
+
+#ifndef RT_USING_HOOK
+#error "the kernel event tracer needs RT_USING_HOOK"
+#endif
+
+#if (RT_KTRACE_RECORDS & (RT_KTRACE_RECORDS - 1)) != 0
+#error "RT_KTRACE_RECORDS must be a power of 2"
+#endif
+
+#ifdef RT_USING_SMP
+#define KTRACE_CPUS             RT_CPUS_NR
+#define KTRACE_CPU_ID()         rt_hw_cpu_id()
+#else
+#define KTRACE_CPUS             1
+#define KTRACE_CPU_ID()         0
+#endif
+
+/* the object address is the id in trace */
+#define KTRACE_ID(object)       ((rt_uint32_t)(rt_ubase_t)(object))
+
+/*
+ * The sequence of record is the lap of ring with the highest bit set, it's 0
+ * while the record is written. The dump takes a record only if the sequence
+ * is the expected one before and after copying it.
+ */
+#define KTRACE_SEQUENCE(head)   ((rt_uint8_t)(((head) / RT_KTRACE_RECORDS) | 0x80))
+
+/* the records copied in each write of dump */
+#define KTRACE_DUMP_BATCH       8
+
+extern void (*rt_scheduler_hook)(struct rt_thread *from, struct rt_thread *to);
+extern void (*rt_interrupt_enter_hook)(void);
+extern void (*rt_interrupt_leave_hook)(void);
+extern void (*rt_object_trytake_hook)(struct rt_object *object);
+extern void (*rt_object_take_hook)(struct rt_object *object);
+extern void (*rt_object_put_hook)(struct rt_object *object);
+extern void (*rt_timer_timeout_hook)(struct rt_timer *timer);
+
+struct ktrace_ring
+{
+    volatile rt_uint32_t head;          /* records written, never wraps back */
+    struct rt_ktrace_record records[RT_KTRACE_RECORDS];
+};
+
+static struct ktrace_ring ktrace_rings[KTRACE_CPUS];
+static rt_uint32_t (*ktrace_clock)(void) = rt_tick_get;
+static rt_uint32_t ktrace_frequency = RT_TICK_PER_SECOND;
+static rt_uint8_t ktrace_running;
+
+/* the hooks before the tracer is started, they are chained and restored */
+static void (*ktrace_prev_switch)(struct rt_thread *from, struct rt_thread *to);
+static void (*ktrace_prev_irq_enter)(void);
+static void (*ktrace_prev_irq_leave)(void);
+static void (*ktrace_prev_trytake)(struct rt_object *object);
+static void (*ktrace_prev_take)(struct rt_object *object);
+static void (*ktrace_prev_put)(struct rt_object *object);
+static void (*ktrace_prev_timer)(struct rt_timer *timer);
+
+static rt_uint8_t ktrace_class(rt_uint8_t type)
+{
+    switch (type & ~RT_Object_Class_Static)
+    {
+    case RT_Object_Class_Thread:
+        return RT_KTRACE_CLASS_THREAD;
+#ifdef RT_USING_SEMAPHORE
+    case RT_Object_Class_Semaphore:
+        return RT_KTRACE_CLASS_SEM;
+#endif
+#ifdef RT_USING_MUTEX
+    case RT_Object_Class_Mutex:
+        return RT_KTRACE_CLASS_MUTEX;
+#endif
+#ifdef RT_USING_EVENT
+    case RT_Object_Class_Event:
+        return RT_KTRACE_CLASS_EVENT;
+#endif
+#ifdef RT_USING_MAILBOX
+    case RT_Object_Class_MailBox:
+        return RT_KTRACE_CLASS_MAILBOX;
+#endif
+#ifdef RT_USING_MESSAGEQUEUE
+    case RT_Object_Class_MessageQueue:
+        return RT_KTRACE_CLASS_MQ;
+#endif
+    case RT_Object_Class_Timer:
+        return RT_KTRACE_CLASS_TIMER;
+    default:
+        return RT_KTRACE_CLASS_OTHER;
+    }
+}
+
+/* it's invoked in the hooks, with interrupt disabled or not */
+static void ktrace_record(rt_uint8_t event, rt_uint8_t cls, void *object, void *thread)
+{
+    int cpu;
+    rt_uint32_t head;
+    struct ktrace_ring *ring;
+    struct rt_ktrace_record *record;
+
+    /* the thread may migrate, the ring and record take the same cpu id */
+    cpu  = KTRACE_CPU_ID();
+    ring = &ktrace_rings[cpu];
+
+    /* take a slot, the interrupt or other cpu may take the next one */
+#ifdef RT_HW_USING_CAS
+    do
+    {
+        head = ring->head;
+    } while (!rt_hw_cas(&(ring->head), head, head + 1));
+#else
+    {
+        rt_base_t level;
+
+        level = rt_hw_interrupt_disable();
+        head = ring->head ++;
+        rt_hw_interrupt_enable(level);
+    }
+#endif
+
+    record = &(ring->records[head & (RT_KTRACE_RECORDS - 1)]);
+    record->sequence  = 0;
+    rt_hw_dmb();
+    record->timestamp = ktrace_clock();
+    record->event     = event;
+    record->cpu       = cpu;
+    record->cls       = cls;
+    record->object    = KTRACE_ID(object);
+    record->thread    = KTRACE_ID(thread);
+    /* commit the record */
+    rt_hw_dmb();
+    record->sequence  = KTRACE_SEQUENCE(head);
+}
+
+static void ktrace_switch_hook(struct rt_thread *from, struct rt_thread *to)
+{
+    ktrace_record(RT_KTRACE_SWITCH, RT_KTRACE_CLASS_THREAD, from, to);
+
+    if (ktrace_prev_switch != RT_NULL)
+        ktrace_prev_switch(from, to);
+}
+
+static void ktrace_irq_enter_hook(void)
+{
+    ktrace_record(RT_KTRACE_IRQ_ENTER, rt_interrupt_get_nest(), RT_NULL,
+                  rt_thread_self());
+
+    if (ktrace_prev_irq_enter != RT_NULL)
+        ktrace_prev_irq_enter();
+}
+
+static void ktrace_irq_leave_hook(void)
+{
+    ktrace_record(RT_KTRACE_IRQ_LEAVE, rt_interrupt_get_nest(), RT_NULL,
+                  rt_thread_self());
+
+    if (ktrace_prev_irq_leave != RT_NULL)
+        ktrace_prev_irq_leave();
+}
+
+static void ktrace_trytake_hook(struct rt_object *object)
+{
+    ktrace_record(RT_KTRACE_TRYTAKE, ktrace_class(object->type), object,
+                  rt_thread_self());
+
+    if (ktrace_prev_trytake != RT_NULL)
+        ktrace_prev_trytake(object);
+}
+
+static void ktrace_take_hook(struct rt_object *object)
+{
+    ktrace_record(RT_KTRACE_TAKE, ktrace_class(object->type), object,
+                  rt_thread_self());
+
+    if (ktrace_prev_take != RT_NULL)
+        ktrace_prev_take(object);
+}
+
+static void ktrace_put_hook(struct rt_object *object)
+{
+    ktrace_record(RT_KTRACE_PUT, ktrace_class(object->type), object,
+                  rt_thread_self());
+
+    if (ktrace_prev_put != RT_NULL)
+        ktrace_prev_put(object);
+}
+
+static void ktrace_timer_hook(struct rt_timer *timer)
+{
+    ktrace_record(RT_KTRACE_TIMER, RT_KTRACE_CLASS_TIMER, timer,
+                  rt_thread_self());
+
+    if (ktrace_prev_timer != RT_NULL)
+        ktrace_prev_timer(timer);
+}
+
+/**
+ * This function will set the clock of tracer. The default clock is the OS
+ * tick, the BSP shall set a high resolution counter, for example the cycle
+ * counter of CPU, to see the latency.
+ *
+ * @param clock the function to get the clock
+ * @param frequency the frequency of clock, Hz
+ */
+void rt_ktrace_set_clock(rt_uint32_t (*clock)(void), rt_uint32_t frequency)
+{
+    RT_ASSERT(clock != RT_NULL);
+    RT_ASSERT(frequency != 0);
+
+    ktrace_clock = clock;
+    ktrace_frequency = frequency;
+}
+
+/**
+ * This function will start the tracer, it sets the scheduler, object,
+ * interrupt and timer hooks of kernel. The hooks set before are invoked
+ * by the tracer, and restored when it's stopped.
+ */
+void rt_ktrace_start(void)
+{
+    if (ktrace_running)
+        return;
+
+    ktrace_prev_switch    = rt_scheduler_hook;
+    ktrace_prev_irq_enter = rt_interrupt_enter_hook;
+    ktrace_prev_irq_leave = rt_interrupt_leave_hook;
+    ktrace_prev_trytake   = rt_object_trytake_hook;
+    ktrace_prev_take      = rt_object_take_hook;
+    ktrace_prev_put       = rt_object_put_hook;
+    ktrace_prev_timer     = rt_timer_timeout_hook;
+
+    rt_scheduler_sethook(ktrace_switch_hook);
+    rt_interrupt_enter_sethook(ktrace_irq_enter_hook);
+    rt_interrupt_leave_sethook(ktrace_irq_leave_hook);
+    rt_object_trytake_sethook(ktrace_trytake_hook);
+    rt_object_take_sethook(ktrace_take_hook);
+    rt_object_put_sethook(ktrace_put_hook);
+    rt_timer_timeout_sethook(ktrace_timer_hook);
+
+    ktrace_running = 1;
+}
+
+/**
+ * This function will stop the tracer and restore the hooks, the records are
+ * kept.
+ */
+void rt_ktrace_stop(void)
+{
+    if (!ktrace_running)
+        return;
+
+    rt_scheduler_sethook(ktrace_prev_switch);
+    rt_interrupt_enter_sethook(ktrace_prev_irq_enter);
+    rt_interrupt_leave_sethook(ktrace_prev_irq_leave);
+    rt_object_trytake_sethook(ktrace_prev_trytake);
+    rt_object_take_sethook(ktrace_prev_take);
+    rt_object_put_sethook(ktrace_prev_put);
+    rt_timer_timeout_sethook(ktrace_prev_timer);
+
+    ktrace_running = 0;
+}
+
+/**
+ * This function will drop all of records.
+ */
+void rt_ktrace_reset(void)
+{
+    int cpu;
+
+    for (cpu = 0; cpu < KTRACE_CPUS; cpu ++)
+        ktrace_rings[cpu].head = 0;
+}
+
+/* the writer of dump */
+struct ktrace_writer
+{
+    rt_size_t (*write)(struct ktrace_writer *writer, const void *buffer, rt_size_t size);
+    void *parameter;
+    rt_off_t pos;
+};
+
+static rt_err_t ktrace_write(struct ktrace_writer *writer, const void *buffer,
+                             rt_size_t size)
+{
+    if (size == 0)
+        return RT_EOK;
+
+    if (writer->write(writer, buffer, size) != size)
+        return -RT_EIO;
+    writer->pos += size;
+
+    return RT_EOK;
+}
+
+/* the names of the objects in trace, it's an array of entries */
+static rt_uint8_t *ktrace_names(rt_uint32_t *count)
+{
+#ifdef RT_USING_HEAP
+    static const rt_uint8_t types[] =
+    {
+        RT_Object_Class_Thread,
+#ifdef RT_USING_SEMAPHORE
+        RT_Object_Class_Semaphore,
+#endif
+#ifdef RT_USING_MUTEX
+        RT_Object_Class_Mutex,
+#endif
+#ifdef RT_USING_EVENT
+        RT_Object_Class_Event,
+#endif
+#ifdef RT_USING_MAILBOX
+        RT_Object_Class_MailBox,
+#endif
+#ifdef RT_USING_MESSAGEQUEUE
+        RT_Object_Class_MessageQueue,
+#endif
+        RT_Object_Class_Timer,
+    };
+    int index;
+    rt_uint32_t total = 0, used = 0;
+    rt_uint8_t *names;
+    struct rt_object *object;
+    struct rt_list_node *node;
+    struct rt_ktrace_name *entry;
+    struct rt_object_information *information;
+
+    rt_enter_critical();
+    for (index = 0; index < sizeof(types) / sizeof(types[0]); index ++)
+    {
+        information = rt_object_get_information((enum rt_object_class_type)types[index]);
+        for (node  = information->object_list.next;
+             node != &(information->object_list);
+             node  = node->next)
+            total ++;
+    }
+    rt_exit_critical();
+
+    names = (rt_uint8_t *)rt_malloc(total * (sizeof(struct rt_ktrace_name) + RT_NAME_MAX));
+    if (names == RT_NULL)
+    {
+        *count = 0;
+        return RT_NULL;
+    }
+
+    /* the objects may be created in the meantime, the table is full then */
+    rt_enter_critical();
+    for (index = 0; index < sizeof(types) / sizeof(types[0]); index ++)
+    {
+        information = rt_object_get_information((enum rt_object_class_type)types[index]);
+        for (node  = information->object_list.next;
+             node != &(information->object_list) && used < total;
+             node  = node->next)
+        {
+            object = rt_list_entry(node, struct rt_object, list);
+
+            entry = (struct rt_ktrace_name *)(names +
+                    used * (sizeof(struct rt_ktrace_name) + RT_NAME_MAX));
+            entry->object = KTRACE_ID(object);
+            entry->cls = ktrace_class(object->type);
+            entry->reserved[0] = entry->reserved[1] = entry->reserved[2] = 0;
+            rt_strncpy((char *)(entry + 1), object->name, RT_NAME_MAX);
+            used ++;
+        }
+    }
+    rt_exit_critical();
+
+    *count = used;
+    return names;
+#else
+    *count = 0;
+    return RT_NULL;
+#endif
+}
+
+/*
+ * It copies the record of index in ring. The record may be written by an
+ * interrupt or other cpu which takes the slot before the tracer stopped, or
+ * overwritten by a later one, then it's dropped as an event 0 record.
+ */
+static void ktrace_copy(struct ktrace_ring *ring, rt_uint32_t index,
+                        struct rt_ktrace_record *record)
+{
+    rt_uint8_t sequence;
+    volatile struct rt_ktrace_record *slot;
+
+    slot = &(ring->records[index & (RT_KTRACE_RECORDS - 1)]);
+    sequence = slot->sequence;
+    rt_hw_dmb();
+    *record = *(struct rt_ktrace_record *)slot;
+    rt_hw_dmb();
+    if (sequence != KTRACE_SEQUENCE(index) || slot->sequence != sequence)
+        rt_memset(record, 0, sizeof(struct rt_ktrace_record));
+}
+
+static rt_err_t ktrace_output(struct ktrace_writer *writer)
+{
+    int cpu;
+    rt_err_t result;
+    rt_uint32_t head, index, used;
+    rt_uint8_t *names;
+    struct rt_ktrace_header header;
+    struct rt_ktrace_record records[KTRACE_DUMP_BATCH];
+
+    /* the rings are not changed during dump */
+    rt_ktrace_stop();
+
+    names = ktrace_names(&header.name_count);
+
+    header.magic        = RT_KTRACE_MAGIC;
+    header.version      = RT_KTRACE_VERSION;
+    header.record_size  = sizeof(struct rt_ktrace_record);
+    header.frequency    = ktrace_frequency;
+    header.cpus         = KTRACE_CPUS;
+    header.name_max     = RT_NAME_MAX;
+    header.record_count = 0;
+    header.lost         = 0;
+    header.reserved     = 0;
+    for (cpu = 0; cpu < KTRACE_CPUS; cpu ++)
+    {
+        head = ktrace_rings[cpu].head;
+        if (head > RT_KTRACE_RECORDS)
+        {
+            header.lost += head - RT_KTRACE_RECORDS;
+            head = RT_KTRACE_RECORDS;
+        }
+        header.record_count += head;
+    }
+
+    result = ktrace_write(writer, &header, sizeof(header));
+    if (result == RT_EOK)
+        result = ktrace_write(writer, names, header.name_count *
+                              (sizeof(struct rt_ktrace_name) + RT_NAME_MAX));
+#ifdef RT_USING_HEAP
+    if (names != RT_NULL)
+        rt_free(names);
+#endif
+
+    /* the records of each cpu, from the oldest to the newest */
+    for (cpu = 0; cpu < KTRACE_CPUS && result == RT_EOK; cpu ++)
+    {
+        head  = ktrace_rings[cpu].head;
+        index = head > RT_KTRACE_RECORDS ? head - RT_KTRACE_RECORDS : 0;
+        for (used = 0; index < head && result == RT_EOK; index ++)
+        {
+            ktrace_copy(&ktrace_rings[cpu], index, &records[used]);
+            used ++;
+            if (used == KTRACE_DUMP_BATCH || index + 1 == head)
+            {
+                result = ktrace_write(writer, records, used * sizeof(struct rt_ktrace_record));
+                used = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+static rt_size_t ktrace_device_write(struct ktrace_writer *writer,
+                                     const void *buffer, rt_size_t size)
+{
+    return rt_device_write((rt_device_t)writer->parameter, writer->pos, buffer, size);
+}
+
+/**
+ * This function will stop the tracer and dump the records to a device, for
+ * example a serial port or USB virtual com. The device shall be opened.
+ *
+ * @param device the device to write
+ *
+ * @return the error code, RT_EOK on successfully.
+ */
+rt_err_t rt_ktrace_dump(rt_device_t device)
+{
+    struct ktrace_writer writer;
+
+    RT_ASSERT(device != RT_NULL);
+
+    writer.write = ktrace_device_write;
+    writer.parameter = device;
+    writer.pos = 0;
+
+    return ktrace_output(&writer);
+}
+
+#ifdef RT_USING_DFS
+#include <dfs_posix.h>
+
+static rt_size_t ktrace_file_write(struct ktrace_writer *writer,
+                                   const void *buffer, rt_size_t size)
+{
+    int length;
+
+    length = write((int)(rt_ubase_t)writer->parameter, buffer, size);
+
+    return length < 0 ? 0 : length;
+}
+
+/**
+ * This function will stop the tracer and dump the records to a file.
+ *
+ * @param filename the file to write
+ *
+ * @return the error code, RT_EOK on successfully.
+ */
+rt_err_t rt_ktrace_dump_file(const char *filename)
+{
+    int fd;
+    rt_err_t result;
+    struct ktrace_writer writer;
+
+    fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0);
+    if (fd < 0)
+        return -RT_EIO;
+
+    writer.write = ktrace_file_write;
+    writer.parameter = (void *)(rt_ubase_t)fd;
+    writer.pos = 0;
+
+    result = ktrace_output(&writer);
+    close(fd);
+
+    return result;
+}
+#endif
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+
+static void ktrace_status(void)
+{
+    int cpu;
+
+    rt_kprintf("ktrace: %s, %d Hz clock\n", ktrace_running ? "running" : "stopped",
+               ktrace_frequency);
+    for (cpu = 0; cpu < KTRACE_CPUS; cpu ++)
+        rt_kprintf("cpu%d: %d records\n", cpu, ktrace_rings[cpu].head);
+}
+
+static void ktrace_dump(const char *name)
+{
+    rt_err_t result;
+    rt_device_t device;
+
+    device = rt_device_find(name);
+    if (device != RT_NULL)
+    {
+        result = rt_device_open(device, RT_DEVICE_OFLAG_RDWR);
+        if (result == RT_EOK)
+        {
+            result = rt_ktrace_dump(device);
+            rt_device_close(device);
+        }
+    }
+    else
+    {
+#ifdef RT_USING_DFS
+        result = rt_ktrace_dump_file(name);
+#else
+        result = -RT_ERROR;
+#endif
+    }
+
+    if (result != RT_EOK)
+        rt_kprintf("ktrace: dump to %s failed\n", name);
+}
+FINSH_FUNCTION_EXPORT_ALIAS(rt_ktrace_start, ktrace_start, start kernel event tracer);
+FINSH_FUNCTION_EXPORT_ALIAS(rt_ktrace_stop, ktrace_stop, stop kernel event tracer);
+FINSH_FUNCTION_EXPORT(ktrace_status, show kernel event tracer status);
+FINSH_FUNCTION_EXPORT(ktrace_dump, dump kernel event trace to device or file);
+
+#ifdef FINSH_USING_MSH
+static int ktrace(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        ktrace_status();
+        rt_kprintf("Usage: ktrace start|stop|reset|dump <device|file>\n");
+    }
+    else if (rt_strcmp(argv[1], "start") == 0)
+        rt_ktrace_start();
+    else if (rt_strcmp(argv[1], "stop") == 0)
+        rt_ktrace_stop();
+    else if (rt_strcmp(argv[1], "reset") == 0)
+        rt_ktrace_reset();
+    else if (rt_strcmp(argv[1], "dump") == 0 && argc > 2)
+        ktrace_dump(argv[2]);
+    else
+        rt_kprintf("Usage: ktrace start|stop|reset|dump <device|file>\n");
+
+    return 0;
+}
+MSH_CMD_EXPORT(ktrace, kernel event tracer);
+#endif
+#endif
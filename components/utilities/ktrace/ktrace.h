@@ -0,0 +1,114 @@
+/*
+ * File      : ktrace.h
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2006 - 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-07-02     agent        the first version
+ */
+
+#ifndef __KTRACE_H__
+#define __KTRACE_H__
+
+#include <rtthread.h>
+
+/*
+ * The kernel event tracer.
+ *
+ * It records the thread switches, the IPC take/release, the interrupt
+ * entry/exit and the timer timeout into a ring buffer of each CPU through
+ * the kernel hooks. A record is 16 bytes, and the slot of record is taken
+ * by compare and swap, so there is no lock on the record path. The oldest
+ * records are overwritten when the ring is full. The hooks set before the
+ * tracer is started are still invoked, and restored when it's stopped.
+ *
+ * The dump is binary: a header, the name table of kernel objects, then the
+ * records of each CPU from oldest to newest. tools/ktrace2json.py converts
+ * it to the Chrome/Perfetto trace JSON.
+ */
+
+#ifndef RT_KTRACE_RECORDS
+#define RT_KTRACE_RECORDS       1024    /* records of each CPU, power of 2 */
+#endif
+
+#define RT_KTRACE_MAGIC         0x4352544b  /* "KTRC" */
+#define RT_KTRACE_VERSION       1
+
+/* event of record */
+#define RT_KTRACE_SWITCH        1       /* object: from thread, thread: to thread */
+#define RT_KTRACE_IRQ_ENTER     2       /* class: interrupt nest */
+#define RT_KTRACE_IRQ_LEAVE     3       /* class: interrupt nest */
+#define RT_KTRACE_TRYTAKE       4       /* try to take the object, may be blocked */
+#define RT_KTRACE_TAKE          5       /* the object is taken */
+#define RT_KTRACE_PUT           6       /* the object is released */
+#define RT_KTRACE_TIMER         7       /* object: the timer timeout */
+/* the records in writing at dump are all 0, the event is 0 then */
+
+/* object class in record and name table, independent of configuration */
+#define RT_KTRACE_CLASS_THREAD  'T'
+#define RT_KTRACE_CLASS_SEM     'S'
+#define RT_KTRACE_CLASS_MUTEX   'M'
+#define RT_KTRACE_CLASS_EVENT   'E'
+#define RT_KTRACE_CLASS_MAILBOX 'B'
+#define RT_KTRACE_CLASS_MQ      'Q'
+#define RT_KTRACE_CLASS_TIMER   't'
+#define RT_KTRACE_CLASS_OTHER   '?'
+
+struct rt_ktrace_record
+{
+    rt_uint32_t timestamp;              /* the clock of tracer */
+    rt_uint8_t  event;
+    rt_uint8_t  cpu;
+    rt_uint8_t  cls;                    /* the object class or interrupt nest */
+    rt_uint8_t  sequence;               /* the lap of ring, 0 in writing */
+    rt_uint32_t object;                 /* the address of object */
+    rt_uint32_t thread;                 /* the address of current thread */
+};
+
+struct rt_ktrace_header
+{
+    rt_uint32_t magic;
+    rt_uint16_t version;
+    rt_uint16_t record_size;
+    rt_uint32_t frequency;              /* the clock frequency, Hz */
+    rt_uint16_t cpus;
+    rt_uint16_t name_max;               /* RT_NAME_MAX */
+    rt_uint32_t name_count;             /* entries in name table */
+    rt_uint32_t record_count;           /* records of all CPUs */
+    rt_uint32_t lost;                   /* records overwritten */
+    rt_uint32_t reserved;
+};
+
+/* the name table entry, followed by name_max bytes of name */
+struct rt_ktrace_name
+{
+    rt_uint32_t object;
+    rt_uint8_t  cls;
+    rt_uint8_t  reserved[3];
+};
+
+void rt_ktrace_set_clock(rt_uint32_t (*clock)(void), rt_uint32_t frequency);
+void rt_ktrace_start(void);
+void rt_ktrace_stop(void);
+void rt_ktrace_reset(void);
+rt_err_t rt_ktrace_dump(rt_device_t device);
+#ifdef RT_USING_DFS
+rt_err_t rt_ktrace_dump_file(const char *filename);
+#endif
+
+#endif
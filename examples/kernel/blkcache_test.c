@@ -0,0 +1,235 @@
+/*
+ * This is the test of block cache device.
+ *
+ * A RAM disk is wrapped by a block cache device. It counts the requests to the
+ * RAM disk for the small appends of a log file, which read and write the last
+ * sector again and again, and for a sequential read of sectors one by one.
+ * Then it checks the data of random reads and writes of the cache against a
+ * shadow copy, and the write back by the flush thread and by sync.
+ */
+#include <rtthread.h>
+#include <rtdevice.h>
+#include "tc_comm.h"
+
+#ifdef RT_USING_BLK_CACHE
+#define RAMDISK_SECTOR_SIZE     512
+#define RAMDISK_SECTORS         256
+#define BLK_CACHE_BUFS          32
+#define BLK_CACHE_APPENDS       256
+#define BLK_CACHE_ROUND         2000
+
+struct ramdisk_device
+{
+    struct rt_device parent;
+    rt_uint8_t *data;
+
+    rt_uint32_t reads, writes;
+};
+
+static struct ramdisk_device ramdisk;
+static rt_uint8_t *shadow;
+static rt_uint8_t sector_buf[RAMDISK_SECTOR_SIZE * BLK_CACHE_BUFS];
+static rt_uint32_t errors;
+
+static rt_size_t ramdisk_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    ramdisk.reads ++;
+    rt_memcpy(buffer, ramdisk.data + pos * RAMDISK_SECTOR_SIZE, size * RAMDISK_SECTOR_SIZE);
+    return size;
+}
+
+static rt_size_t ramdisk_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    ramdisk.writes ++;
+    rt_memcpy(ramdisk.data + pos * RAMDISK_SECTOR_SIZE, buffer, size * RAMDISK_SECTOR_SIZE);
+    return size;
+}
+
+static rt_err_t ramdisk_control(rt_device_t dev, rt_uint8_t cmd, void *args)
+{
+    if (cmd == RT_DEVICE_CTRL_BLK_GETGEOME)
+    {
+        struct rt_device_blk_geometry *geometry = (struct rt_device_blk_geometry *)args;
+
+        geometry->sector_count     = RAMDISK_SECTORS;
+        geometry->bytes_per_sector = RAMDISK_SECTOR_SIZE;
+        geometry->block_size       = RAMDISK_SECTOR_SIZE;
+    }
+
+    return RT_EOK;
+}
+
+static void blk_cache_counter_reset(void)
+{
+    ramdisk.reads  = 0;
+    ramdisk.writes = 0;
+}
+
+/* append 16 bytes to the log in each time, by read-modify-write of a sector */
+static void blk_cache_append_test(rt_device_t cache)
+{
+    int index;
+    rt_uint32_t offset = 0;
+
+    blk_cache_counter_reset();
+    for (index = 0; index < BLK_CACHE_APPENDS; index ++, offset += 16)
+    {
+        rt_device_read(cache, offset / RAMDISK_SECTOR_SIZE, sector_buf, 1);
+        rt_memset(sector_buf + offset % RAMDISK_SECTOR_SIZE, index, 16);
+        rt_device_write(cache, offset / RAMDISK_SECTOR_SIZE, sector_buf, 1);
+    }
+    rt_device_control(cache, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL);
+
+    /* 8 sectors are written by one request at most */
+    if (ramdisk.writes > 2 || ramdisk.reads > BLK_CACHE_APPENDS * 16 / RAMDISK_SECTOR_SIZE)
+        errors ++;
+    for (index = 0; index < BLK_CACHE_APPENDS * 16; index ++)
+    {
+        if (ramdisk.data[index] != (rt_uint8_t)(index / 16))
+        {
+            errors ++;
+            break;
+        }
+    }
+
+    rt_kprintf("blkcache: %d appends, %d reads and %d writes of device (%d without cache)\n",
+               BLK_CACHE_APPENDS, ramdisk.reads, ramdisk.writes, BLK_CACHE_APPENDS * 2);
+}
+
+static void blk_cache_read_ahead_test(rt_device_t cache)
+{
+    int sector;
+
+    blk_cache_counter_reset();
+    for (sector = 64; sector < 192; sector ++)
+    {
+        rt_device_read(cache, sector, sector_buf, 1);
+        if (rt_memcmp(sector_buf, ramdisk.data + sector * RAMDISK_SECTOR_SIZE,
+                      RAMDISK_SECTOR_SIZE) != 0)
+            errors ++;
+    }
+
+    if (ramdisk.reads > 128 / 4)
+        errors ++;
+    rt_kprintf("blkcache: 128 sequential reads, %d reads of device\n", ramdisk.reads);
+}
+
+static void blk_cache_random_test(rt_device_t cache)
+{
+    int round;
+    rt_uint32_t sector, count, seed = 1;
+
+    for (round = 0; round < BLK_CACHE_ROUND; round ++)
+    {
+        seed = seed * 1103515245 + 12345;
+        count  = (seed >> 8) % 10 == 0 ? BLK_CACHE_BUFS : (seed >> 16) % 4 + 1;
+        sector = (seed >> 4) % (RAMDISK_SECTORS - count + 1);
+
+        if ((seed >> 20) & 1)
+        {
+            rt_memset(sector_buf, round, count * RAMDISK_SECTOR_SIZE);
+            sector_buf[0] = seed;
+            if (rt_device_write(cache, sector, sector_buf, count) != count)
+                errors ++;
+            rt_memcpy(shadow + sector * RAMDISK_SECTOR_SIZE, sector_buf,
+                      count * RAMDISK_SECTOR_SIZE);
+        }
+        else
+        {
+            if (rt_device_read(cache, sector, sector_buf, count) != count ||
+                rt_memcmp(sector_buf, shadow + sector * RAMDISK_SECTOR_SIZE,
+                          count * RAMDISK_SECTOR_SIZE) != 0)
+                errors ++;
+        }
+    }
+
+    /* out of the device */
+    if (rt_device_read(cache, RAMDISK_SECTORS - 1, sector_buf, 2) != 0)
+        errors ++;
+
+    rt_device_control(cache, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL);
+    if (rt_memcmp(ramdisk.data, shadow, RAMDISK_SECTORS * RAMDISK_SECTOR_SIZE) != 0)
+        errors ++;
+}
+
+static void blk_cache_flush_test(rt_device_t cache)
+{
+    rt_memset(sector_buf, 0x5A, RAMDISK_SECTOR_SIZE);
+    rt_device_write(cache, 7, sector_buf, 1);
+    if (ramdisk.data[7 * RAMDISK_SECTOR_SIZE] == 0x5A)
+        errors ++;
+
+    /* written back by the flush thread */
+    rt_thread_delay(rt_tick_from_millisecond(RT_BLK_CACHE_FLUSH_INTERVAL) * 2);
+    if (ramdisk.data[7 * RAMDISK_SECTOR_SIZE] != 0x5A)
+        errors ++;
+
+    /* written back on delete */
+    rt_memset(sector_buf, 0xA5, RAMDISK_SECTOR_SIZE);
+    rt_device_write(cache, 8, sector_buf, 1);
+}
+
+static void blk_cache_test_init(void)
+{
+    rt_device_t cache;
+
+    errors = 0;
+    ramdisk.data = (rt_uint8_t *)rt_malloc(RAMDISK_SECTORS * RAMDISK_SECTOR_SIZE);
+    shadow = (rt_uint8_t *)rt_malloc(RAMDISK_SECTORS * RAMDISK_SECTOR_SIZE);
+    if (ramdisk.data == RT_NULL || shadow == RT_NULL)
+    {
+        tc_done(TC_STAT_FAILED);
+        return;
+    }
+    rt_memset(ramdisk.data, 0, RAMDISK_SECTORS * RAMDISK_SECTOR_SIZE);
+
+    ramdisk.parent.type    = RT_Device_Class_Block;
+    ramdisk.parent.read    = ramdisk_read;
+    ramdisk.parent.write   = ramdisk_write;
+    ramdisk.parent.control = ramdisk_control;
+    rt_device_register(&(ramdisk.parent), "ramdisk", RT_DEVICE_FLAG_RDWR);
+
+    cache = rt_blk_cache_create("ramc", &(ramdisk.parent), BLK_CACHE_BUFS);
+    if (cache == RT_NULL || rt_device_open(cache, RT_DEVICE_OFLAG_RDWR) != RT_EOK)
+    {
+        errors ++;
+        goto _exit;
+    }
+
+    blk_cache_append_test(cache);
+    blk_cache_read_ahead_test(cache);
+    rt_memcpy(shadow, ramdisk.data, RAMDISK_SECTORS * RAMDISK_SECTOR_SIZE);
+    blk_cache_random_test(cache);
+    blk_cache_flush_test(cache);
+
+    rt_device_close(cache);
+    if (rt_blk_cache_delete(cache) != RT_EOK ||
+        ramdisk.data[8 * RAMDISK_SECTOR_SIZE] != 0xA5)
+        errors ++;
+
+_exit:
+    rt_device_unregister(&(ramdisk.parent));
+    rt_free(ramdisk.data);
+    rt_free(shadow);
+
+    rt_kprintf("blkcache: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_blk_cache()
+{
+    blk_cache_test_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_blk_cache, a block cache device test);
+#else
+int rt_application_init()
+{
+    blk_cache_test_init();
+
+    return 0;
+}
+#endif
+#endif
@@ -0,0 +1,228 @@
+/*
+ * This is the test and benchmark of cpu usage accounting.
+ *
+ * A thread spins for CPU_USAGE_SPIN ticks, and the cycles accounted to it
+ * shall be close to the cycles of these ticks. On single cpu, the cycles of
+ * all threads and the interrupt in the period shall sum up to the cycles
+ * accounted to the cpu, and to the delta of cycle counter.
+ *
+ * The overhead is measured as the cycles of a thread switch by yield, and
+ * the cycles of an accounting update, which is done once in each thread
+ * switch and each interrupt.
+ */
+#include <rtthread.h>
+#include <rthw.h>
+#include "tc_comm.h"
+
+#ifdef RT_USING_CPU_USAGE
+#define CPU_USAGE_SPIN          10
+#define CPU_USAGE_ROUND         1000
+
+static struct rt_semaphore spin_done, spin_exit;
+static rt_uint32_t errors;
+
+static void cpu_usage_spin_entry(void *parameter)
+{
+    rt_tick_t tick;
+
+    tick = rt_tick_get();
+    while (rt_tick_get() - tick < CPU_USAGE_SPIN);
+
+    /* keep it in the thread list until the accounting is checked */
+    rt_sem_release(&spin_done);
+    rt_sem_take(&spin_exit, RT_WAITING_FOREVER);
+}
+
+static void cpu_usage_yield_entry(void *parameter)
+{
+    int index;
+
+    for (index = 0; index < CPU_USAGE_ROUND; index ++)
+        rt_thread_yield();
+}
+
+static rt_thread_t cpu_usage_thread_create(void (*entry)(void *))
+{
+    rt_thread_t tid;
+
+    tid = rt_thread_create("cusage", entry, RT_NULL, THREAD_STACK_SIZE,
+                           rt_thread_self()->current_priority, THREAD_TIMESLICE);
+    if (tid == RT_NULL)
+        return RT_NULL;
+
+#ifdef RT_USING_SMP
+    {
+        rt_uint8_t cpu;
+
+        /* the bench threads shall run on the same cpu */
+        cpu = rt_hw_cpu_id();
+        rt_thread_control(tid, RT_THREAD_CTRL_BIND_CPU, &cpu);
+    }
+#endif
+
+    return tid;
+}
+
+#ifndef RT_USING_SMP
+/* the sum of cycles of all threads, with interrupt disabled */
+static rt_uint64_t cpu_usage_threads(void)
+{
+    rt_uint64_t cycles = 0;
+    struct rt_list_node *node;
+    struct rt_object_information *information;
+
+    information = rt_object_get_information(RT_Object_Class_Thread);
+    for (node = information->object_list.next;
+         node != &(information->object_list);
+         node = node->next)
+    {
+        cycles += rt_list_entry(node, struct rt_thread, list)->cycles;
+    }
+
+    return cycles;
+}
+#endif
+
+static void cpu_usage_overhead(void)
+{
+    int index;
+    rt_base_t level;
+    rt_uint32_t cycle, read, update, irq, yield;
+    rt_thread_t tid;
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < CPU_USAGE_ROUND; index ++)
+        rt_hw_cycle_get();
+    read = (tc_cycle_get() - cycle) / CPU_USAGE_ROUND;
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < CPU_USAGE_ROUND; index ++)
+    {
+        level = rt_hw_interrupt_disable();
+        rt_hw_interrupt_enable(level);
+    }
+    irq = (tc_cycle_get() - cycle) / CPU_USAGE_ROUND;
+
+    /* it's an accounting update with interrupt disabled */
+    cycle = tc_cycle_get();
+    for (index = 0; index < CPU_USAGE_ROUND; index ++)
+        rt_thread_cycles_get(rt_thread_self());
+    update = (tc_cycle_get() - cycle) / CPU_USAGE_ROUND;
+    update = update > irq ? update - irq : 0;
+
+    /* each yield of the two threads is a thread switch */
+    tid = cpu_usage_thread_create(cpu_usage_yield_entry);
+    if (tid == RT_NULL)
+    {
+        errors ++;
+        return;
+    }
+    rt_thread_startup(tid);
+    cycle = tc_cycle_get();
+    for (index = 0; index < CPU_USAGE_ROUND; index ++)
+        rt_thread_yield();
+    yield = (tc_cycle_get() - cycle) / (CPU_USAGE_ROUND * 2);
+
+    rt_kprintf("cpu usage bench: counter read %d, accounting update %d, "
+               "thread switch %d cycles\n", read, update, yield);
+
+    /* the exited thread is removed by idle thread */
+    rt_thread_delay(2);
+}
+
+static void cpu_usage_bench_init(void)
+{
+    int cpu = 0;
+    rt_base_t level;
+    rt_thread_t tid;
+    rt_uint64_t expect, spin;
+    struct rt_cpu_usage before, after;
+#ifndef RT_USING_SMP
+    rt_uint64_t threads_before, threads_after;
+#endif
+
+    errors = 0;
+    rt_sem_init(&spin_done, "cudone", 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&spin_exit, "cuexit", 0, RT_IPC_FLAG_FIFO);
+
+    rt_kprintf("cpu usage bench: %d Hz cycle counter\n", rt_hw_cycle_frequency());
+    cpu_usage_overhead();
+
+    tid = cpu_usage_thread_create(cpu_usage_spin_entry);
+    if (tid == RT_NULL)
+    {
+        rt_sem_detach(&spin_done);
+        rt_sem_detach(&spin_exit);
+        tc_done(TC_STAT_FAILED);
+        return;
+    }
+
+    level = rt_hw_interrupt_disable();
+#ifdef RT_USING_SMP
+    cpu = rt_hw_cpu_id();
+#endif
+    rt_cpu_usage_get(cpu, &before);
+#ifndef RT_USING_SMP
+    threads_before = cpu_usage_threads();
+#endif
+    rt_hw_interrupt_enable(level);
+
+    rt_thread_startup(tid);
+    rt_sem_take(&spin_done, RT_WAITING_FOREVER);
+
+    level = rt_hw_interrupt_disable();
+    rt_cpu_usage_get(cpu, &after);
+#ifndef RT_USING_SMP
+    threads_after = cpu_usage_threads();
+#endif
+    spin = tid->cycles;
+    rt_hw_interrupt_enable(level);
+
+    expect = (rt_uint64_t)CPU_USAGE_SPIN * rt_hw_cycle_frequency() / RT_TICK_PER_SECOND;
+    rt_kprintf("cpu usage bench: spin %d cycles, expect %d; cpu %d cycles, "
+               "irq %d, idle %d\n", (rt_uint32_t)spin, (rt_uint32_t)expect,
+               (rt_uint32_t)(after.total - before.total),
+               (rt_uint32_t)(after.irq - before.irq),
+               (rt_uint32_t)(after.idle - before.idle));
+
+    /* the interrupts in the spinning are not accounted to the thread */
+    if (expect != 0 && (spin < expect / 2 || spin > expect + expect / 2))
+        errors ++;
+    if (after.total - before.total < spin)
+        errors ++;
+    /* all of the cycles are accounted */
+    if ((rt_uint32_t)(after.total - before.total) !=
+        (rt_uint32_t)(after.last_cycle - before.last_cycle))
+        errors ++;
+#ifndef RT_USING_SMP
+    if (threads_after - threads_before + after.irq - before.irq !=
+        after.total - before.total)
+        errors ++;
+#endif
+
+    rt_sem_release(&spin_exit);
+    rt_thread_delay(1);
+    rt_sem_detach(&spin_done);
+    rt_sem_detach(&spin_exit);
+
+    rt_kprintf("cpu usage bench: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_cpu_usage_bench()
+{
+    cpu_usage_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_cpu_usage_bench, a cpu usage accounting test and benchmark);
+#else
+int rt_application_init()
+{
+    cpu_usage_bench_init();
+
+    return 0;
+}
+#endif
+#endif
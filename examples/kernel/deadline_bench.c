@@ -0,0 +1,303 @@
+/*
+ * This is the test of earliest deadline first scheduling under load.
+ *
+ * Three periodic deadline threads run their jobs for some ticks of budget in
+ * each period, with a thread overrunning its budget in each job and a fixed
+ * priority thread below the deadline priority spinning on each cpu. The
+ * admitted jobs shall meet all of deadlines, the overrunning jobs are
+ * throttled and miss their deadlines, and the spinning thread runs in the
+ * left time.
+ *
+ * The admission is checked by a thread which just fits in the utilization
+ * left and a thread which exceeds it.
+ */
+#include <rtthread.h>
+#include "tc_comm.h"
+
+#ifdef RT_USING_DEADLINE
+#define DEADLINE_BENCH_TICKS    400
+#define DEADLINE_BENCH_LOOPS    3
+#define DEADLINE_BENCH_OVERRUN  DEADLINE_BENCH_LOOPS
+
+#ifdef RT_USING_SMP
+#define DEADLINE_BENCH_HOGS     RT_CPUS_NR
+#else
+#define DEADLINE_BENCH_HOGS     1
+#endif
+
+struct deadline_loop
+{
+    const char *name;
+    rt_tick_t period, budget, deadline;
+    rt_tick_t work;                     /* ticks of budget used by each job */
+
+    rt_thread_t tid;
+    rt_tick_t response;                 /* the worst response time */
+    rt_uint32_t released, completed, misses, throttled;
+};
+
+static struct deadline_loop loops[] =
+{
+    {"dl10", 10, 2, 10, 1},
+    {"dl20", 20, 4, 15, 3},
+    {"dl40", 40, 8, 40, 6},
+    /* it never completes its job */
+    {"dlrun", 20, 2, 20, 0},
+};
+
+static volatile int deadline_stop;
+static volatile rt_uint32_t hog_loops[DEADLINE_BENCH_HOGS];
+static struct rt_semaphore loop_done;
+static rt_uint32_t errors;
+
+static void deadline_loop_save(struct deadline_loop *loop)
+{
+    struct rt_deadline *dl = &(rt_thread_self()->deadline);
+
+    loop->released  = dl->released;
+    loop->completed = dl->completed;
+    loop->misses    = dl->misses;
+    loop->throttled = dl->throttled;
+}
+
+static void deadline_loop_entry(void *parameter)
+{
+    rt_tick_t release, response;
+    struct deadline_loop *loop = (struct deadline_loop *)parameter;
+    volatile struct rt_deadline *dl = &(rt_thread_self()->deadline);
+
+    while (!deadline_stop)
+    {
+        /* the budget is only accounted when the job is running */
+        release = dl->abs_deadline - dl->deadline;
+        while (dl->budget - dl->remaining < loop->work);
+
+        response = rt_tick_get() - release;
+        if (response > loop->response)
+            loop->response = response;
+
+        rt_thread_deadline_wait();
+    }
+
+    deadline_loop_save(loop);
+    rt_sem_release(&loop_done);
+}
+
+static void deadline_overrun_entry(void *parameter)
+{
+    struct deadline_loop *loop = (struct deadline_loop *)parameter;
+
+    while (!deadline_stop);
+
+    deadline_loop_save(loop);
+    rt_sem_release(&loop_done);
+}
+
+static void deadline_hog_entry(void *parameter)
+{
+    rt_uint32_t index = (rt_uint32_t)parameter;
+
+    while (!deadline_stop)
+        hog_loops[index] ++;
+
+    rt_sem_release(&loop_done);
+}
+
+/* a thread fits in the utilization left of cpu is admitted, but no more */
+static void deadline_admission(int cpu)
+{
+    rt_thread_t tid;
+    rt_uint32_t before;
+    rt_tick_t budget;
+
+    before = rt_deadline_utilization(cpu);
+    budget = (RT_DEADLINE_UTILIZATION * 10 - before) / 10;
+
+    tid = rt_thread_create("dladm", deadline_loop_entry, RT_NULL, THREAD_STACK_SIZE,
+                           THREAD_PRIORITY, THREAD_TIMESLICE);
+    if (tid == RT_NULL)
+    {
+        errors ++;
+        return;
+    }
+#ifdef RT_USING_SMP
+    {
+        rt_uint8_t bind = cpu;
+
+        rt_thread_control(tid, RT_THREAD_CTRL_BIND_CPU, &bind);
+    }
+#endif
+
+    if (rt_thread_deadline_set(tid, 100, budget + 1, 100) != -RT_EFULL)
+        errors ++;
+    if (rt_deadline_utilization(cpu) != before)
+        errors ++;
+
+    if (budget > 0)
+    {
+        if (rt_thread_deadline_set(tid, 100, budget, 100) != RT_EOK)
+            errors ++;
+        if (tid->init_priority != RT_DEADLINE_PRIORITY)
+            errors ++;
+    }
+
+    /* the utilization is given back */
+    rt_thread_delete(tid);
+    if (rt_deadline_utilization(cpu) != before)
+        errors ++;
+
+    rt_kprintf("deadline bench: cpu%d utilization %d permille, admit %d/100\n",
+               cpu, before, budget);
+}
+
+static void deadline_bench_init(void)
+{
+    int index, cpu = 0;
+    rt_uint8_t priority, saved;
+    rt_uint32_t total = 0;
+    rt_thread_t hogs[DEADLINE_BENCH_HOGS];
+    struct deadline_loop *loop;
+
+    errors = 0;
+    deadline_stop = 0;
+    rt_sem_init(&loop_done, "dldone", 0, RT_IPC_FLAG_FIFO);
+
+    /* supervise the run above the deadline threads */
+    saved = rt_thread_self()->current_priority;
+    priority = RT_DEADLINE_PRIORITY > 0 ? RT_DEADLINE_PRIORITY - 1 : 0;
+    rt_thread_control(rt_thread_self(), RT_THREAD_CTRL_CHANGE_PRIORITY, &priority);
+
+    for (index = 0; index < sizeof(loops) / sizeof(loops[0]); index ++)
+    {
+        loop = &loops[index];
+        loop->response = 0;
+        loop->tid = rt_thread_deadline_create(loop->name,
+                                              index == DEADLINE_BENCH_OVERRUN ?
+                                              deadline_overrun_entry : deadline_loop_entry,
+                                              loop, THREAD_STACK_SIZE, loop->period,
+                                              loop->budget, loop->deadline);
+        if (loop->tid == RT_NULL)
+            errors ++;
+    }
+
+    for (index = 0; index < DEADLINE_BENCH_HOGS; index ++)
+    {
+        hog_loops[index] = 0;
+        hogs[index] = rt_thread_create("dlhog", deadline_hog_entry,
+                                       (void *)(rt_uint32_t)index,
+                                       THREAD_STACK_SIZE, RT_DEADLINE_PRIORITY + 1,
+                                       THREAD_TIMESLICE);
+        if (hogs[index] == RT_NULL)
+        {
+            errors ++;
+            continue;
+        }
+#ifdef RT_USING_SMP
+        {
+            rt_uint8_t bind = index;
+
+            rt_thread_control(hogs[index], RT_THREAD_CTRL_BIND_CPU, &bind);
+        }
+#endif
+    }
+
+    if (errors != 0)
+    {
+        rt_kprintf("deadline bench: create threads failed\n");
+        tc_done(TC_STAT_FAILED);
+        return;
+    }
+
+#ifdef RT_USING_SMP
+    for (cpu = 0; cpu < RT_CPUS_NR; cpu ++)
+#endif
+    {
+        deadline_admission(cpu);
+    }
+
+    for (index = 0; index < DEADLINE_BENCH_HOGS; index ++)
+        rt_thread_startup(hogs[index]);
+    for (index = 0; index < sizeof(loops) / sizeof(loops[0]); index ++)
+        rt_thread_startup(loops[index].tid);
+
+    rt_thread_delay(DEADLINE_BENCH_TICKS);
+    deadline_stop = 1;
+
+    /* the waiting jobs finish in the next period */
+    for (index = 0; index < sizeof(loops) / sizeof(loops[0]) + DEADLINE_BENCH_HOGS; index ++)
+    {
+        if (rt_sem_take(&loop_done, DEADLINE_BENCH_TICKS) != RT_EOK)
+        {
+            errors ++;
+            break;
+        }
+    }
+    rt_thread_delay(1);
+
+    for (index = 0; index < sizeof(loops) / sizeof(loops[0]); index ++)
+    {
+        loop = &loops[index];
+        rt_kprintf("%-6s %2d/%d/%-2d: %3d released, %3d completed, %3d misses, "
+                   "%3d throttled, worst response %d\n",
+                   loop->name, loop->period, loop->budget, loop->deadline,
+                   loop->released, loop->completed, loop->misses,
+                   loop->throttled, loop->response);
+
+        if (index == DEADLINE_BENCH_OVERRUN)
+        {
+            /* throttled in each period */
+            if (loop->completed != 0 || loop->throttled + 1 < loop->released ||
+                loop->misses + 1 < loop->released)
+                errors ++;
+        }
+        else
+        {
+            if (loop->misses != 0 || loop->throttled != 0 ||
+                loop->response > loop->deadline ||
+                loop->completed + 1 < DEADLINE_BENCH_TICKS / loop->period)
+                errors ++;
+        }
+    }
+
+    for (index = 0; index < DEADLINE_BENCH_HOGS; index ++)
+    {
+        /* the fixed priority thread runs in the left time */
+        if (hog_loops[index] == 0)
+            errors ++;
+    }
+
+    /* the utilization is given back when the threads exit */
+    total = 0;
+#ifdef RT_USING_SMP
+    for (cpu = 0; cpu < RT_CPUS_NR; cpu ++)
+#endif
+    {
+        total += rt_deadline_utilization(cpu);
+    }
+    if (total != 0)
+        errors ++;
+
+    rt_thread_control(rt_thread_self(), RT_THREAD_CTRL_CHANGE_PRIORITY, &saved);
+    rt_sem_detach(&loop_done);
+
+    rt_kprintf("deadline bench: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_deadline_bench()
+{
+    deadline_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_deadline_bench, an earliest deadline first scheduling test under load);
+#else
+int rt_application_init()
+{
+    deadline_bench_init();
+
+    return 0;
+}
+#endif
+#endif
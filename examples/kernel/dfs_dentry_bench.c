@@ -0,0 +1,291 @@
+/*
+ * This is a benchmark of the path resolution of DFS.
+ *
+ * A romfs of a deep directory tree is mounted, each directory has some files
+ * and one sub-directory. It shows the stat() and open() calls per second, and
+ * the cycles of a call, on a file at the bottom of tree and on a file which
+ * doesn't exist there. Run it without and with DFS_USING_DENTRY_CACHE to
+ * compare, the cached stat doesn't walk the directories of file system, and
+ * the stat of a normalized path doesn't build the full path.
+ *
+ * When ramfs is enabled, it's mounted on the romfs to check the stat after
+ * the file is created, written, renamed and unlinked.
+ */
+#include <rtthread.h>
+#include <dfs_posix.h>
+#include "tc_comm.h"
+
+#if defined(RT_USING_DFS) && defined(RT_USING_DFS_ROMFS)
+#include <dfs_romfs.h>
+#ifdef RT_USING_DFS_RAMFS
+#include <dfs_ramfs.h>
+#endif
+
+#define DENTRY_BENCH_DEPTH      6
+#define DENTRY_BENCH_FANOUT     8
+#define DENTRY_BENCH_ROUND      20000
+#define DENTRY_BENCH_MOUNT      "/dbench"
+#define DENTRY_BENCH_POOL_SIZE  (8 * 1024)
+
+static const char *file_names[DENTRY_BENCH_FANOUT] =
+{
+    "f0", "f1", "f2", "f3", "f4", "f5", "f6", "f7"
+};
+static const char *dir_names[DENTRY_BENCH_DEPTH] =
+{
+    "d0", "d1", "d2", "d3", "d4", "d5"
+};
+static const rt_uint8_t file_data[] = "dentry bench";
+
+/* the last entry of level 0 is the mount point of ramfs */
+static struct romfs_dirent bench_levels[DENTRY_BENCH_DEPTH][DENTRY_BENCH_FANOUT + 1];
+static struct romfs_dirent bench_root;
+
+static char mount_path[16];
+static char deep_file[64], deep_none[64];
+static rt_uint32_t errors;
+
+/* each directory has files and a sub-directory at last */
+static void dentry_bench_tree_init(void)
+{
+    int level, index;
+    struct romfs_dirent *dirent;
+
+    for (level = 0; level < DENTRY_BENCH_DEPTH; level ++)
+    {
+        for (index = 0; index < DENTRY_BENCH_FANOUT; index ++)
+        {
+            dirent = &bench_levels[level][index];
+            if (index == DENTRY_BENCH_FANOUT - 1 && level < DENTRY_BENCH_DEPTH - 1)
+            {
+                dirent->type = ROMFS_DIRENT_DIR;
+                dirent->name = dir_names[level];
+                dirent->data = (const rt_uint8_t *)bench_levels[level + 1];
+                dirent->size = DENTRY_BENCH_FANOUT;
+            }
+            else
+            {
+                dirent->type = ROMFS_DIRENT_FILE;
+                dirent->name = file_names[index];
+                dirent->data = file_data;
+                dirent->size = sizeof(file_data);
+            }
+        }
+    }
+
+    dirent = &bench_levels[0][DENTRY_BENCH_FANOUT];
+    dirent->type = ROMFS_DIRENT_DIR;
+    dirent->name = "ram";
+    dirent->data = RT_NULL;
+    dirent->size = 0;
+
+    bench_root.type = ROMFS_DIRENT_DIR;
+    bench_root.name = "/";
+    bench_root.data = (const rt_uint8_t *)bench_levels[0];
+    bench_root.size = DENTRY_BENCH_FANOUT + 1;
+}
+
+static void dentry_bench_path_init(void)
+{
+    int level, length;
+
+    length = rt_snprintf(deep_file, sizeof(deep_file), "%s", mount_path[1] ? mount_path : "");
+    for (level = 0; level < DENTRY_BENCH_DEPTH - 1; level ++)
+        length += rt_snprintf(deep_file + length, sizeof(deep_file) - length, "/%s", dir_names[level]);
+
+    rt_snprintf(deep_none, sizeof(deep_none), "%s/none", deep_file);
+    rt_snprintf(deep_file + length, sizeof(deep_file) - length, "/%s", file_names[1]);
+}
+
+static rt_tick_t bench_tick;
+static rt_uint32_t bench_cycle;
+
+static void dentry_bench_start(void)
+{
+    bench_tick  = rt_tick_get();
+    bench_cycle = tc_cycle_get();
+}
+
+static void dentry_bench_report(const char *name)
+{
+    rt_tick_t tick;
+    rt_uint32_t cycle;
+
+    cycle = tc_cycle_get() - bench_cycle;
+    tick  = rt_tick_get() - bench_tick;
+    if (tick == 0)
+        tick = 1;
+
+    rt_kprintf("%-12s: %d calls/s, %d cycles\n", name,
+               DENTRY_BENCH_ROUND * RT_TICK_PER_SECOND / tick,
+               cycle / DENTRY_BENCH_ROUND);
+}
+
+static void dentry_bench_run(void)
+{
+    int index, fd;
+    struct stat buf;
+
+    dentry_bench_start();
+    for (index = 0; index < DENTRY_BENCH_ROUND; index ++)
+    {
+        if (stat(deep_file, &buf) != 0 || buf.st_size != sizeof(file_data))
+            errors ++;
+    }
+    dentry_bench_report("stat");
+
+    /* the open of a file doesn't look up the cache without negative entry */
+    dentry_bench_start();
+    for (index = 0; index < DENTRY_BENCH_ROUND; index ++)
+    {
+        fd = open(deep_file, O_RDONLY, 0);
+        if (fd < 0)
+        {
+            errors ++;
+            continue;
+        }
+        close(fd);
+    }
+    dentry_bench_report("open/close");
+
+    dentry_bench_start();
+    for (index = 0; index < DENTRY_BENCH_ROUND; index ++)
+    {
+        if (stat(deep_none, &buf) == 0)
+            errors ++;
+    }
+    dentry_bench_report("stat none");
+
+    dentry_bench_start();
+    for (index = 0; index < DENTRY_BENCH_ROUND; index ++)
+    {
+        if (open(deep_none, O_RDONLY, 0) >= 0)
+            errors ++;
+    }
+    dentry_bench_report("open none");
+}
+
+#ifdef RT_USING_DFS_RAMFS
+static void dentry_bench_stat_check(const char *path, int size)
+{
+    struct stat buf;
+
+    if (size < 0)
+    {
+        if (stat(path, &buf) == 0)
+            errors ++;
+    }
+    else if (stat(path, &buf) != 0 || buf.st_size != size)
+        errors ++;
+}
+
+/* the cached stat is invalidated when the file is changed */
+static void dentry_bench_ramfs_test(rt_uint8_t *pool)
+{
+    int fd;
+    char ram_path[32], path_a[40], path_b[40];
+
+    rt_snprintf(ram_path, sizeof(ram_path), "%s/ram", mount_path[1] ? mount_path : "");
+    if (dfs_mount(RT_NULL, ram_path, "ram", 0, dfs_ramfs_create(pool, DENTRY_BENCH_POOL_SIZE)) != 0)
+    {
+        errors ++;
+        return;
+    }
+    rt_snprintf(path_a, sizeof(path_a), "%s/a", ram_path);
+    rt_snprintf(path_b, sizeof(path_b), "%s/b", ram_path);
+
+    /* the negative entry is dropped when the file is created */
+    dentry_bench_stat_check(path_a, -1);
+    fd = open(path_a, O_WRONLY | O_CREAT, 0);
+    if (fd < 0)
+        errors ++;
+    dentry_bench_stat_check(path_a, 0);
+
+    write(fd, file_data, 8);
+    dentry_bench_stat_check(path_a, 8);
+    write(fd, file_data, 8);
+    dentry_bench_stat_check(path_a, 16);
+    close(fd);
+
+    /* the entries of both paths are dropped on rename */
+    dentry_bench_stat_check(path_b, -1);
+    if (rename(path_a, path_b) != 0)
+        errors ++;
+    dentry_bench_stat_check(path_a, -1);
+    dentry_bench_stat_check(path_b, 16);
+
+    if (unlink(path_b) != 0)
+        errors ++;
+    dentry_bench_stat_check(path_b, -1);
+
+    dfs_unmount(ram_path);
+    /* the path is on romfs again */
+    dentry_bench_stat_check(ram_path, 0);
+}
+#endif
+
+static void dfs_dentry_bench_init(void)
+{
+#ifdef DFS_USING_DENTRY_CACHE
+    rt_kprintf("dfs dentry bench: dentry cache\n");
+#else
+    rt_kprintf("dfs dentry bench: no dentry cache\n");
+#endif
+
+    errors = 0;
+    dentry_bench_tree_init();
+
+    /* mount romfs on root, or on a directory of the root file system */
+    if (dfs_filesystem_lookup("/") == RT_NULL)
+        rt_strncpy(mount_path, "/", sizeof(mount_path));
+    else
+    {
+        rt_strncpy(mount_path, DENTRY_BENCH_MOUNT, sizeof(mount_path));
+        mkdir(mount_path, 0);
+    }
+    if (dfs_mount(RT_NULL, mount_path, "rom", 0, &bench_root) != 0)
+    {
+        errors ++;
+        goto _exit;
+    }
+    dentry_bench_path_init();
+
+    dentry_bench_run();
+
+#ifdef RT_USING_DFS_RAMFS
+    {
+        rt_uint8_t *pool;
+
+        pool = (rt_uint8_t *)rt_malloc(DENTRY_BENCH_POOL_SIZE);
+        if (pool != RT_NULL)
+        {
+            dentry_bench_ramfs_test(pool);
+            rt_free(pool);
+        }
+    }
+#endif
+
+    dfs_unmount(mount_path);
+
+_exit:
+    rt_kprintf("dfs dentry bench: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_dfs_dentry_bench()
+{
+    dfs_dentry_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_dfs_dentry_bench, a benchmark of path resolution);
+#else
+int rt_application_init()
+{
+    dfs_dentry_bench_init();
+
+    return 0;
+}
+#endif
+#endif
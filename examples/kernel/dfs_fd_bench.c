@@ -0,0 +1,213 @@
+/*
+ * This is a benchmark of the file descriptor table of DFS.
+ *
+ * It opens files on a ramfs until the file descriptor table is full, which
+ * grows the table up to DFS_FD_MAX * DFS_FD_CHUNK_MAX descriptors, and checks
+ * the descriptors are unique. Then the threads read and write their own file
+ * on ramfs at the same time, by 1, 2 and 4 threads. It shows the cycles of a
+ * read or write in each case, the read() and write() don't serialise on the
+ * dfs_lock in fd_get() and fd_put(), so it scales on SMP.
+ */
+#include <rtthread.h>
+#include <dfs_posix.h>
+#include "tc_comm.h"
+
+#if defined(RT_USING_DFS) && defined(RT_USING_DFS_RAMFS)
+#include <dfs_ramfs.h>
+
+#ifndef DFS_FD_CHUNK_MAX
+#define DFS_FD_CHUNK_MAX        1
+#endif
+
+#define FD_BENCH_THREADS        4
+#define FD_BENCH_ROUND          2000
+#define FD_BENCH_SIZE           64
+#define FD_BENCH_POOL_SIZE      (32 * 1024)
+#define FD_BENCH_MOUNT          "/fdbench"
+
+static char mount_path[16];
+static struct rt_semaphore start_sem, done_sem;
+static rt_uint32_t errors;
+
+static void fd_bench_name(char *name, int index)
+{
+    rt_snprintf(name, 32, "%s/f%d", mount_path[1] ? mount_path : "", index);
+}
+
+/* open files until the table is full */
+static void fd_bench_table_test(void)
+{
+    int index, count, fd;
+    int *fds;
+    char name[32];
+
+    fds = (int *)rt_malloc(sizeof(int) * (DFS_FD_MAX * DFS_FD_CHUNK_MAX + 1));
+    if (fds == RT_NULL)
+    {
+        errors ++;
+        return;
+    }
+
+    fd_bench_name(name, 0);
+    for (count = 0; count <= DFS_FD_MAX * DFS_FD_CHUNK_MAX; count ++)
+    {
+        fd = open(name, O_RDWR | O_CREAT, 0);
+        if (fd < 0)
+            break;
+
+        for (index = 0; index < count; index ++)
+        {
+            if (fds[index] == fd)
+                errors ++;
+        }
+        fds[count] = fd;
+    }
+
+    /* the opened files of others are not counted */
+    if (count == 0 || count > DFS_FD_MAX * DFS_FD_CHUNK_MAX)
+        errors ++;
+    rt_kprintf("dfs fd bench: %d files opened, table size %d\n",
+               count, DFS_FD_MAX * DFS_FD_CHUNK_MAX);
+
+    for (index = 0; index < count; index ++)
+    {
+        if (close(fds[index]) != 0)
+            errors ++;
+    }
+    /* closed twice */
+    if (count > 0 && close(fds[0]) == 0)
+        errors ++;
+    rt_free(fds);
+}
+
+static void fd_bench_entry(void *parameter)
+{
+    int index, fd;
+    char name[32];
+    rt_uint8_t buf[FD_BENCH_SIZE];
+    rt_uint8_t value = (rt_uint8_t)(rt_ubase_t)parameter;
+
+    fd_bench_name(name, (int)(rt_ubase_t)parameter);
+    fd = open(name, O_RDWR | O_CREAT, 0);
+    if (fd < 0)
+    {
+        errors ++;
+        rt_sem_release(&done_sem);
+        return;
+    }
+    rt_memset(buf, value, sizeof(buf));
+    write(fd, buf, sizeof(buf));
+
+    rt_sem_take(&start_sem, RT_WAITING_FOREVER);
+    for (index = 0; index < FD_BENCH_ROUND; index ++)
+    {
+        lseek(fd, 0, SEEK_SET);
+        if (read(fd, buf, sizeof(buf)) != sizeof(buf) || buf[index % FD_BENCH_SIZE] != value)
+            errors ++;
+
+        lseek(fd, 0, SEEK_SET);
+        if (write(fd, buf, sizeof(buf)) != sizeof(buf))
+            errors ++;
+    }
+
+    close(fd);
+    unlink(name);
+    rt_sem_release(&done_sem);
+}
+
+static void fd_bench_run(int threads)
+{
+    int index;
+    rt_uint32_t cycle;
+    rt_thread_t tid;
+
+    for (index = 0; index < threads; index ++)
+    {
+        tid = rt_thread_create("fdbench", fd_bench_entry, (void *)(rt_ubase_t)(index + 1),
+                               THREAD_STACK_SIZE * 2, THREAD_PRIORITY, THREAD_TIMESLICE);
+        if (tid == RT_NULL)
+        {
+            errors ++;
+            threads = index;
+            break;
+        }
+        rt_thread_startup(tid);
+    }
+    /* wait for the files created */
+    rt_thread_delay(RT_TICK_PER_SECOND / 10);
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < threads; index ++)
+        rt_sem_release(&start_sem);
+    for (index = 0; index < threads; index ++)
+        rt_sem_take(&done_sem, RT_WAITING_FOREVER);
+    cycle = tc_cycle_get() - cycle;
+
+    if (threads > 0)
+        rt_kprintf("dfs fd bench: %d threads, read/write %d\n", threads,
+                   cycle / (threads * FD_BENCH_ROUND * 2));
+}
+
+static void dfs_fd_bench_init(void)
+{
+    rt_uint8_t *pool;
+
+    errors = 0;
+    rt_sem_init(&start_sem, "fdstart", 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&done_sem, "fddone", 0, RT_IPC_FLAG_FIFO);
+
+    pool = (rt_uint8_t *)rt_malloc(FD_BENCH_POOL_SIZE);
+    if (pool == RT_NULL)
+    {
+        errors ++;
+        goto _exit;
+    }
+
+    /* mount ramfs on root, or on a directory of the root file system */
+    if (dfs_filesystem_lookup("/") == RT_NULL)
+        rt_strncpy(mount_path, "/", sizeof(mount_path));
+    else
+    {
+        rt_strncpy(mount_path, FD_BENCH_MOUNT, sizeof(mount_path));
+        mkdir(mount_path, 0);
+    }
+    if (dfs_mount(RT_NULL, mount_path, "ram", 0, dfs_ramfs_create(pool, FD_BENCH_POOL_SIZE)) != 0)
+    {
+        rt_free(pool);
+        errors ++;
+        goto _exit;
+    }
+
+    fd_bench_table_test();
+    fd_bench_run(1);
+    fd_bench_run(2);
+    fd_bench_run(FD_BENCH_THREADS);
+
+    dfs_unmount(mount_path);
+    rt_free(pool);
+
+_exit:
+    rt_sem_detach(&start_sem);
+    rt_sem_detach(&done_sem);
+
+    rt_kprintf("dfs fd bench: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_dfs_fd_bench()
+{
+    dfs_fd_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_dfs_fd_bench, a benchmark of file descriptor table);
+#else
+int rt_application_init()
+{
+    dfs_fd_bench_init();
+
+    return 0;
+}
+#endif
+#endif
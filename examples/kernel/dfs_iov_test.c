@@ -0,0 +1,333 @@
+/*
+ * This is the test of vectored and positional I/O of DFS.
+ *
+ * It writes a file on ramfs by writev() and reads it back by readv() with
+ * buffers in other sizes, then checks pread() and pwrite() don't change the
+ * file position. Then the threads do pread() and pwrite() on their own part
+ * of one shared file descriptor at the same time, and the cycles of them are
+ * compared with lseek() and read()/write() under a mutex, which is needed to
+ * share a file descriptor without positional I/O.
+ *
+ * At last, the first thread does read() and write() on the shared file
+ * descriptor while the others do pread() and pwrite(), and another thread
+ * grows the file by pwrite() and a second file in turn, so the data of file
+ * is moved during the transfers of others.
+ */
+#include <rtthread.h>
+#include <dfs_posix.h>
+#include "tc_comm.h"
+
+#if defined(RT_USING_DFS) && defined(RT_USING_DFS_RAMFS)
+#include <dfs_ramfs.h>
+
+#define IOV_TEST_THREADS        4
+#define IOV_TEST_ROUND          2000
+#define IOV_TEST_GROW           1024
+#define IOV_TEST_SIZE           64
+#define IOV_TEST_POOL_SIZE      (16 * 1024)
+#define IOV_TEST_MOUNT          "/iovtest"
+
+static char mount_path[16];
+static char file_name[32], grow_name[32];
+static int shared_fd;
+static struct rt_semaphore start_sem, done_sem;
+static struct rt_mutex fd_lock;
+static rt_uint32_t errors;
+
+static void iov_test_fill(rt_uint8_t *buf, rt_size_t size, rt_uint8_t value)
+{
+    rt_size_t index;
+
+    for (index = 0; index < size; index ++)
+        buf[index] = (rt_uint8_t)(value + index);
+}
+
+static void iov_test_vector(void)
+{
+    int fd;
+    rt_uint8_t data[100], buf[100];
+    struct iovec iov[3];
+
+    fd = open(file_name, O_RDWR | O_CREAT | O_TRUNC, 0);
+    if (fd < 0)
+    {
+        errors ++;
+        return;
+    }
+    iov_test_fill(data, sizeof(data), 0);
+
+    /* 100 bytes in 10, 0 and 90 bytes */
+    iov[0].iov_base = data;
+    iov[0].iov_len  = 10;
+    iov[1].iov_base = data + 10;
+    iov[1].iov_len  = 0;
+    iov[2].iov_base = data + 10;
+    iov[2].iov_len  = 90;
+    if (writev(fd, iov, 3) != sizeof(data) || lseek(fd, 0, SEEK_CUR) != sizeof(data))
+        errors ++;
+
+    /* read back in 33, 33 and 50 bytes, the last one is short */
+    rt_memset(buf, 0, sizeof(buf));
+    lseek(fd, 0, SEEK_SET);
+    iov[0].iov_base = buf;
+    iov[0].iov_len  = 33;
+    iov[1].iov_base = buf + 33;
+    iov[1].iov_len  = 33;
+    iov[2].iov_base = buf + 66;
+    iov[2].iov_len  = 50;
+    if (readv(fd, iov, 3) != sizeof(data) || rt_memcmp(buf, data, sizeof(data)) != 0)
+        errors ++;
+    /* end of file */
+    if (readv(fd, iov, 3) != 0)
+        errors ++;
+
+    /* the position is not changed by positional I/O */
+    lseek(fd, 20, SEEK_SET);
+    rt_memset(buf, 0, sizeof(buf));
+    if (pread(fd, buf, 30, 50) != 30 || rt_memcmp(buf, data + 50, 30) != 0)
+        errors ++;
+    if (pread(fd, buf, 30, 80) != 20 || pread(fd, buf, 30, 200) != 0)
+        errors ++;
+    if (pwrite(fd, data, 10, 0) != 10 || lseek(fd, 0, SEEK_CUR) != 20)
+        errors ++;
+
+    /* write after the end of file, the hole is filled with zero */
+    if (pwrite(fd, data, 10, 110) != 10 || lseek(fd, 0, SEEK_END) != 120)
+        errors ++;
+    if (pread(fd, buf, 20, 100) != 20 || buf[0] != 0 || buf[9] != 0 ||
+        rt_memcmp(buf + 10, data, 10) != 0)
+        errors ++;
+
+    iov[0].iov_base = buf;
+    iov[0].iov_len  = 10;
+    iov[1].iov_base = buf + 10;
+    iov[1].iov_len  = 10;
+    if (preadv(fd, iov, 2, 5) != 20 || rt_memcmp(buf, data + 5, 20) != 0)
+        errors ++;
+
+    close(fd);
+    unlink(file_name);
+}
+
+/* the modes of test run */
+#define IOV_MODE_LOCKED         0x01    /* lseek+read/write with lock */
+#define IOV_MODE_MIXED          0x02    /* read/write with pread/pwrite and growth */
+
+static void iov_test_entry(void *parameter)
+{
+    int index, mode, plain;
+    off_t offset;
+    rt_uint8_t value, buf[IOV_TEST_SIZE];
+
+    mode   = (rt_ubase_t)parameter & 0x03;
+    value  = (rt_uint8_t)((rt_ubase_t)parameter >> 2);
+    offset = value * IOV_TEST_SIZE;
+    /* the first thread of mixed run is the only one changes the position */
+    plain  = (mode & IOV_MODE_LOCKED) || ((mode & IOV_MODE_MIXED) && value == 0);
+
+    rt_sem_take(&start_sem, RT_WAITING_FOREVER);
+    for (index = 0; index < IOV_TEST_ROUND; index ++)
+    {
+        rt_memset(buf, value + index, sizeof(buf));
+        if (plain)
+        {
+            if (mode & IOV_MODE_LOCKED)
+                rt_mutex_take(&fd_lock, RT_WAITING_FOREVER);
+            lseek(shared_fd, offset, SEEK_SET);
+            if (write(shared_fd, buf, sizeof(buf)) != sizeof(buf))
+                errors ++;
+            if (mode & IOV_MODE_LOCKED)
+                rt_mutex_release(&fd_lock);
+        }
+        else if (pwrite(shared_fd, buf, sizeof(buf), offset) != sizeof(buf))
+            errors ++;
+
+        rt_memset(buf, 0, sizeof(buf));
+        if (plain)
+        {
+            if (mode & IOV_MODE_LOCKED)
+                rt_mutex_take(&fd_lock, RT_WAITING_FOREVER);
+            lseek(shared_fd, offset, SEEK_SET);
+            if (read(shared_fd, buf, sizeof(buf)) != sizeof(buf))
+                errors ++;
+            if (mode & IOV_MODE_LOCKED)
+                rt_mutex_release(&fd_lock);
+        }
+        else if (pread(shared_fd, buf, sizeof(buf), offset) != sizeof(buf))
+            errors ++;
+
+        /* the part of file is not written by others */
+        if (buf[0] != (rt_uint8_t)(value + index) ||
+            buf[IOV_TEST_SIZE - 1] != (rt_uint8_t)(value + index))
+            errors ++;
+    }
+
+    rt_sem_release(&done_sem);
+}
+
+/* grow the shared file and a second file in turn, so the data is moved */
+static void iov_grow_entry(void *parameter)
+{
+    int index, fd;
+    rt_uint8_t value = 0x5a;
+
+    fd = open(grow_name, O_RDWR | O_CREAT | O_TRUNC, 0);
+    if (fd < 0)
+        errors ++;
+
+    rt_sem_take(&start_sem, RT_WAITING_FOREVER);
+    for (index = 0; index < IOV_TEST_GROW && fd >= 0; index ++)
+    {
+        if (pwrite(shared_fd, &value, 1, IOV_TEST_THREADS * IOV_TEST_SIZE + index) != 1 ||
+            write(fd, &value, 1) != 1)
+            errors ++;
+    }
+
+    if (fd >= 0)
+    {
+        close(fd);
+        unlink(grow_name);
+    }
+    rt_sem_release(&done_sem);
+}
+
+static void iov_test_run(int mode)
+{
+    int index, threads, grows = 0;
+    rt_uint32_t cycle;
+    rt_thread_t tid;
+
+    shared_fd = open(file_name, O_RDWR | O_CREAT | O_TRUNC, 0);
+    if (shared_fd < 0)
+    {
+        errors ++;
+        return;
+    }
+    if (mode & IOV_MODE_LOCKED)
+    {
+        rt_uint8_t buf[IOV_TEST_SIZE];
+
+        /* ramfs doesn't seek after the end of file */
+        rt_memset(buf, 0, sizeof(buf));
+        for (index = 0; index < IOV_TEST_THREADS; index ++)
+            write(shared_fd, buf, sizeof(buf));
+    }
+    /* the position of shared file descriptor */
+    lseek(shared_fd, 0, SEEK_SET);
+
+    for (threads = 0; threads < IOV_TEST_THREADS; threads ++)
+    {
+        tid = rt_thread_create("iovtest", iov_test_entry,
+                               (void *)(rt_ubase_t)((threads << 2) | mode),
+                               THREAD_STACK_SIZE * 2, THREAD_PRIORITY, THREAD_TIMESLICE);
+        if (tid == RT_NULL)
+        {
+            errors ++;
+            break;
+        }
+        rt_thread_startup(tid);
+    }
+    if ((mode & IOV_MODE_MIXED) && threads == IOV_TEST_THREADS)
+    {
+        tid = rt_thread_create("iovgrow", iov_grow_entry, RT_NULL,
+                               THREAD_STACK_SIZE * 2, THREAD_PRIORITY, THREAD_TIMESLICE);
+        if (tid == RT_NULL)
+            errors ++;
+        else
+        {
+            rt_thread_startup(tid);
+            grows = 1;
+        }
+    }
+    rt_thread_delay(RT_TICK_PER_SECOND / 10);
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < threads + grows; index ++)
+        rt_sem_release(&start_sem);
+    for (index = 0; index < threads + grows; index ++)
+        rt_sem_take(&done_sem, RT_WAITING_FOREVER);
+    cycle = tc_cycle_get() - cycle;
+
+    /* the position is not changed by pread/pwrite */
+    if (mode == 0 && lseek(shared_fd, 0, SEEK_CUR) != 0)
+        errors ++;
+    /* the file is grown by all threads */
+    if (lseek(shared_fd, 0, SEEK_END) != threads * IOV_TEST_SIZE + grows * IOV_TEST_GROW)
+        errors ++;
+
+    if (threads > 0 && !(mode & IOV_MODE_MIXED))
+        rt_kprintf("dfs iov test: %d threads, %s %d\n", threads,
+                   (mode & IOV_MODE_LOCKED) ? "lseek+read/write with lock" : "pread/pwrite",
+                   cycle / (threads * IOV_TEST_ROUND * 2));
+
+    close(shared_fd);
+    unlink(file_name);
+}
+
+static void dfs_iov_test_init(void)
+{
+    rt_uint8_t *pool;
+
+    errors = 0;
+    rt_sem_init(&start_sem, "iovstart", 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&done_sem, "iovdone", 0, RT_IPC_FLAG_FIFO);
+    rt_mutex_init(&fd_lock, "iovlock", RT_IPC_FLAG_FIFO);
+
+    pool = (rt_uint8_t *)rt_malloc(IOV_TEST_POOL_SIZE);
+    if (pool == RT_NULL)
+    {
+        errors ++;
+        goto _exit;
+    }
+
+    /* mount ramfs on root, or on a directory of the root file system */
+    if (dfs_filesystem_lookup("/") == RT_NULL)
+        rt_strncpy(mount_path, "/", sizeof(mount_path));
+    else
+    {
+        rt_strncpy(mount_path, IOV_TEST_MOUNT, sizeof(mount_path));
+        mkdir(mount_path, 0);
+    }
+    if (dfs_mount(RT_NULL, mount_path, "ram", 0, dfs_ramfs_create(pool, IOV_TEST_POOL_SIZE)) != 0)
+    {
+        rt_free(pool);
+        errors ++;
+        goto _exit;
+    }
+    rt_snprintf(file_name, sizeof(file_name), "%s/iov", mount_path[1] ? mount_path : "");
+    rt_snprintf(grow_name, sizeof(grow_name), "%s/grow", mount_path[1] ? mount_path : "");
+
+    iov_test_vector();
+    iov_test_run(IOV_MODE_LOCKED);
+    iov_test_run(0);
+    iov_test_run(IOV_MODE_MIXED);
+
+    dfs_unmount(mount_path);
+    rt_free(pool);
+
+_exit:
+    rt_sem_detach(&start_sem);
+    rt_sem_detach(&done_sem);
+    rt_mutex_detach(&fd_lock);
+
+    rt_kprintf("dfs iov test: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_dfs_iov_test()
+{
+    dfs_iov_test_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_dfs_iov_test, a test of vectored and positional I/O);
+#else
+int rt_application_init()
+{
+    dfs_iov_test_init();
+
+    return 0;
+}
+#endif
+#endif
@@ -0,0 +1,155 @@
+/*
+ * This is a benchmark of the thread switch with FPU.
+ *
+ * Two threads of the same priority switch to each other by yield, and do a
+ * floating point addition in each round, by neither of them, one of them or
+ * both of them. It shows the average cycles of a thread switch in each case,
+ * and checks the floating point results, which are kept in FPU registers
+ * across the switches.
+ *
+ * Run it without and with RT_USING_LAZY_FPU to compare the context switch of
+ * CPU port. With the lazy FPU, the switch is as cheap as the integer one when
+ * only one thread uses the FPU, and the FPU registers are swapped on the trap
+ * when both of them use it.
+ */
+#include <rtthread.h>
+#include <rthw.h>
+#include "tc_comm.h"
+
+#define FPU_BENCH_ROUND         1000
+#define FPU_BENCH_PRIORITY      1
+/* the sum of index * 0.5 in the rounds, exact in double */
+#define FPU_BENCH_SUM           ((double)FPU_BENCH_ROUND * (FPU_BENCH_ROUND - 1) / 4)
+
+static volatile double fpu_scale = 0.5;
+static struct rt_semaphore peer_done, bench_done;
+static rt_uint32_t errors;
+
+static void fpu_bench_peer_entry(void *parameter)
+{
+    int index;
+    double acc = 0;
+    int use_fpu = (int)(rt_ubase_t)parameter;
+
+    for (index = 0; index < FPU_BENCH_ROUND; index ++)
+    {
+        if (use_fpu)
+            acc += index * fpu_scale;
+        rt_thread_yield();
+    }
+
+    if (use_fpu && acc != FPU_BENCH_SUM)
+        errors ++;
+
+    rt_sem_release(&peer_done);
+}
+
+static rt_thread_t fpu_bench_thread_create(void (*entry)(void *), void *parameter)
+{
+    rt_thread_t tid;
+
+    tid = rt_thread_create("fbench", entry, parameter, THREAD_STACK_SIZE,
+                           FPU_BENCH_PRIORITY, THREAD_TIMESLICE);
+    if (tid == RT_NULL)
+        return RT_NULL;
+
+#ifdef RT_USING_SMP
+    {
+        rt_uint8_t cpu;
+
+        /* the bench threads shall run on the same cpu */
+        cpu = rt_hw_cpu_id();
+        rt_thread_control(tid, RT_THREAD_CTRL_BIND_CPU, &cpu);
+    }
+#endif
+
+    return tid;
+}
+
+static void fpu_bench_run(const char *name, int self_fpu, int peer_fpu)
+{
+    int index;
+    double acc = 0;
+    rt_uint32_t cycle;
+    rt_thread_t peer;
+
+    peer = fpu_bench_thread_create(fpu_bench_peer_entry, (void *)(rt_ubase_t)peer_fpu);
+    if (peer == RT_NULL)
+    {
+        errors ++;
+        return;
+    }
+    rt_thread_startup(peer);
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < FPU_BENCH_ROUND; index ++)
+    {
+        if (self_fpu)
+            acc += index * fpu_scale;
+        rt_thread_yield();
+    }
+    cycle = tc_cycle_get() - cycle;
+
+    rt_sem_take(&peer_done, RT_WAITING_FOREVER);
+    if (self_fpu && acc != FPU_BENCH_SUM)
+        errors ++;
+
+    rt_kprintf("%-10s: switch %d\n", name, cycle / (FPU_BENCH_ROUND * 2));
+}
+
+static void fpu_bench_entry(void *parameter)
+{
+    fpu_bench_run("integer", 0, 0);
+    fpu_bench_run("fpu by one", 1, 0);
+    fpu_bench_run("fpu by two", 1, 1);
+
+    rt_sem_release(&bench_done);
+}
+
+static void fpu_switch_bench_init(void)
+{
+    rt_thread_t tid;
+
+#ifdef RT_USING_LAZY_FPU
+    rt_kprintf("fpu switch bench: lazy FPU\n");
+#else
+    rt_kprintf("fpu switch bench: FPU saved on switch\n");
+#endif
+
+    errors = 0;
+    rt_sem_init(&peer_done, "fpeer", 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&bench_done, "fbench", 0, RT_IPC_FLAG_FIFO);
+
+    tid = fpu_bench_thread_create(fpu_bench_entry, RT_NULL);
+    if (tid == RT_NULL)
+    {
+        rt_sem_detach(&peer_done);
+        rt_sem_detach(&bench_done);
+        tc_done(TC_STAT_FAILED);
+        return;
+    }
+    rt_thread_startup(tid);
+    rt_sem_take(&bench_done, RT_WAITING_FOREVER);
+    rt_sem_detach(&peer_done);
+    rt_sem_detach(&bench_done);
+
+    rt_kprintf("fpu switch bench: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_fpu_switch_bench()
+{
+    fpu_switch_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_fpu_switch_bench, a thread switch benchmark with FPU);
+#else
+int rt_application_init()
+{
+    fpu_switch_bench_init();
+
+    return 0;
+}
+#endif
@@ -0,0 +1,368 @@
+/*
+ * This is a stress benchmark for the system heap.
+ *
+ * It replays an allocation trace for HEAP_BENCH_ROUND rounds and reports the
+ * average, p99 and worst-case time of rt_malloc(), the worst-case time of
+ * rt_free(), and the fragmentation of heap at the end of the trace, which is
+ * the largest block allocatable compared with all of the free memory. Each
+ * block is filled with a pattern and checked before released, so it's also a
+ * stress test of the heap.
+ *
+ * The heap backend is selected at compile time. Build it with
+ * RT_USING_SMALL_MEM, RT_USING_SLAB, RT_USING_TLSF or RT_USING_MEMHEAP_AS_HEAP
+ * to compare the backends. The slab backend reserves a zone for each size
+ * class, it needs several megabytes of heap to replay the trace.
+ *
+ * The built-in trace is generated from a workload model of an embedded
+ * application: 55% of allocations are 8-64 bytes, 30% are 65-512 bytes, 11%
+ * are 513-2048 bytes buffers and 4% are 1K-4K bytes thread stacks, up to 48
+ * blocks are alive and the smaller blocks are released sooner. The peak of
+ * alive data is about 38K bytes. To replay the trace of an application, record
+ * it by rt_malloc_sethook()/rt_free_sethook() and replace heap_trace[].
+ */
+#include <rtthread.h>
+#include "tc_comm.h"
+
+#define HEAP_BENCH_ROUND        4
+#define HEAP_BENCH_SLOTS        48
+
+/*
+ * The allocation trace, each event is a pair of block slot and size. The size
+ * 0 is to release the block in the slot.
+ */
+static const rt_uint16_t heap_trace[] =
+{
+    16, 55, 25, 32, 29, 198, 16, 0, 25, 0, 6, 1313, 22, 64, 39, 30,
+    39, 0, 29, 0, 7, 1531, 10, 21, 42, 34, 32, 284, 22, 0, 10, 0,
+    3, 14, 14, 427, 16, 351, 4, 179, 32, 0, 19, 284, 23, 29, 16, 0,
+    30, 255, 10, 23, 3, 0, 6, 0, 12, 27, 39, 8, 20, 51, 8, 325,
+    39, 0, 18, 88, 10, 0, 30, 0, 23, 0, 35, 41, 43, 2048, 35, 0,
+    19, 0, 4, 0, 28, 20, 35, 266, 31, 35, 28, 0, 17, 19, 27, 47,
+    27, 0, 35, 0, 31, 0, 20, 0, 12, 0, 7, 0, 14, 0, 11, 306,
+    39, 13, 43, 0, 17, 0, 26, 55, 39, 0, 42, 0, 13, 264, 8, 0,
+    33, 61, 9, 41, 37, 358, 37, 0, 2, 226, 19, 51, 2, 0, 40, 193,
+    43, 366, 7, 489, 17, 256, 21, 46, 35, 132, 23, 32, 18, 0, 37, 365,
+    28, 21, 44, 40, 14, 1968, 38, 446, 25, 2048, 18, 30, 24, 324, 29, 52,
+    44, 0, 21, 0, 14, 0, 22, 20, 33, 0, 42, 51, 16, 504, 0, 14,
+    32, 41, 0, 0, 12, 446, 36, 256, 44, 22, 30, 4096, 8, 58, 26, 0,
+    19, 0, 32, 0, 8, 0, 35, 0, 28, 0, 42, 0, 47, 119, 11, 0,
+    2, 23, 17, 0, 8, 44, 36, 0, 0, 52, 42, 1702, 0, 0, 12, 0,
+    20, 37, 38, 0, 3, 8, 39, 583, 35, 866, 13, 0, 36, 28, 2, 0,
+    27, 32, 10, 13, 18, 0, 29, 0, 5, 16, 18, 1344, 16, 0, 44, 0,
+    5, 0, 13, 198, 8, 0, 17, 190, 38, 156, 16, 264, 8, 26, 34, 906,
+    5, 29, 5, 0, 31, 391, 0, 342, 43, 0, 11, 20, 4, 443, 15, 442,
+    33, 1715, 1, 233, 44, 22, 2, 1877, 46, 193, 25, 0, 6, 1002, 4, 0,
+    5, 26, 32, 39, 15, 0, 14, 360, 19, 612, 4, 38, 4, 0, 34, 0,
+    21, 9, 28, 45, 34, 32, 42, 0, 12, 820, 41, 331, 45, 25, 43, 1776,
+    20, 0, 42, 64, 29, 1681, 5, 0, 15, 32, 5, 336, 21, 0, 20, 11,
+    27, 0, 16, 0, 27, 44, 26, 64, 4, 421, 36, 0, 35, 0, 21, 16,
+    16, 23, 32, 0, 36, 85, 32, 2048, 15, 0, 25, 14, 18, 0, 10, 0,
+    39, 0, 15, 230, 22, 0, 1, 0, 16, 0, 16, 950, 10, 335, 35, 425,
+    39, 301, 42, 0, 22, 371, 1, 13, 42, 24, 18, 2048, 32, 0, 3, 0,
+    8, 0, 32, 60, 8, 32, 3, 30, 44, 0, 44, 8, 42, 0, 37, 0,
+    42, 156, 37, 1612, 41, 0, 41, 31, 11, 0, 11, 63, 11, 0, 11, 62,
+    45, 0, 45, 63, 22, 0, 22, 13, 26, 0, 26, 56, 11, 0, 27, 0,
+    27, 292, 11, 40, 21, 0, 21, 157, 19, 0, 19, 52, 14, 0, 14, 200,
+    26, 0, 26, 627, 28, 0, 28, 28, 34, 0, 34, 65, 46, 0, 6, 0,
+    46, 31, 6, 31, 46, 0, 41, 0, 41, 1977, 20, 0, 16, 0, 26, 0,
+    46, 23, 32, 0, 20, 31, 16, 488, 32, 118, 20, 0, 20, 273, 14, 0,
+    14, 74, 26, 8, 10, 0, 10, 1244, 9, 0, 9, 27, 39, 0, 23, 0,
+    39, 903, 23, 45, 33, 0, 33, 11, 43, 0, 43, 26, 42, 0, 42, 36,
+    6, 0, 6, 192, 29, 0, 29, 64, 26, 0, 26, 26, 27, 0, 27, 316,
+    46, 0, 46, 83, 22, 0, 22, 51, 26, 0, 26, 62, 4, 0, 4, 188,
+    27, 0, 27, 326, 33, 0, 27, 0, 27, 1312, 44, 0, 22, 0, 44, 708,
+    33, 136, 14, 0, 22, 55, 14, 21, 5, 0, 5, 58, 45, 0, 43, 0,
+    43, 30, 35, 0, 45, 512, 35, 1202, 11, 0, 11, 60, 43, 0, 43, 54,
+    11, 0, 11, 14, 26, 0, 26, 50, 13, 0, 26, 0, 26, 497, 0, 0,
+    13, 82, 0, 41, 11, 0, 35, 0, 11, 28, 35, 38, 23, 0, 23, 61,
+    19, 0, 19, 12, 23, 0, 23, 44, 7, 0, 7, 206, 14, 0, 14, 4096,
+    45, 0, 45, 424, 12, 0, 12, 46, 32, 0, 32, 509, 40, 0, 1, 0,
+    1, 45, 5, 0, 25, 0, 25, 58, 35, 0, 35, 388, 5, 63, 15, 0,
+    40, 63, 15, 26, 37, 0, 37, 27, 38, 0, 14, 0, 38, 48, 43, 0,
+    23, 0, 43, 40, 23, 57, 14, 40, 43, 0, 4, 0, 29, 0, 15, 0,
+    8, 0, 4, 26, 15, 1931, 43, 61, 34, 0, 8, 1177, 29, 1244, 37, 0,
+    34, 50, 19, 0, 43, 0, 37, 43, 5, 0, 26, 0, 38, 0, 8, 0,
+    5, 28, 33, 0, 28, 0, 38, 56, 43, 67, 19, 1276, 8, 29, 28, 38,
+    33, 48, 26, 46, 42, 0, 5, 0, 29, 0, 5, 106, 29, 310, 26, 0,
+    32, 0, 26, 25, 32, 30, 3, 0, 42, 57, 33, 0, 3, 114, 33, 17,
+    46, 0, 46, 61, 28, 0, 12, 0, 12, 55, 28, 82, 32, 0, 26, 0,
+    5, 0, 9, 0, 9, 487, 5, 33, 25, 0, 32, 2560, 25, 61, 13, 0,
+    34, 0, 26, 322, 13, 490, 34, 100, 6, 0, 6, 17, 42, 0, 46, 0,
+    45, 0, 13, 0, 46, 13, 42, 85, 13, 245, 45, 18, 34, 0, 40, 0,
+    40, 4096, 34, 60, 13, 0, 13, 1713, 18, 0, 42, 0, 42, 423, 18, 143,
+    18, 0, 36, 0, 28, 0, 34, 0, 28, 38, 1, 0, 18, 137, 23, 0,
+    5, 0, 25, 0, 3, 0, 36, 64, 5, 16, 3, 2048, 25, 54, 1, 756,
+    36, 0, 23, 22, 36, 49, 34, 64, 21, 0, 21, 45, 46, 0, 38, 0,
+    38, 127, 46, 44, 10, 0, 25, 0, 25, 243, 10, 34, 6, 0, 28, 0,
+    8, 0, 6, 212, 8, 23, 28, 145, 45, 0, 12, 0, 46, 0, 12, 462,
+    45, 55, 46, 28, 8, 0, 8, 1536, 21, 0, 21, 9, 18, 0, 18, 1255,
+    31, 0, 31, 49, 10, 0, 22, 0, 4, 0, 22, 37, 3, 0, 10, 983,
+    3, 25, 4, 266, 14, 0, 33, 0, 12, 0, 14, 689, 12, 29, 26, 0,
+    33, 260, 12, 0, 26, 457, 12, 269, 11, 0, 11, 30, 34, 0, 34, 18,
+    45, 0, 4, 0, 4, 9, 29, 0, 15, 0, 29, 1917, 15, 4096, 23, 0,
+    23, 15, 45, 10, 23, 0, 23, 111, 47, 0, 47, 24, 35, 0, 17, 0,
+    35, 25, 36, 0, 17, 1832, 0, 0, 36, 28, 0, 91, 21, 0, 21, 56,
+    24, 0, 24, 435, 5, 0, 5, 478, 15, 0, 11, 0, 15, 380, 11, 375,
+    40, 0, 40, 50, 15, 0, 3, 0, 40, 0, 3, 36, 15, 28, 40, 23,
+    0, 0, 36, 0, 35, 0, 35, 49, 36, 34, 40, 0, 3, 0, 43, 0,
+    19, 0, 45, 0, 47, 0, 6, 0, 45, 1977, 40, 378, 40, 0, 47, 18,
+    37, 0, 19, 291, 40, 27, 6, 53, 3, 27, 31, 0, 31, 33, 21, 0,
+    47, 0, 46, 0, 31, 0, 35, 0, 43, 1227, 37, 29, 35, 62, 15, 0,
+    7, 0, 38, 0, 40, 0, 35, 0, 47, 2048, 22, 0, 34, 0, 30, 0,
+    41, 0, 31, 92, 35, 43, 0, 93, 13, 0, 21, 58, 40, 51, 7, 16,
+    46, 39, 4, 0, 7, 0, 40, 0, 23, 0, 4, 42, 34, 56, 15, 57,
+    30, 1946, 46, 0, 7, 22, 43, 0, 41, 161, 40, 33, 12, 0, 4, 0,
+    4, 41, 37, 0, 37, 25, 34, 0, 43, 482, 46, 84, 13, 222, 22, 44,
+    4, 0, 34, 486, 5, 0, 4, 256, 3, 0, 12, 39, 36, 0, 23, 464,
+    5, 46, 36, 37, 38, 335, 6, 0, 42, 0, 6, 32, 24, 0, 9, 0,
+    36, 0, 41, 0, 3, 327, 22, 0, 9, 246, 36, 56, 40, 0, 6, 0,
+    42, 178, 42, 0, 41, 749, 11, 0, 11, 400, 24, 61, 8, 0, 40, 176,
+    21, 0, 37, 0, 21, 353, 42, 1705, 7, 0, 22, 48, 35, 0, 35, 408,
+    3, 0, 31, 0, 6, 2048, 7, 453, 38, 0, 23, 0, 14, 0, 42, 0,
+    15, 0, 38, 62, 22, 0, 33, 0, 14, 36, 11, 0, 14, 0, 15, 22,
+    9, 0, 33, 461, 0, 0, 25, 0, 31, 41, 23, 42, 26, 0, 22, 43,
+    14, 1407, 42, 12, 11, 62, 25, 28, 42, 0, 8, 34, 38, 0, 3, 550,
+    37, 2048, 43, 0, 15, 0, 42, 33, 23, 0, 0, 2048, 25, 0, 18, 0,
+    29, 0, 11, 0, 18, 14, 25, 62, 38, 44, 23, 339, 15, 473, 38, 0,
+    9, 24, 26, 45, 4, 0, 42, 0, 42, 57, 11, 192, 22, 0, 36, 0,
+    22, 39, 11, 0, 24, 0, 12, 0, 42, 0, 16, 0, 8, 0, 21, 0,
+    29, 62, 40, 0, 9, 0, 22, 0, 43, 432, 29, 0, 18, 0, 38, 34,
+    26, 0, 7, 0, 21, 64, 13, 0, 8, 1777, 40, 41, 9, 373, 13, 45,
+    21, 0, 9, 0, 9, 179, 12, 4096, 5, 0, 45, 0, 22, 21, 25, 0,
+    31, 0, 20, 0, 7, 504, 24, 25, 18, 52, 15, 0, 42, 13, 15, 24,
+    36, 68, 9, 0, 26, 63, 15, 0, 14, 0, 29, 64, 45, 488, 20, 10,
+    5, 19, 33, 0, 9, 15, 16, 21, 2, 0, 4, 348, 0, 0, 2, 60,
+    38, 0, 20, 0, 43, 0, 33, 12, 47, 0, 29, 0, 38, 187, 10, 0,
+    23, 0, 34, 0, 34, 17, 11, 55, 15, 90, 21, 11, 13, 0, 15, 0,
+    13, 286, 38, 0, 12, 0, 18, 0, 20, 45, 16, 0, 29, 32, 45, 0,
+    16, 1164, 14, 29, 18, 90, 47, 9, 15, 26, 47, 0, 5, 0, 14, 0,
+    43, 38, 10, 204, 0, 44, 11, 0, 9, 0, 28, 0, 42, 0, 9, 232,
+    18, 0, 1, 0, 47, 58, 11, 639, 38, 16, 42, 182, 23, 214, 26, 0,
+    38, 0, 16, 0, 46, 0, 40, 0, 47, 0, 24, 0, 31, 30, 42, 0,
+    28, 24, 34, 0, 0, 0, 14, 9, 46, 115, 27, 0, 28, 0, 26, 1830,
+    5, 24, 24, 53, 27, 8, 26, 0, 34, 108, 15, 0, 39, 0, 28, 21,
+    14, 0, 0, 1084, 24, 0, 18, 17, 33, 0, 39, 1949, 15, 1684, 28, 0,
+    40, 273, 26, 53, 25, 656, 43, 0, 22, 0, 4, 0, 28, 19, 42, 21,
+    45, 152, 12, 56, 24, 12, 22, 26, 27, 0, 38, 215, 20, 0, 12, 0,
+    16, 233, 23, 0, 18, 0, 29, 0, 42, 0, 46, 0, 27, 288, 41, 0,
+    2, 0, 24, 0, 47, 261, 2, 20, 47, 0, 43, 487, 1, 504, 29, 1969,
+    21, 0, 6, 0, 38, 0, 20, 393, 7, 0, 24, 41, 9, 0, 18, 49,
+    2, 0, 42, 1866, 28, 0, 12, 32, 34, 0, 9, 59, 45, 0, 10, 0,
+    23, 753, 27, 0, 23, 0, 36, 0, 22, 0, 23, 28, 33, 401, 25, 0,
+    21, 8, 35, 0, 15, 0, 12, 0, 17, 0, 41, 54, 38, 200, 41, 0,
+    19, 0, 32, 0, 47, 297, 10, 94, 18, 0, 37, 0, 40, 0, 4, 308,
+    37, 15, 43, 0, 12, 10, 42, 0, 31, 0, 4, 0, 36, 456, 10, 0,
+    32, 29, 42, 466, 32, 0, 9, 0, 6, 52, 2, 31, 40, 11, 23, 0,
+    33, 0, 6, 0, 42, 0, 40, 0, 12, 0, 17, 1838, 4, 214, 38, 0,
+    23, 54, 5, 0, 38, 1234, 12, 58, 26, 0, 43, 28, 46, 653, 28, 1186,
+    16, 0, 7, 54, 2, 0, 12, 0, 39, 0, 5, 196, 27, 24, 15, 64,
+    36, 0, 47, 0, 36, 9, 37, 0, 37, 21, 21, 0, 8, 0, 23, 0,
+    9, 2048, 2, 12, 21, 261, 6, 38, 30, 0, 23, 1360, 5, 0, 28, 0,
+    38, 0, 40, 392, 20, 0, 25, 397, 25, 0, 23, 0, 25, 39, 37, 0,
+    36, 0, 43, 0, 7, 0, 30, 15, 17, 0, 17, 182, 31, 22, 2, 0,
+};
+
+#define HEAP_TRACE_EVENTS       (sizeof(heap_trace) / sizeof(heap_trace[0]) / 2)
+
+struct heap_bench_block
+{
+    rt_uint8_t *ptr;
+    rt_uint16_t size;
+};
+
+static struct heap_bench_block blocks[HEAP_BENCH_SLOTS];
+static rt_uint32_t latency[HEAP_TRACE_EVENTS];
+
+static rt_uint32_t malloc_max, malloc_p99, free_max, total_cycles, total_count;
+
+static void heap_bench_sort(rt_uint32_t *data, rt_uint32_t count)
+{
+    rt_uint32_t i, j, value;
+
+    /* insertion sort */
+    for (i = 1; i < count; i ++)
+    {
+        value = data[i];
+        for (j = i; j > 0 && data[j - 1] > value; j --)
+            data[j] = data[j - 1];
+        data[j] = value;
+    }
+}
+
+/* release the block in slot, return the number of corrupted bytes */
+static rt_uint32_t heap_bench_free(int slot)
+{
+    rt_uint32_t index, errors = 0, cycle;
+    rt_uint8_t pattern = (rt_uint8_t)(slot * 7 + 1);
+
+    for (index = 0; index < blocks[slot].size; index ++)
+    {
+        if (blocks[slot].ptr[index] != pattern)
+            errors ++;
+    }
+
+    cycle = tc_cycle_get();
+    rt_free(blocks[slot].ptr);
+    cycle = tc_cycle_get() - cycle;
+    if (cycle > free_max)
+        free_max = cycle;
+
+    blocks[slot].ptr = RT_NULL;
+
+    return errors;
+}
+
+/* find the largest block allocatable by binary search */
+static rt_uint32_t heap_bench_largest(rt_uint32_t limit)
+{
+    void *ptr;
+    rt_uint32_t low = 0, high = limit, size;
+
+    while (low < high)
+    {
+        size = low + (high - low + 1) / 2;
+
+        ptr = rt_malloc(size);
+        if (ptr != RT_NULL)
+        {
+            rt_free(ptr);
+            low = size;
+        }
+        else
+        {
+            high = size - 1;
+        }
+    }
+
+    return low;
+}
+
+static void heap_bench_fragment(void)
+{
+    int slot;
+    rt_uint32_t total, used, largest, percent, live = 0;
+
+    for (slot = 0; slot < HEAP_BENCH_SLOTS; slot ++)
+    {
+        if (blocks[slot].ptr != RT_NULL)
+            live += blocks[slot].size;
+    }
+
+    rt_memory_info(&total, &used, RT_NULL);
+    largest = heap_bench_largest(total - used);
+
+    /* the percent of free memory not in the largest block */
+    percent = 0;
+    if (total - used >= 100 && largest < total - used)
+        percent = 100 - largest / ((total - used) / 100);
+
+    rt_kprintf("fragmentation: free %d, largest block %d (%d%% fragmented), "
+               "used %d for %d live bytes\n",
+               total - used, largest, percent, used, live);
+}
+
+/* replay the trace, return the number of errors */
+static rt_uint32_t heap_bench_replay(int round)
+{
+    int slot;
+    rt_uint32_t index, count = 0, errors = 0, cycle;
+    rt_uint16_t size;
+
+    for (index = 0; index < HEAP_TRACE_EVENTS; index ++)
+    {
+        slot = heap_trace[index * 2];
+        size = heap_trace[index * 2 + 1];
+
+        if (size == 0)
+        {
+            errors += heap_bench_free(slot);
+            continue;
+        }
+
+        cycle = tc_cycle_get();
+        blocks[slot].ptr = (rt_uint8_t *)rt_malloc(size);
+        cycle = tc_cycle_get() - cycle;
+
+        if (blocks[slot].ptr == RT_NULL)
+        {
+            rt_kprintf("allocate %d bytes failed at event %d\n", size, index);
+            errors ++;
+            break;
+        }
+        blocks[slot].size = size;
+        rt_memset(blocks[slot].ptr, slot * 7 + 1, size);
+
+        latency[count ++] = cycle;
+        total_cycles += cycle;
+    }
+    total_count += count;
+
+    if (round == 0)
+        heap_bench_fragment();
+
+    /* release the blocks alive at the end of trace */
+    for (slot = 0; slot < HEAP_BENCH_SLOTS; slot ++)
+    {
+        if (blocks[slot].ptr != RT_NULL)
+            errors += heap_bench_free(slot);
+    }
+
+    heap_bench_sort(latency, count);
+    if (count > 0)
+    {
+        if (latency[count * 99 / 100] > malloc_p99)
+            malloc_p99 = latency[count * 99 / 100];
+        if (latency[count - 1] > malloc_max)
+            malloc_max = latency[count - 1];
+    }
+
+    return errors;
+}
+
+static void heap_bench_init(void)
+{
+    int round;
+    rt_uint32_t errors = 0;
+
+#if defined(RT_USING_MEMHEAP_AS_HEAP)
+    rt_kprintf("heap backend: memheap\n");
+#elif defined(RT_USING_TLSF)
+    rt_kprintf("heap backend: tlsf\n");
+#elif defined(RT_USING_SLAB)
+    rt_kprintf("heap backend: slab\n");
+#else
+    rt_kprintf("heap backend: small memory\n");
+#endif
+
+    rt_memset(blocks, 0, sizeof(blocks));
+    malloc_max = malloc_p99 = free_max = 0;
+    total_cycles = total_count = 0;
+
+    for (round = 0; round < HEAP_BENCH_ROUND; round ++)
+        errors += heap_bench_replay(round);
+
+    rt_kprintf("%d allocations: malloc avg %d, p99 %d, max %d, free max %d\n",
+               total_count, total_count ? total_cycles / total_count : 0,
+               malloc_p99, malloc_max, free_max);
+    if (errors != 0)
+        rt_kprintf("heap bench: %d errors\n", errors);
+
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_heap_bench()
+{
+    heap_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_heap_bench, a heap trace replay benchmark);
+#else
+int rt_application_init()
+{
+    heap_bench_init();
+
+    return 0;
+}
+#endif
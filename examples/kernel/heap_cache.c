@@ -0,0 +1,169 @@
+/*
+ * This is the test of per-thread slab caches.
+ *
+ * The worker threads allocate and release small blocks of random sizes, and
+ * pass some of blocks to each other through a mailbox, so the blocks are
+ * released into the cache of another thread. Each block is filled with a
+ * pattern and checked before released. After the workers exit, their caches
+ * shall be flushed back to the heap and the used memory shall be same as the
+ * one before test.
+ *
+ * The workers are static threads, so there is no memory of thread object or
+ * stack released by idle thread during the test.
+ */
+#include <rtthread.h>
+#include "tc_comm.h"
+
+#ifdef RT_USING_SLAB_CACHE
+
+#define CACHE_TEST_THREADS      4
+#define CACHE_TEST_SLOTS        32
+#define CACHE_TEST_LOOP         5000
+
+static struct rt_thread workers[CACHE_TEST_THREADS];
+static rt_uint8_t worker_stack[CACHE_TEST_THREADS][THREAD_STACK_SIZE];
+static struct rt_mailbox exchange;
+static rt_uint32_t exchange_pool[16];
+static struct rt_semaphore done;
+static volatile rt_uint32_t errors;
+
+/* the first byte is the size of block, and all bytes are same */
+static void *cache_test_alloc(rt_uint32_t size)
+{
+    rt_uint8_t *block;
+
+    block = rt_malloc(size);
+    if (block != RT_NULL)
+        rt_memset(block, size, size);
+
+    return block;
+}
+
+static void cache_test_free(rt_uint8_t *block)
+{
+    rt_uint32_t index, size;
+
+    size = block[0];
+    for (index = 1; index < size; index ++)
+    {
+        if (block[index] != size)
+        {
+            errors ++;
+            break;
+        }
+    }
+
+    rt_free(block);
+}
+
+static void cache_test_entry(void *parameter)
+{
+    int index;
+    rt_uint32_t seed, slot;
+    rt_uint8_t *block;
+    rt_uint8_t *slots[CACHE_TEST_SLOTS];
+
+    rt_memset(slots, 0, sizeof(slots));
+    seed = (rt_uint32_t)(rt_ubase_t)parameter + 1;
+
+    for (index = 0; index < CACHE_TEST_LOOP; index ++)
+    {
+        seed = seed * 1103515245 + 12345;
+        slot = (seed >> 16) % CACHE_TEST_SLOTS;
+
+        if (slots[slot] == RT_NULL)
+        {
+            slots[slot] = cache_test_alloc((seed >> 8) % 255 + 1);
+            if (slots[slot] == RT_NULL)
+                errors ++;
+        }
+        else if (seed & 0x01)
+        {
+            /* pass to other thread, or release it when mailbox is full */
+            if (rt_mb_send(&exchange, (rt_uint32_t)slots[slot]) != RT_EOK)
+                cache_test_free(slots[slot]);
+            slots[slot] = RT_NULL;
+        }
+        else
+        {
+            cache_test_free(slots[slot]);
+            slots[slot] = RT_NULL;
+        }
+
+        /* release the block from other thread */
+        if (rt_mb_recv(&exchange, (rt_uint32_t *)&block, 0) == RT_EOK)
+            cache_test_free(block);
+
+        if (index % 100 == 0)
+            rt_thread_delay(1);
+    }
+
+    for (slot = 0; slot < CACHE_TEST_SLOTS; slot ++)
+    {
+        if (slots[slot] != RT_NULL)
+            cache_test_free(slots[slot]);
+    }
+
+    rt_sem_release(&done);
+}
+
+static void heap_cache_init(void)
+{
+    int index;
+    rt_uint8_t *block;
+    rt_uint32_t used_before, used_after;
+
+    errors = 0;
+    rt_sem_init(&done, "hcache", 0, RT_IPC_FLAG_FIFO);
+    rt_mb_init(&exchange, "hcache", exchange_pool,
+               sizeof(exchange_pool) / sizeof(exchange_pool[0]), RT_IPC_FLAG_FIFO);
+
+    rt_memory_info(RT_NULL, &used_before, RT_NULL);
+
+    for (index = 0; index < CACHE_TEST_THREADS; index ++)
+    {
+        rt_thread_init(&workers[index], "hcache", cache_test_entry,
+                       (void *)(rt_ubase_t)index, worker_stack[index],
+                       THREAD_STACK_SIZE, THREAD_PRIORITY, THREAD_TIMESLICE);
+        rt_thread_startup(&workers[index]);
+    }
+
+    for (index = 0; index < CACHE_TEST_THREADS; index ++)
+        rt_sem_take(&done, RT_WAITING_FOREVER);
+
+    /* the blocks left in mailbox */
+    while (rt_mb_recv(&exchange, (rt_uint32_t *)&block, 0) == RT_EOK)
+        cache_test_free(block);
+
+    /* let the workers exit */
+    rt_thread_delay(RT_TICK_PER_SECOND / 10);
+    rt_memory_info(RT_NULL, &used_after, RT_NULL);
+
+    rt_mb_detach(&exchange);
+    rt_sem_detach(&done);
+
+    rt_kprintf("heap cache: %d errors, used memory %d before test, %d after test\n",
+               errors, used_before, used_after);
+    if (errors != 0 || used_after != used_before)
+        tc_done(TC_STAT_FAILED);
+    else
+        tc_done(TC_STAT_PASSED);
+}
+
+#ifdef RT_USING_TC
+int _tc_heap_cache()
+{
+    heap_cache_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_heap_cache, a per-thread slab cache test);
+#else
+int rt_application_init()
+{
+    heap_cache_init();
+
+    return 0;
+}
+#endif
+#endif
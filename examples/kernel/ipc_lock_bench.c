@@ -0,0 +1,453 @@
+/*
+ * This is the test and benchmark of the lock-free fast path of semaphore and
+ * mutex.
+ *
+ * It measures the average and worst-case cycles of an uncontended mutex
+ * take/release pair and a semaphore release/take pair, with the cycles of an
+ * interrupt disable/enable pair as the reference. Then IPC_LOCK_THREADS
+ * threads increase a shared counter under the mutex and the semaphore, which
+ * shows the throughput under contention and checks the mutual exclusion.
+ *
+ * The priority inheritance is checked along a chain of mutexes: the low
+ * priority thread holds mutex 2, the middle one holds mutex 1 and waits for
+ * mutex 2, and the high one waits for mutex 1, both of the low and middle
+ * threads shall be raised to the high priority.
+ *
+ * The owner may be preempted between taking the lock word and setting the
+ * owner of mutex, and raised by a waiting thread in it. A low priority thread
+ * takes and releases a mutex in a loop, and a high priority thread takes it
+ * at each tick, which preempts the loop anywhere for IPC_LOCK_WINDOW_TICKS
+ * times. The low priority thread shall be back to its priority at the end.
+ */
+#include <rtthread.h>
+#include <rthw.h>
+#include "tc_comm.h"
+
+#if defined(RT_USING_SEMAPHORE) && defined(RT_USING_MUTEX)
+#define IPC_LOCK_ROUND          10000
+#define IPC_LOCK_THREADS        4
+#define IPC_LOCK_LOOPS          2000
+#define IPC_LOCK_WINDOW_TICKS   1000
+
+static struct rt_mutex lock_mutex, chain_mutex1, chain_mutex2;
+static struct rt_semaphore lock_sem, mutex_start, sem_start, lock_done, chain_go;
+static volatile rt_uint32_t lock_counter;
+static rt_uint8_t chain_priority;
+static volatile rt_uint8_t window_stop;
+static rt_uint32_t errors;
+
+static void ipc_lock_uncontended(void)
+{
+    int index;
+    rt_base_t level;
+    rt_uint32_t cycle, delta, irq, mutex, mutex_max, sem, sem_max;
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < IPC_LOCK_ROUND; index ++)
+    {
+        level = rt_hw_interrupt_disable();
+        rt_hw_interrupt_enable(level);
+    }
+    irq = (tc_cycle_get() - cycle) / IPC_LOCK_ROUND;
+
+    mutex = mutex_max = 0;
+    for (index = 0; index < IPC_LOCK_ROUND; index ++)
+    {
+        cycle = tc_cycle_get();
+        rt_mutex_take(&lock_mutex, RT_WAITING_FOREVER);
+        rt_mutex_release(&lock_mutex);
+        delta = tc_cycle_get() - cycle;
+
+        mutex += delta;
+        if (delta > mutex_max)
+            mutex_max = delta;
+    }
+
+    sem = sem_max = 0;
+    for (index = 0; index < IPC_LOCK_ROUND; index ++)
+    {
+        cycle = tc_cycle_get();
+        rt_sem_release(&lock_sem);
+        rt_sem_take(&lock_sem, RT_WAITING_FOREVER);
+        delta = tc_cycle_get() - cycle;
+
+        sem += delta;
+        if (delta > sem_max)
+            sem_max = delta;
+    }
+
+    rt_kprintf("ipc lock bench: irq disable/enable %d, mutex take/release %d/%d, "
+               "sem release/take %d/%d cycles (avg/max)\n",
+               irq, mutex / IPC_LOCK_ROUND, mutex_max, sem / IPC_LOCK_ROUND, sem_max);
+
+    /* the recursive taking */
+    rt_mutex_take(&lock_mutex, RT_WAITING_FOREVER);
+    rt_mutex_take(&lock_mutex, RT_WAITING_FOREVER);
+    if (lock_mutex.hold != 2 || lock_mutex.owner != rt_thread_self())
+        errors ++;
+    rt_mutex_release(&lock_mutex);
+    rt_mutex_release(&lock_mutex);
+    if (lock_mutex.hold != 0 || lock_mutex.owner != RT_NULL || lock_mutex.lock != 0)
+        errors ++;
+
+    /* only the owner could release it */
+    if (rt_mutex_release(&lock_mutex) != -RT_ERROR)
+        errors ++;
+    if (rt_sem_trytake(&lock_sem) != -RT_ETIMEOUT)
+        errors ++;
+}
+
+static void ipc_lock_entry(void *parameter)
+{
+    int index;
+
+    rt_sem_take(&mutex_start, RT_WAITING_FOREVER);
+    for (index = 0; index < IPC_LOCK_LOOPS; index ++)
+    {
+        rt_mutex_take(&lock_mutex, RT_WAITING_FOREVER);
+        lock_counter ++;
+        /* give the others a chance to wait */
+        if ((index & 0x0f) == 0)
+            rt_thread_yield();
+        rt_mutex_release(&lock_mutex);
+    }
+    rt_sem_release(&lock_done);
+
+    /* the semaphore is used as a lock */
+    rt_sem_take(&sem_start, RT_WAITING_FOREVER);
+    for (index = 0; index < IPC_LOCK_LOOPS; index ++)
+    {
+        rt_sem_take(&lock_sem, RT_WAITING_FOREVER);
+        lock_counter ++;
+        if ((index & 0x0f) == 0)
+            rt_thread_yield();
+        rt_sem_release(&lock_sem);
+    }
+    rt_sem_release(&lock_done);
+}
+
+static void ipc_lock_contended(const char *name, rt_sem_t start)
+{
+    int index;
+    rt_uint32_t cycle;
+
+    lock_counter = 0;
+    cycle = tc_cycle_get();
+    for (index = 0; index < IPC_LOCK_THREADS; index ++)
+        rt_sem_release(start);
+    for (index = 0; index < IPC_LOCK_THREADS; index ++)
+        rt_sem_take(&lock_done, RT_WAITING_FOREVER);
+    cycle = tc_cycle_get() - cycle;
+
+    rt_kprintf("ipc lock bench: %s, %d threads, %d cycles per lock, counter %d\n",
+               name, IPC_LOCK_THREADS, cycle / (IPC_LOCK_THREADS * IPC_LOCK_LOOPS),
+               lock_counter);
+
+    if (lock_counter != IPC_LOCK_THREADS * IPC_LOCK_LOOPS)
+        errors ++;
+}
+
+static void ipc_lock_contention(void)
+{
+    int index;
+    rt_thread_t tid;
+
+    for (index = 0; index < IPC_LOCK_THREADS; index ++)
+    {
+        tid = rt_thread_create("tlock", ipc_lock_entry, RT_NULL, THREAD_STACK_SIZE,
+                               chain_priority + 1, THREAD_TIMESLICE);
+        if (tid == RT_NULL)
+        {
+            errors ++;
+            return;
+        }
+        rt_thread_startup(tid);
+    }
+
+    ipc_lock_contended("mutex", &mutex_start);
+    rt_sem_release(&lock_sem);
+    ipc_lock_contended("semaphore", &sem_start);
+    if (lock_sem.value != 1)
+        errors ++;
+
+    /* the exited threads are removed by idle thread */
+    rt_thread_delay(2);
+}
+
+static void ipc_lock_check_priority(rt_uint8_t priority)
+{
+    if (rt_thread_self()->current_priority != priority)
+    {
+        rt_kprintf("ipc lock bench: thread %s priority %d, expect %d\n",
+                   rt_thread_self()->name, rt_thread_self()->current_priority,
+                   priority);
+        errors ++;
+    }
+}
+
+static void ipc_lock_holder_entry(void *parameter)
+{
+    rt_mutex_take(&chain_mutex1, RT_WAITING_FOREVER);
+    rt_sem_release(&lock_done);
+    rt_sem_take(&chain_go, RT_WAITING_FOREVER);
+
+    /* it's raised by the timeout thread, and restored on release */
+    ipc_lock_check_priority(chain_priority);
+    rt_mutex_release(&chain_mutex1);
+    ipc_lock_check_priority(chain_priority + 1);
+
+    rt_sem_release(&lock_done);
+}
+
+static void ipc_lock_timeout(void)
+{
+    rt_thread_t tid;
+
+    tid = rt_thread_create("thold", ipc_lock_holder_entry, RT_NULL,
+                           THREAD_STACK_SIZE, chain_priority + 1,
+                           THREAD_TIMESLICE);
+    if (tid == RT_NULL)
+    {
+        errors ++;
+        return;
+    }
+    rt_thread_startup(tid);
+    rt_sem_take(&lock_done, RT_WAITING_FOREVER);
+
+    /* the waiters flag is left by the timeout thread */
+    if (rt_mutex_take(&chain_mutex1, 2) != -RT_ETIMEOUT)
+        errors ++;
+    if (chain_mutex1.lock != ((rt_uint32_t)tid | RT_MUTEX_WAITERS))
+        errors ++;
+    rt_sem_release(&chain_go);
+    rt_sem_take(&lock_done, RT_WAITING_FOREVER);
+    if (chain_mutex1.lock != 0 || chain_mutex1.owner != RT_NULL)
+        errors ++;
+
+    /* and the semaphore */
+    if (rt_sem_take(&chain_go, 2) != -RT_ETIMEOUT)
+        errors ++;
+    if (chain_go.value != RT_SEM_WAITERS)
+        errors ++;
+    rt_sem_release(&chain_go);
+    if (chain_go.value != 1 || rt_sem_take(&chain_go, 0) != RT_EOK)
+        errors ++;
+
+    rt_thread_delay(2);
+}
+
+/* the low priority thread holds mutex 2 */
+static void ipc_lock_chain_low(void *parameter)
+{
+    rt_mutex_take(&chain_mutex2, RT_WAITING_FOREVER);
+    rt_sem_take(&chain_go, RT_WAITING_FOREVER);
+
+    /* it's raised by the high priority thread through the middle one */
+    ipc_lock_check_priority(chain_priority + 1);
+    rt_mutex_release(&chain_mutex2);
+    ipc_lock_check_priority(chain_priority + 3);
+
+    rt_sem_release(&lock_done);
+}
+
+/* the middle priority thread holds mutex 1 and waits for mutex 2 */
+static void ipc_lock_chain_middle(void *parameter)
+{
+    rt_mutex_take(&chain_mutex1, RT_WAITING_FOREVER);
+    rt_mutex_take(&chain_mutex2, RT_WAITING_FOREVER);
+
+    ipc_lock_check_priority(chain_priority + 1);
+    rt_mutex_release(&chain_mutex2);
+    rt_mutex_release(&chain_mutex1);
+    ipc_lock_check_priority(chain_priority + 2);
+
+    rt_sem_release(&lock_done);
+}
+
+/* the high priority thread waits for mutex 1 */
+static void ipc_lock_chain_high(void *parameter)
+{
+    rt_mutex_take(&chain_mutex1, RT_WAITING_FOREVER);
+    rt_mutex_release(&chain_mutex1);
+    ipc_lock_check_priority(chain_priority + 1);
+
+    rt_sem_release(&lock_done);
+}
+
+static void ipc_lock_chain(void)
+{
+    int index;
+    rt_thread_t tid[3];
+    static void (* const entries[3])(void *) =
+    {
+        ipc_lock_chain_low, ipc_lock_chain_middle, ipc_lock_chain_high
+    };
+
+    for (index = 0; index < 3; index ++)
+    {
+        tid[index] = rt_thread_create("tchain", entries[index], RT_NULL,
+                                      THREAD_STACK_SIZE,
+                                      chain_priority + 3 - index,
+                                      THREAD_TIMESLICE);
+        if (tid[index] == RT_NULL)
+        {
+            errors ++;
+            break;
+        }
+
+#ifdef RT_USING_SMP
+        {
+            rt_uint8_t cpu;
+
+            /* the chain threads shall run on the same cpu */
+            cpu = rt_hw_cpu_id();
+            rt_thread_control(tid[index], RT_THREAD_CTRL_BIND_CPU, &cpu);
+        }
+#endif
+        rt_thread_startup(tid[index]);
+        rt_thread_delay(2);
+    }
+
+    if (index == 3)
+    {
+        rt_kprintf("ipc lock bench: priority chain %d -> %d -> %d, raised to %d, %d\n",
+                   tid[2]->init_priority, tid[1]->init_priority, tid[0]->init_priority,
+                   tid[1]->current_priority, tid[0]->current_priority);
+
+        if (tid[0]->current_priority != chain_priority + 1 ||
+            tid[1]->current_priority != chain_priority + 1)
+            errors ++;
+    }
+
+    /* let the low priority thread go */
+    rt_sem_release(&chain_go);
+    while (index --)
+        rt_sem_take(&lock_done, RT_WAITING_FOREVER);
+
+    rt_thread_delay(2);
+}
+
+/* the low priority thread takes and releases the mutex until it's stopped */
+static void ipc_lock_window_low(void *parameter)
+{
+    while (!window_stop)
+    {
+        rt_mutex_take(&lock_mutex, RT_WAITING_FOREVER);
+        rt_mutex_release(&lock_mutex);
+    }
+
+    ipc_lock_check_priority(chain_priority + 2);
+    rt_sem_release(&lock_done);
+}
+
+/* the high priority thread takes the mutex at each tick */
+static void ipc_lock_window_high(void *parameter)
+{
+    int index;
+
+    for (index = 0; index < IPC_LOCK_WINDOW_TICKS; index ++)
+    {
+        rt_thread_delay(1);
+        rt_mutex_take(&lock_mutex, RT_WAITING_FOREVER);
+        rt_mutex_release(&lock_mutex);
+    }
+
+    window_stop = 1;
+    rt_sem_release(&lock_done);
+}
+
+static void ipc_lock_window(void)
+{
+    int index;
+    rt_thread_t tid[2];
+    static void (* const entries[2])(void *) =
+    {
+        ipc_lock_window_low, ipc_lock_window_high
+    };
+
+    window_stop = 0;
+    for (index = 0; index < 2; index ++)
+    {
+        tid[index] = rt_thread_create("twindow", entries[index], RT_NULL,
+                                      THREAD_STACK_SIZE,
+                                      chain_priority + 2 - index,
+                                      THREAD_TIMESLICE);
+        if (tid[index] == RT_NULL)
+        {
+            errors ++;
+            break;
+        }
+
+#ifdef RT_USING_SMP
+        {
+            rt_uint8_t cpu;
+
+            /* the high priority thread shall preempt the low one */
+            cpu = rt_hw_cpu_id();
+            rt_thread_control(tid[index], RT_THREAD_CTRL_BIND_CPU, &cpu);
+        }
+#endif
+        rt_thread_startup(tid[index]);
+    }
+
+    /* stop the low priority thread if the high one is not created */
+    if (index < 2)
+        window_stop = 1;
+    while (index --)
+        rt_sem_take(&lock_done, RT_WAITING_FOREVER);
+
+    rt_thread_delay(2);
+}
+
+static void ipc_lock_bench_init(void)
+{
+    errors = 0;
+    chain_priority = rt_thread_self()->current_priority;
+
+    rt_mutex_init(&lock_mutex, "mlock", RT_IPC_FLAG_FIFO);
+    rt_mutex_init(&chain_mutex1, "mchain1", RT_IPC_FLAG_PRIO);
+    rt_mutex_init(&chain_mutex2, "mchain2", RT_IPC_FLAG_PRIO);
+    rt_sem_init(&lock_sem, "slock", 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&mutex_start, "smstart", 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&sem_start, "ssstart", 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&lock_done, "sdone", 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&chain_go, "sgo", 0, RT_IPC_FLAG_FIFO);
+
+    ipc_lock_uncontended();
+
+    ipc_lock_contention();
+
+    ipc_lock_timeout();
+    ipc_lock_chain();
+    ipc_lock_window();
+
+    rt_mutex_detach(&lock_mutex);
+    rt_mutex_detach(&chain_mutex1);
+    rt_mutex_detach(&chain_mutex2);
+    rt_sem_detach(&lock_sem);
+    rt_sem_detach(&mutex_start);
+    rt_sem_detach(&sem_start);
+    rt_sem_detach(&lock_done);
+    rt_sem_detach(&chain_go);
+
+    rt_kprintf("ipc lock bench: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_ipc_lock_bench()
+{
+    ipc_lock_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_ipc_lock_bench, a mutex and semaphore fast path test and benchmark);
+#else
+int rt_application_init()
+{
+    ipc_lock_bench_init();
+
+    return 0;
+}
+#endif
+#endif
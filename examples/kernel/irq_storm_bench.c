@@ -0,0 +1,212 @@
+/*
+ * This is a benchmark of deferred interrupt handling under interrupt storm.
+ *
+ * A hard timer simulates a device which raises IRQ_STORM_BURST interrupts in
+ * each tick. Each interrupt puts a sequence number to the receive FIFO of the
+ * device, and a thread drains the FIFO. It's done in two ways:
+ *
+ * - semaphore: the interrupt releases a semaphore for each data, the thread
+ *   takes the semaphore and reads one data each time.
+ * - deferred: the interrupt raises an interrupt source, the bottom half in
+ *   interrupt thread drains the FIFO with the merged events.
+ *
+ * It shows the average and worst-case cycles in interrupt for each data, the
+ * number of thread wakeups and the data lost by FIFO overflow. The data shall
+ * be received in order.
+ */
+#include <rtthread.h>
+#include "tc_comm.h"
+
+#ifdef RT_USING_IRQ_THREAD
+#define IRQ_STORM_FIFO_SIZE     256
+#define IRQ_STORM_BURST         64
+#define IRQ_STORM_TICKS         50
+#define IRQ_STORM_EVENT_RX      0x01
+
+#define IRQ_STORM_SEMAPHORE     0
+#define IRQ_STORM_DEFERRED      1
+
+static rt_uint32_t storm_fifo[IRQ_STORM_FIFO_SIZE];
+static volatile rt_uint32_t storm_head, storm_tail;
+static volatile rt_uint32_t storm_produced, storm_consumed, storm_lost;
+static rt_uint32_t storm_expect, storm_wakeups;
+static rt_uint32_t storm_isr_total, storm_isr_max;
+static volatile rt_uint32_t storm_ticks;
+static int storm_mode;
+
+static struct rt_timer storm_timer;
+static struct rt_irq_source storm_source;
+static struct rt_semaphore storm_sem;
+static rt_thread_t storm_reader;
+static rt_uint32_t errors;
+
+/* the device receives a data in interrupt */
+static void storm_fifo_push(void)
+{
+    if (storm_head - storm_tail == IRQ_STORM_FIFO_SIZE)
+        storm_lost ++;
+    else
+    {
+        storm_fifo[storm_head % IRQ_STORM_FIFO_SIZE] = storm_produced;
+        storm_head ++;
+    }
+    storm_produced ++;
+}
+
+static void storm_fifo_read(void)
+{
+    rt_uint32_t data;
+
+    data = storm_fifo[storm_tail % IRQ_STORM_FIFO_SIZE];
+    storm_tail ++;
+
+    /* the lost data are skipped, but never out of order */
+    if (data < storm_expect)
+        errors ++;
+    storm_expect = data + 1;
+    storm_consumed ++;
+}
+
+static rt_uint32_t storm_top_half(int vector, void *param)
+{
+    storm_fifo_push();
+
+    return IRQ_STORM_EVENT_RX;
+}
+
+static void storm_bottom_half(rt_uint32_t events, void *param)
+{
+    if (!(events & IRQ_STORM_EVENT_RX))
+        errors ++;
+
+    storm_wakeups ++;
+    while (storm_tail != storm_head)
+        storm_fifo_read();
+}
+
+static void storm_reader_entry(void *parameter)
+{
+    while (1)
+    {
+        rt_sem_take(&storm_sem, RT_WAITING_FOREVER);
+
+        storm_wakeups ++;
+        if (storm_tail != storm_head)
+            storm_fifo_read();
+    }
+}
+
+static void storm_timeout(void *parameter)
+{
+    int index;
+    rt_uint32_t cycle;
+
+    if (storm_ticks == 0)
+        return;
+    storm_ticks --;
+
+    for (index = 0; index < IRQ_STORM_BURST; index ++)
+    {
+        cycle = tc_cycle_get();
+        if (storm_mode == IRQ_STORM_DEFERRED)
+        {
+            rt_irq_source_raise(&storm_source, storm_top_half(-1, RT_NULL));
+        }
+        else
+        {
+            storm_fifo_push();
+            rt_sem_release(&storm_sem);
+        }
+        cycle = tc_cycle_get() - cycle;
+
+        storm_isr_total += cycle;
+        if (cycle > storm_isr_max)
+            storm_isr_max = cycle;
+    }
+}
+
+static void irq_storm_run(int mode)
+{
+    int wait;
+
+    storm_mode = mode;
+    storm_head = storm_tail = 0;
+    storm_produced = storm_consumed = storm_lost = 0;
+    storm_expect = storm_wakeups = 0;
+    storm_isr_total = storm_isr_max = 0;
+    storm_ticks = IRQ_STORM_TICKS;
+
+    rt_timer_init(&storm_timer, "storm", storm_timeout, RT_NULL, 1,
+                  RT_TIMER_FLAG_PERIODIC | RT_TIMER_FLAG_HARD_TIMER);
+    rt_timer_start(&storm_timer);
+
+    /* wait for the storm and the draining of FIFO */
+    for (wait = 0; wait < IRQ_STORM_TICKS * 4; wait ++)
+    {
+        rt_thread_delay(1);
+        if (storm_ticks == 0 && storm_consumed + storm_lost == storm_produced)
+            break;
+    }
+    rt_timer_detach(&storm_timer);
+
+    rt_kprintf("%s: %d data, isr %d/%d cycles (avg/max), %d wakeups, %d lost\n",
+               mode == IRQ_STORM_DEFERRED ? "deferred " : "semaphore",
+               storm_produced, storm_isr_total / storm_produced, storm_isr_max,
+               storm_wakeups, storm_lost);
+
+    if (storm_produced != IRQ_STORM_TICKS * IRQ_STORM_BURST ||
+        storm_consumed + storm_lost != storm_produced)
+        errors ++;
+}
+
+static void irq_storm_bench_init(void)
+{
+    errors = 0;
+
+    /* the reader has the priority of the highest interrupt thread */
+    rt_sem_init(&storm_sem, "storm", 0, RT_IPC_FLAG_FIFO);
+    storm_reader = rt_thread_create("storm", storm_reader_entry, RT_NULL,
+                                    THREAD_STACK_SIZE, RT_IRQ_THREAD_PRIORITY,
+                                    THREAD_TIMESLICE);
+    if (storm_reader == RT_NULL)
+    {
+        rt_sem_detach(&storm_sem);
+        tc_done(TC_STAT_FAILED);
+        return;
+    }
+    rt_thread_startup(storm_reader);
+    irq_storm_run(IRQ_STORM_SEMAPHORE);
+    rt_thread_delete(storm_reader);
+    rt_sem_detach(&storm_sem);
+
+    rt_irq_source_init(&storm_source, "storm", storm_top_half, storm_bottom_half,
+                       RT_NULL, 0, 0);
+    irq_storm_run(IRQ_STORM_DEFERRED);
+    rt_irq_source_detach(&storm_source);
+
+    /* the deferred handling shall keep up with the storm */
+    if (storm_lost != 0 || storm_source.handled != storm_wakeups ||
+        storm_source.raised != storm_produced)
+        errors ++;
+
+    rt_kprintf("irq storm bench: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_irq_storm_bench()
+{
+    irq_storm_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_irq_storm_bench, a deferred interrupt benchmark under interrupt storm);
+#else
+int rt_application_init()
+{
+    irq_storm_bench_init();
+
+    return 0;
+}
+#endif
+#endif
@@ -0,0 +1,185 @@
+/*
+ * This is the test and benchmark of kernel event tracer.
+ *
+ * It measures the cycles of a semaphore release/take pair with the tracer
+ * stopped and running, the difference is the cost of recording the put and
+ * take events. Then two threads ping-pong through semaphores with tracer
+ * running, and the trace is dumped to a device which checks the header and
+ * counts the thread switch records. A scheduler hook set before the tracer
+ * shall be invoked while tracing, and restored when the tracer is stopped.
+ */
+#include <rtthread.h>
+#include "tc_comm.h"
+
+#ifdef RT_USING_KTRACE
+#include <ktrace.h>
+
+#define KTRACE_BENCH_ROUND      1000
+#define KTRACE_BENCH_PINGPONG   100
+
+static struct rt_semaphore ping, pong, done;
+static struct rt_device dump_device;
+static rt_uint32_t dump_size, dump_records, dump_switches;
+static struct rt_ktrace_header dump_header;
+static rt_uint32_t errors;
+static rt_uint32_t hook_switches;
+
+static void ktrace_bench_hook(struct rt_thread *from, struct rt_thread *to)
+{
+    hook_switches ++;
+}
+
+/* the dump is checked on the fly, it's not kept in memory */
+static rt_size_t dump_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    rt_size_t index;
+    rt_uint32_t records_start;
+    const rt_uint8_t *data = (const rt_uint8_t *)buffer;
+    const struct rt_ktrace_record *record;
+
+    for (index = 0; index < size; index ++, dump_size ++)
+    {
+        if (dump_size < sizeof(dump_header))
+            ((rt_uint8_t *)&dump_header)[dump_size] = data[index];
+    }
+
+    /* the records are written in whole */
+    records_start = sizeof(dump_header) +
+                    dump_header.name_count * (sizeof(struct rt_ktrace_name) + RT_NAME_MAX);
+    if (dump_size - size >= records_start)
+    {
+        for (index = 0; index + sizeof(*record) <= size; index += sizeof(*record))
+        {
+            record = (const struct rt_ktrace_record *)(data + index);
+            if (record->event == RT_KTRACE_SWITCH)
+                dump_switches ++;
+            dump_records ++;
+        }
+    }
+
+    return size;
+}
+
+static void ktrace_bench_entry(void *parameter)
+{
+    int index;
+
+    for (index = 0; index < KTRACE_BENCH_PINGPONG; index ++)
+    {
+        rt_sem_take(&ping, RT_WAITING_FOREVER);
+        rt_sem_release(&pong);
+    }
+
+    rt_sem_release(&done);
+}
+
+static rt_uint32_t ktrace_bench_pair(void)
+{
+    int index;
+    rt_uint32_t cycle;
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < KTRACE_BENCH_ROUND; index ++)
+    {
+        rt_sem_release(&ping);
+        rt_sem_take(&ping, RT_WAITING_FOREVER);
+    }
+
+    return (tc_cycle_get() - cycle) / KTRACE_BENCH_ROUND;
+}
+
+static void ktrace_bench_init(void)
+{
+    int index;
+    rt_thread_t tid;
+    rt_uint32_t stopped, running;
+
+    errors = 0;
+    rt_sem_init(&ping, "kping", 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&pong, "kpong", 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&done, "kdone", 0, RT_IPC_FLAG_FIFO);
+
+    /* the cost of recording */
+    rt_ktrace_stop();
+    stopped = ktrace_bench_pair();
+    rt_ktrace_reset();
+    rt_ktrace_start();
+    running = ktrace_bench_pair();
+    rt_ktrace_stop();
+    rt_kprintf("ktrace bench: release/take pair %d cycles, %d cycles with tracer\n",
+               stopped, running);
+
+    /* ping-pong with the tracer running */
+    hook_switches = 0;
+    rt_scheduler_sethook(ktrace_bench_hook);
+    rt_ktrace_reset();
+    rt_ktrace_start();
+    tid = rt_thread_create("kpong", ktrace_bench_entry, RT_NULL, THREAD_STACK_SIZE,
+                           THREAD_PRIORITY, THREAD_TIMESLICE);
+    if (tid != RT_NULL)
+    {
+        rt_thread_startup(tid);
+        for (index = 0; index < KTRACE_BENCH_PINGPONG; index ++)
+        {
+            rt_sem_release(&ping);
+            rt_sem_take(&pong, RT_WAITING_FOREVER);
+        }
+        rt_sem_take(&done, RT_WAITING_FOREVER);
+    }
+    else
+        errors ++;
+
+    dump_size = dump_records = dump_switches = 0;
+    rt_memset(&dump_header, 0, sizeof(dump_header));
+    dump_device.type  = RT_Device_Class_Char;
+    dump_device.write = dump_write;
+    rt_device_register(&dump_device, "ktdump", RT_DEVICE_FLAG_WRONLY);
+    rt_device_open(&dump_device, RT_DEVICE_OFLAG_WRONLY);
+    if (rt_ktrace_dump(&dump_device) != RT_EOK)
+        errors ++;
+    rt_device_close(&dump_device);
+    rt_device_unregister(&dump_device);
+
+    /* the hook is chained during tracing and restored after it */
+    if (hook_switches < KTRACE_BENCH_PINGPONG)
+        errors ++;
+    hook_switches = 0;
+    rt_thread_delay(1);
+    if (hook_switches == 0)
+        errors ++;
+    rt_scheduler_sethook(RT_NULL);
+
+    rt_kprintf("ktrace bench: dump %d bytes, %d records, %d lost, %d thread switches\n",
+               dump_size, dump_records, dump_header.lost, dump_switches);
+
+    /* the waiting thread is switched in at least once in each ping-pong */
+    if (dump_header.magic != RT_KTRACE_MAGIC ||
+        dump_header.record_count != dump_records ||
+        (dump_header.lost == 0 && dump_switches < KTRACE_BENCH_PINGPONG))
+        errors ++;
+
+    rt_sem_detach(&ping);
+    rt_sem_detach(&pong);
+    rt_sem_detach(&done);
+
+    rt_kprintf("ktrace bench: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_ktrace_bench()
+{
+    ktrace_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_ktrace_bench, a kernel event tracer test and benchmark);
+#else
+int rt_application_init()
+{
+    ktrace_bench_init();
+
+    return 0;
+}
+#endif
+#endif
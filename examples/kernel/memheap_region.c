@@ -0,0 +1,135 @@
+/*
+ * This is the test of memory regions of memory heap.
+ *
+ * Two memory heaps are tagged as the fast region and the DMA region. The
+ * allocations in the fast region are placed on the fast heap, and fall back
+ * to the system heap when it's exhausted, unless RT_MEM_NOFALLBACK is given.
+ * The DMA region doesn't fall back. The statistics of regions are checked
+ * along the way.
+ */
+#include <rtthread.h>
+#include "tc_comm.h"
+
+#ifdef RT_USING_MEMHEAP_REGION
+#define REGION_POOL_SIZE        1024
+#define REGION_BLOCK_SIZE       256
+
+ALIGN(RT_ALIGN_SIZE)
+static rt_uint8_t fast_pool[REGION_POOL_SIZE];
+ALIGN(RT_ALIGN_SIZE)
+static rt_uint8_t dma_pool[REGION_POOL_SIZE];
+static struct rt_memheap fast_heap, dma_heap;
+static rt_uint32_t errors;
+
+#define IN_POOL(ptr, pool) \
+    ((rt_uint8_t *)(ptr) >= (rt_uint8_t *)(pool) && \
+     (rt_uint8_t *)(ptr) <  (rt_uint8_t *)(pool) + sizeof(pool))
+
+static void memheap_region_test(void)
+{
+    int index, count = 0;
+    void *ptr, *blocks[REGION_POOL_SIZE / REGION_BLOCK_SIZE];
+    struct rt_memory_region_info before, after;
+
+    rt_memory_region_info(RT_MEM_FAST, &before);
+
+    /* fill up the fast heap */
+    for (index = 0; index < sizeof(blocks) / sizeof(blocks[0]); index ++)
+    {
+        blocks[index] = rt_malloc_region(REGION_BLOCK_SIZE, RT_MEM_FAST | RT_MEM_NOFALLBACK);
+        if (blocks[index] == RT_NULL)
+            break;
+        if (!IN_POOL(blocks[index], fast_pool))
+            errors ++;
+        count ++;
+    }
+    if (count == 0 || count == sizeof(blocks) / sizeof(blocks[0]))
+        errors ++;
+
+    /* the default allocation is not on the fast heap */
+    ptr = rt_malloc(REGION_BLOCK_SIZE);
+    if (ptr == RT_NULL || IN_POOL(ptr, fast_pool))
+        errors ++;
+    rt_free(ptr);
+
+    /* fall back to the default region */
+    if (rt_malloc_region(REGION_BLOCK_SIZE, RT_MEM_FAST | RT_MEM_NOFALLBACK) != RT_NULL)
+        errors ++;
+    ptr = rt_malloc_region(REGION_BLOCK_SIZE, RT_MEM_FAST);
+    if (ptr == RT_NULL || IN_POOL(ptr, fast_pool))
+        errors ++;
+    rt_free(ptr);
+
+    /* the DMA region doesn't fall back */
+    ptr = rt_malloc_region(REGION_POOL_SIZE, RT_MEM_DMA);
+    if (ptr != RT_NULL)
+        errors ++;
+    ptr = rt_malloc_region(REGION_BLOCK_SIZE, RT_MEM_DMA);
+    if (!IN_POOL(ptr, dma_pool))
+        errors ++;
+
+    /* the grown block stays in its region */
+    ptr = rt_realloc(ptr, REGION_POOL_SIZE / 2);
+    if (!IN_POOL(ptr, dma_pool))
+        errors ++;
+    rt_free(ptr);
+
+    rt_memory_region_info(RT_MEM_FAST, &after);
+    if (after.alloc_count - before.alloc_count != count + 3 ||
+        after.fallback_count - before.fallback_count != 1 ||
+        after.fail_count - before.fail_count != 2 ||
+        after.total != REGION_POOL_SIZE || after.used <= before.used)
+        errors ++;
+    rt_kprintf("memheap region: %d blocks of %d bytes in fast region, used %d/%d\n",
+               count, REGION_BLOCK_SIZE, after.used, after.total);
+
+    for (index = 0; index < count; index ++)
+        rt_free(blocks[index]);
+    rt_memory_region_info(RT_MEM_FAST, &after);
+    if (after.used != before.used)
+        errors ++;
+
+    /* the fast region falls back to nothing */
+    rt_memory_region_set_fallback(RT_MEM_FAST, RT_MEM_NONE);
+    if (rt_malloc_region(REGION_POOL_SIZE, RT_MEM_FAST) != RT_NULL)
+        errors ++;
+    rt_memory_region_set_fallback(RT_MEM_FAST, RT_MEM_DEFAULT);
+    if (rt_memory_region_set_fallback(RT_MEM_REGION_NR, RT_MEM_NONE) == RT_EOK)
+        errors ++;
+}
+
+static void memheap_region_init(void)
+{
+    errors = 0;
+
+    rt_memheap_init(&fast_heap, "fast", fast_pool, sizeof(fast_pool));
+    rt_memheap_set_region(&fast_heap, RT_MEM_FAST);
+    rt_memheap_init(&dma_heap, "dma", dma_pool, sizeof(dma_pool));
+    rt_memheap_set_region(&dma_heap, RT_MEM_DMA);
+
+    memheap_region_test();
+
+    rt_memheap_detach(&fast_heap);
+    rt_memheap_detach(&dma_heap);
+
+    rt_kprintf("memheap region: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_memheap_region()
+{
+    memheap_region_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_memheap_region, a memory region test of memory heap);
+#else
+int rt_application_init()
+{
+    memheap_region_init();
+
+    return 0;
+}
+#endif
+#endif
@@ -0,0 +1,193 @@
+/*
+ * This is a benchmark of the memory pool and the lock-free memory pool.
+ *
+ * It measures the number of allocation/release pairs per second, and the
+ * average and worst-case time of a pair. The whole of rt_mp_alloc() and
+ * rt_mp_free() are in interrupt disabled section, so their worst-case time
+ * is the interrupt-off time of memory pool. The lock-free memory pool has no
+ * interrupt-off time when the CPU has compare and swap (RT_HW_USING_CAS).
+ *
+ * During the benchmark, a hard timer allocates and releases the blocks of
+ * lock-free memory pool in interrupt, and all of the blocks shall be free
+ * at the end.
+ */
+#include <rtthread.h>
+#include <rthw.h>
+#include "tc_comm.h"
+
+#define MEMP_BENCH_TICKS        (RT_TICK_PER_SECOND / 10)
+#define MEMP_BENCH_BLOCKS       32
+#define MEMP_BENCH_BLOCK_SIZE   64
+
+struct memp_bench_stat
+{
+    rt_uint32_t pairs;
+    rt_uint32_t total;
+    rt_uint32_t max;
+    rt_uint32_t op_max;         /* the worst-case of a single operation */
+};
+
+ALIGN(RT_ALIGN_SIZE)
+static rt_uint8_t mp_pool[MEMP_BENCH_BLOCKS * (MEMP_BENCH_BLOCK_SIZE + sizeof(void *))];
+ALIGN(RT_ALIGN_SIZE)
+static rt_uint8_t lf_pool[MEMP_BENCH_BLOCKS * MEMP_BENCH_BLOCK_SIZE];
+static struct rt_mempool mp;
+static struct rt_lfpool lfpool;
+static struct rt_timer isr_timer;
+static volatile rt_uint32_t isr_pairs, errors;
+
+static void memp_bench_stat_add(struct memp_bench_stat *stat, rt_uint32_t alloc,
+                                rt_uint32_t release)
+{
+    stat->pairs ++;
+    stat->total += alloc + release;
+    if (alloc + release > stat->max)
+        stat->max = alloc + release;
+    if (alloc > stat->op_max)
+        stat->op_max = alloc;
+    if (release > stat->op_max)
+        stat->op_max = release;
+}
+
+static void memp_bench_isr(void *parameter)
+{
+    void *block;
+
+    block = rt_lfpool_alloc(&lfpool);
+    if (block != RT_NULL)
+    {
+        rt_memset(block, 0x5a, MEMP_BENCH_BLOCK_SIZE);
+        rt_lfpool_free(&lfpool, block);
+        isr_pairs ++;
+    }
+}
+
+static void memp_bench_report(const char *name, struct memp_bench_stat *stat,
+                              rt_uint32_t irq_off)
+{
+    rt_kprintf("%-8s: %d pairs per second, pair %d/%d (avg/max), interrupt off %d\n",
+               name, stat->pairs * (RT_TICK_PER_SECOND / MEMP_BENCH_TICKS),
+               stat->total / stat->pairs, stat->max, irq_off);
+}
+
+static void memp_bench_mp(void)
+{
+    void *block;
+    rt_tick_t tick;
+    rt_uint32_t start, alloc, release;
+    struct memp_bench_stat stat;
+
+    rt_memset(&stat, 0, sizeof(stat));
+
+    tick = rt_tick_get();
+    while (rt_tick_get() - tick < MEMP_BENCH_TICKS)
+    {
+        start = tc_cycle_get();
+        block = rt_mp_alloc(&mp, 0);
+        alloc = tc_cycle_get();
+        rt_mp_free(block);
+        release = tc_cycle_get();
+
+        memp_bench_stat_add(&stat, alloc - start, release - alloc);
+    }
+
+    /* the operations are in interrupt disabled section */
+    memp_bench_report("mempool", &stat, stat.op_max);
+}
+
+static void memp_bench_lfpool(void)
+{
+    void *block;
+    rt_tick_t tick;
+    rt_uint32_t start, alloc, release;
+    struct memp_bench_stat stat;
+
+    rt_memset(&stat, 0, sizeof(stat));
+
+    tick = rt_tick_get();
+    while (rt_tick_get() - tick < MEMP_BENCH_TICKS)
+    {
+        start = tc_cycle_get();
+        block = rt_lfpool_alloc(&lfpool);
+        alloc = tc_cycle_get();
+        if (block == RT_NULL)
+        {
+            errors ++;
+            continue;
+        }
+        rt_lfpool_free(&lfpool, block);
+        release = tc_cycle_get();
+
+        memp_bench_stat_add(&stat, alloc - start, release - alloc);
+    }
+
+#ifdef RT_HW_USING_CAS
+    memp_bench_report("lfpool", &stat, 0);
+#else
+    memp_bench_report("lfpool", &stat, stat.op_max);
+#endif
+}
+
+/* all of blocks shall be allocatable, and the pool shall be empty then */
+static int memp_bench_check(void)
+{
+    int index;
+    void *blocks[MEMP_BENCH_BLOCKS];
+
+    for (index = 0; index < MEMP_BENCH_BLOCKS; index ++)
+    {
+        blocks[index] = rt_lfpool_alloc(&lfpool);
+        if (blocks[index] == RT_NULL)
+            return -1;
+    }
+    if (rt_lfpool_alloc(&lfpool) != RT_NULL)
+        return -1;
+
+    for (index = 0; index < MEMP_BENCH_BLOCKS; index ++)
+        rt_lfpool_free(&lfpool, blocks[index]);
+
+    return 0;
+}
+
+static void memp_bench_init(void)
+{
+    errors = 0;
+    isr_pairs = 0;
+
+    rt_mp_init(&mp, "mpbench", mp_pool, sizeof(mp_pool), MEMP_BENCH_BLOCK_SIZE);
+    rt_lfpool_init(&lfpool, lf_pool, sizeof(lf_pool), MEMP_BENCH_BLOCK_SIZE);
+
+    rt_timer_init(&isr_timer, "mpbench", memp_bench_isr, RT_NULL, 1,
+                  RT_TIMER_FLAG_PERIODIC | RT_TIMER_FLAG_HARD_TIMER);
+    rt_timer_start(&isr_timer);
+
+    memp_bench_mp();
+    memp_bench_lfpool();
+
+    rt_timer_stop(&isr_timer);
+    rt_timer_detach(&isr_timer);
+    rt_mp_detach(&mp);
+
+    if (memp_bench_check() != 0)
+        errors ++;
+
+    rt_kprintf("memory pool bench: %d pairs in timer, %d errors\n", isr_pairs, errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_memp_bench()
+{
+    memp_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_memp_bench, a memory pool benchmark);
+#else
+int rt_application_init()
+{
+    memp_bench_init();
+
+    return 0;
+}
+#endif
@@ -0,0 +1,256 @@
+/*
+ * This is a throughput benchmark of message queue.
+ *
+ * A producer thread and a consumer thread pass the frames of 256 and 1500
+ * bytes through a message queue, by the copying interface rt_mq_send() and
+ * rt_mq_recv(), then by the zero-copy interface rt_mq_reserve()/rt_mq_commit()
+ * and rt_mq_borrow()/rt_mq_release(). The producer writes a whole frame and
+ * the consumer reads it in both cases, which is the work of a driver and a
+ * protocol stack. It reports the frames per second and the cycles per frame,
+ * and checks the sequence number of each frame. The cycles of passing a frame
+ * in one thread are reported too, which has no cost of thread switching.
+ */
+#include <rtthread.h>
+#include <rthw.h>
+#include "tc_comm.h"
+
+#define MQ_BENCH_TICKS          (RT_TICK_PER_SECOND / 10)
+#define MQ_BENCH_MSGS           8
+#define MQ_BENCH_FRAME_MAX      1500
+#define MQ_BENCH_ROUND          1000
+
+static rt_mq_t bench_mq;
+static rt_uint32_t frame_size;
+static rt_uint32_t zero_copy;
+static volatile rt_uint32_t bench_stop;
+static rt_uint32_t bench_frames, errors;
+static volatile rt_uint32_t bench_sum;
+static struct rt_semaphore bench_done;
+
+/* a frame is the sequence number and the payload */
+static void mq_bench_fill(rt_uint8_t *frame, rt_uint32_t seq)
+{
+    *(rt_uint32_t *)frame = seq;
+    rt_memset(frame + sizeof(rt_uint32_t), (rt_uint8_t)seq,
+              frame_size - sizeof(rt_uint32_t));
+}
+
+static void mq_bench_check(rt_uint8_t *frame, rt_uint32_t seq)
+{
+    rt_uint32_t index, sum = 0;
+
+    if (*(rt_uint32_t *)frame != seq)
+        errors ++;
+
+    /* read the whole frame */
+    for (index = sizeof(rt_uint32_t); index < frame_size; index += sizeof(rt_uint32_t))
+        sum += *(rt_uint32_t *)(frame + index);
+    bench_sum += sum;
+}
+
+static void mq_bench_producer(void *parameter)
+{
+    void *buffer;
+    rt_uint32_t seq = 0;
+    static rt_uint8_t frame[MQ_BENCH_FRAME_MAX];
+
+    while (bench_stop == 0)
+    {
+        if (zero_copy)
+        {
+            if (rt_mq_reserve(bench_mq, &buffer) != RT_EOK)
+            {
+                /* the queue is full, let the consumer run */
+                rt_thread_yield();
+                continue;
+            }
+
+            mq_bench_fill(buffer, seq);
+            rt_mq_commit(bench_mq, buffer);
+        }
+        else
+        {
+            mq_bench_fill(frame, seq);
+            if (rt_mq_send(bench_mq, frame, frame_size) != RT_EOK)
+            {
+                rt_thread_yield();
+                continue;
+            }
+        }
+
+        seq ++;
+    }
+
+    rt_sem_release(&bench_done);
+}
+
+static void mq_bench_consumer(void *parameter)
+{
+    void *buffer;
+    rt_uint32_t seq = 0;
+    static rt_uint8_t frame[MQ_BENCH_FRAME_MAX];
+
+    while (bench_stop == 0)
+    {
+        if (zero_copy)
+        {
+            if (rt_mq_borrow(bench_mq, &buffer, 0) != RT_EOK)
+            {
+                /* the queue is empty, let the producer run */
+                rt_thread_yield();
+                continue;
+            }
+
+            mq_bench_check(buffer, seq);
+            rt_mq_release(bench_mq, buffer);
+        }
+        else
+        {
+            if (rt_mq_recv(bench_mq, frame, frame_size, 0) != RT_EOK)
+            {
+                rt_thread_yield();
+                continue;
+            }
+
+            mq_bench_check(frame, seq);
+        }
+
+        seq ++;
+    }
+
+    bench_frames = seq;
+    rt_sem_release(&bench_done);
+}
+
+static rt_thread_t mq_bench_thread(void (*entry)(void *))
+{
+    rt_thread_t tid;
+
+    tid = rt_thread_create("mqbench", entry, RT_NULL, THREAD_STACK_SIZE,
+                           THREAD_PRIORITY, THREAD_TIMESLICE);
+    if (tid == RT_NULL)
+        return RT_NULL;
+
+#ifdef RT_USING_SMP
+    {
+        rt_uint8_t cpu;
+
+        /* the bench threads shall run on the same cpu */
+        cpu = rt_hw_cpu_id();
+        rt_thread_control(tid, RT_THREAD_CTRL_BIND_CPU, &cpu);
+    }
+#endif
+    rt_thread_startup(tid);
+
+    return tid;
+}
+
+/* pass the frames in current thread */
+static rt_uint32_t mq_bench_pass(void)
+{
+    int index;
+    void *buffer;
+    rt_uint32_t cycle;
+    static rt_uint8_t frame[MQ_BENCH_FRAME_MAX];
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < MQ_BENCH_ROUND; index ++)
+    {
+        if (zero_copy)
+        {
+            rt_mq_reserve(bench_mq, &buffer);
+            mq_bench_fill(buffer, index);
+            rt_mq_commit(bench_mq, buffer);
+
+            rt_mq_borrow(bench_mq, &buffer, 0);
+            mq_bench_check(buffer, index);
+            rt_mq_release(bench_mq, buffer);
+        }
+        else
+        {
+            mq_bench_fill(frame, index);
+            rt_mq_send(bench_mq, frame, frame_size);
+
+            rt_mq_recv(bench_mq, frame, frame_size, 0);
+            mq_bench_check(frame, index);
+        }
+    }
+
+    return (tc_cycle_get() - cycle) / MQ_BENCH_ROUND;
+}
+
+static void mq_bench_run(rt_uint32_t size, rt_uint32_t zc)
+{
+    rt_uint32_t cycle, pass;
+
+    frame_size = size;
+    zero_copy  = zc;
+    bench_stop = 0;
+    bench_frames = 0;
+    rt_mq_control(bench_mq, RT_IPC_CMD_RESET, RT_NULL);
+
+    pass = mq_bench_pass();
+
+    cycle = tc_cycle_get();
+    mq_bench_thread(mq_bench_producer);
+    mq_bench_thread(mq_bench_consumer);
+
+    rt_thread_delay(MQ_BENCH_TICKS);
+    bench_stop = 1;
+    rt_sem_take(&bench_done, RT_WAITING_FOREVER);
+    rt_sem_take(&bench_done, RT_WAITING_FOREVER);
+    cycle = tc_cycle_get() - cycle;
+
+    if (bench_frames == 0)
+    {
+        errors ++;
+        return;
+    }
+
+    rt_kprintf("%4d bytes %-9s: %d frames per second, %d cycles per frame, "
+               "%d cycles in one thread\n", size, zc ? "zero-copy" : "copy",
+               bench_frames * (RT_TICK_PER_SECOND / MQ_BENCH_TICKS),
+               cycle / bench_frames, pass);
+}
+
+static void messageq_bench_init(void)
+{
+    errors = 0;
+    rt_sem_init(&bench_done, "mqbench", 0, RT_IPC_FLAG_FIFO);
+    bench_mq = rt_mq_create("mqbench", MQ_BENCH_FRAME_MAX, MQ_BENCH_MSGS,
+                            RT_IPC_FLAG_FIFO);
+    if (bench_mq == RT_NULL)
+    {
+        rt_sem_detach(&bench_done);
+        tc_done(TC_STAT_FAILED);
+        return;
+    }
+
+    mq_bench_run(256, 0);
+    mq_bench_run(256, 1);
+    mq_bench_run(MQ_BENCH_FRAME_MAX, 0);
+    mq_bench_run(MQ_BENCH_FRAME_MAX, 1);
+
+    rt_mq_delete(bench_mq);
+    rt_sem_detach(&bench_done);
+
+    rt_kprintf("message queue bench: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_messageq_bench()
+{
+    messageq_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_messageq_bench, a message queue throughput benchmark);
+#else
+int rt_application_init()
+{
+    messageq_bench_init();
+
+    return 0;
+}
+#endif
@@ -0,0 +1,428 @@
+/*
+ * This is the test of request queue of mmcsd block device.
+ *
+ * A simulated SD host runs the commands on a RAM disk in a thread, each data
+ * command takes one tick like the programming time of a card. A card of two
+ * partitions is probed on it. It counts the data commands and ticks of 64
+ * single-sector writes by rt_device_write() one by one and by
+ * rt_mmcsd_blk_submit() at once, which are merged to multi-block writes with
+ * ACMD23 when the request queue is enabled. Then it checks the data of merged
+ * reads, the split of a request larger than the host can do in one command,
+ * the order of overlapped writes, the error of a request out of card and the
+ * sectors of the second partition. A read on the idle queue is done by the
+ * caller itself.
+ *
+ * The time is measured by rt_tick_get(), the tick shall be 1ms or so.
+ */
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <drivers/mmcsd_core.h>
+#include "tc_comm.h"
+
+#if defined(RT_USING_SDIO) && defined(RT_USING_DFS)
+#include <dfs_fs.h>
+
+#define SDSIM_SECTORS           512
+#define SDSIM_PART0_OFFSET      32
+#define SDSIM_PART1_OFFSET      256
+#define SDSIM_MAX_BLK_COUNT     16
+#define MMCSD_TEST_REQS         64
+
+static struct rt_mmcsd_host *sdsim_host;
+static struct rt_mmcsd_card *sdsim_card;
+static rt_uint8_t *sdsim_disk;
+static rt_bool_t sdsim_app_cmd;
+static rt_uint32_t sdsim_data_cmds, sdsim_erase_counts;
+static rt_thread_t sdsim_requester;
+
+static struct rt_mailbox sdsim_mb;
+static rt_uint32_t sdsim_mb_pool[4];
+static rt_thread_t sdsim_thread;
+
+static rt_uint8_t *test_buf;
+static struct rt_mmcsd_blk_req test_reqs[MMCSD_TEST_REQS];
+static int done_count, done_order;
+static rt_uint32_t errors;
+
+static void sdsim_data(struct rt_mmcsd_cmd *cmd, struct rt_mmcsd_data *data, rt_bool_t write)
+{
+    rt_uint8_t *ptr;
+
+    if (cmd->arg + data->blks > SDSIM_SECTORS)
+    {
+        cmd->err = -RT_EIO;
+        return;
+    }
+
+    ptr = sdsim_disk + cmd->arg * SECTOR_SIZE;
+    if (write)
+        rt_memcpy(ptr, data->buf, data->blks * SECTOR_SIZE);
+    else
+        rt_memcpy(data->buf, ptr, data->blks * SECTOR_SIZE);
+
+    sdsim_data_cmds ++;
+    /* the time of card */
+    rt_thread_delay(1);
+}
+
+/* the "DMA" of host, which finishes the requests one by one */
+static void sdsim_entry(void *parameter)
+{
+    struct rt_mmcsd_req *req;
+    struct rt_mmcsd_cmd *cmd;
+
+    while (rt_mb_recv(&sdsim_mb, (rt_uint32_t *)&req, RT_WAITING_FOREVER) == RT_EOK)
+    {
+        if (req == RT_NULL)
+            break;
+
+        cmd = req->cmd;
+        switch (cmd->cmd_code)
+        {
+        case APP_CMD:
+            cmd->resp[0] = R1_APP_CMD;
+            break;
+        case SET_BLOCK_COUNT:
+            if (sdsim_app_cmd)
+                sdsim_erase_counts ++;
+            break;
+        case SEND_STATUS:
+            cmd->resp[0] = R1_READY_FOR_DATA | (4 << 9);
+            break;
+        case READ_SINGLE_BLOCK:
+        case READ_MULTIPLE_BLOCK:
+            sdsim_data(cmd, req->data, RT_FALSE);
+            break;
+        case WRITE_BLOCK:
+        case WRITE_MULTIPLE_BLOCK:
+            sdsim_data(cmd, req->data, RT_TRUE);
+            break;
+        default:
+            break;
+        }
+        sdsim_app_cmd = (cmd->cmd_code == APP_CMD);
+
+        mmcsd_req_complete(sdsim_host);
+    }
+}
+
+static void sdsim_request(struct rt_mmcsd_host *host, struct rt_mmcsd_req *req)
+{
+    sdsim_requester = rt_thread_self();
+    rt_mb_send(&sdsim_mb, (rt_uint32_t)req);
+}
+
+static const struct rt_mmcsd_host_ops sdsim_ops =
+{
+    sdsim_request,
+    RT_NULL,
+    RT_NULL,
+    RT_NULL,
+};
+
+/* a partition table of two partitions */
+static void sdsim_part_init(int index, rt_uint32_t offset, rt_uint32_t size)
+{
+    rt_uint8_t *dpt = sdsim_disk + 0x1be + index * 16;
+
+    dpt[0]  = 0x00;
+    dpt[4]  = 0x0b;
+    dpt[8]  = offset & 0xff;
+    dpt[9]  = (offset >> 8) & 0xff;
+    dpt[12] = size & 0xff;
+    dpt[13] = (size >> 8) & 0xff;
+}
+
+static rt_err_t sdsim_init(void)
+{
+    sdsim_disk = rt_calloc(SDSIM_SECTORS, SECTOR_SIZE);
+    sdsim_host = mmcsd_alloc_host();
+    sdsim_card = rt_calloc(1, sizeof(struct rt_mmcsd_card));
+    if (sdsim_disk == RT_NULL || sdsim_host == RT_NULL || sdsim_card == RT_NULL)
+        return -RT_ENOMEM;
+
+    sdsim_part_init(0, SDSIM_PART0_OFFSET, SDSIM_PART1_OFFSET - SDSIM_PART0_OFFSET);
+    sdsim_part_init(1, SDSIM_PART1_OFFSET, SDSIM_SECTORS - SDSIM_PART1_OFFSET);
+    sdsim_disk[510] = 0x55;
+    sdsim_disk[511] = 0xaa;
+
+    sdsim_host->ops = &sdsim_ops;
+    sdsim_host->io_cfg.clock = 25000000;
+    sdsim_host->max_blk_count = SDSIM_MAX_BLK_COUNT;
+    sdsim_host->card = sdsim_card;
+
+    sdsim_card->host = sdsim_host;
+    sdsim_card->card_type = CARD_TYPE_SD;
+    sdsim_card->flags = CARD_FLAG_SDHC;
+    sdsim_card->rca = 1;
+    sdsim_card->card_blksize = SECTOR_SIZE;
+    sdsim_card->card_capacity = SDSIM_SECTORS / 2;
+
+    rt_mb_init(&sdsim_mb, "sdsim", sdsim_mb_pool,
+               sizeof(sdsim_mb_pool) / sizeof(sdsim_mb_pool[0]), RT_IPC_FLAG_FIFO);
+    sdsim_thread = rt_thread_create("sdsim", sdsim_entry, RT_NULL,
+                                    THREAD_STACK_SIZE * 2, THREAD_PRIORITY - 2, THREAD_TIMESLICE);
+    if (sdsim_thread == RT_NULL)
+        return -RT_ENOMEM;
+    rt_thread_startup(sdsim_thread);
+
+    return RT_EOK;
+}
+
+static void sdsim_cleanup(void)
+{
+    if (sdsim_thread != RT_NULL)
+    {
+        rt_mb_send(&sdsim_mb, 0);
+        rt_thread_delay(RT_TICK_PER_SECOND / 10);
+        rt_mb_detach(&sdsim_mb);
+    }
+    if (sdsim_host != RT_NULL)
+        mmcsd_free_host(sdsim_host);
+    rt_free(sdsim_card);
+    rt_free(sdsim_disk);
+}
+
+static void mmcsd_test_done(struct rt_mmcsd_blk_req *req)
+{
+    /* done in order of sectors */
+    if (req->result != RT_EOK || (int)(rt_ubase_t)req->user_data != done_order)
+        errors ++;
+    done_order ++;
+    done_count ++;
+}
+
+/* the sector of partition 0 in disk */
+static rt_uint8_t *mmcsd_test_sector(rt_uint32_t sector)
+{
+    return sdsim_disk + (SDSIM_PART0_OFFSET + sector) * SECTOR_SIZE;
+}
+
+/* the buffer of request, it's not adjacent to the others when stride is 2 */
+static rt_uint8_t *mmcsd_test_buf(int index, int stride)
+{
+    return test_buf + index * stride * SECTOR_SIZE;
+}
+
+static void mmcsd_test_report(const char *name, rt_tick_t tick)
+{
+    rt_kprintf("mmcsd blk: %-24s %d data commands, %d ACMD23, %d ticks\n", name,
+               sdsim_data_cmds, sdsim_erase_counts, rt_tick_get() - tick);
+}
+
+static void mmcsd_test_write(rt_device_t dev)
+{
+    int index;
+    rt_tick_t tick;
+
+    /* the writes one by one */
+    sdsim_data_cmds = sdsim_erase_counts = 0;
+    tick = rt_tick_get();
+    for (index = 0; index < MMCSD_TEST_REQS; index ++)
+    {
+        rt_memset(mmcsd_test_buf(index, 1), index, SECTOR_SIZE);
+        if (rt_device_write(dev, 64 + index, mmcsd_test_buf(index, 1), 1) != 1)
+            errors ++;
+    }
+    mmcsd_test_report("rt_device_write:", tick);
+    if (sdsim_data_cmds != MMCSD_TEST_REQS)
+        errors ++;
+
+    /* submitted at once, in buffers not adjacent */
+    sdsim_data_cmds = sdsim_erase_counts = 0;
+    done_count = done_order = 0;
+    tick = rt_tick_get();
+    for (index = 0; index < MMCSD_TEST_REQS; index ++)
+    {
+        rt_memset(mmcsd_test_buf(index, 2), index + 1, SECTOR_SIZE);
+        rt_memset(&test_reqs[index], 0, sizeof(struct rt_mmcsd_blk_req));
+        test_reqs[index].sector    = 64 + index;
+        test_reqs[index].blks      = 1;
+        test_reqs[index].buf       = mmcsd_test_buf(index, 2);
+        test_reqs[index].flags     = MMCSD_BLK_REQ_WRITE;
+        test_reqs[index].done      = mmcsd_test_done;
+        test_reqs[index].user_data = (void *)(rt_ubase_t)index;
+        rt_mmcsd_blk_submit(dev, &test_reqs[index]);
+    }
+    rt_device_control(dev, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL);
+    mmcsd_test_report("rt_mmcsd_blk_submit:", tick);
+
+    if (done_count != MMCSD_TEST_REQS)
+        errors ++;
+    for (index = 0; index < MMCSD_TEST_REQS; index ++)
+    {
+        if (mmcsd_test_sector(64 + index)[0] != index + 1 ||
+            mmcsd_test_sector(64 + index)[SECTOR_SIZE - 1] != index + 1)
+            errors ++;
+    }
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    if (sdsim_data_cmds > MMCSD_TEST_REQS / 4 || sdsim_erase_counts == 0)
+        errors ++;
+#endif
+}
+
+static void mmcsd_test_read(rt_device_t dev)
+{
+    int index;
+    rt_tick_t tick;
+
+    sdsim_data_cmds = sdsim_erase_counts = 0;
+    done_count = done_order = 0;
+    tick = rt_tick_get();
+    rt_memset(test_buf, 0, MMCSD_TEST_REQS * 2 * SECTOR_SIZE);
+    for (index = 0; index < MMCSD_TEST_REQS; index ++)
+    {
+        rt_memset(&test_reqs[index], 0, sizeof(struct rt_mmcsd_blk_req));
+        test_reqs[index].sector    = 64 + index;
+        test_reqs[index].blks      = 1;
+        test_reqs[index].buf       = mmcsd_test_buf(index, index < MMCSD_TEST_REQS / 2 ? 1 : 2);
+        test_reqs[index].done      = mmcsd_test_done;
+        test_reqs[index].user_data = (void *)(rt_ubase_t)index;
+        rt_mmcsd_blk_submit(dev, &test_reqs[index]);
+    }
+    rt_device_control(dev, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL);
+    mmcsd_test_report("read submit:", tick);
+
+    if (done_count != MMCSD_TEST_REQS)
+        errors ++;
+    for (index = 0; index < MMCSD_TEST_REQS; index ++)
+    {
+        if (rt_memcmp(test_reqs[index].buf, mmcsd_test_sector(64 + index), SECTOR_SIZE) != 0)
+            errors ++;
+    }
+}
+
+static void mmcsd_test_misc(rt_device_t dev, rt_device_t dev1)
+{
+    int index;
+    struct rt_mmcsd_blk_req req;
+
+    /* larger than the host can do in one command */
+    sdsim_data_cmds = 0;
+    for (index = 0; index < 40 * SECTOR_SIZE; index ++)
+        test_buf[index] = (rt_uint8_t)(index / 7);
+    if (rt_device_write(dev, 100, test_buf, 40) != 40 ||
+        rt_memcmp(mmcsd_test_sector(100), test_buf, 40 * SECTOR_SIZE) != 0)
+        errors ++;
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    if (sdsim_data_cmds != (40 + SDSIM_MAX_BLK_COUNT - 1) / SDSIM_MAX_BLK_COUNT)
+        errors ++;
+#endif
+
+    /* the overlapped write is not merged before the one submitted earlier */
+    done_count = 0;
+    for (index = 0; index < 4; index ++)
+    {
+        rt_memset(mmcsd_test_buf(index, 2), 0xa0 + index, SECTOR_SIZE);
+        rt_memset(&test_reqs[index], 0, sizeof(struct rt_mmcsd_blk_req));
+        test_reqs[index].sector = (index & 0x01) ? 21 : 20;
+        test_reqs[index].blks   = 1;
+        test_reqs[index].buf    = mmcsd_test_buf(index, 2);
+        test_reqs[index].flags  = MMCSD_BLK_REQ_WRITE;
+        rt_mmcsd_blk_submit(dev, &test_reqs[index]);
+    }
+    /* it reads the data of the last writes */
+    if (rt_device_read(dev, 20, test_buf + 8 * SECTOR_SIZE, 2) != 2 ||
+        test_buf[8 * SECTOR_SIZE] != 0xa2 || test_buf[9 * SECTOR_SIZE] != 0xa3)
+        errors ++;
+
+    /* out of card, the error of merged transfer is got by all requests */
+    rt_memset(&test_reqs[0], 0, sizeof(struct rt_mmcsd_blk_req));
+    test_reqs[0].sector = SDSIM_SECTORS - SDSIM_PART1_OFFSET - 1;
+    test_reqs[0].blks   = 1;
+    test_reqs[0].buf    = test_buf;
+    rt_memcpy(&test_reqs[1], &test_reqs[0], sizeof(struct rt_mmcsd_blk_req));
+    test_reqs[1].sector = SDSIM_SECTORS - SDSIM_PART1_OFFSET;
+    test_reqs[1].buf    = test_buf + SECTOR_SIZE;
+    rt_mmcsd_blk_submit(dev1, &test_reqs[0]);
+    rt_mmcsd_blk_submit(dev1, &test_reqs[1]);
+    rt_device_control(dev1, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL);
+    if (test_reqs[1].result == RT_EOK)
+        errors ++;
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    if (test_reqs[0].result == RT_EOK)
+        errors ++;
+#endif
+
+    /* the queue is idle, the read is not passed to its thread */
+    rt_thread_delay(1);
+    sdsim_requester = RT_NULL;
+    if (rt_device_read(dev, 20, test_buf, 1) != 1 || sdsim_requester != rt_thread_self())
+        errors ++;
+
+    /* the sector of partition 1 */
+    rt_memset(test_buf, 0x5a, SECTOR_SIZE);
+    rt_memset(&req, 0, sizeof(struct rt_mmcsd_blk_req));
+    req.sector = 3;
+    req.blks   = 1;
+    req.buf    = test_buf;
+    req.flags  = MMCSD_BLK_REQ_WRITE;
+    rt_mmcsd_blk_submit(dev1, &req);
+    rt_device_control(dev1, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL);
+    if (req.result != RT_EOK || sdsim_disk[(SDSIM_PART1_OFFSET + 3) * SECTOR_SIZE] != 0x5a)
+        errors ++;
+}
+
+static void mmcsd_blk_test_init(void)
+{
+    rt_device_t dev, dev1;
+
+    errors = 0;
+#ifdef RT_MMCSD_USING_BLK_QUEUE
+    rt_kprintf("mmcsd blk test: request queue\n");
+#else
+    rt_kprintf("mmcsd blk test: no request queue\n");
+#endif
+
+    test_buf = rt_malloc(MMCSD_TEST_REQS * 2 * SECTOR_SIZE);
+    if (test_buf == RT_NULL || sdsim_init() != RT_EOK ||
+        rt_mmcsd_blk_probe(sdsim_card) != 0)
+    {
+        errors ++;
+        goto _exit;
+    }
+
+    dev  = rt_device_find("sd0");
+    dev1 = rt_device_find("sd1");
+    if (dev == RT_NULL || dev1 == RT_NULL ||
+        rt_device_open(dev, RT_DEVICE_OFLAG_RDWR) != RT_EOK)
+        errors ++;
+    else
+    {
+        rt_device_open(dev1, RT_DEVICE_OFLAG_RDWR);
+        mmcsd_test_write(dev);
+        mmcsd_test_read(dev);
+        mmcsd_test_misc(dev, dev1);
+        rt_device_close(dev1);
+        rt_device_close(dev);
+    }
+
+    rt_mmcsd_blk_remove(sdsim_card);
+    if (rt_device_find("sd0") != RT_NULL || rt_device_find("sd1") != RT_NULL)
+        errors ++;
+
+_exit:
+    sdsim_cleanup();
+    rt_free(test_buf);
+
+    rt_kprintf("mmcsd blk test: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_mmcsd_blk_test()
+{
+    mmcsd_blk_test_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_mmcsd_blk_test, a test of request queue of mmcsd block device);
+#else
+int rt_application_init()
+{
+    mmcsd_blk_test_init();
+
+    return 0;
+}
+#endif
+#endif
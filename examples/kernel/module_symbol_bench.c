@@ -0,0 +1,137 @@
+/*
+ * This is the benchmark of the symbol lookup of module.
+ *
+ * It shows the cycles to find a kernel symbol by rt_module_find_symbol(), for
+ * the symbols in the kernel symbol table and a symbol not in it, which are
+ * done for each relocation of the kernel symbols when a module is loaded.
+ * Then it shows the cycles of rt_module_open() on the application module of
+ * examples/module/relocapp, which has 5000 relocations of kernel symbols, if
+ * it's copied to MODULE_BENCH_PATH on the file system.
+ *
+ * Run it without and with RT_USING_MODULE_SYMHASH to compare the linear
+ * search and the hash index of symbol table.
+ */
+#include <rtthread.h>
+#include "tc_comm.h"
+
+#ifdef RT_USING_MODULE
+#define MODULE_BENCH_ROUND      100
+#ifndef MODULE_BENCH_PATH
+#define MODULE_BENCH_PATH       "/relocapp.mo"
+#endif
+
+/* the kernel symbols referenced by relocapp */
+static const char *symbols[] =
+{
+    "rt_malloc", "rt_free", "rt_realloc", "rt_calloc",
+    "rt_kprintf", "rt_snprintf", "rt_sprintf", "rt_vsnprintf",
+    "rt_memcpy", "rt_memset", "rt_memmove", "rt_memcmp",
+    "rt_strcmp", "rt_strncmp", "rt_strlen", "rt_strncpy",
+    "rt_strstr", "rt_strdup", "rt_tick_get", "rt_thread_self",
+    "rt_thread_create", "rt_thread_delete", "rt_thread_startup", "rt_thread_delay",
+    "rt_thread_yield", "rt_thread_find", "rt_thread_control", "rt_sem_create",
+    "rt_sem_delete", "rt_sem_take", "rt_sem_release", "rt_mutex_create",
+    "rt_mutex_delete", "rt_mutex_take", "rt_mutex_release", "rt_event_create",
+    "rt_event_send", "rt_event_recv", "rt_mb_create", "rt_mb_send",
+    "rt_mb_recv", "rt_mq_create", "rt_mq_send", "rt_mq_recv",
+    "rt_timer_create", "rt_timer_start", "rt_timer_stop", "rt_timer_delete",
+    "rt_get_errno", "rt_set_errno",
+};
+#define SYMBOL_NR               (sizeof(symbols) / sizeof(symbols[0]))
+
+static rt_uint32_t errors;
+
+static void module_symbol_lookup_bench(void)
+{
+    int round, index;
+    rt_uint32_t cycle;
+
+    cycle = tc_cycle_get();
+    for (round = 0; round < MODULE_BENCH_ROUND; round ++)
+    {
+        for (index = 0; index < SYMBOL_NR; index ++)
+        {
+            if (rt_module_find_symbol(RT_NULL, symbols[index]) == RT_NULL)
+                errors ++;
+        }
+    }
+    cycle = tc_cycle_get() - cycle;
+    rt_kprintf("kernel symbol found    : %d\n", cycle / (MODULE_BENCH_ROUND * SYMBOL_NR));
+
+    /* the whole table is searched */
+    cycle = tc_cycle_get();
+    for (round = 0; round < MODULE_BENCH_ROUND; round ++)
+    {
+        if (rt_module_find_symbol(RT_NULL, "rt_no_such_symbol") != RT_NULL)
+            errors ++;
+    }
+    cycle = tc_cycle_get() - cycle;
+    rt_kprintf("kernel symbol not found: %d\n", cycle / MODULE_BENCH_ROUND);
+
+    if (rt_module_find_symbol(RT_NULL, "rt_malloc") != (void *)rt_malloc)
+        errors ++;
+}
+
+#ifdef RT_USING_DFS
+#include <dfs_posix.h>
+
+static void module_open_bench(void)
+{
+    struct stat s;
+    rt_uint32_t cycle;
+    rt_module_t module;
+
+    if (stat(MODULE_BENCH_PATH, &s) != 0)
+    {
+        rt_kprintf("module open: %s not found, skipped\n", MODULE_BENCH_PATH);
+        return;
+    }
+
+    /* the module runs and exits by itself */
+    cycle = tc_cycle_get();
+    module = rt_module_open(MODULE_BENCH_PATH);
+    cycle = tc_cycle_get() - cycle;
+
+    if (module == RT_NULL)
+        errors ++;
+    else
+        rt_kprintf("module open: %s of %d bytes, %d\n", MODULE_BENCH_PATH,
+                   s.st_size, cycle);
+}
+#endif
+
+static void module_symbol_bench_init(void)
+{
+#ifdef RT_USING_MODULE_SYMHASH
+    rt_kprintf("module symbol bench: hash index\n");
+#else
+    rt_kprintf("module symbol bench: linear search\n");
+#endif
+
+    errors = 0;
+    module_symbol_lookup_bench();
+#ifdef RT_USING_DFS
+    module_open_bench();
+#endif
+
+    rt_kprintf("module symbol bench: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_module_symbol_bench()
+{
+    module_symbol_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_module_symbol_bench, a symbol lookup benchmark of module);
+#else
+int rt_application_init()
+{
+    module_symbol_bench_init();
+
+    return 0;
+}
+#endif
+#endif
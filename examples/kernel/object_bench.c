@@ -0,0 +1,152 @@
+/*
+ * This is a benchmark of kernel object lookup.
+ *
+ * It registers 8, 32 and 128 semaphores and devices, then measures the
+ * average and worst-case time of rt_object_find() and rt_device_find() for
+ * the oldest object, which is at the tail of object list, and for a name
+ * which is not in the system. Without RT_USING_OBJECT_HASH the lookup time
+ * grows with the object count; with it, only the objects in one name hash
+ * bucket are compared.
+ *
+ * Each lookup shall return the expected object, and a detached object shall
+ * not be found anymore.
+ */
+#include <rtthread.h>
+#include "tc_comm.h"
+
+#define OBJECT_BENCH_MAX        128
+#define OBJECT_BENCH_ROUND      1000
+
+struct object_bench_stat
+{
+    rt_uint32_t total;
+    rt_uint32_t max;
+};
+
+static struct rt_semaphore bench_sems[OBJECT_BENCH_MAX];
+static struct rt_device bench_devices[OBJECT_BENCH_MAX];
+static rt_uint32_t errors;
+
+static void object_bench_stat_add(struct object_bench_stat *stat, rt_uint32_t cycle)
+{
+    stat->total += cycle;
+    if (cycle > stat->max)
+        stat->max = cycle;
+}
+
+static void object_bench_name(char *name, rt_uint32_t index)
+{
+    rt_snprintf(name, RT_NAME_MAX, "ob%d", index);
+}
+
+static void object_bench_run(rt_uint32_t count)
+{
+    int index;
+    rt_uint32_t cycle;
+    rt_object_t object;
+    rt_device_t device;
+    char name[RT_NAME_MAX];
+    struct object_bench_stat sem_hit, sem_miss, dev_hit, dev_miss;
+
+    rt_memset(&sem_hit, 0, sizeof(sem_hit));
+    rt_memset(&sem_miss, 0, sizeof(sem_miss));
+    rt_memset(&dev_hit, 0, sizeof(dev_hit));
+    rt_memset(&dev_miss, 0, sizeof(dev_miss));
+
+    for (index = 0; index < count; index ++)
+    {
+        object_bench_name(name, index);
+        rt_sem_init(&bench_sems[index], name, 0, RT_IPC_FLAG_FIFO);
+
+        bench_devices[index].type = RT_Device_Class_Miscellaneous;
+        rt_device_register(&bench_devices[index], name, RT_DEVICE_FLAG_RDWR);
+    }
+
+    for (index = 0; index < OBJECT_BENCH_ROUND; index ++)
+    {
+        /* the first one is the oldest object */
+        object_bench_name(name, 0);
+        cycle = tc_cycle_get();
+        object = rt_object_find(name, RT_Object_Class_Semaphore);
+        object_bench_stat_add(&sem_hit, tc_cycle_get() - cycle);
+        if (object != &(bench_sems[0].parent.parent))
+            errors ++;
+
+        cycle = tc_cycle_get();
+        device = rt_device_find(name);
+        object_bench_stat_add(&dev_hit, tc_cycle_get() - cycle);
+        if (device != &bench_devices[0])
+            errors ++;
+
+        object_bench_name(name, OBJECT_BENCH_MAX);
+        cycle = tc_cycle_get();
+        object = rt_object_find(name, RT_Object_Class_Semaphore);
+        object_bench_stat_add(&sem_miss, tc_cycle_get() - cycle);
+        if (object != RT_NULL)
+            errors ++;
+
+        cycle = tc_cycle_get();
+        device = rt_device_find(name);
+        object_bench_stat_add(&dev_miss, tc_cycle_get() - cycle);
+        if (device != RT_NULL)
+            errors ++;
+    }
+
+    rt_kprintf("%3d objects: object find %d/%d, miss %d/%d; "
+               "device find %d/%d, miss %d/%d (avg/max)\n", count,
+               sem_hit.total / OBJECT_BENCH_ROUND, sem_hit.max,
+               sem_miss.total / OBJECT_BENCH_ROUND, sem_miss.max,
+               dev_hit.total / OBJECT_BENCH_ROUND, dev_hit.max,
+               dev_miss.total / OBJECT_BENCH_ROUND, dev_miss.max);
+
+    for (index = 0; index < count; index ++)
+    {
+        rt_sem_detach(&bench_sems[index]);
+        rt_device_unregister(&bench_devices[index]);
+    }
+
+    /* the detached objects shall not be found */
+    for (index = 0; index < count; index ++)
+    {
+        object_bench_name(name, index);
+        if (rt_object_find(name, RT_Object_Class_Semaphore) != RT_NULL ||
+            rt_device_find(name) != RT_NULL)
+            errors ++;
+    }
+}
+
+static void object_bench_init(void)
+{
+    errors = 0;
+    rt_memset(bench_devices, 0, sizeof(bench_devices));
+
+#ifdef RT_USING_OBJECT_HASH
+    rt_kprintf("object bench: %d hash buckets\n", RT_OBJECT_HASH_SIZE);
+#else
+    rt_kprintf("object bench: no hash index\n");
+#endif
+
+    object_bench_run(8);
+    object_bench_run(32);
+    object_bench_run(OBJECT_BENCH_MAX);
+
+    rt_kprintf("object bench: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_object_bench()
+{
+    object_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_object_bench, an object and device lookup benchmark);
+#else
+int rt_application_init()
+{
+    object_bench_init();
+
+    return 0;
+}
+#endif
@@ -0,0 +1,272 @@
+/*
+ * This is the benchmark of the lock-free ring buffer of single producer and
+ * single consumer.
+ *
+ * It shows the cycles of putting and getting blocks of data through
+ * rt_ringbuffer in interrupt disabled sections, as pipe and serial do, through
+ * rt_spsc_ring_put/get, and through the reserve/commit and peek/release of
+ * rt_spsc_ring without the copy. Then a producer thread and a consumer thread
+ * pass a sequence of bytes through rt_spsc_ring, on different cpus on SMP,
+ * and the consumer checks the sequence.
+ */
+#include <rtthread.h>
+#include <rthw.h>
+#include <rtdevice.h>
+#include "tc_comm.h"
+
+#ifdef RT_USING_DEVICE_IPC
+#define RING_BENCH_SIZE         256
+#define RING_BENCH_ROUND        1000
+#define RING_BENCH_BYTES        (64 * 1024)
+/* a prime, so the sequence does not align with the ring */
+#define RING_BENCH_MOD          251
+
+static rt_uint8_t ring_pool[RING_BENCH_SIZE];
+static rt_uint8_t ring_data[RING_BENCH_SIZE];
+static struct rt_ringbuffer rb;
+static struct rt_spsc_ring ring;
+static struct rt_semaphore ring_done;
+static rt_uint32_t errors;
+
+static void ring_bench_show(const char *name, int block, rt_uint32_t cycle)
+{
+    rt_kprintf("%-16s %3d bytes: %d per block\n", name, block,
+               cycle / RING_BENCH_ROUND);
+}
+
+static void ringbuffer_bench(int block)
+{
+    int index;
+    rt_base_t level;
+    rt_uint32_t cycle;
+
+    rt_ringbuffer_init(&rb, ring_pool, RING_BENCH_SIZE);
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < RING_BENCH_ROUND; index ++)
+    {
+        level = rt_hw_interrupt_disable();
+        rt_ringbuffer_put(&rb, ring_data, block);
+        rt_hw_interrupt_enable(level);
+
+        level = rt_hw_interrupt_disable();
+        if (rt_ringbuffer_get(&rb, ring_data, block) != block)
+            errors ++;
+        rt_hw_interrupt_enable(level);
+    }
+    cycle = tc_cycle_get() - cycle;
+
+    ring_bench_show("ringbuffer", block, cycle);
+}
+
+static void spsc_ring_bench(int block)
+{
+    int index;
+    rt_uint32_t cycle;
+
+    rt_spsc_ring_init(&ring, ring_pool, RING_BENCH_SIZE);
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < RING_BENCH_ROUND; index ++)
+    {
+        rt_spsc_ring_put(&ring, ring_data, block);
+        if (rt_spsc_ring_get(&ring, ring_data, block) != block)
+            errors ++;
+    }
+    cycle = tc_cycle_get() - cycle;
+
+    ring_bench_show("spsc put/get", block, cycle);
+}
+
+static void spsc_ring_zero_copy_bench(int block)
+{
+    int index;
+    rt_size_t length;
+    rt_uint8_t *ptr;
+    rt_uint32_t cycle;
+
+    rt_spsc_ring_init(&ring, ring_pool, RING_BENCH_SIZE);
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < RING_BENCH_ROUND; index ++)
+    {
+        /* the producer writes the data in place, such as by DMA */
+        length = rt_spsc_ring_reserve(&ring, &ptr);
+        if (length > block)
+            length = block;
+        ptr[0] = (rt_uint8_t)index;
+        rt_spsc_ring_commit(&ring, length);
+
+        length = rt_spsc_ring_peek(&ring, &ptr);
+        if (ptr[0] != (rt_uint8_t)index)
+            errors ++;
+        rt_spsc_ring_release(&ring, length);
+    }
+    cycle = tc_cycle_get() - cycle;
+
+    ring_bench_show("spsc zero copy", block, cycle);
+}
+
+static void ring_producer_entry(void *parameter)
+{
+    rt_uint32_t sent = 0, index, length;
+    rt_uint8_t *ptr;
+    rt_uint8_t block[32];
+
+    while (sent < RING_BENCH_BYTES)
+    {
+        /* in turn by the copy and in place */
+        if (sent & 0x100)
+        {
+            length = rt_spsc_ring_reserve(&ring, &ptr);
+            if (length > RING_BENCH_BYTES - sent)
+                length = RING_BENCH_BYTES - sent;
+            for (index = 0; index < length; index ++)
+                ptr[index] = (sent + index) % RING_BENCH_MOD;
+            rt_spsc_ring_commit(&ring, length);
+        }
+        else
+        {
+            length = sizeof(block);
+            if (length > RING_BENCH_BYTES - sent)
+                length = RING_BENCH_BYTES - sent;
+            for (index = 0; index < length; index ++)
+                block[index] = (sent + index) % RING_BENCH_MOD;
+            length = rt_spsc_ring_put(&ring, block, length);
+        }
+
+        sent += length;
+        if (length == 0)
+            rt_thread_yield();
+    }
+
+    rt_sem_release(&ring_done);
+}
+
+static void ring_consumer_entry(void *parameter)
+{
+    rt_uint32_t received = 0, index, length;
+    rt_uint8_t *ptr;
+    rt_uint8_t block[24];
+
+    while (received < RING_BENCH_BYTES)
+    {
+        if (received & 0x80)
+        {
+            length = rt_spsc_ring_peek(&ring, &ptr);
+            for (index = 0; index < length; index ++)
+            {
+                if (ptr[index] != (received + index) % RING_BENCH_MOD)
+                    errors ++;
+            }
+            rt_spsc_ring_release(&ring, length);
+        }
+        else
+        {
+            ptr = block;
+            length = rt_spsc_ring_get(&ring, block, sizeof(block));
+            for (index = 0; index < length; index ++)
+            {
+                if (ptr[index] != (received + index) % RING_BENCH_MOD)
+                    errors ++;
+            }
+        }
+
+        received += length;
+        if (length == 0)
+            rt_thread_yield();
+    }
+
+    rt_sem_release(&ring_done);
+}
+
+static rt_thread_t ring_thread_create(const char *name,
+                                      void (*entry)(void *), int cpu)
+{
+    rt_thread_t tid;
+
+    tid = rt_thread_create(name, entry, RT_NULL, THREAD_STACK_SIZE,
+                           THREAD_PRIORITY, THREAD_TIMESLICE);
+    if (tid == RT_NULL)
+        return RT_NULL;
+
+#ifdef RT_USING_SMP
+    {
+        rt_uint8_t bind = cpu % RT_CPUS_NR;
+
+        rt_thread_control(tid, RT_THREAD_CTRL_BIND_CPU, &bind);
+    }
+#endif
+    rt_thread_startup(tid);
+
+    return tid;
+}
+
+static void spsc_ring_thread_test(void)
+{
+    rt_tick_t tick;
+
+    rt_spsc_ring_init(&ring, ring_pool, RING_BENCH_SIZE);
+    rt_sem_init(&ring_done, "rdone", 0, RT_IPC_FLAG_FIFO);
+
+    tick = rt_tick_get();
+    if (ring_thread_create("rprod", ring_producer_entry, 0) == RT_NULL ||
+        ring_thread_create("rcons", ring_consumer_entry, 1) == RT_NULL)
+    {
+        errors ++;
+        rt_sem_detach(&ring_done);
+        return;
+    }
+
+    if (rt_sem_take(&ring_done, RT_TICK_PER_SECOND * 10) != RT_EOK ||
+        rt_sem_take(&ring_done, RT_TICK_PER_SECOND * 10) != RT_EOK)
+        errors ++;
+    tick = rt_tick_get() - tick;
+
+    if (rt_spsc_ring_data_len(&ring) != 0)
+        errors ++;
+    rt_kprintf("spsc ring: %d bytes by two threads in %d ticks\n",
+               RING_BENCH_BYTES, tick);
+
+    rt_sem_detach(&ring_done);
+}
+
+static void ringbuffer_bench_init(void)
+{
+    int index;
+    static const int blocks[] = {1, 16, 64, 200};
+
+    errors = 0;
+    if (rt_spsc_ring_init(&ring, ring_pool, RING_BENCH_SIZE - 1) == RT_EOK)
+        errors ++;
+
+    for (index = 0; index < sizeof(blocks) / sizeof(blocks[0]); index ++)
+    {
+        ringbuffer_bench(blocks[index]);
+        spsc_ring_bench(blocks[index]);
+        spsc_ring_zero_copy_bench(blocks[index]);
+    }
+
+    spsc_ring_thread_test();
+
+    rt_kprintf("ringbuffer bench: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_ringbuffer_bench()
+{
+    ringbuffer_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_ringbuffer_bench, a lock-free ring buffer benchmark);
+#else
+int rt_application_init()
+{
+    ringbuffer_bench_init();
+
+    return 0;
+}
+#endif
+#endif
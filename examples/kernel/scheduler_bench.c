@@ -0,0 +1,205 @@
+/*
+ * This is a benchmark for the scheduler.
+ *
+ * It measures the average and worst-case time of rt_schedule() without thread
+ * switching (the lookup of highest ready priority), rt_schedule_insert_thread()
+ * and rt_schedule_remove_thread(), and the time of a thread switch by yield.
+ * The measurement is done with only the bench threads ready, then with ready
+ * threads on the priorities up to RT_THREAD_PRIORITY_MAX.
+ */
+#include <rtthread.h>
+#include <rthw.h>
+#include "tc_comm.h"
+
+#define SCHED_BENCH_ROUND       1000
+#define SCHED_BENCH_PRIORITY    1
+/* the load threads are on the priorities from SCHED_BENCH_PRIORITY + 1 */
+#define SCHED_BENCH_LOADS       32
+#define SCHED_BENCH_LOAD_STEP   ((RT_THREAD_PRIORITY_MAX - 3) / SCHED_BENCH_LOADS + 1)
+
+struct sched_bench_stat
+{
+    rt_uint32_t total;
+    rt_uint32_t max;
+};
+
+static rt_thread_t bench_loads[SCHED_BENCH_LOADS];
+static rt_thread_t bench_peer;
+static struct rt_semaphore bench_done;
+static volatile rt_uint32_t bench_stop;
+
+static void sched_bench_stat_add(struct sched_bench_stat *stat, rt_uint32_t cycle)
+{
+    stat->total += cycle;
+    if (cycle > stat->max)
+        stat->max = cycle;
+}
+
+static void sched_bench_load_entry(void *parameter)
+{
+    /* only runs when the bench thread is waiting */
+    while (bench_stop == 0)
+        rt_thread_delay(1);
+}
+
+static void sched_bench_peer_entry(void *parameter)
+{
+    int index;
+
+    for (index = 0; index < SCHED_BENCH_ROUND; index ++)
+        rt_thread_yield();
+}
+
+static rt_thread_t sched_bench_thread_create(void (*entry)(void *),
+                                             rt_uint8_t priority)
+{
+    rt_thread_t tid;
+
+    tid = rt_thread_create("sbench", entry, RT_NULL, THREAD_STACK_SIZE,
+                           priority, THREAD_TIMESLICE);
+    if (tid == RT_NULL)
+        return RT_NULL;
+
+#ifdef RT_USING_SMP
+    {
+        rt_uint8_t cpu;
+
+        /* the bench threads shall run on the same cpu */
+        cpu = rt_hw_cpu_id();
+        rt_thread_control(tid, RT_THREAD_CTRL_BIND_CPU, &cpu);
+    }
+#endif
+
+    return tid;
+}
+
+static int sched_bench_load(void)
+{
+    int index, count = 0;
+    rt_uint8_t priority;
+
+    for (index = 0; index < SCHED_BENCH_LOADS; index ++)
+    {
+        priority = SCHED_BENCH_PRIORITY + 1 + index * SCHED_BENCH_LOAD_STEP;
+        if (priority >= RT_THREAD_PRIORITY_MAX - 1)
+            break;
+
+        bench_loads[index] = sched_bench_thread_create(sched_bench_load_entry, priority);
+        if (bench_loads[index] == RT_NULL)
+            break;
+
+        /* it's ready but not running, the bench thread has higher priority */
+        rt_thread_startup(bench_loads[index]);
+        count ++;
+    }
+
+    return count;
+}
+
+static void sched_bench_run(int loads)
+{
+    int index;
+    rt_base_t level;
+    rt_uint32_t cycle;
+    rt_thread_t thread;
+    struct sched_bench_stat schedule, insert, remove;
+
+    rt_memset(&schedule, 0, sizeof(schedule));
+    rt_memset(&insert, 0, sizeof(insert));
+    rt_memset(&remove, 0, sizeof(remove));
+
+    /* the lowest priority ready thread */
+    thread = loads ? bench_loads[loads - 1] : rt_thread_self();
+
+    for (index = 0; index < SCHED_BENCH_ROUND; index ++)
+    {
+        /* no thread switch, it's the lookup of highest priority */
+        cycle = tc_cycle_get();
+        rt_schedule();
+        sched_bench_stat_add(&schedule, tc_cycle_get() - cycle);
+
+        level = rt_hw_interrupt_disable();
+
+        cycle = tc_cycle_get();
+        rt_schedule_remove_thread(thread);
+        sched_bench_stat_add(&remove, tc_cycle_get() - cycle);
+
+        cycle = tc_cycle_get();
+        rt_schedule_insert_thread(thread);
+        sched_bench_stat_add(&insert, tc_cycle_get() - cycle);
+
+        rt_hw_interrupt_enable(level);
+    }
+
+    /* switch between the bench thread and its peer */
+    bench_peer = sched_bench_thread_create(sched_bench_peer_entry, SCHED_BENCH_PRIORITY);
+    rt_thread_startup(bench_peer);
+    cycle = tc_cycle_get();
+    for (index = 0; index < SCHED_BENCH_ROUND; index ++)
+        rt_thread_yield();
+    cycle = tc_cycle_get() - cycle;
+
+    rt_kprintf("%2d ready priorities: schedule %d/%d, insert %d/%d, remove %d/%d, "
+               "switch %d (avg/max)\n", loads + 1,
+               schedule.total / SCHED_BENCH_ROUND, schedule.max,
+               insert.total / SCHED_BENCH_ROUND, insert.max,
+               remove.total / SCHED_BENCH_ROUND, remove.max,
+               cycle / (SCHED_BENCH_ROUND * 2));
+}
+
+static void sched_bench_entry(void *parameter)
+{
+    int loads;
+
+    sched_bench_run(0);
+
+    loads = sched_bench_load();
+    sched_bench_run(loads);
+
+    rt_sem_release(&bench_done);
+}
+
+static void scheduler_bench_init(void)
+{
+    rt_thread_t tid;
+
+    rt_kprintf("scheduler bench: %d priority levels\n", RT_THREAD_PRIORITY_MAX);
+
+    bench_stop = 0;
+    rt_memset(bench_loads, 0, sizeof(bench_loads));
+    rt_sem_init(&bench_done, "sbench", 0, RT_IPC_FLAG_FIFO);
+
+    tid = sched_bench_thread_create(sched_bench_entry, SCHED_BENCH_PRIORITY);
+    if (tid == RT_NULL)
+    {
+        rt_sem_detach(&bench_done);
+        tc_done(TC_STAT_FAILED);
+        return;
+    }
+    rt_thread_startup(tid);
+    rt_sem_take(&bench_done, RT_WAITING_FOREVER);
+
+    /* let the load threads exit */
+    bench_stop = 1;
+    rt_thread_delay(RT_TICK_PER_SECOND / 10);
+    rt_sem_detach(&bench_done);
+
+    tc_done(TC_STAT_PASSED);
+}
+
+#ifdef RT_USING_TC
+int _tc_scheduler_bench()
+{
+    scheduler_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_scheduler_bench, a scheduler lookup/insert/switch benchmark);
+#else
+int rt_application_init()
+{
+    scheduler_bench_init();
+
+    return 0;
+}
+#endif
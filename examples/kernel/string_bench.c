@@ -0,0 +1,152 @@
+/*
+ * This is a benchmark of the memory and string routines.
+ *
+ * It measures the cycles of rt_memcpy(), rt_memset(), rt_memcmp() of equal
+ * blocks and rt_strlen() on the sizes from 16 to 4096 bytes, with aligned
+ * buffers and with the source one byte off, and the cycles of a bytewise
+ * loop as the reference. With RT_USING_CPU_MEMCPY, the copy and set of large
+ * blocks are done by the vector routines of CPU port. With the libc of
+ * toolchain (RT_USING_LIBC), memcpy(), memcmp() and strlen() are measured as
+ * well to compare with.
+ */
+#include <rtthread.h>
+#include <rthw.h>
+#include "tc_comm.h"
+
+#ifdef RT_USING_LIBC
+#include <string.h>
+
+/* the library is called through pointers, which keeps compiler from folding it */
+static void *(*volatile libc_memcpy)(void *dst, const void *src, size_t size) = memcpy;
+static int (*volatile libc_memcmp)(const void *a, const void *b, size_t size) = memcmp;
+static size_t (*volatile libc_strlen)(const char *str) = strlen;
+#endif
+
+#define STRING_BENCH_MAX        4096
+#define STRING_BENCH_ROUND      100
+
+ALIGN(RT_ALIGN_SIZE)
+static rt_uint8_t bench_src[STRING_BENCH_MAX + 16];
+ALIGN(RT_ALIGN_SIZE)
+static rt_uint8_t bench_dst[STRING_BENCH_MAX + 16];
+static const rt_uint32_t bench_sizes[] = {16, 64, 256, 1024, STRING_BENCH_MAX};
+
+/* the bytewise reference, volatile keeps compiler from using library */
+static void bench_byte_copy(rt_uint8_t *dst, const rt_uint8_t *src, rt_uint32_t size)
+{
+    volatile rt_uint8_t *d = dst;
+
+    while (size--)
+        *d++ = *src++;
+}
+
+static void string_bench_run(rt_uint32_t size, rt_uint32_t offset)
+{
+    int index;
+    rt_uint32_t cycle, byte, copy, set, cmp, len;
+    rt_uint8_t *src = bench_src + offset;
+
+    /* a string of size bytes in source */
+    rt_memset(bench_src, 'a', sizeof(bench_src));
+    src[size - 1] = '\0';
+    rt_memcpy(bench_dst, src, size);
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < STRING_BENCH_ROUND; index ++)
+        bench_byte_copy(bench_dst, src, size);
+    byte = (tc_cycle_get() - cycle) / STRING_BENCH_ROUND;
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < STRING_BENCH_ROUND; index ++)
+        rt_memcpy(bench_dst, src, size);
+    copy = (tc_cycle_get() - cycle) / STRING_BENCH_ROUND;
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < STRING_BENCH_ROUND; index ++)
+        rt_memset(bench_dst, index, size);
+    set = (tc_cycle_get() - cycle) / STRING_BENCH_ROUND;
+
+    rt_memcpy(bench_dst, src, size);
+    cycle = tc_cycle_get();
+    for (index = 0; index < STRING_BENCH_ROUND; index ++)
+    {
+        if (rt_memcmp(bench_dst, src, size) != 0)
+            break;
+    }
+    cmp = (tc_cycle_get() - cycle) / STRING_BENCH_ROUND;
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < STRING_BENCH_ROUND; index ++)
+    {
+        if (rt_strlen((const char *)src) != size - 1)
+            break;
+    }
+    len = (tc_cycle_get() - cycle) / STRING_BENCH_ROUND;
+
+    rt_kprintf("%4d bytes, src offset %d: bytewise %d, memcpy %d, memset %d, "
+               "memcmp %d, strlen %d\n", size, offset, byte, copy, set, cmp, len);
+
+#ifdef RT_USING_LIBC
+    cycle = tc_cycle_get();
+    for (index = 0; index < STRING_BENCH_ROUND; index ++)
+        libc_memcpy(bench_dst, src, size);
+    copy = (tc_cycle_get() - cycle) / STRING_BENCH_ROUND;
+
+    rt_memcpy(bench_dst, src, size);
+    cycle = tc_cycle_get();
+    for (index = 0; index < STRING_BENCH_ROUND; index ++)
+    {
+        if (libc_memcmp(bench_dst, src, size) != 0)
+            break;
+    }
+    cmp = (tc_cycle_get() - cycle) / STRING_BENCH_ROUND;
+
+    cycle = tc_cycle_get();
+    for (index = 0; index < STRING_BENCH_ROUND; index ++)
+    {
+        if (libc_strlen((const char *)src) != size - 1)
+            break;
+    }
+    len = (tc_cycle_get() - cycle) / STRING_BENCH_ROUND;
+
+    rt_kprintf("%4d bytes, src offset %d: libc memcpy %d, memcmp %d, strlen %d\n",
+               size, offset, copy, cmp, len);
+#endif
+}
+
+static void string_bench_init(void)
+{
+    int index;
+
+#ifdef RT_USING_CPU_MEMCPY
+    rt_kprintf("string bench: %d bytes word, cpu memcpy from %d bytes\n",
+               sizeof(rt_ubase_t), RT_HW_MEMCPY_THRESHOLD);
+#else
+    rt_kprintf("string bench: %d bytes word\n", sizeof(rt_ubase_t));
+#endif
+
+    for (index = 0; index < sizeof(bench_sizes) / sizeof(bench_sizes[0]); index ++)
+    {
+        string_bench_run(bench_sizes[index], 0);
+        string_bench_run(bench_sizes[index], 1);
+    }
+
+    tc_done(TC_STAT_PASSED);
+}
+
+#ifdef RT_USING_TC
+int _tc_string_bench()
+{
+    string_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_string_bench, a memory and string routines benchmark);
+#else
+int rt_application_init()
+{
+    string_bench_init();
+
+    return 0;
+}
+#endif
@@ -0,0 +1,247 @@
+/*
+ * This is the correctness test of the memory and string routines.
+ *
+ * It sweeps the sizes, the source and destination alignments of rt_memcpy(),
+ * rt_memset(), rt_memmove(), rt_memcmp() and rt_strlen(), then runs random
+ * cases of larger sizes. The result is checked against a bytewise reference,
+ * and the guard bytes around the destination shall not be changed. With the
+ * libc of toolchain (RT_USING_LIBC), the results of rt_memcpy(), rt_memcmp()
+ * and rt_strlen() shall be the same as memcpy(), memcmp() and strlen().
+ */
+#include <rtthread.h>
+#include "tc_comm.h"
+
+#ifdef RT_USING_LIBC
+#include <string.h>
+#endif
+
+#define FUZZ_GUARD              32
+#define FUZZ_SWEEP_SIZE         160
+#define FUZZ_ALIGN              16
+#define FUZZ_SIZE_MAX           1024
+#define FUZZ_RANDOM_ROUND       2000
+#define FUZZ_BUFFER_SIZE        (FUZZ_SIZE_MAX + FUZZ_ALIGN + FUZZ_GUARD * 2)
+
+ALIGN(RT_ALIGN_SIZE)
+static rt_uint8_t fuzz_src[FUZZ_BUFFER_SIZE];
+ALIGN(RT_ALIGN_SIZE)
+static rt_uint8_t fuzz_dst[FUZZ_BUFFER_SIZE];
+ALIGN(RT_ALIGN_SIZE)
+static rt_uint8_t fuzz_ref[FUZZ_BUFFER_SIZE];
+static rt_uint32_t fuzz_seed;
+static rt_uint32_t errors;
+
+static rt_uint32_t fuzz_random(void)
+{
+    fuzz_seed = fuzz_seed * 1103515245 + 12345;
+    return fuzz_seed >> 8;
+}
+
+static void fuzz_fill(rt_uint8_t *buffer, rt_uint32_t size)
+{
+    rt_uint32_t index;
+
+    for (index = 0; index < size; index ++)
+        buffer[index] = (rt_uint8_t)fuzz_random();
+}
+
+/* the reference routines, volatile keeps compiler from using library */
+static void fuzz_ref_copy(rt_uint8_t *dst, const rt_uint8_t *src, rt_uint32_t size)
+{
+    volatile rt_uint8_t *d = dst;
+
+    while (size--)
+        *d++ = *src++;
+}
+
+static int fuzz_ref_equal(const rt_uint8_t *a, const rt_uint8_t *b, rt_uint32_t size)
+{
+    while (size--)
+    {
+        if (*a++ != *b++)
+            return 0;
+    }
+
+    return 1;
+}
+
+static int fuzz_sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+static void fuzz_check(const char *name, rt_uint32_t size, rt_uint32_t dst_align,
+                       rt_uint32_t src_align)
+{
+    if (fuzz_ref_equal(fuzz_dst, fuzz_ref, FUZZ_BUFFER_SIZE))
+        return;
+
+    /* report the first few errors only */
+    if (errors ++ < 8)
+        rt_kprintf("%s: size %d, dst align %d, src align %d failed\n",
+                   name, size, dst_align, src_align);
+}
+
+static void fuzz_memcpy(rt_uint32_t size, rt_uint32_t dst_align, rt_uint32_t src_align)
+{
+    rt_uint8_t *src = fuzz_src + FUZZ_GUARD + src_align;
+    rt_uint8_t *dst = fuzz_dst + FUZZ_GUARD + dst_align;
+
+    fuzz_fill(fuzz_src, FUZZ_BUFFER_SIZE);
+    fuzz_fill(fuzz_dst, FUZZ_BUFFER_SIZE);
+    fuzz_ref_copy(fuzz_ref, fuzz_dst, FUZZ_BUFFER_SIZE);
+    fuzz_ref_copy(fuzz_ref + FUZZ_GUARD + dst_align, src, size);
+
+    if (rt_memcpy(dst, src, size) != dst)
+        errors ++;
+    fuzz_check("memcpy", size, dst_align, src_align);
+
+#ifdef RT_USING_LIBC
+    memcpy(fuzz_ref + FUZZ_GUARD + dst_align, src, size);
+    fuzz_check("libc memcpy", size, dst_align, src_align);
+#endif
+}
+
+static void fuzz_memset(rt_uint32_t size, rt_uint32_t dst_align)
+{
+    rt_uint32_t index;
+    int c = (int)fuzz_random();
+    rt_uint8_t *dst = fuzz_dst + FUZZ_GUARD + dst_align;
+
+    fuzz_fill(fuzz_dst, FUZZ_BUFFER_SIZE);
+    fuzz_ref_copy(fuzz_ref, fuzz_dst, FUZZ_BUFFER_SIZE);
+    for (index = 0; index < size; index ++)
+        fuzz_ref[FUZZ_GUARD + dst_align + index] = (rt_uint8_t)c;
+
+    if (rt_memset(dst, c, size) != dst)
+        errors ++;
+    fuzz_check("memset", size, dst_align, 0);
+}
+
+/* move inside the destination buffer, the offset is in [-FUZZ_ALIGN, FUZZ_ALIGN] */
+static void fuzz_memmove(rt_uint32_t size, rt_uint32_t dst_align, int offset)
+{
+    rt_uint8_t *dst = fuzz_dst + FUZZ_GUARD + dst_align;
+
+    fuzz_fill(fuzz_dst, FUZZ_BUFFER_SIZE);
+    fuzz_ref_copy(fuzz_ref, fuzz_dst, FUZZ_BUFFER_SIZE);
+    /* the reference copies through the source buffer */
+    fuzz_ref_copy(fuzz_src, dst + offset, size);
+    fuzz_ref_copy(fuzz_ref + FUZZ_GUARD + dst_align, fuzz_src, size);
+
+    if (rt_memmove(dst, dst + offset, size) != dst)
+        errors ++;
+    fuzz_check("memmove", size, dst_align, dst_align + offset);
+}
+
+static void fuzz_memcmp(rt_uint32_t size, rt_uint32_t dst_align, rt_uint32_t src_align)
+{
+    int result, expect = 0;
+    rt_uint32_t diff;
+    rt_uint8_t *src = fuzz_src + FUZZ_GUARD + src_align;
+    rt_uint8_t *dst = fuzz_dst + FUZZ_GUARD + dst_align;
+
+    fuzz_fill(fuzz_src, FUZZ_BUFFER_SIZE);
+    fuzz_ref_copy(dst, src, size);
+
+    /* change one byte, or keep them equal */
+    diff = fuzz_random() % (size + 1);
+    if (diff < size)
+    {
+        dst[diff] = (rt_uint8_t)fuzz_random();
+        expect = fuzz_sign(dst[diff] - src[diff]);
+    }
+
+    result = rt_memcmp(dst, src, size);
+    if (fuzz_sign(result) != expect && errors ++ < 8)
+        rt_kprintf("memcmp: size %d, dst align %d, src align %d failed\n",
+                   size, dst_align, src_align);
+
+#ifdef RT_USING_LIBC
+    if (fuzz_sign(result) != fuzz_sign(memcmp(dst, src, size)) && errors ++ < 8)
+        rt_kprintf("libc memcmp: size %d, dst align %d, src align %d failed\n",
+                   size, dst_align, src_align);
+#endif
+}
+
+static void fuzz_strlen(rt_uint32_t size, rt_uint32_t align)
+{
+    rt_uint32_t index;
+    char *str = (char *)fuzz_src + FUZZ_GUARD + align;
+
+    /* no null character before size, and the bytes after it are not null */
+    for (index = 0; index < size + FUZZ_GUARD; index ++)
+        str[index] = (char)(fuzz_random() % 255 + 1);
+    str[size] = '\0';
+
+    if (rt_strlen(str) != size && errors ++ < 8)
+        rt_kprintf("strlen: size %d, align %d failed\n", size, align);
+
+#ifdef RT_USING_LIBC
+    if (rt_strlen(str) != strlen(str) && errors ++ < 8)
+        rt_kprintf("libc strlen: size %d, align %d failed\n", size, align);
+#endif
+}
+
+static void string_fuzz_init(void)
+{
+    rt_uint32_t size, dst_align, src_align, round;
+    int offset;
+
+    errors = 0;
+    fuzz_seed = 1;
+
+    /* sweep the small sizes and all alignments */
+    for (size = 0; size < FUZZ_SWEEP_SIZE; size ++)
+    {
+        for (dst_align = 0; dst_align < FUZZ_ALIGN; dst_align ++)
+        {
+            for (src_align = 0; src_align < FUZZ_ALIGN; src_align ++)
+            {
+                fuzz_memcpy(size, dst_align, src_align);
+                fuzz_memcmp(size, dst_align, src_align);
+            }
+
+            for (offset = -FUZZ_ALIGN; offset <= FUZZ_ALIGN; offset ++)
+                fuzz_memmove(size, dst_align, offset);
+
+            fuzz_memset(size, dst_align);
+            fuzz_strlen(size, dst_align);
+        }
+    }
+
+    /* the random sizes and alignments up to FUZZ_SIZE_MAX */
+    for (round = 0; round < FUZZ_RANDOM_ROUND; round ++)
+    {
+        size = fuzz_random() % (FUZZ_SIZE_MAX + 1);
+        dst_align = fuzz_random() % FUZZ_ALIGN;
+        src_align = fuzz_random() % FUZZ_ALIGN;
+        offset = (int)(fuzz_random() % (FUZZ_ALIGN * 2 + 1)) - FUZZ_ALIGN;
+
+        fuzz_memcpy(size, dst_align, src_align);
+        fuzz_memcmp(size, dst_align, src_align);
+        fuzz_memmove(size, dst_align, offset);
+        fuzz_memset(size, dst_align);
+        fuzz_strlen(size, dst_align);
+    }
+
+    rt_kprintf("string fuzz: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_string_fuzz()
+{
+    string_fuzz_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_string_fuzz, a memory and string routines fuzz test);
+#else
+int rt_application_init()
+{
+    string_fuzz_init();
+
+    return 0;
+}
+#endif
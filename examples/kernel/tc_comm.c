@@ -133,6 +133,17 @@ void tc_cleanup(void (*cleanup)())
     _tc_cleanup = cleanup;
 }
 
+/*
+ * The time stamp used by the benchmark testcases, all of the cycles they
+ * report are measured by it. It's the cycle counter of CPU port, which falls
+ * back to the OS tick if the port doesn't provide one. The BSP could override
+ * this function with another high resolution counter.
+ */
+WEAK rt_uint32_t tc_cycle_get(void)
+{
+    return rt_hw_cycle_get();
+}
+
 void tc_start(const char* tc_prefix)
 {
     rt_err_t result;
@@ -6,6 +6,7 @@
  *
  */
 #include <rtthread.h>
+#include <rthw.h>
 #ifdef RT_USING_FINSH
 #include <finsh.h>
 #endif
@@ -31,12 +32,14 @@ void tc_stop(void);
 void tc_done(rt_uint8_t state);
 void tc_stat(rt_uint8_t state);
 void tc_cleanup(void (*cleanup)(void));
+rt_uint32_t tc_cycle_get(void);
 #else
 #define tc_start(x)
 #define tc_stop()
 #define tc_done(s)
 #define tc_stat(s)
 #define tc_cleanup(c)
+#define tc_cycle_get()  rt_hw_cycle_get()
 #endif
 
 #endif
@@ -0,0 +1,298 @@
+/*
+ * This is the test of SMP scheduler.
+ *
+ * - parallel: RT_CPUS_NR threads shall run on all CPUs at the same time.
+ * - affinity: the bound thread shall only run on its cpu, and the running
+ *   thread shall be migrated when it's bound to other cpu.
+ * - stealing: the threads queued on a busy cpu shall be stolen by the CPUs
+ *   going to idle.
+ * - exclusion: the mutex, semaphore and critical section shall keep mutual
+ *   exclusion between CPUs.
+ */
+#include <rtthread.h>
+#include <rthw.h>
+#include "tc_comm.h"
+
+#ifdef RT_USING_SMP
+
+#define SMP_TEST_TIMEOUT        (RT_TICK_PER_SECOND * 5)
+#define SMP_TEST_LOOP           10000
+
+static struct rt_semaphore done;
+static volatile rt_uint32_t arrived, cpu_mask, errors;
+static volatile rt_uint32_t release;
+static volatile rt_uint32_t counter;
+static struct rt_mutex lock;
+
+static int smp_cpu_id(void)
+{
+    rt_base_t level;
+    int cpu;
+
+    level = rt_hw_local_irq_disable();
+    cpu = rt_hw_cpu_id();
+    rt_hw_local_irq_enable(level);
+
+    return cpu;
+}
+
+static rt_thread_t smp_thread_create(void (*entry)(void *), void *parameter,
+                                     rt_uint8_t priority, int cpu)
+{
+    rt_thread_t tid;
+    rt_uint8_t bind_cpu = cpu;
+
+    tid = rt_thread_create("smp", entry, parameter, THREAD_STACK_SIZE,
+                           priority, THREAD_TIMESLICE);
+    if (tid == RT_NULL)
+        return RT_NULL;
+
+    if (cpu != RT_CPUS_NR)
+        rt_thread_control(tid, RT_THREAD_CTRL_BIND_CPU, &bind_cpu);
+    rt_thread_startup(tid);
+
+    return tid;
+}
+
+/* wait for the count of threads finished */
+static rt_err_t smp_wait(rt_uint32_t count)
+{
+    while (count --)
+    {
+        if (rt_sem_take(&done, SMP_TEST_TIMEOUT) != RT_EOK)
+            return -RT_ETIMEOUT;
+    }
+
+    return RT_EOK;
+}
+
+/* spin until all of threads arrived, then record the cpu */
+static void smp_barrier_entry(void *parameter)
+{
+    rt_base_t level;
+    rt_tick_t tick;
+    rt_uint32_t count = (rt_uint32_t)(rt_ubase_t)parameter;
+
+    level = rt_hw_interrupt_disable();
+    arrived ++;
+    rt_hw_interrupt_enable(level);
+
+    tick = rt_tick_get();
+    while (arrived < count && rt_tick_get() - tick < SMP_TEST_TIMEOUT);
+
+    level = rt_hw_interrupt_disable();
+    cpu_mask |= 1 << rt_hw_cpu_id();
+    rt_hw_interrupt_enable(level);
+
+    rt_sem_release(&done);
+}
+
+static int smp_test_parallel(void)
+{
+    int index;
+
+    arrived = cpu_mask = 0;
+    for (index = 0; index < RT_CPUS_NR; index ++)
+        smp_thread_create(smp_barrier_entry, (void *)RT_CPUS_NR,
+                          THREAD_PRIORITY, RT_CPUS_NR);
+
+    if (smp_wait(RT_CPUS_NR) != RT_EOK || cpu_mask != RT_CPU_MASK)
+    {
+        rt_kprintf("parallel: failed, cpu mask 0x%x\n", cpu_mask);
+        return -1;
+    }
+
+    rt_kprintf("parallel: %d threads run on cpu mask 0x%x\n", RT_CPUS_NR, cpu_mask);
+    return 0;
+}
+
+static void smp_affinity_entry(void *parameter)
+{
+    int index;
+    rt_uint8_t cpu = (rt_uint8_t)(rt_ubase_t)parameter;
+
+    for (index = 0; index < 100; index ++)
+    {
+        if (smp_cpu_id() != cpu)
+            errors ++;
+
+        if (index % 10 == 0)
+            rt_thread_delay(1);
+        else
+            rt_thread_yield();
+
+        if (index == 50)
+        {
+            /* migrate itself to next cpu */
+            cpu = (cpu + 1) % RT_CPUS_NR;
+            rt_thread_control(rt_thread_self(), RT_THREAD_CTRL_BIND_CPU, &cpu);
+        }
+    }
+
+    rt_sem_release(&done);
+}
+
+static int smp_test_affinity(void)
+{
+    int cpu;
+
+    errors = 0;
+    for (cpu = 0; cpu < RT_CPUS_NR; cpu ++)
+        smp_thread_create(smp_affinity_entry, (void *)(rt_ubase_t)cpu,
+                          THREAD_PRIORITY, cpu);
+
+    if (smp_wait(RT_CPUS_NR) != RT_EOK || errors != 0)
+    {
+        rt_kprintf("affinity: failed, %d errors\n", errors);
+        return -1;
+    }
+
+    rt_kprintf("affinity: passed\n");
+    return 0;
+}
+
+static void smp_blocker_entry(void *parameter)
+{
+    rt_base_t level;
+    rt_tick_t tick;
+
+    level = rt_hw_interrupt_disable();
+    arrived ++;
+    rt_hw_interrupt_enable(level);
+
+    /* keep the cpu busy */
+    tick = rt_tick_get();
+    while (release == 0 && rt_tick_get() - tick < SMP_TEST_TIMEOUT);
+}
+
+static int smp_test_stealing(void)
+{
+    int cpu, self;
+    rt_tick_t tick;
+
+    /* occupy the other CPUs by the higher priority threads */
+    self = smp_cpu_id();
+    rt_thread_control(rt_thread_self(), RT_THREAD_CTRL_BIND_CPU, &self);
+
+    arrived = release = 0;
+    for (cpu = 0; cpu < RT_CPUS_NR; cpu ++)
+    {
+        if (cpu != self)
+            smp_thread_create(smp_blocker_entry, RT_NULL, THREAD_PRIORITY - 1, cpu);
+    }
+    tick = rt_tick_get();
+    while (arrived < RT_CPUS_NR - 1 && rt_tick_get() - tick < SMP_TEST_TIMEOUT)
+        rt_thread_delay(1);
+
+    /* all of the workers are queued on this cpu */
+    arrived = cpu_mask = 0;
+    for (cpu = 0; cpu < RT_CPUS_NR; cpu ++)
+        smp_thread_create(smp_barrier_entry, (void *)RT_CPUS_NR,
+                          THREAD_PRIORITY, RT_CPUS_NR);
+
+    /* the CPUs going to idle shall steal the workers */
+    release = 1;
+
+    cpu = RT_CPUS_NR;
+    rt_thread_control(rt_thread_self(), RT_THREAD_CTRL_BIND_CPU, &cpu);
+
+    if (smp_wait(RT_CPUS_NR) != RT_EOK || cpu_mask != RT_CPU_MASK)
+    {
+        rt_kprintf("stealing: failed, cpu mask 0x%x\n", cpu_mask);
+        return -1;
+    }
+
+    rt_kprintf("stealing: workers run on cpu mask 0x%x\n", cpu_mask);
+    return 0;
+}
+
+static void smp_exclusion_entry(void *parameter)
+{
+    int index;
+    rt_uint32_t value;
+
+    for (index = 0; index < SMP_TEST_LOOP; index ++)
+    {
+        if ((rt_ubase_t)parameter)
+        {
+            rt_mutex_take(&lock, RT_WAITING_FOREVER);
+            value = counter;
+            counter = value + 1;
+            rt_mutex_release(&lock);
+        }
+        else
+        {
+            rt_enter_critical();
+            value = counter;
+            counter = value + 1;
+            rt_exit_critical();
+        }
+    }
+
+    rt_sem_release(&done);
+}
+
+static int smp_test_exclusion(void)
+{
+    int index;
+    rt_uint32_t count = RT_CPUS_NR * 2;
+
+    counter = 0;
+    rt_mutex_init(&lock, "smp", RT_IPC_FLAG_FIFO);
+    for (index = 0; index < count; index ++)
+        smp_thread_create(smp_exclusion_entry, (void *)(rt_ubase_t)(index & 0x01),
+                          THREAD_PRIORITY, RT_CPUS_NR);
+
+    if (smp_wait(count) != RT_EOK || counter != count * SMP_TEST_LOOP)
+    {
+        rt_kprintf("exclusion: failed, counter %d, expect %d\n",
+                   counter, count * SMP_TEST_LOOP);
+        rt_mutex_detach(&lock);
+        return -1;
+    }
+
+    rt_mutex_detach(&lock);
+    rt_kprintf("exclusion: %d threads counted %d\n", count, counter);
+    return 0;
+}
+
+static void smp_test_init(void)
+{
+    int result = 0;
+
+    rt_sem_init(&done, "smp", 0, RT_IPC_FLAG_FIFO);
+
+    if (smp_test_parallel() != 0)
+        result = -1;
+    if (smp_test_affinity() != 0)
+        result = -1;
+    if (smp_test_stealing() != 0)
+        result = -1;
+    if (smp_test_exclusion() != 0)
+        result = -1;
+
+    /* let the idle threads clean up the exited threads */
+    rt_thread_delay(RT_TICK_PER_SECOND / 10);
+    rt_sem_detach(&done);
+
+    rt_kprintf("smp test %s on %d CPUs\n", result == 0 ? "passed" : "failed", RT_CPUS_NR);
+    tc_done(result == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_thread_smp()
+{
+    smp_test_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_thread_smp, a SMP scheduler test);
+#else
+int rt_application_init()
+{
+    smp_test_init();
+
+    return 0;
+}
+#endif
+#endif
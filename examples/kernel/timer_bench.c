@@ -0,0 +1,178 @@
+/*
+ * This is a benchmark for the timer management.
+ *
+ * It arms 10, 100 and 1000 timers, then measures the worst-case time of
+ * rt_timer_start/rt_timer_stop on the armed timers and the time of the tick
+ * interrupt which expires a batch of timers, rt_timer_check() runs in it with
+ * interrupt disabled. These are the interrupt-off sections of the timer
+ * management. The tick interrupt is measured by the interrupt hooks, which
+ * needs RT_USING_HOOK. Build it with and without RT_USING_TIMER_WHEEL to
+ * compare the skip list and the timing wheel backend.
+ */
+#include <rtthread.h>
+#include <rthw.h>
+#include "tc_comm.h"
+
+#define TIMER_BENCH_ROUND       64
+#define TIMER_BENCH_BATCH       10
+#define TIMER_BENCH_TIMEOUT     (RT_TICK_PER_SECOND * 60)
+
+static const rt_uint32_t bench_count[] = {10, 100, 1000};
+
+static struct rt_timer probe;
+
+#ifdef RT_USING_SMP
+#define TIMER_BENCH_CPUS        RT_CPUS_NR
+#define TIMER_BENCH_CPU_ID()    rt_hw_cpu_id()
+#else
+#define TIMER_BENCH_CPUS        1
+#define TIMER_BENCH_CPU_ID()    0
+#endif
+
+static volatile rt_uint32_t expire_count, expire_batch, expire_cpu, expire_irq;
+static rt_uint32_t irq_enter_cycle[TIMER_BENCH_CPUS];
+
+static void timer_bench_timeout(void *parameter)
+{
+}
+
+static void timer_bench_expire(void *parameter)
+{
+    expire_cpu = TIMER_BENCH_CPU_ID();
+    expire_count ++;
+}
+
+#ifdef RT_USING_HOOK
+static void timer_bench_irq_enter(void)
+{
+    if (rt_interrupt_get_nest() == 1)
+        irq_enter_cycle[TIMER_BENCH_CPU_ID()] = tc_cycle_get();
+}
+
+/* the outermost interrupt in which the whole batch is expired */
+static void timer_bench_irq_leave(void)
+{
+    if (rt_interrupt_get_nest() == 0 && expire_irq == 0 &&
+        expire_count == expire_batch && expire_cpu == TIMER_BENCH_CPU_ID())
+        expire_irq = tc_cycle_get() - irq_enter_cycle[TIMER_BENCH_CPU_ID()];
+}
+#endif
+
+static rt_err_t timer_bench_run(rt_uint32_t count)
+{
+    rt_uint32_t index, round;
+    rt_uint32_t cycle, start_max, stop_max;
+    rt_tick_t tick;
+    struct rt_timer *timers;
+
+    timers = (struct rt_timer *)rt_malloc(sizeof(struct rt_timer) * count);
+    if (timers == RT_NULL)
+    {
+        rt_kprintf("no memory for %d timers\n", count);
+        return -RT_ENOMEM;
+    }
+
+    /* arm the timers, the longer timeout is armed later */
+    for (index = 0; index < count; index ++)
+    {
+        rt_timer_init(&timers[index], "bench", timer_bench_timeout, RT_NULL,
+                      TIMER_BENCH_TIMEOUT + index, RT_TIMER_FLAG_ONE_SHOT);
+        rt_timer_start(&timers[index]);
+    }
+
+    /* the probe timer has the longest timeout, which is the worst case of list */
+    rt_timer_init(&probe, "probe", timer_bench_timeout, RT_NULL,
+                  TIMER_BENCH_TIMEOUT + count, RT_TIMER_FLAG_ONE_SHOT);
+
+    start_max = stop_max = 0;
+    for (round = 0; round < TIMER_BENCH_ROUND; round ++)
+    {
+        rt_enter_critical();
+
+        cycle = tc_cycle_get();
+        rt_timer_start(&probe);
+        cycle = tc_cycle_get() - cycle;
+        if (cycle > start_max) start_max = cycle;
+
+        cycle = tc_cycle_get();
+        rt_timer_stop(&probe);
+        cycle = tc_cycle_get() - cycle;
+        if (cycle > stop_max) stop_max = cycle;
+
+        rt_exit_critical();
+    }
+    rt_timer_detach(&probe);
+
+    /* let a batch of timers expire in the same tick */
+    expire_count = 0;
+    expire_irq   = 0;
+    expire_batch = count < TIMER_BENCH_BATCH ? count : TIMER_BENCH_BATCH;
+    rt_enter_critical();
+    for (index = 0; index < TIMER_BENCH_BATCH && index < count; index ++)
+    {
+        rt_timer_stop(&timers[index]);
+        timers[index].timeout_func = timer_bench_expire;
+        tick = 2;
+        rt_timer_control(&timers[index], RT_TIMER_CTRL_SET_TIME, &tick);
+    }
+    for (index = 0; index < TIMER_BENCH_BATCH && index < count; index ++)
+        rt_timer_start(&timers[index]);
+    rt_exit_critical();
+    rt_thread_delay(4);
+
+    for (index = 0; index < count; index ++)
+        rt_timer_detach(&timers[index]);
+    rt_free(timers);
+
+    rt_kprintf("%4d timers: start %d, stop %d, expire %d timers in tick interrupt %d\n",
+               count, start_max, stop_max, expire_count, expire_irq);
+
+    return RT_EOK;
+}
+
+static void timer_bench_init(void)
+{
+    int index;
+    rt_uint8_t res = TC_STAT_PASSED;
+
+#ifdef RT_USING_TIMER_WHEEL
+    rt_kprintf("timer backend: timing wheel\n");
+#else
+    rt_kprintf("timer backend: skip list, level %d\n", RT_TIMER_SKIP_LIST_LEVEL);
+#endif
+
+#ifdef RT_USING_HOOK
+    rt_interrupt_enter_sethook(timer_bench_irq_enter);
+    rt_interrupt_leave_sethook(timer_bench_irq_leave);
+#endif
+
+    for (index = 0; index < sizeof(bench_count) / sizeof(bench_count[0]); index ++)
+    {
+        if (timer_bench_run(bench_count[index]) != RT_EOK)
+            res = TC_STAT_FAILED;
+    }
+
+#ifdef RT_USING_HOOK
+    rt_interrupt_enter_sethook(RT_NULL);
+    rt_interrupt_leave_sethook(RT_NULL);
+#endif
+
+    tc_done(res);
+}
+
+#ifdef RT_USING_TC
+int _tc_timer_bench()
+{
+    timer_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_timer_bench, a timer start/stop/expire benchmark);
+#else
+int rt_application_init()
+{
+    timer_bench_init();
+
+    return 0;
+}
+#endif
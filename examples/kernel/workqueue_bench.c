@@ -0,0 +1,322 @@
+/*
+ * This is the test of workqueue with a pool of workers.
+ *
+ * It checks the merging of works submitted while pending, the order of work
+ * priorities, the work submitted again while it's running, the order of
+ * delayed works, cancel, flush, the flush ended by the cancel of the pending
+ * work and the parallel run of workers. Then it shows the cycles of a work
+ * from submission to the end of its run, with one worker and with a pool of
+ * workers.
+ */
+#include <rtthread.h>
+#include <rthw.h>
+#include <rtdevice.h>
+#include "tc_comm.h"
+
+#if defined(RT_USING_DEVICE_IPC) && defined(RT_USING_HEAP)
+#define WORKQ_BENCH_WORKERS     4
+#define WORKQ_BENCH_PRIORITY    (THREAD_PRIORITY - 1)
+#define WORKQ_BENCH_WORKS       16
+#define WORKQ_BENCH_ROUND       1000
+#define WORKQ_BENCH_SLEEP       5
+
+static struct rt_semaphore gate_sem, done_sem;
+static rt_uint32_t errors;
+
+/* the order of runs */
+static char run_order[8];
+static volatile int run_count;
+
+/* the running works, and the most of them at the same time */
+static volatile int running, running_max;
+
+static void workq_gate_func(struct rt_work *work, void *work_data)
+{
+    /* hold the worker until the works are submitted */
+    rt_sem_take(&gate_sem, RT_WAITING_FOREVER);
+}
+
+static void workq_mark_func(struct rt_work *work, void *work_data)
+{
+    if (run_count < sizeof(run_order) - 1)
+        run_order[run_count] = (char)(rt_ubase_t)work_data;
+    run_count ++;
+    rt_sem_release(&done_sem);
+}
+
+static void workq_sleep_func(struct rt_work *work, void *work_data)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    running ++;
+    if (running > running_max)
+        running_max = running;
+    rt_hw_interrupt_enable(level);
+
+    rt_thread_delay(WORKQ_BENCH_SLEEP);
+
+    level = rt_hw_interrupt_disable();
+    running --;
+    run_count ++;
+    rt_hw_interrupt_enable(level);
+}
+
+/* it submits itself in the first run */
+static struct rt_workqueue *self_queue;
+static void workq_self_func(struct rt_work *work, void *work_data)
+{
+    workq_sleep_func(work, work_data);
+    if (run_count == 1)
+        rt_workqueue_dowork(self_queue, work);
+}
+
+static void workq_run_reset(void)
+{
+    rt_memset(run_order, 0, sizeof(run_order));
+    run_count   = 0;
+    running     = 0;
+    running_max = 0;
+    rt_sem_control(&done_sem, RT_IPC_CMD_RESET, 0);
+}
+
+/* the works submitted while the worker is held */
+static void workq_order_test(struct rt_workqueue *queue)
+{
+    int index;
+    struct rt_work gate, a, low, high;
+
+    workq_run_reset();
+    rt_work_init(&gate, workq_gate_func, RT_NULL);
+    rt_work_init(&a, workq_mark_func, (void *)'a');
+    rt_work_init(&low, workq_mark_func, (void *)'l');
+    rt_work_init(&high, workq_mark_func, (void *)'h');
+    rt_work_set_priority(&low, RT_WORK_PRIORITY_DEFAULT + 1);
+    rt_work_set_priority(&high, RT_WORK_PRIORITY_DEFAULT - 1);
+
+    rt_workqueue_dowork(queue, &gate);
+    rt_thread_delay(1);
+
+    /* merged to one run */
+    for (index = 0; index < 5; index ++)
+        rt_workqueue_dowork(queue, &a);
+    rt_workqueue_dowork(queue, &low);
+    rt_workqueue_dowork(queue, &high);
+
+    rt_sem_release(&gate_sem);
+    rt_workqueue_flush(queue);
+
+    if (rt_strcmp(run_order, "hal") != 0)
+        errors ++;
+    rt_kprintf("workqueue: order %s (expect hal)\n", run_order);
+}
+
+static void workq_delayed_test(struct rt_workqueue *queue)
+{
+    rt_tick_t tick;
+    struct rt_work d10, d30, d20;
+
+    workq_run_reset();
+    rt_work_init(&d10, workq_mark_func, (void *)'1');
+    rt_work_init(&d20, workq_mark_func, (void *)'2');
+    rt_work_init(&d30, workq_mark_func, (void *)'3');
+
+    tick = rt_tick_get();
+    rt_workqueue_submit_delayed(queue, &d30, 30);
+    rt_workqueue_submit_delayed(queue, &d10, 10);
+    rt_workqueue_submit_delayed(queue, &d20, 20);
+    /* the delayed one is not changed */
+    rt_workqueue_submit_delayed(queue, &d10, 40);
+
+    if (rt_sem_take(&done_sem, 100) != RT_EOK || rt_tick_get() - tick < 10)
+        errors ++;
+    /* canceled before its timeout */
+    if (rt_workqueue_cancel_work(queue, &d20) != RT_EOK)
+        errors ++;
+    if (rt_sem_take(&done_sem, 100) != RT_EOK || rt_tick_get() - tick < 30)
+        errors ++;
+    rt_thread_delay(20);
+
+    if (rt_strcmp(run_order, "13") != 0)
+        errors ++;
+    rt_kprintf("workqueue: delayed %s (expect 13)\n", run_order);
+}
+
+static void workq_pool_test(struct rt_workqueue *queue)
+{
+    int index;
+    rt_tick_t tick;
+    struct rt_work works[WORKQ_BENCH_WORKS];
+    struct rt_work self;
+
+    /* the works run in parallel on workers */
+    workq_run_reset();
+    tick = rt_tick_get();
+    for (index = 0; index < WORKQ_BENCH_WORKS; index ++)
+    {
+        rt_work_init(&works[index], workq_sleep_func, RT_NULL);
+        rt_workqueue_dowork(queue, &works[index]);
+    }
+    rt_workqueue_flush(queue);
+    tick = rt_tick_get() - tick;
+
+    if (run_count != WORKQ_BENCH_WORKS || running_max != WORKQ_BENCH_WORKERS ||
+        tick >= WORKQ_BENCH_WORKS * WORKQ_BENCH_SLEEP)
+        errors ++;
+    rt_kprintf("workqueue: %d works on %d workers in %d ticks, %d at most at once\n",
+               run_count, WORKQ_BENCH_WORKERS, tick, running_max);
+
+    /* submitted again while running, it runs again but not at the same time */
+    workq_run_reset();
+    self_queue = queue;
+    rt_work_init(&self, workq_self_func, RT_NULL);
+    rt_workqueue_dowork(queue, &self);
+    rt_workqueue_flush(queue);
+    if (run_count != 2 || running_max != 1)
+        errors ++;
+
+    /* wait for the running one */
+    workq_run_reset();
+    rt_workqueue_dowork(queue, &works[0]);
+    rt_thread_delay(1);
+    if (rt_workqueue_cancel_work(queue, &works[0]) != -RT_EBUSY)
+        errors ++;
+    rt_workqueue_cancel_work_sync(queue, &works[0]);
+    if (run_count != 1 || running != 0)
+        errors ++;
+}
+
+static void workq_flush_entry(void *parameter)
+{
+    rt_workqueue_flush((struct rt_workqueue *)parameter);
+    rt_sem_release(&done_sem);
+}
+
+/* the flush is done when the pending work is canceled before it runs */
+static void workq_cancel_flush_test(void)
+{
+    rt_uint8_t priority;
+    rt_thread_t tid;
+    struct rt_work work;
+    struct rt_workqueue *queue;
+
+    /* the worker is lower than the current thread, the flusher is higher */
+    priority = rt_thread_self()->current_priority;
+    queue = rt_workqueue_create("wcancel", THREAD_STACK_SIZE, priority + 1);
+    if (queue == RT_NULL)
+    {
+        errors ++;
+        return;
+    }
+
+    workq_run_reset();
+    rt_work_init(&work, workq_mark_func, (void *)'c');
+    rt_workqueue_dowork(queue, &work);
+
+    tid = rt_thread_create("wflush", workq_flush_entry, queue,
+                           THREAD_STACK_SIZE, priority - 1, THREAD_TIMESLICE);
+    if (tid == RT_NULL)
+        errors ++;
+    else
+    {
+        rt_thread_startup(tid);
+        rt_workqueue_cancel_work(queue, &work);
+        if (rt_sem_take(&done_sem, 100) != RT_EOK || run_count > 1)
+            errors ++;
+    }
+
+    rt_workqueue_destroy(queue);
+}
+
+/* the cycles from submission to the end of run */
+static void workq_latency_bench(struct rt_workqueue *queue, int workers)
+{
+    int index;
+    rt_uint32_t cycle, total = 0, max = 0;
+    struct rt_work work;
+
+    rt_work_init(&work, workq_mark_func, (void *)'x');
+    for (index = 0; index < WORKQ_BENCH_ROUND; index ++)
+    {
+        cycle = tc_cycle_get();
+        rt_workqueue_dowork(queue, &work);
+        rt_sem_take(&done_sem, RT_WAITING_FOREVER);
+        cycle = tc_cycle_get() - cycle;
+
+        total += cycle;
+        if (cycle > max)
+            max = cycle;
+    }
+    rt_workqueue_flush(queue);
+
+    rt_kprintf("workqueue: %d workers, submit to done %d/%d (avg/max)\n",
+               workers, total / WORKQ_BENCH_ROUND, max);
+}
+
+static void workqueue_bench_init(void)
+{
+    struct rt_workqueue *queue;
+
+    errors = 0;
+    rt_sem_init(&gate_sem, "wgate", 0, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&done_sem, "wdone", 0, RT_IPC_FLAG_FIFO);
+
+    queue = rt_workqueue_create("wbench", THREAD_STACK_SIZE, WORKQ_BENCH_PRIORITY);
+    if (queue == RT_NULL)
+    {
+        errors ++;
+        goto _exit;
+    }
+    workq_order_test(queue);
+    workq_delayed_test(queue);
+    workq_latency_bench(queue, 1);
+    rt_workqueue_destroy(queue);
+    workq_cancel_flush_test();
+
+    queue = rt_workqueue_create_pool("wbench", WORKQ_BENCH_WORKERS,
+                                     THREAD_STACK_SIZE, WORKQ_BENCH_PRIORITY);
+    if (queue == RT_NULL)
+    {
+        errors ++;
+        goto _exit;
+    }
+    workq_pool_test(queue);
+    workq_latency_bench(queue, WORKQ_BENCH_WORKERS);
+    rt_workqueue_destroy(queue);
+
+#ifdef RT_USING_SYSTEM_WORKQUEUE
+    {
+        struct rt_work work;
+
+        rt_work_init(&work, workq_mark_func, (void *)'s');
+        if (rt_work_submit(&work, 1) != RT_EOK ||
+            rt_sem_take(&done_sem, 100) != RT_EOK)
+            errors ++;
+    }
+#endif
+
+_exit:
+    rt_sem_detach(&gate_sem);
+    rt_sem_detach(&done_sem);
+
+    rt_kprintf("workqueue bench: %d errors\n", errors);
+    tc_done(errors == 0 ? TC_STAT_PASSED : TC_STAT_FAILED);
+}
+
+#ifdef RT_USING_TC
+int _tc_workqueue_bench()
+{
+    workqueue_bench_init();
+
+    return 0;
+}
+FINSH_FUNCTION_EXPORT(_tc_workqueue_bench, a workqueue test with a pool of workers);
+#else
+int rt_application_init()
+{
+    workqueue_bench_init();
+
+    return 0;
+}
+#endif
+#endif
@@ -0,0 +1,42 @@
+/*
+ * The application module with 5000 relocations of kernel symbols, for the
+ * load time benchmark of module (examples/kernel/module_symbol_bench.c).
+ *
+ * Each entry of the table is an absolute relocation of a kernel symbol, 100
+ * times of 50 symbols.
+ */
+#include <rtthread.h>
+
+#define RELOC_SYMBOLS(X)                                                    \
+    X(rt_malloc)        X(rt_free)          X(rt_realloc)       X(rt_calloc)        \
+    X(rt_kprintf)       X(rt_snprintf)      X(rt_sprintf)       X(rt_vsnprintf)     \
+    X(rt_memcpy)        X(rt_memset)        X(rt_memmove)       X(rt_memcmp)        \
+    X(rt_strcmp)        X(rt_strncmp)       X(rt_strlen)        X(rt_strncpy)       \
+    X(rt_strstr)        X(rt_strdup)        X(rt_tick_get)      X(rt_thread_self)   \
+    X(rt_thread_create) X(rt_thread_delete) X(rt_thread_startup) X(rt_thread_delay) \
+    X(rt_thread_yield)  X(rt_thread_find)   X(rt_thread_control) X(rt_sem_create)   \
+    X(rt_sem_delete)    X(rt_sem_take)      X(rt_sem_release)   X(rt_mutex_create)  \
+    X(rt_mutex_delete)  X(rt_mutex_take)    X(rt_mutex_release) X(rt_event_create)  \
+    X(rt_event_send)    X(rt_event_recv)    X(rt_mb_create)     X(rt_mb_send)       \
+    X(rt_mb_recv)       X(rt_mq_create)     X(rt_mq_send)       X(rt_mq_recv)       \
+    X(rt_timer_create)  X(rt_timer_start)   X(rt_timer_stop)    X(rt_timer_delete)  \
+    X(rt_get_errno)     X(rt_set_errno)
+
+#define RELOC_ENTRY(symbol)     (void *)symbol,
+#define RELOC_ROW               RELOC_SYMBOLS(RELOC_ENTRY)
+#define RELOC_ROW10             RELOC_ROW RELOC_ROW RELOC_ROW RELOC_ROW RELOC_ROW \
+                                RELOC_ROW RELOC_ROW RELOC_ROW RELOC_ROW RELOC_ROW
+
+static void * const reloc_table[] =
+{
+    RELOC_ROW10 RELOC_ROW10 RELOC_ROW10 RELOC_ROW10 RELOC_ROW10
+    RELOC_ROW10 RELOC_ROW10 RELOC_ROW10 RELOC_ROW10 RELOC_ROW10
+};
+
+int main(void)
+{
+    rt_kprintf("relocapp: %d relocations, the first one 0x%08x\n",
+               sizeof(reloc_table) / sizeof(reloc_table[0]), reloc_table[0]);
+
+    return 0;
+}
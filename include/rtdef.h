@@ -30,6 +30,16 @@
  * 2012-12-30     Bernard      add more control command for graphic.
  * 2013-01-09     Bernard      change version number.
  * 2015-02-01     Bernard      change version number to v2.1.0
+ * 2017-06-24     agent        add SMP cpu structure and thread cpu binding
+ * 2017-06-30     agent        add name hash index of kernel object
+ * 2017-07-03     agent        add cycle accounting of thread and cpu
+ * 2017-07-04     agent        add deferred interrupt source
+ * 2017-07-05     agent        add lock word of semaphore and mutex for the
+ *                             lock-free fast path
+ * 2017-07-06     agent        add deadline scheduling parameters of thread
+ * 2017-07-07     agent        add FPU context flag of thread for lazy FPU
+ * 2017-07-10     agent        add memory region of memory heap
+ * 2017-07-11     agent        add hash index of module symbol table
  */
 
 #ifndef __RT_DEF_H__
@@ -64,6 +74,8 @@ typedef signed   long                   rt_int32_t;     /**< 32bit integer type
 typedef unsigned char                   rt_uint8_t;     /**<  8bit unsigned integer type */
 typedef unsigned short                  rt_uint16_t;    /**< 16bit unsigned integer type */
 typedef unsigned long                   rt_uint32_t;    /**< 32bit unsigned integer type */
+typedef signed   long long              rt_int64_t;     /**< 64bit integer type */
+typedef unsigned long long              rt_uint64_t;    /**< 64bit unsigned integer type */
 typedef int                             rt_bool_t;      /**< boolean type */
 
 /* 32bit CPU */
@@ -306,6 +318,15 @@ typedef struct rt_list_node rt_list_t;                  /**< Type for lists. */
  */
 #define RT_OBJECT_FLAG_MODULE           0x80            /**< is module object. */
 
+#ifdef RT_USING_OBJECT_HASH
+#ifndef RT_OBJECT_HASH_SIZE
+#define RT_OBJECT_HASH_SIZE             16              /**< buckets of object name hash */
+#endif
+#if (RT_OBJECT_HASH_SIZE & (RT_OBJECT_HASH_SIZE - 1)) != 0
+#error "RT_OBJECT_HASH_SIZE must be a power of 2"
+#endif
+#endif
+
 /**
  * Base structure of Kernel object
  */
@@ -319,6 +340,11 @@ struct rt_object
     void      *module_id;                               /**< id of application module */
 #endif
     rt_list_t  list;                                    /**< list node of kernel object */
+
+#ifdef RT_USING_OBJECT_HASH
+    struct rt_object  *hash_next;                       /**< next object in name hash bucket */
+    struct rt_object **hash_pprev;                      /**< link to this object in bucket */
+#endif
 };
 typedef struct rt_object *rt_object_t;                  /**< Type for kernel objects. */
 
@@ -382,6 +408,9 @@ struct rt_object_information
     enum rt_object_class_type type;                     /**< object class type */
     rt_list_t                 object_list;              /**< object list */
     rt_size_t                 object_size;              /**< object size */
+#ifdef RT_USING_OBJECT_HASH
+    struct rt_object         *object_hash[RT_OBJECT_HASH_SIZE]; /**< object name hash buckets */
+#endif
 };
 
 /**
@@ -466,6 +495,13 @@ typedef struct rt_timer *rt_timer_t;
 #define RT_THREAD_BLOCK                 RT_THREAD_SUSPEND   /**< Blocked status */
 #define RT_THREAD_CLOSE                 0x04                /**< Closed status */
 
+#ifdef RT_USING_LAZY_FPU
+/*
+ * thread FPU flag definitions
+ */
+#define RT_THREAD_FPU_USED              0x01                /**< FPU context of thread is saved */
+#endif
+
 /**
  * thread control command definitions
  */
@@ -473,6 +509,57 @@ typedef struct rt_timer *rt_timer_t;
 #define RT_THREAD_CTRL_CLOSE            0x01                /**< Close thread. */
 #define RT_THREAD_CTRL_CHANGE_PRIORITY  0x02                /**< Change thread priority. */
 #define RT_THREAD_CTRL_INFO             0x03                /**< Get thread information. */
+#define RT_THREAD_CTRL_BIND_CPU         0x04                /**< Set thread bind cpu. */
+
+#ifdef RT_USING_SMP
+#define RT_CPU_DETACHED                 RT_CPUS_NR          /**< The thread not running on cpu. */
+#define RT_CPU_MASK                     ((1 << RT_CPUS_NR) - 1) /**< All CPUs mask bit. */
+
+#define RT_SCHEDULE_IPI                 0                   /**< The IPI to reschedule */
+#endif
+
+#ifdef RT_USING_DEADLINE
+#ifndef RT_DEADLINE_PRIORITY
+#define RT_DEADLINE_PRIORITY            (RT_THREAD_PRIORITY_MAX / 4)    /**< priority of deadline threads */
+#endif
+#ifndef RT_DEADLINE_UTILIZATION
+#define RT_DEADLINE_UTILIZATION         90                  /**< admission bound of each cpu, in percent */
+#endif
+
+/**
+ * flags of deadline thread
+ */
+#define RT_DEADLINE_FLAG_THROTTLED      0x01                /**< suspended for running out of budget */
+#define RT_DEADLINE_FLAG_WAITING        0x02                /**< suspended for the next period */
+
+/**
+ * Deadline scheduling parameters and statistics of thread. The job of thread
+ * is released in each period, it shall be done in the budget ticks before
+ * the relative deadline.
+ */
+struct rt_deadline
+{
+    rt_tick_t   period;                                     /**< period, 0 if not a deadline thread */
+    rt_tick_t   budget;                                     /**< execution budget in each period */
+    rt_tick_t   deadline;                                   /**< relative deadline */
+
+    rt_tick_t   abs_deadline;                               /**< deadline of the current job */
+    rt_tick_t   remaining;                                  /**< remaining budget of the current job */
+
+    rt_uint32_t released;                                   /**< number of released jobs */
+    rt_uint32_t completed;                                  /**< number of completed jobs */
+    rt_uint32_t misses;                                     /**< number of missed deadlines */
+    rt_uint32_t throttled;                                  /**< number of budget overruns */
+
+    rt_uint16_t density;                                    /**< budget / deadline, in permille */
+    rt_uint8_t  flag;                                       /**< flags of deadline thread */
+#ifdef RT_USING_SMP
+    rt_uint8_t  cpu;                                        /**< cpu of the admitted utilization */
+#endif
+
+    struct rt_timer timer;                                  /**< timer to release the jobs */
+};
+#endif
 
 /**
  * Thread structure
@@ -489,6 +576,12 @@ struct rt_thread
 #endif
 
     rt_list_t   list;                                   /**< the object list */
+
+#ifdef RT_USING_OBJECT_HASH
+    struct rt_object  *hash_next;                       /**< next object in name hash bucket */
+    struct rt_object **hash_pprev;                      /**< link to this object in bucket */
+#endif
+
     rt_list_t   tlist;                                  /**< the thread list */
 
     /* stack point and entry */
@@ -512,6 +605,13 @@ struct rt_thread
 #endif
     rt_uint32_t number_mask;
 
+#ifdef RT_USING_SMP
+    rt_uint8_t  bind_cpu;                               /**< thread is bind to cpu */
+    rt_uint8_t  oncpu;                                  /**< process on cpu */
+    rt_uint8_t  ready_cpu;                              /**< cpu of the ready queue */
+    rt_uint16_t cpus_lock_nest;                         /**< cpus lock count */
+#endif
+
 #if defined(RT_USING_EVENT)
     /* thread event */
     rt_uint32_t event_set;
@@ -525,11 +625,123 @@ struct rt_thread
 
     void (*cleanup)(struct rt_thread *tid);             /**< cleanup function when thread exit */
 
+#ifdef RT_USING_SLAB_CACHE
+    void       *heap_cache;                             /**< slab magazines of thread */
+#endif
+
+#ifdef RT_USING_CPU_USAGE
+    rt_uint64_t cycles;                                 /**< cycles running on cpu */
+#endif
+
+#ifdef RT_USING_MUTEX
+    struct rt_mutex *pending_mutex;                     /**< mutex the thread is waiting for */
+#endif
+
+#ifdef RT_USING_DEADLINE
+    struct rt_deadline deadline;                        /**< deadline scheduling of thread */
+#endif
+
+#ifdef RT_USING_LAZY_FPU
+    rt_uint8_t  fpu_flag;                               /**< FPU context flag of thread */
+#endif
+
     rt_uint32_t user_data;                              /**< private user data beyond this thread */
 };
 typedef struct rt_thread *rt_thread_t;
 
+#ifdef RT_USING_CPU_USAGE
+/**
+ * CPU usage of each CPU, in cycles of rt_hw_cycle_get()
+ */
+struct rt_cpu_usage
+{
+    rt_uint64_t total;                                  /**< cycles accounted */
+    rt_uint64_t irq;                                    /**< cycles in interrupt */
+    rt_uint64_t idle;                                   /**< cycles of idle thread */
+
+    rt_uint32_t last_cycle;                             /**< cycle of the last accounting */
+    rt_uint32_t irq_cycle;                              /**< cycle of entering interrupt */
+    struct rt_thread *idle_thread;                      /**< idle thread of cpu */
+};
+#endif
+
+#ifdef RT_USING_SMP
+/**
+ * CPU structure, the scheduling state of each CPU
+ */
+struct rt_cpu
+{
+    struct rt_thread *current_thread;                   /**< the running thread */
+    rt_uint8_t  irq_nest;                               /**< interrupt nest */
+    rt_uint8_t  irq_switch_flag;                        /**< switch thread on interrupt leave */
+    rt_uint8_t  current_priority;                       /**< priority of the running thread */
+    rt_int16_t  scheduler_lock_nest;                    /**< critical section nest */
+
+    /* ready queue of this cpu */
+    rt_list_t   priority_table[RT_THREAD_PRIORITY_MAX];
+    rt_uint32_t ready_priority_group;
+#if RT_THREAD_PRIORITY_MAX > 32
+    rt_uint8_t  ready_table[32];
+#endif
+
+#ifdef RT_USING_CPU_USAGE
+    struct rt_cpu_usage usage;                          /**< cpu usage accounting */
+#endif
+};
+#endif
+
+/*@}*/
+
+#ifdef RT_USING_IRQ_THREAD
+/**
+ * @addtogroup IRQThread
+ */
+
+/*@{*/
+
+#ifndef RT_IRQ_THREAD_NR
+#define RT_IRQ_THREAD_NR                2               /**< number of interrupt threads */
+#endif
+#ifndef RT_IRQ_THREAD_PRIORITY
+#define RT_IRQ_THREAD_PRIORITY          1               /**< priority of the highest interrupt thread */
+#endif
+#ifndef RT_IRQ_THREAD_STACK_SIZE
+#define RT_IRQ_THREAD_STACK_SIZE        1024            /**< stack size of interrupt thread */
+#endif
+
+/**
+ * flags of deferred interrupt source
+ */
+#define RT_IRQ_SOURCE_FLAG_ONESHOT      0x01            /**< mask the vector until bottom half done */
+
+/**
+ * Deferred interrupt source. The top half runs in interrupt and returns the
+ * events to be deferred, the events raised before the bottom half runs are
+ * merged, then the bottom half handles them in an interrupt thread.
+ */
+struct rt_irq_source
+{
+    rt_list_t   list;                                   /**< node in pending list */
+    const char *name;                                   /**< name of source */
+
+    rt_uint32_t (*top_half)(int vector, void *param);   /**< top half in interrupt */
+    void (*bottom_half)(rt_uint32_t events, void *param);   /**< bottom half in thread */
+    void       *param;                                  /**< parameter of handlers */
+
+    int         vector;                                 /**< interrupt vector, -1 if not installed */
+    rt_uint8_t  level;                                  /**< level of interrupt thread, 0 is highest */
+    rt_uint8_t  flag;                                   /**< flags of source */
+    rt_uint8_t  pending;                                /**< in pending list */
+    rt_uint8_t  reserved;
+
+    rt_uint32_t events;                                 /**< pending events */
+    rt_uint32_t raised;                                 /**< number of raising */
+    rt_uint32_t handled;                                /**< number of bottom half runs */
+};
+typedef struct rt_irq_source *rt_irq_source_t;
+
 /*@}*/
+#endif
 
 /**
  * @addtogroup IPC
@@ -567,9 +779,17 @@ struct rt_semaphore
 {
     struct rt_ipc_object parent;                        /**< inherit from ipc_object */
 
-    rt_uint16_t          value;                         /**< value of semaphore. */
+    volatile rt_uint32_t value;                         /**< value of semaphore and waiters flag */
 };
 typedef struct rt_semaphore *rt_sem_t;
+
+/*
+ * The value is changed by compare and swap without interrupt disabled if no
+ * thread is waiting, the waiters flag forces the take and release to the
+ * path with interrupt disabled.
+ */
+#define RT_SEM_WAITERS                  0x80000000      /**< threads are waiting on semaphore */
+#define RT_SEM_VALUE(sem)               ((sem)->value & ~RT_SEM_WAITERS)
 #endif
 
 #ifdef RT_USING_MUTEX
@@ -586,8 +806,18 @@ struct rt_mutex
     rt_uint8_t           hold;                          /**< numbers of thread hold the mutex */
 
     struct rt_thread    *owner;                         /**< current owner of mutex */
+
+    volatile rt_uint32_t lock;                          /**< owner thread and waiters flag */
 };
 typedef struct rt_mutex *rt_mutex_t;
+
+/*
+ * The lock word is the address of owner thread or zero, it's taken and
+ * released by compare and swap if no thread is waiting. The value, hold,
+ * original priority and owner are kept by the owner thread.
+ */
+#define RT_MUTEX_WAITERS                0x01            /**< threads are waiting on mutex */
+#define RT_MUTEX_PI_DEPTH               8               /**< max length of priority inheritance chain */
 #endif
 
 #ifdef RT_USING_EVENT
@@ -667,6 +897,37 @@ typedef struct rt_messagequeue *rt_mq_t;
  */
 
 #ifdef RT_USING_MEMHEAP
+#ifdef RT_USING_MEMHEAP_REGION
+/**
+ * memory region of memory heap, a heap belongs to one region
+ */
+#define RT_MEM_DEFAULT                  0               /**< system heap and the heaps not tagged */
+#define RT_MEM_FAST                     1               /**< fast memory, such as on-chip SRAM and DTCM */
+#define RT_MEM_LARGE                    2               /**< large memory, such as cacheable SDRAM */
+#define RT_MEM_DMA                      3               /**< non-cacheable memory for DMA */
+#define RT_MEM_REGION_NR                4
+
+#define RT_MEM_REGION_MASK              0x0F            /**< region in the flag of rt_malloc_region */
+#define RT_MEM_NOFALLBACK               0x80            /**< not fall back to the other regions */
+#define RT_MEM_NONE                     0xFF            /**< no fallback region */
+
+/**
+ * statistics of memory region
+ */
+struct rt_memory_region_info
+{
+    rt_uint32_t             total;                      /**< size of the heaps in region */
+    rt_uint32_t             used;                       /**< used size of the heaps in region */
+    rt_uint32_t             max_used;                   /**< sum of maximum used size of the heaps */
+
+    rt_uint32_t             alloc_count;                /**< allocations requested on region */
+    rt_uint32_t             fallback_count;             /**< allocations got from the fallback regions */
+    rt_uint32_t             fail_count;                 /**< allocations failed */
+
+    rt_uint8_t              fallback;                   /**< the fallback region */
+};
+#endif
+
 /**
  * memory item on the heap
  */
@@ -701,6 +962,10 @@ struct rt_memheap
     struct rt_memheap_item  free_header;                /**< free block list header */
 
     struct rt_semaphore     lock;                       /**< semaphore lock */
+
+#ifdef RT_USING_MEMHEAP_REGION
+    rt_uint8_t              region;                     /**< memory region of heap */
+#endif
 };
 #endif
 
@@ -725,6 +990,20 @@ struct rt_mempool
     rt_size_t        suspend_thread_count;              /**< numbers of thread pended on this resource */
 };
 typedef struct rt_mempool *rt_mp_t;
+
+/**
+ * lock-free memory pool structure, which is safe in interrupt
+ */
+struct rt_lfpool
+{
+    rt_uint8_t      *start_address;                     /**< memory pool start */
+
+    rt_size_t        block_size;                        /**< size of memory blocks */
+    rt_size_t        block_total_count;                 /**< numbers of memory block */
+
+    volatile rt_uint32_t head;                          /**< tag and index of the first free block */
+};
+typedef struct rt_lfpool *rt_lfpool_t;
 #endif
 
 /*@}*/
@@ -990,6 +1269,9 @@ struct rt_module
 
     rt_uint16_t                  nsym;                  /**< number of symbol in the module */
     struct rt_module_symtab     *symtab;                /**< module symbol table */
+#ifdef RT_USING_MODULE_SYMHASH
+    rt_uint16_t                 *symhash;               /**< hash index of symbol table */
+#endif
 
     /* object in this module, module object is the last basic object type */
     struct rt_object_information module_object[RT_Object_Class_Unknown];
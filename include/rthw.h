@@ -23,6 +23,15 @@
  * 2006-04-25     Bernard      add rt_hw_context_switch_interrupt declaration
  * 2006-09-24     Bernard      add rt_hw_context_switch_to declaration
  * 2012-12-29     Bernard      add rt_hw_exception_install declaration
+ * 2017-06-22     agent        add rt_hw_tickless_sleep declaration
+ * 2017-06-24     agent        add SMP interfaces
+ * 2017-06-25     agent        add rt_hw_ffs for the scheduler
+ * 2017-06-28     agent        add rt_hw_cas for the lock-free memory pool
+ * 2017-07-01     agent        add rt_hw_memcpy/rt_hw_memset hook of CPU port
+ * 2017-07-03     agent        add cycle counter interfaces
+ * 2017-07-07     agent        add lazy FPU interfaces
+ * 2017-07-09     agent        add rt_hw_dmb memory barrier
+ * 2017-07-18     agent        add rt_hw_cas with interrupt disabled
  */
 
 #ifndef __RT_HW_H__
@@ -51,6 +60,109 @@ rt_uint8_t *rt_hw_stack_init(void       *entry,
                              rt_uint8_t *stack_addr,
                              void       *exit);
 
+/*
+ * Find first set bit, it returns the index (beginning with 1) of the least
+ * significant bit set in value, or 0 if value is 0.
+ *
+ * The scheduler uses rt_hw_ffs to get the highest ready priority. It's the
+ * compiler builtin on GCC, which is BSF on x86 and RBIT/CLZ on ARMv7, and
+ * the inlined CLZ on ARM compilers when the CPU port has CLZ instruction
+ * (RT_USING_CPU_FFS). Otherwise it's the __rt_ffs of CPU port or the table
+ * lookup in kernel service.
+ */
+int __rt_ffs(int value);
+
+#if defined(__GNUC__)
+#define rt_hw_ffs(value)    __builtin_ffs(value)
+#elif defined(RT_USING_CPU_FFS) && defined(__CC_ARM)
+rt_inline int rt_hw_ffs(int value)
+{
+    /* the lowest bit set is isolated by value & -value */
+    return 32 - __clz((rt_uint32_t)value & (0 - (rt_uint32_t)value));
+}
+#elif defined(RT_USING_CPU_FFS) && defined(__ICCARM__)
+#include <intrinsics.h>
+rt_inline int rt_hw_ffs(int value)
+{
+    /* the lowest bit set is isolated by value & -value */
+    return 32 - __CLZ((rt_uint32_t)value & (0 - (rt_uint32_t)value));
+}
+#else
+#define rt_hw_ffs(value)    __rt_ffs(value)
+#endif
+
+/*
+ * Memory copy and set by the vector instructions of CPU port.
+ *
+ * With RT_USING_CPU_MEMCPY, rt_memcpy() and rt_memset() hand the blocks not
+ * less than RT_HW_MEMCPY_THRESHOLD bytes to rt_hw_memcpy() and rt_hw_memset()
+ * of CPU port, for example NEON on Cortex-A or SSE2 on the x86 simulator.
+ * They return RT_NULL when the vector unit can't be used, and the block is
+ * handled by the word routines of kernel service. The kernel doesn't save
+ * the vector registers on context switch or interrupt, so the port shall
+ * keep the registers it uses.
+ */
+#ifdef RT_USING_CPU_MEMCPY
+#ifndef RT_HW_MEMCPY_THRESHOLD
+#define RT_HW_MEMCPY_THRESHOLD  128
+#endif
+void *rt_hw_memcpy(void *dst, const void *src, rt_ubase_t count);
+void *rt_hw_memset(void *s, int c, rt_ubase_t count);
+#endif
+
+/*
+ * Compare and swap, it stores newval to *ptr if *ptr equals to oldval, and
+ * returns non-zero on success.
+ *
+ * RT_HW_USING_CAS is defined when the CPU has the atomic instructions: it's
+ * the compiler builtin on GCC, which is LDREX/STREX on ARMv6/ARMv7 and
+ * LOCK CMPXCHG on x86, the LDREX/STREX intrinsics on ARM compiler for
+ * Cortex-M3/M4/M7, or the rt_hw_cas of CPU port (RT_USING_CPU_CAS). When
+ * it is not defined, for example on Cortex-M0, rt_hw_cas is still provided
+ * with interrupt disabled after the interrupt interfaces.
+ */
+#if defined(__GNUC__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4)
+#define RT_HW_USING_CAS
+#define rt_hw_cas(ptr, oldval, newval) \
+    __sync_bool_compare_and_swap((ptr), (oldval), (newval))
+#elif defined(__CC_ARM) && (defined(__TARGET_ARCH_7_M) || defined(__TARGET_ARCH_7E_M))
+#define RT_HW_USING_CAS
+rt_inline int rt_hw_cas(volatile rt_uint32_t *ptr, rt_uint32_t oldval, rt_uint32_t newval)
+{
+    do
+    {
+        if (__ldrex(ptr) != oldval)
+        {
+            __clrex();
+            return 0;
+        }
+    } while (__strex(newval, ptr) != 0);
+
+    return 1;
+}
+#elif defined(RT_USING_CPU_CAS)
+#define RT_HW_USING_CAS
+int rt_hw_cas(volatile rt_uint32_t *ptr, rt_uint32_t oldval, rt_uint32_t newval);
+#endif
+
+/*
+ * Data memory barrier, the memory accesses before it are observed by the
+ * other CPUs and bus masters (DMA) before the ones after it. It's a compiler
+ * barrier as well. The lock-free users publish the data with it.
+ *
+ * It's DMB on ARMv7 and MFENCE on x86 by the compiler builtin on GCC.
+ */
+#if defined(__GNUC__)
+#define rt_hw_dmb()     __sync_synchronize()
+#elif defined(__CC_ARM)
+#define rt_hw_dmb()     __dmb(0xF)
+#elif defined(__ICCARM__)
+#include <intrinsics.h>
+#define rt_hw_dmb()     __DMB()
+#else
+void rt_hw_dmb(void);
+#endif
+
 /*
  * Interrupt handler definition
  */
@@ -78,15 +190,61 @@ rt_isr_handler_t rt_hw_interrupt_install(int              vector,
                                          void            *param,
                                          char            *name);
 
+#ifdef RT_USING_SMP
+/*
+ * On SMP, the interrupt disable of kernel is the local interrupt disable and
+ * the lock of kernel shared by all CPUs.
+ */
+rt_base_t rt_hw_local_irq_disable(void);
+void rt_hw_local_irq_enable(rt_base_t level);
+
+rt_base_t rt_cpus_lock(void);
+void rt_cpus_unlock(rt_base_t level);
+void rt_cpus_lock_status_restore(struct rt_thread *thread);
+
+#define rt_hw_interrupt_disable rt_cpus_lock
+#define rt_hw_interrupt_enable  rt_cpus_unlock
+#else
 rt_base_t rt_hw_interrupt_disable(void);
 void rt_hw_interrupt_enable(rt_base_t level);
+#endif
+
+#ifndef RT_HW_USING_CAS
+/* the CPU has no atomic instruction, the word is changed with interrupt disabled */
+rt_inline int rt_hw_cas(volatile rt_uint32_t *ptr, rt_uint32_t oldval, rt_uint32_t newval)
+{
+    int result = 0;
+    register rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (*ptr == oldval)
+    {
+        *ptr = newval;
+        result = 1;
+    }
+    rt_hw_interrupt_enable(level);
+
+    return result;
+}
+#endif
 
 /*
  * Context interfaces
  */
+#ifdef RT_USING_SMP
+/*
+ * The port shall invoke rt_cpus_lock_status_restore(to_thread) in the context
+ * of to_thread after switching, which passes the kernel lock to it.
+ */
+void rt_hw_context_switch(rt_uint32_t from, rt_uint32_t to, struct rt_thread *to_thread);
+void rt_hw_context_switch_to(rt_uint32_t to, struct rt_thread *to_thread);
+void rt_hw_context_switch_interrupt(void *context, rt_uint32_t from, rt_uint32_t to,
+                                    struct rt_thread *to_thread);
+#else
 void rt_hw_context_switch(rt_uint32_t from, rt_uint32_t to);
 void rt_hw_context_switch_to(rt_uint32_t to);
 void rt_hw_context_switch_interrupt(rt_uint32_t from, rt_uint32_t to);
+#endif
 
 void rt_hw_console_output(const char *str);
 
@@ -98,6 +256,64 @@ void rt_hw_show_memory(rt_uint32_t addr, rt_uint32_t size);
  */
 void rt_hw_exception_install(rt_err_t (*exception_handle)(void *context));
 
+#ifdef RT_USING_TICKLESS
+/*
+ * Tickless interfaces
+ */
+rt_tick_t rt_hw_tickless_sleep(rt_tick_t timeout);
+#endif
+
+/*
+ * Cycle counter interfaces, used by the cpu usage accounting of scheduler and
+ * the benchmarks of kernel.
+ *
+ * The counter is free running and wraps at 32 bits, such as DWT CYCCNT of
+ * Cortex-M or the clock of host on simulator. The default one in kernel is
+ * the OS tick, which is too coarse to account the threads running shorter
+ * than a tick. The frequency is 0 if the port doesn't know it.
+ */
+void rt_hw_cycle_init(void);
+rt_uint32_t rt_hw_cycle_get(void);
+rt_uint32_t rt_hw_cycle_frequency(void);
+
+#ifdef RT_USING_LAZY_FPU
+/*
+ * Lazy FPU interfaces.
+ *
+ * The FPU is only enabled for the thread owning it. The other thread traps on
+ * its first FPU instruction, then the port saves the FPU registers of owner
+ * and loads the ones of this thread, which becomes the owner. The context
+ * switch doesn't touch the FPU registers.
+ *
+ * The FPU shall not be used in interrupt. The kernel invokes this function
+ * when a thread is closed, the port shall drop it if it's the owner.
+ */
+void rt_hw_fpu_thread_close(struct rt_thread *thread);
+#endif
+
+#ifdef RT_USING_SMP
+/*
+ * SMP interfaces
+ */
+typedef union
+{
+    unsigned long slock;
+    struct __arch_tickets
+    {
+        unsigned short owner;
+        unsigned short next;
+    } tickets;
+} rt_hw_spinlock_t;
+
+int rt_hw_cpu_id(void);
+
+void rt_hw_spin_lock(rt_hw_spinlock_t *lock);
+void rt_hw_spin_unlock(rt_hw_spinlock_t *lock);
+
+/* send the inter-processor interrupt to the CPUs in cpu_mask */
+void rt_hw_ipi_send(int ipi_vector, unsigned int cpu_mask);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -27,6 +27,13 @@
  * 2010-04-11     yi.qiu       add module feature
  * 2013-06-24     Bernard      add rt_kprintf re-define when not use RT_USING_CONSOLE.
  * 2016-08-09     ArdaFu       add new thread and interrupt hook.
+ * 2017-06-24     agent        add SMP scheduler and cpu service.
+ * 2017-06-30     agent        add rt_object_lookup.
+ * 2017-07-03     agent        add cpu usage accounting APIs.
+ * 2017-07-04     agent        add deferred interrupt source APIs.
+ * 2017-07-06     agent        add deadline thread APIs.
+ * 2017-07-10     agent        add memory region APIs of memory heap.
+ * 2017-07-11     agent        add rt_module_find_symbol.
  */
 
 #ifndef __RT_THREAD_H__
@@ -63,6 +70,8 @@ rt_object_t rt_object_allocate(enum rt_object_class_type type,
 void rt_object_delete(rt_object_t object);
 rt_bool_t rt_object_is_systemobject(rt_object_t object);
 rt_object_t rt_object_find(const char *name, rt_uint8_t type);
+rt_object_t rt_object_lookup(struct rt_object_information *information,
+                             const char                   *name);
 
 #ifdef RT_USING_HOOK
 void rt_object_attach_sethook(void (*hook)(struct rt_object *object));
@@ -87,6 +96,9 @@ void rt_system_tick_init(void);
 rt_tick_t rt_tick_get(void);
 void rt_tick_set(rt_tick_t tick);
 void rt_tick_increase(void);
+#ifdef RT_USING_TICKLESS
+void rt_tick_compensate(rt_tick_t ticks);
+#endif
 rt_tick_t rt_tick_from_millisecond(rt_uint32_t ms);
 
 void rt_system_timer_init(void);
@@ -154,6 +166,31 @@ rt_err_t rt_thread_suspend(rt_thread_t thread);
 rt_err_t rt_thread_resume(rt_thread_t thread);
 void rt_thread_timeout(void *parameter);
 
+#ifdef RT_USING_DEADLINE
+/*
+ * deadline thread interface
+ */
+rt_err_t rt_thread_deadline_set(rt_thread_t thread,
+                                rt_tick_t   period,
+                                rt_tick_t   budget,
+                                rt_tick_t   deadline);
+#ifdef RT_USING_HEAP
+rt_thread_t rt_thread_deadline_create(const char *name,
+                                      void (*entry)(void *parameter),
+                                      void       *parameter,
+                                      rt_uint32_t stack_size,
+                                      rt_tick_t   period,
+                                      rt_tick_t   budget,
+                                      rt_tick_t   deadline);
+#endif
+rt_err_t rt_thread_deadline_wait(void);
+rt_uint32_t rt_deadline_utilization(int cpu);
+
+void rt_thread_deadline_start(struct rt_thread *thread);
+void rt_thread_deadline_close(struct rt_thread *thread);
+void rt_thread_deadline_tick(struct rt_thread *thread);
+#endif
+
 #ifdef RT_USING_HOOK
 void rt_thread_suspend_sethook(void (*hook)(rt_thread_t thread));
 void rt_thread_resume_sethook (void (*hook)(rt_thread_t thread));
@@ -184,10 +221,36 @@ void rt_enter_critical(void);
 void rt_exit_critical(void);
 rt_uint16_t rt_critical_level(void);
 
+#ifdef RT_USING_SMP
+void rt_scheduler_do_irq_switch(void *context);
+void rt_scheduler_ipi_handler(int vector, void *param);
+
+/*
+ * cpu service
+ */
+struct rt_cpu *rt_cpu_self(void);
+struct rt_cpu *rt_cpu_index(int index);
+#endif
+
 #ifdef RT_USING_HOOK
 void rt_scheduler_sethook(void (*hook)(rt_thread_t from, rt_thread_t to));
 #endif
 
+#ifdef RT_USING_CPU_USAGE
+/*
+ * cpu usage accounting
+ */
+rt_err_t rt_cpu_usage_get(int cpu, struct rt_cpu_usage *usage);
+rt_uint64_t rt_thread_cycles_get(rt_thread_t thread);
+
+void rt_cpu_usage_irq_enter(void);
+void rt_cpu_usage_irq_leave(void);
+#ifdef RT_USING_TICKLESS
+void rt_cpu_usage_sleep_enter(void);
+void rt_cpu_usage_sleep_leave(rt_tick_t ticks);
+#endif
+#endif
+
 /**@}*/
 
 /**
@@ -217,6 +280,13 @@ rt_err_t rt_mp_delete(rt_mp_t mp);
 void *rt_mp_alloc(rt_mp_t mp, rt_int32_t time);
 void rt_mp_free(void *block);
 
+rt_err_t rt_lfpool_init(rt_lfpool_t pool,
+                        void       *start,
+                        rt_size_t   size,
+                        rt_size_t   block_size);
+void *rt_lfpool_alloc(rt_lfpool_t pool);
+void rt_lfpool_free(rt_lfpool_t pool, void *block);
+
 #ifdef RT_USING_HOOK
 void rt_mp_alloc_sethook(void (*hook)(struct rt_mempool *mp, void *block));
 void rt_mp_free_sethook(void (*hook)(struct rt_mempool *mp, void *block));
@@ -246,6 +316,10 @@ void *rt_page_alloc(rt_size_t npages);
 void rt_page_free(void *addr, rt_size_t npages);
 #endif
 
+#ifdef RT_USING_SLAB_CACHE
+void rt_slab_cache_flush(rt_thread_t thread);
+#endif
+
 #ifdef RT_USING_HOOK
 void rt_malloc_sethook(void (*hook)(void *ptr, rt_uint32_t size));
 void rt_free_sethook(void (*hook)(void *ptr));
@@ -265,6 +339,13 @@ rt_err_t rt_memheap_detach(struct rt_memheap *heap);
 void* rt_memheap_alloc(struct rt_memheap *heap, rt_uint32_t size);
 void *rt_memheap_realloc(struct rt_memheap* heap, void* ptr, rt_size_t newsize);
 void rt_memheap_free(void *ptr);
+
+#ifdef RT_USING_MEMHEAP_REGION
+void rt_memheap_set_region(struct rt_memheap *heap, rt_uint8_t region);
+void *rt_malloc_region(rt_size_t size, rt_uint32_t flag);
+rt_err_t rt_memory_region_set_fallback(rt_uint8_t region, rt_uint8_t fallback);
+rt_err_t rt_memory_region_info(rt_uint8_t region, struct rt_memory_region_info *info);
+#endif
 #endif
 
 /**@}*/
@@ -370,6 +451,11 @@ rt_err_t rt_mq_recv(rt_mq_t    mq,
                     rt_size_t  size,
                     rt_int32_t timeout);
 rt_err_t rt_mq_control(rt_mq_t mq, rt_uint8_t cmd, void *arg);
+
+rt_err_t rt_mq_reserve(rt_mq_t mq, void **buffer);
+rt_err_t rt_mq_commit(rt_mq_t mq, void *buffer);
+rt_err_t rt_mq_borrow(rt_mq_t mq, void **buffer, rt_int32_t timeout);
+void rt_mq_release(rt_mq_t mq, void *buffer);
 #endif
 
 /**@}*/
@@ -436,6 +522,7 @@ void *rt_module_realloc(void *ptr, rt_size_t size);
 void rt_module_free(rt_module_t module, void *addr);
 rt_module_t rt_module_self(void);
 rt_module_t rt_module_find(const char *name);
+void *rt_module_find_symbol(rt_module_t module, const char *name);
 
 #ifdef RT_USING_HOOK
 void rt_module_load_sethook(void (*hook)(rt_module_t module));
@@ -473,6 +560,24 @@ void rt_interrupt_enter_sethook(void (*hook)(void));
 void rt_interrupt_leave_sethook(void (*hook)(void));
 #endif
 
+#ifdef RT_USING_IRQ_THREAD
+/*
+ * deferred interrupt source, the bottom half runs in interrupt thread
+ */
+void rt_system_irq_thread_init(void);
+
+rt_err_t rt_irq_source_init(rt_irq_source_t source,
+                            const char     *name,
+                            rt_uint32_t (*top_half)(int vector, void *param),
+                            void (*bottom_half)(rt_uint32_t events, void *param),
+                            void           *param,
+                            rt_uint8_t      level,
+                            rt_uint8_t      flag);
+void rt_irq_source_install(rt_irq_source_t source, int vector);
+void rt_irq_source_detach(rt_irq_source_t source);
+void rt_irq_source_raise(rt_irq_source_t source, rt_uint32_t events);
+#endif
+
 #ifdef RT_USING_COMPONENTS_INIT
 void rt_components_init(void);
 void rt_components_board_init(void);
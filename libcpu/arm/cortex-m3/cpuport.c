@@ -15,6 +15,7 @@
  * 2012-12-23   aozima      stack addr align to 8byte.
  * 2012-12-29   Bernard     Add exception hook.
  * 2013-07-09   aozima      enhancement hard fault exception handler.
+ * 2017-07-03   agent       add the cycle counter of DWT.
  */
 
 #include <rtthread.h>
@@ -352,6 +353,41 @@ void rt_hw_cpu_shutdown(void)
     RT_ASSERT(0);
 }
 
+/*
+ * The cycle counter of DWT, it counts the core clock.
+ */
+#define DEMCR                   (*(volatile rt_uint32_t *)0xE000EDFC)
+#define DEMCR_TRCENA            (1UL << 24)
+#define DWT_CTRL                (*(volatile rt_uint32_t *)0xE0001000)
+#define DWT_CTRL_CYCCNTENA      (1UL << 0)
+#define DWT_CYCCNT              (*(volatile rt_uint32_t *)0xE0001004)
+
+/*
+ * the core clock of CMSIS system file, it's a weak reference for the BSP
+ * without CMSIS, then the frequency of counter is unknown (0).
+ */
+extern WEAK rt_uint32_t SystemCoreClock;
+
+void rt_hw_cycle_init(void)
+{
+    DEMCR |= DEMCR_TRCENA;
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+rt_uint32_t rt_hw_cycle_get(void)
+{
+    return DWT_CYCCNT;
+}
+
+rt_uint32_t rt_hw_cycle_frequency(void)
+{
+    if (&SystemCoreClock == RT_NULL)
+        return 0;
+
+    return SystemCoreClock;
+}
+
 #ifdef RT_USING_CPU_FFS
 /**
  * This function finds the first bit set (beginning with the least significant bit)
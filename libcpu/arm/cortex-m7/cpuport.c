@@ -17,14 +17,26 @@
  * 2012-12-23     aozima       stack addr align to 8byte.
  * 2012-12-29     Bernard      Add exception hook.
  * 2013-06-23     aozima       support lazy stack optimized.
+ * 2017-07-03     agent        add the cycle counter of DWT.
+ * 2017-07-07     agent        add lazy FPU context switch by the ownership.
  */
 
+#include <rthw.h>
 #include <rtthread.h>
 
 #define USE_FPU   /* ARMCC */ (  (defined ( __CC_ARM ) && defined ( __TARGET_FPU_VFP )) \
                   /* IAR */   || (defined ( __ICCARM__ ) && defined ( __ARMVFP__ )) \
                   /* GNU */   || (defined ( __GNUC__ ) && defined ( __VFP_FP__ ) && !defined(__SOFTFP__)) )
 
+#if defined(RT_USING_LAZY_FPU) && USE_FPU
+#ifndef __GNUC__
+#error "The lazy FPU context switch is only supported by GCC port."
+#endif
+#define USE_LAZY_FPU    1
+#else
+#define USE_LAZY_FPU    0
+#endif
+
 /* exception and interrupt handler table */
 rt_uint32_t rt_interrupt_from_thread;
 rt_uint32_t rt_interrupt_to_thread;
@@ -32,6 +44,17 @@ rt_uint32_t rt_thread_switch_interrupt_flag;
 /* exception hook */
 static rt_err_t (*rt_exception_hook)(void *context) = RT_NULL;
 
+#if USE_LAZY_FPU
+#define SCB_CPACR               (*(volatile rt_uint32_t *)0xE000ED88)
+#define CPACR_CP10_CP11         (0x0FUL << 20)
+#define FPU_FPDSCR              (*(volatile rt_uint32_t *)0xE000EF3C)
+#define SCB_SHCSR               (*(volatile rt_uint32_t *)0xE000ED24)
+#define SHCSR_USGFAULTENA       (1UL << 18)
+
+/* s0 ~ s31 and fpscr, in 8 bytes align */
+#define FPU_CONTEXT_SIZE        RT_ALIGN(33 * sizeof(rt_uint32_t), 8)
+#endif
+
 struct exception_stack_frame
 {
     rt_uint32_t r0;
@@ -46,7 +69,7 @@ struct exception_stack_frame
 
 struct stack_frame
 {
-#if USE_FPU
+#if USE_FPU && !USE_LAZY_FPU
     rt_uint32_t flag;
 #endif /* USE_FPU */
 
@@ -145,6 +168,10 @@ rt_uint8_t *rt_hw_stack_init(void       *tentry,
 
     stk  = stack_addr + sizeof(rt_uint32_t);
     stk  = (rt_uint8_t *)RT_ALIGN_DOWN((rt_uint32_t)stk, 8);
+#if USE_LAZY_FPU
+    /* the FPU context is saved at the top of stack */
+    stk -= FPU_CONTEXT_SIZE;
+#endif
     stk -= sizeof(struct stack_frame);
 
     stack_frame = (struct stack_frame *)stk;
@@ -164,7 +191,7 @@ rt_uint8_t *rt_hw_stack_init(void       *tentry,
     stack_frame->exception_stack_frame.pc  = (unsigned long)tentry;    /* entry point, pc */
     stack_frame->exception_stack_frame.psr = 0x01000000L;              /* PSR */
 
-#if USE_FPU
+#if USE_FPU && !USE_LAZY_FPU
     stack_frame->flag = 0;
 #endif /* USE_FPU */
 
@@ -172,6 +199,96 @@ rt_uint8_t *rt_hw_stack_init(void       *tentry,
     return stk;
 }
 
+#if USE_LAZY_FPU
+/*
+ * The FPU is enabled (CPACR) by PendSV only when it switches to the owner of
+ * FPU, and the automatic FPU state preservation on exception is disabled. So
+ * the FPU registers are not touched by the context switch.
+ *
+ * The first FPU instruction of the other thread takes the NOCP usage fault,
+ * which is escalated to hard fault as the usage fault is not enabled. The
+ * hard fault handler saves the registers of the owner to the FPU context at
+ * the top of its stack, loads the ones of current thread, makes it the owner
+ * and returns to execute the instruction again.
+ *
+ * The interrupt shall not use the FPU, it would take the hard fault.
+ */
+
+/* the &sp of the thread owning the FPU, the same as rt_interrupt_to_thread */
+rt_uint32_t rt_hw_fpu_owner;
+
+static rt_uint32_t *_fpu_context(struct rt_thread *thread)
+{
+    rt_uint32_t stk;
+
+    stk = (rt_uint32_t)thread->stack_addr + thread->stack_size;
+
+    return (rt_uint32_t *)(RT_ALIGN_DOWN(stk, 8) - FPU_CONTEXT_SIZE);
+}
+
+/*
+ * invoked by rt_hw_context_switch_to. The NOCP fault is handled by the hard
+ * fault handler only, so the usage fault shall not be enabled by BSP.
+ */
+void rt_hw_fpu_fault_check(void)
+{
+    RT_ASSERT((SCB_SHCSR & SHCSR_USGFAULTENA) == 0);
+}
+
+/* invoked by the hard fault handler on the NOCP fault of thread */
+void rt_hw_fpu_switch(void)
+{
+    struct rt_thread *owner;
+    struct rt_thread *thread;
+    rt_uint32_t *context;
+
+    thread = rt_thread_self();
+
+    SCB_CPACR |= CPACR_CP10_CP11;
+    __asm volatile ("dsb\n isb" ::: "memory");
+
+    if (rt_hw_fpu_owner != 0)
+    {
+        owner   = rt_list_entry(rt_hw_fpu_owner, struct rt_thread, sp);
+        context = _fpu_context(owner);
+
+        __asm volatile ("vstmia %0!, {s0-s31}   \n"
+                        "vmrs   r1, fpscr       \n"
+                        "str    r1, [%0]        \n"
+                        : "+r"(context) : : "r1", "memory");
+        owner->fpu_flag |= RT_THREAD_FPU_USED;
+    }
+
+    if (thread->fpu_flag & RT_THREAD_FPU_USED)
+    {
+        context = _fpu_context(thread);
+
+        __asm volatile ("vldmia %0!, {s0-s31}   \n"
+                        "ldr    r1, [%0]        \n"
+                        "vmsr   fpscr, r1       \n"
+                        : "+r"(context) : : "r1", "memory");
+    }
+    else
+    {
+        /* the first FPU instruction of thread, in the default mode */
+        __asm volatile ("vmsr   fpscr, %0" : : "r"(FPU_FPDSCR));
+    }
+
+    rt_hw_fpu_owner = (rt_uint32_t)&(thread->sp);
+}
+
+void rt_hw_fpu_thread_close(struct rt_thread *thread)
+{
+    register rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (rt_hw_fpu_owner == (rt_uint32_t)&(thread->sp))
+        rt_hw_fpu_owner = 0;
+    thread->fpu_flag = 0;
+    rt_hw_interrupt_enable(level);
+}
+#endif
+
 /**
  * This function set the hook, which is invoked on fault exception handling.
  *
@@ -222,6 +339,44 @@ void rt_hw_cpu_shutdown(void)
     RT_ASSERT(0);
 }
 
+/*
+ * The cycle counter of DWT, it counts the core clock.
+ */
+#define DEMCR                   (*(volatile rt_uint32_t *)0xE000EDFC)
+#define DEMCR_TRCENA            (1UL << 24)
+#define DWT_CTRL                (*(volatile rt_uint32_t *)0xE0001000)
+#define DWT_CTRL_CYCCNTENA      (1UL << 0)
+#define DWT_CYCCNT              (*(volatile rt_uint32_t *)0xE0001004)
+#define DWT_LAR                 (*(volatile rt_uint32_t *)0xE0001FB0)
+
+/*
+ * the core clock of CMSIS system file, it's a weak reference for the BSP
+ * without CMSIS, then the frequency of counter is unknown (0).
+ */
+extern WEAK rt_uint32_t SystemCoreClock;
+
+void rt_hw_cycle_init(void)
+{
+    DEMCR |= DEMCR_TRCENA;
+    /* unlock the DWT of Cortex-M7 */
+    DWT_LAR = 0xC5ACCE55;
+    DWT_CYCCNT = 0;
+    DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+rt_uint32_t rt_hw_cycle_get(void)
+{
+    return DWT_CYCCNT;
+}
+
+rt_uint32_t rt_hw_cycle_frequency(void)
+{
+    if (&SystemCoreClock == RT_NULL)
+        return 0;
+
+    return SystemCoreClock;
+}
+
 #ifdef RT_USING_CPU_FFS
 /**
  * This function finds the first bit set (beginning with the least significant bit)
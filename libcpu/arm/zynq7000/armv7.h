@@ -60,6 +60,18 @@ struct rt_hw_exp_stack
 #define E_Bit       (1<<9)
 #define J_Bit       (1<<24)
 
+#define FPEXC_EN    (1<<30)
+
+#ifdef RT_USING_LAZY_FPU
+/* the VFP context at the top of thread stack: d0 ~ d31 and fpscr */
+#define VFP_CONTEXT_SIZE    RT_ALIGN(32 * 8 + 4, 8)
+#define VFP_CONTEXT(thread) \
+    ((rt_uint32_t *)(RT_ALIGN_DOWN((rt_uint32_t)(thread)->stack_addr + \
+                                   (thread)->stack_size, 8) - VFP_CONTEXT_SIZE))
+
+void rt_hw_vfp_init(void);
+#endif
+
 void rt_hw_mmu_init(void);
 
 #endif
@@ -0,0 +1,124 @@
+/*
+ * File      : memcpy_neon.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Develop Team
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rt-thread.org/license/LICENSE
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-07-01     agent        first version
+ * 2017-07-07     agent        note the VFP ownership of lazy FPU
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+
+/*
+ * The memory copy and set by NEON, the hook of rt_memcpy() and rt_memset()
+ * with RT_USING_CPU_MEMCPY. It needs -mfpu=neon.
+ *
+ * The VFP/NEON registers are not saved on context switch in this port, so
+ * the blocks of NEON_CHUNK bytes are copied with interrupt disabled, and the
+ * registers used are pushed and restored. The interrupt-off time is short
+ * as the NEON copies 64 bytes in a few cycles.
+ *
+ * With RT_USING_LAZY_FPU, the VFP is only enabled for the thread owning it,
+ * the others copy by CPU rather than taking the VFP from the owner.
+ */
+#if defined(RT_USING_CPU_MEMCPY) && defined(__ARM_NEON__) && defined(__GNUC__)
+
+#define NEON_BLOCK      64
+#define NEON_CHUNK      256
+
+/* the VFP/NEON is enabled (FPEXC.EN) */
+rt_inline int _neon_enabled(void)
+{
+    rt_uint32_t fpexc;
+
+    asm volatile ("vmrs %0, fpexc" : "=r"(fpexc));
+
+    return fpexc & (1 << 30);
+}
+
+void *rt_hw_memcpy(void *dst, const void *src, rt_ubase_t count)
+{
+    rt_base_t level;
+    rt_ubase_t blocks;
+    rt_uint8_t *d = (rt_uint8_t *)dst;
+    const rt_uint8_t *s = (const rt_uint8_t *)src;
+
+    if (count < NEON_BLOCK || !_neon_enabled())
+        return RT_NULL;
+
+    while (count >= NEON_BLOCK)
+    {
+        blocks = count / NEON_BLOCK;
+        if (blocks > NEON_CHUNK / NEON_BLOCK)
+            blocks = NEON_CHUNK / NEON_BLOCK;
+        count -= blocks * NEON_BLOCK;
+
+        level = rt_hw_interrupt_disable();
+        asm volatile (
+            "vpush      {d0-d7}             \n"
+            "1:                             \n"
+            "vld1.8     {d0-d3}, [%1]!      \n"
+            "vld1.8     {d4-d7}, [%1]!      \n"
+            "vst1.8     {d0-d3}, [%0]!      \n"
+            "vst1.8     {d4-d7}, [%0]!      \n"
+            "subs       %2, %2, #1          \n"
+            "bne        1b                  \n"
+            "vpop       {d0-d7}             \n"
+            : "+r"(d), "+r"(s), "+r"(blocks)
+            :
+            : "cc", "memory");
+        rt_hw_interrupt_enable(level);
+    }
+
+    while (count--)
+        *d++ = *s++;
+
+    return dst;
+}
+
+void *rt_hw_memset(void *s, int c, rt_ubase_t count)
+{
+    rt_base_t level;
+    rt_ubase_t blocks;
+    rt_uint8_t *m = (rt_uint8_t *)s;
+
+    if (count < NEON_BLOCK || !_neon_enabled())
+        return RT_NULL;
+
+    while (count >= NEON_BLOCK)
+    {
+        blocks = count / NEON_BLOCK;
+        if (blocks > NEON_CHUNK / NEON_BLOCK)
+            blocks = NEON_CHUNK / NEON_BLOCK;
+        count -= blocks * NEON_BLOCK;
+
+        level = rt_hw_interrupt_disable();
+        asm volatile (
+            "vpush      {d0-d3}             \n"
+            "vdup.8     q0, %2              \n"
+            "vdup.8     q1, %2              \n"
+            "1:                             \n"
+            "vst1.8     {d0-d3}, [%0]!      \n"
+            "vst1.8     {d0-d3}, [%0]!      \n"
+            "subs       %1, %1, #1          \n"
+            "bne        1b                  \n"
+            "vpop       {d0-d3}             \n"
+            : "+r"(m), "+r"(blocks)
+            : "r"(c)
+            : "cc", "memory");
+        rt_hw_interrupt_enable(level);
+    }
+
+    while (count--)
+        *m++ = (rt_uint8_t)c;
+
+    return s;
+}
+#endif
@@ -12,6 +12,7 @@
  * 2011-09-23     Bernard      the first version
  * 2011-10-05     Bernard      add thumb mode
  * 2013-07-15     Bernard      add Cortex-A8 support.
+ * 2017-07-07     agent        reserve the VFP context for lazy FPU.
  */
 #include <rtthread.h>
 #include "zynq7000.h"
@@ -32,6 +33,11 @@ rt_uint8_t *rt_hw_stack_init(void *tentry, void *parameter,
     rt_uint32_t *stk;
 
     stk      = (rt_uint32_t *)stack_addr;
+#ifdef RT_USING_LAZY_FPU
+    /* the VFP context is saved at the top of stack */
+    stk      = (rt_uint32_t *)(RT_ALIGN_DOWN((rt_uint32_t)stk + sizeof(rt_uint32_t), 8) -
+                               VFP_CONTEXT_SIZE) - 1;
+#endif
     *(stk)   = (rt_uint32_t)tentry;         /* entry point */
     *(--stk) = (rt_uint32_t)texit;          /* lr */
     *(--stk) = 0;                           /* r12 */
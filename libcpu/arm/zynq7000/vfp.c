@@ -0,0 +1,121 @@
+/*
+ * File      : vfp.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2017, RT-Thread Develop Team
+ *
+ * The license and distribution terms for this file may be
+ * found in the file LICENSE in this distribution or at
+ * http://www.rt-thread.org/license/LICENSE
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-07-07     agent        first version
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include "zynq7000.h"
+
+/*
+ * The lazy VFP context switch. The VFP is enabled (FPEXC.EN) by the context
+ * switch only when it switches to the owner of VFP, so the VFP registers are
+ * not touched by the context switch.
+ *
+ * The first VFP/NEON instruction of the other thread takes the undefined
+ * instruction exception. The handler saves d0 ~ d31 and fpscr of the owner to
+ * the VFP context at the top of its stack, loads the ones of current thread,
+ * makes it the owner and executes the instruction again.
+ *
+ * The Cortex-A9 of Zynq7000 has NEON, so there are 32 double registers. The
+ * interrupt shall not use the VFP, except the NEON copy of rt_hw_memcpy which
+ * saves the registers it uses.
+ */
+#if defined(RT_USING_LAZY_FPU) && defined(__GNUC__)
+
+/* the &sp of the thread owning the VFP, the same as rt_interrupt_to_thread */
+rt_uint32_t rt_hw_fpu_owner;
+
+void rt_hw_vfp_init(void)
+{
+    rt_uint32_t cpacr;
+
+    /* full access of CP10 and CP11 */
+    asm volatile ("mrc p15, 0, %0, c1, c0, 2" : "=r"(cpacr));
+    cpacr |= (0x0F << 20);
+    asm volatile ("mcr p15, 0, %0, c1, c0, 2\n isb" : : "r"(cpacr) : "memory");
+
+    /* the VFP is disabled until a thread takes it */
+    asm volatile ("vmsr fpexc, %0" : : "r"(0));
+    rt_hw_fpu_owner = 0;
+}
+
+/*
+ * This function is invoked by the undefined instruction exception, it gives
+ * the VFP to the current thread.
+ *
+ * @param spsr the cpsr of the interrupted context
+ *
+ * @return the offset of the instruction to lr, 0 if it's not a VFP access of
+ * thread.
+ */
+int rt_hw_vfp_undef(rt_uint32_t spsr)
+{
+    rt_uint32_t fpexc;
+    rt_uint32_t *context;
+    struct rt_thread *owner;
+    struct rt_thread *thread;
+
+    asm volatile ("vmrs %0, fpexc" : "=r"(fpexc));
+
+    /* the VFP is not disabled, it's an undefined instruction indeed */
+    thread = rt_thread_self();
+    if ((spsr & MODEMASK) != SVCMODE || (fpexc & FPEXC_EN) || thread == RT_NULL)
+        return 0;
+
+    asm volatile ("vmsr fpexc, %0" : : "r"(FPEXC_EN));
+
+    if (rt_hw_fpu_owner != 0)
+    {
+        owner   = rt_list_entry(rt_hw_fpu_owner, struct rt_thread, sp);
+        context = VFP_CONTEXT(owner);
+
+        asm volatile ("vstmia %0!, {d0-d15}     \n"
+                      "vstmia %0!, {d16-d31}    \n"
+                      "vmrs   r1, fpscr         \n"
+                      "str    r1, [%0]          \n"
+                      : "+r"(context) : : "r1", "memory");
+        owner->fpu_flag |= RT_THREAD_FPU_USED;
+    }
+
+    if (thread->fpu_flag & RT_THREAD_FPU_USED)
+    {
+        context = VFP_CONTEXT(thread);
+
+        asm volatile ("vldmia %0!, {d0-d15}     \n"
+                      "vldmia %0!, {d16-d31}    \n"
+                      "ldr    r1, [%0]          \n"
+                      "vmsr   fpscr, r1         \n"
+                      : "+r"(context) : : "r1", "memory");
+    }
+    else
+    {
+        /* the first VFP instruction of thread, in the default mode */
+        asm volatile ("vmsr fpscr, %0" : : "r"(0));
+    }
+
+    rt_hw_fpu_owner = (rt_uint32_t)&(thread->sp);
+
+    return (spsr & T_Bit) ? 2 : 4;
+}
+
+void rt_hw_fpu_thread_close(struct rt_thread *thread)
+{
+    register rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (rt_hw_fpu_owner == (rt_uint32_t)&(thread->sp))
+        rt_hw_fpu_owner = 0;
+    thread->fpu_flag = 0;
+    rt_hw_interrupt_enable(level);
+}
+#endif
@@ -0,0 +1,49 @@
+/*
+ * File      : cpu_cycle.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2006 - 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-07-03     agent        the first version
+ */
+
+/*
+ * The cycle counter of simulator, it's the monotonic
+ * clock of host in nanoseconds. The 32 bits counter wraps in about 4 seconds,
+ * which is much longer than a tick.
+ */
+#include <rthw.h>
+#include <time.h>
+
+void rt_hw_cycle_init(void)
+{
+}
+
+rt_uint32_t rt_hw_cycle_get(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (rt_uint32_t)(now.tv_sec * 1000000000UL + now.tv_nsec);
+}
+
+rt_uint32_t rt_hw_cycle_frequency(void)
+{
+    return 1000000000UL;
+}
@@ -13,6 +13,9 @@
 #include <time.h>
 #include <sys/time.h>
 
+/* the SMP simulation is in cpu_smp.c */
+#ifndef RT_USING_SMP
+
 //#define TRACE       printf
 #define TRACE(...)
 
@@ -60,8 +63,17 @@ static int (* cpu_isr_table[MAX_INTERRUPT_NUM])(void) = {0};
 
 static pthread_t mainthread_pid;
 
+#ifdef RT_USING_TICKLESS
+/* the idle thread is sleeping in rt_hw_tickless_sleep */
+static volatile int tickless_sleeping;
+static pthread_cond_t cond_tickless;
+/* the time of the last tick reported to kernel */
+static struct timespec tickless_last;
+#endif
+
 /* function definition */
 static void start_sys_timer(void);
+static void set_sys_timer(long value_us, long interval_us);
 static int tick_interrupt_isr(void);
 static void mthread_signal_tick(int sig);
 static int mainthread_scheduler(void);
@@ -387,6 +399,15 @@ void rt_hw_context_switch(rt_uint32_t from,
     rt_interrupt_from_thread = *((rt_uint32_t *)from);
     rt_interrupt_to_thread = *((rt_uint32_t *)to);
 
+#ifdef RT_USING_TICKLESS
+    if (tickless_sleeping)
+    {
+        /* the thread switch is an interrupt, wake up the idle thread */
+        tickless_sleeping = 0;
+        pthread_cond_signal(&cond_tickless);
+    }
+#endif
+
     /* 这个函数只是并不会真正执行中断处理函数，而只是简单的
      * 设置一下中断挂起标志位
      */
@@ -397,6 +418,22 @@ void rt_hw_context_switch(rt_uint32_t from,
 void rt_hw_context_switch_interrupt(rt_uint32_t from,
                                     rt_uint32_t to)
 {
+    pthread_mutex_lock(ptr_int_mutex);
+    if (cpu_pending_interrupts)
+    {
+        /*
+         * The switch is already pending in this interrupt, the from thread
+         * is still running, only the to thread is changed.
+         */
+        rt_interrupt_to_thread = *((rt_uint32_t *)to);
+        if (rt_interrupt_to_thread == rt_interrupt_from_thread)
+            cpu_pending_interrupts --;
+        pthread_mutex_unlock(ptr_int_mutex);
+
+        return;
+    }
+    pthread_mutex_unlock(ptr_int_mutex);
+
     rt_hw_context_switch(from, to);
 }
 
@@ -455,6 +492,9 @@ static int mainthread_scheduler(void)
     pthread_mutexattr_init(&mutexattr);
     pthread_mutexattr_settype(&mutexattr, PTHREAD_MUTEX_RECURSIVE_NP);
     pthread_mutex_init(ptr_int_mutex, &mutexattr);
+#ifdef RT_USING_TICKLESS
+    pthread_cond_init(&cond_tickless, NULL);
+#endif
 
     /* start timer */
     start_sys_timer();
@@ -478,6 +518,15 @@ static int mainthread_scheduler(void)
         // if (systick_signal_flag != 0)
         if (pthread_mutex_trylock(ptr_int_mutex) == 0)
         {
+#ifdef RT_USING_TICKLESS
+            if (tickless_sleeping)
+            {
+                /* the one-shot wakeup, the idle thread fixes up the tick */
+                tickless_sleeping = 0;
+                pthread_cond_signal(&cond_tickless);
+            }
+            else
+#endif
             tick_interrupt_isr();
             // systick_signal_flag = 0;
             pthread_mutex_unlock(ptr_int_mutex);
@@ -500,7 +549,6 @@ static int mainthread_scheduler(void)
  */
 static void start_sys_timer(void)
 {
-    struct itimerval itimer, oitimer;
     int us;
 
     RT_ASSERT(RT_TICK_PER_SECOND <= 1000000 || RT_TICK_PER_SECOND >= 1);
@@ -508,6 +556,20 @@ static void start_sys_timer(void)
     us = 1000000 / RT_TICK_PER_SECOND - 1;
 
     TRACE("start system tick!\n");
+#ifdef RT_USING_TICKLESS
+    clock_gettime(CLOCK_MONOTONIC, &tickless_last);
+#endif
+    set_sys_timer(us, us);
+}
+
+/*
+ * Set the count-down of the next timer event and the interval between timer
+ * events, the interval of 0 means one-shot.
+ */
+static void set_sys_timer(long value_us, long interval_us)
+{
+    struct itimerval itimer, oitimer;
+
     /* Initialise the structure with the current timer information. */
     if (0 != getitimer(TIMER_TYPE, &itimer))
     {
@@ -516,11 +578,11 @@ static void start_sys_timer(void)
     }
 
     /* Set the interval between timer events. */
-    itimer.it_interval.tv_sec = 0;
-    itimer.it_interval.tv_usec = us;
+    itimer.it_interval.tv_sec = interval_us / 1000000;
+    itimer.it_interval.tv_usec = interval_us % 1000000;
     /* Set the current count-down. */
-    itimer.it_value.tv_sec = 0;
-    itimer.it_value.tv_usec = us;
+    itimer.it_value.tv_sec = value_us / 1000000;
+    itimer.it_value.tv_usec = value_us % 1000000;
 
     /* Set-up the timer interrupt. */
     if (0 != setitimer(TIMER_TYPE, &itimer, &oitimer))
@@ -548,6 +610,59 @@ static void mthread_signal_tick(int sig)
     }
 }
 
+#ifdef RT_USING_TICKLESS
+/* the microseconds from the time of last reported tick */
+static long tickless_elapsed_us(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - tickless_last.tv_sec) * 1000000L +
+           (now.tv_nsec - tickless_last.tv_nsec) / 1000L;
+}
+
+/*
+ * Stop the periodic tick and wait for the one-shot wakeup or a thread switch
+ * request, it's invoked by the idle thread with interrupt disabled.
+ *
+ * @return the passed ticks during sleep
+ */
+rt_tick_t rt_hw_tickless_sleep(rt_tick_t timeout)
+{
+    long us, elapsed;
+    rt_tick_t ticks;
+
+    us = 1000000 / RT_TICK_PER_SECOND;
+
+    /* no more than one hour to sleep */
+    if (timeout > RT_TICK_PER_SECOND * 3600)
+        timeout = RT_TICK_PER_SECOND * 3600;
+
+    /* the wakeup is aligned with the periodic tick */
+    elapsed = tickless_elapsed_us();
+    set_sys_timer(timeout * us - elapsed > 0 ? timeout * us - elapsed : 1, 0);
+
+    tickless_sleeping = 1;
+    while (tickless_sleeping)
+    {
+        pthread_cond_wait(&cond_tickless, ptr_int_mutex);
+    }
+
+    /* report the whole ticks and keep the rest to the next periodic tick */
+    elapsed = tickless_elapsed_us();
+    ticks = elapsed / us;
+    tickless_last.tv_nsec += (ticks % RT_TICK_PER_SECOND) * us * 1000L;
+    tickless_last.tv_sec  += ticks / RT_TICK_PER_SECOND + tickless_last.tv_nsec / 1000000000L;
+    tickless_last.tv_nsec %= 1000000000L;
+
+    /* restart the periodic tick */
+    set_sys_timer(us - elapsed % us, us);
+
+    return ticks;
+}
+#endif
+
 /* isr return value: 1, should not be masked, if 0, can be masked */
 static int tick_interrupt_isr(void)
 {
@@ -555,6 +670,16 @@ static int tick_interrupt_isr(void)
     /* enter interrupt */
     rt_interrupt_enter();
 
+#ifdef RT_USING_TICKLESS
+    /* advance the time of the last tick */
+    tickless_last.tv_nsec += 1000000000L / RT_TICK_PER_SECOND;
+    if (tickless_last.tv_nsec >= 1000000000L)
+    {
+        tickless_last.tv_sec ++;
+        tickless_last.tv_nsec -= 1000000000L;
+    }
+#endif
+
     rt_tick_increase();
 
     /* leave interrupt */
@@ -563,4 +688,4 @@ static int tick_interrupt_isr(void)
     TRACE("isr: systick leave!\n");
     return 0;
 }
-
+#endif /* RT_USING_SMP */
@@ -0,0 +1,400 @@
+/*
+ * File      : cpu_smp.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2006 - 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-06-24     agent        the first version
+ */
+
+/*
+ * The SMP simulation on POSIX host.
+ *
+ * Each thread of RT-Thread is a posix thread, which waits on its semaphore
+ * when it's not running. A simulated cpu is the posix thread running on it,
+ * so there are RT_CPUS_NR threads running in parallel. The thread switch posts
+ * the semaphore of new thread and waits on the semaphore of old thread.
+ *
+ * The interrupts of a cpu are the pending bits of cpu, and a signal is sent
+ * to the posix thread running on the cpu. The signal handler (or the local
+ * interrupt enable) performs the interrupt service and the thread switch
+ * requested in interrupt, as the interrupt of real hardware does. The main
+ * thread generates the tick interrupts of all CPUs after the scheduler is
+ * started.
+ */
+#include <rtthread.h>
+#include <rthw.h>
+
+#ifdef RT_USING_SMP
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <semaphore.h>
+#include <time.h>
+
+typedef struct _thread
+{
+    pthread_t pthread;
+    void (*task)(void *);
+    void *para;
+    void (*exit)(void);
+    sem_t sem;
+    struct rt_thread *rtthread;
+    /* the cpu to run on, which is set by the thread switching to it */
+    volatile int cpu;
+} thread_t;
+
+#define MSG_IRQ             SIGUSR1
+
+#define IRQ_TICK            (1u << 0)
+#define IRQ_IPI(vector)     (1u << ((vector) + 1))
+
+struct cpu_state
+{
+    /* the posix thread running on the cpu */
+    thread_t *volatile thread;
+    /* the local interrupt is disabled */
+    volatile int irq_disabled;
+    /* the pending interrupts */
+    volatile unsigned int pending;
+};
+
+static struct cpu_state cpus[RT_CPUS_NR];
+
+/* the cpu of posix thread, and the thread itself */
+static __thread int cpu_id;
+static __thread thread_t *self;
+/* the posix thread is changing the local interrupt state */
+static __thread volatile sig_atomic_t irq_guard;
+
+static void cpu_irq_poll(void);
+
+static void cpu_irq_signal(int sig)
+{
+    /* the cpu state is being changed, the interrupt is pending */
+    if (irq_guard)
+        return;
+
+    /* the thread has been switched out of the cpu */
+    if (self == RT_NULL || cpus[cpu_id].thread != self)
+        return;
+
+    cpu_irq_poll();
+}
+
+/* raise interrupts on the cpu */
+static void cpu_irq_raise(int cpu, unsigned int irq)
+{
+    thread_t *thread;
+
+    __atomic_or_fetch(&cpus[cpu].pending, irq, __ATOMIC_SEQ_CST);
+
+    /* the thread switched in later polls the pending interrupts */
+    thread = __atomic_load_n(&cpus[cpu].thread, __ATOMIC_SEQ_CST);
+    if (thread != RT_NULL)
+        pthread_kill(thread->pthread, MSG_IRQ);
+}
+
+/* serve the pending interrupts of current cpu with local interrupt disabled */
+static void cpu_irq_handle(void)
+{
+    unsigned int pending;
+
+    pending = __atomic_exchange_n(&cpus[cpu_id].pending, 0, __ATOMIC_SEQ_CST);
+    if (pending == 0)
+        return;
+
+    rt_interrupt_enter();
+
+    if (pending & IRQ_TICK)
+        rt_tick_increase();
+    if (pending & IRQ_IPI(RT_SCHEDULE_IPI))
+        rt_scheduler_ipi_handler(RT_SCHEDULE_IPI, RT_NULL);
+
+    rt_interrupt_leave();
+
+    /* the thread may be switched out here and resumed on other cpu */
+    rt_scheduler_do_irq_switch(RT_NULL);
+}
+
+static void cpu_irq_poll(void)
+{
+    for (;;)
+    {
+        irq_guard = 1;
+        if (cpus[cpu_id].irq_disabled || cpus[cpu_id].pending == 0)
+        {
+            irq_guard = 0;
+
+            /* the interrupt raised while the guard is set */
+            if (cpus[cpu_id].irq_disabled || cpus[cpu_id].pending == 0)
+                return;
+            continue;
+        }
+        cpus[cpu_id].irq_disabled = 1;
+        irq_guard = 0;
+
+        cpu_irq_handle();
+
+        /* return from interrupt, the cpu_id may be changed */
+        irq_guard = 1;
+        cpus[cpu_id].irq_disabled = 0;
+        irq_guard = 0;
+    }
+}
+
+rt_base_t rt_hw_local_irq_disable(void)
+{
+    rt_base_t level;
+
+    irq_guard = 1;
+    level = cpus[cpu_id].irq_disabled;
+    cpus[cpu_id].irq_disabled = 1;
+    irq_guard = 0;
+
+    return level;
+}
+
+void rt_hw_local_irq_enable(rt_base_t level)
+{
+    irq_guard = 1;
+    cpus[cpu_id].irq_disabled = level;
+    irq_guard = 0;
+
+    if (level == 0)
+        cpu_irq_poll();
+}
+
+int rt_hw_cpu_id(void)
+{
+    return cpu_id;
+}
+
+void rt_hw_spin_lock(rt_hw_spinlock_t *lock)
+{
+    unsigned short ticket;
+    int spin = 0;
+
+    ticket = __atomic_fetch_add(&lock->tickets.next, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&lock->tickets.owner, __ATOMIC_ACQUIRE) != ticket)
+    {
+        /* the lock owner may be preempted by host */
+        if (++ spin > 1000)
+        {
+            spin = 0;
+            sched_yield();
+        }
+    }
+}
+
+void rt_hw_spin_unlock(rt_hw_spinlock_t *lock)
+{
+    __atomic_add_fetch(&lock->tickets.owner, 1, __ATOMIC_RELEASE);
+}
+
+void rt_hw_ipi_send(int ipi_vector, unsigned int cpu_mask)
+{
+    int cpu;
+
+    for (cpu = 0; cpu < RT_CPUS_NR; cpu ++)
+    {
+        if (cpu_mask & (1u << cpu))
+            cpu_irq_raise(cpu, IRQ_IPI(ipi_vector));
+    }
+}
+
+static void *thread_run(void *parameter)
+{
+    sigset_t sigmask;
+    thread_t *thread = (thread_t *)parameter;
+
+    /* the thread may be created in interrupt, where the signal is blocked */
+    sigemptyset(&sigmask);
+    sigaddset(&sigmask, MSG_IRQ);
+    pthread_sigmask(SIG_UNBLOCK, &sigmask, RT_NULL);
+
+    self = thread;
+    while (sem_wait(&thread->sem) != 0);
+
+    /* the first switch to the thread */
+    cpu_id = thread->cpu;
+    rt_cpus_lock_status_restore(thread->rtthread);
+    rt_hw_local_irq_enable(0);
+
+    thread->task(thread->para);
+    thread->exit();
+
+    /* never reach here */
+    return RT_NULL;
+}
+
+rt_uint8_t *rt_hw_stack_init(void       *entry,
+                             void       *parameter,
+                             rt_uint8_t *stack_addr,
+                             void       *texit)
+{
+    thread_t *thread;
+    thread_t **sp;
+    pthread_attr_t attr;
+
+    /*
+     * The posix thread may be still waiting on the semaphore after the thread
+     * is deleted, so keep the thread structure out of the thread stack.
+     */
+    thread = (thread_t *)calloc(1, sizeof(thread_t));
+    if (thread == RT_NULL || sem_init(&thread->sem, 0, 0) != 0)
+    {
+        printf("init thread failed, exit\n");
+        exit(EXIT_FAILURE);
+    }
+    thread->task = entry;
+    thread->para = parameter;
+    thread->exit = texit;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread->pthread, &attr, thread_run, thread) != 0)
+    {
+        printf("pthread create failed, exit\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_attr_destroy(&attr);
+
+    /* the stack pointer keeps the thread structure */
+    sp = (thread_t **)(((rt_ubase_t)stack_addr - sizeof(thread_t *)) &
+                       ~(sizeof(thread_t *) - 1));
+    *sp = thread;
+
+    return (rt_uint8_t *)sp;
+}
+
+static void cpu_switch(thread_t *from, thread_t *to, struct rt_thread *to_thread)
+{
+    int closed;
+
+    /* the thread exits, the posix thread is never resumed */
+    closed = from->rtthread->stat == RT_THREAD_CLOSE;
+
+    to->rtthread = to_thread;
+    to->cpu = cpu_id;
+    __atomic_store_n(&cpus[cpu_id].thread, to, __ATOMIC_SEQ_CST);
+    sem_post(&to->sem);
+
+    if (closed)
+    {
+        sem_destroy(&from->sem);
+        free(from);
+        pthread_exit(RT_NULL);
+    }
+
+    /* wait until the thread is switched in again on any cpu */
+    while (sem_wait(&from->sem) != 0);
+
+    cpu_id = from->cpu;
+    rt_cpus_lock_status_restore(from->rtthread);
+}
+
+void rt_hw_context_switch(rt_uint32_t from, rt_uint32_t to, struct rt_thread *to_thread)
+{
+    cpu_switch(**(thread_t ***)from, **(thread_t ***)to, to_thread);
+}
+
+void rt_hw_context_switch_interrupt(void *context, rt_uint32_t from, rt_uint32_t to,
+                                    struct rt_thread *to_thread)
+{
+    /* it's invoked when leaving interrupt, so switch the thread at once */
+    cpu_switch(**(thread_t ***)from, **(thread_t ***)to, to_thread);
+}
+
+static void *secondary_cpu_entry(void *parameter)
+{
+    cpu_id = (int)(rt_ubase_t)parameter;
+
+    /* start the scheduling of secondary cpu */
+    rt_system_scheduler_start();
+
+    return RT_NULL;
+}
+
+static void cpu_tick_loop(void)
+{
+    int cpu;
+    struct timespec next;
+    long period = 1000000000L / RT_TICK_PER_SECOND;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (;;)
+    {
+        next.tv_nsec += period;
+        if (next.tv_nsec >= 1000000000L)
+        {
+            next.tv_sec ++;
+            next.tv_nsec -= 1000000000L;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, RT_NULL) == EINTR);
+
+        for (cpu = 0; cpu < RT_CPUS_NR; cpu ++)
+            cpu_irq_raise(cpu, IRQ_TICK);
+    }
+}
+
+void rt_hw_context_switch_to(rt_uint32_t to, struct rt_thread *to_thread)
+{
+    int cpu;
+    thread_t *thread = **(thread_t ***)to;
+    pthread_t pthread;
+    struct sigaction act;
+
+    if (cpu_id == 0)
+    {
+        /* install the interrupt signal */
+        act.sa_handler = cpu_irq_signal;
+        sigemptyset(&act.sa_mask);
+        act.sa_flags = SA_RESTART;
+        sigaction(MSG_IRQ, &act, RT_NULL);
+    }
+
+    thread->rtthread = to_thread;
+    thread->cpu = cpu_id;
+    __atomic_store_n(&cpus[cpu_id].thread, thread, __ATOMIC_SEQ_CST);
+    sem_post(&thread->sem);
+
+    if (cpu_id != 0)
+    {
+        /* the secondary cpu runs on the posix thread switched to */
+        pthread_exit(RT_NULL);
+    }
+
+    /* the main thread starts the secondary CPUs, then generates the tick */
+    for (cpu = 1; cpu < RT_CPUS_NR; cpu ++)
+    {
+        if (pthread_create(&pthread, RT_NULL, secondary_cpu_entry,
+                           (void *)(rt_ubase_t)cpu) != 0)
+        {
+            printf("start cpu%d failed, exit\n", cpu);
+            exit(EXIT_FAILURE);
+        }
+        pthread_detach(pthread);
+    }
+
+    cpu_tick_loop();
+}
+#endif /* RT_USING_SMP */
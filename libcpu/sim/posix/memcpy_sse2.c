@@ -0,0 +1,115 @@
+/*
+ * File      : memcpy_sse2.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2006 - 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-07-01     agent        the first version
+ */
+
+/*
+ * The memory copy and set of simulator by SSE2, the hook of rt_memcpy() and
+ * rt_memset() with RT_USING_CPU_MEMCPY. Each thread of simulator is a posix
+ * thread, and the host saves its SSE registers on thread switch.
+ */
+#include <rthw.h>
+#include <rtthread.h>
+
+#if defined(RT_USING_CPU_MEMCPY) && defined(__SSE2__)
+#include <emmintrin.h>
+
+#define SSE2_SIZE       16
+#define SSE2_MASK       (SSE2_SIZE - 1)
+
+void *rt_hw_memcpy(void *dst, const void *src, rt_ubase_t count)
+{
+    rt_uint8_t *d = (rt_uint8_t *)dst;
+    const rt_uint8_t *s = (const rt_uint8_t *)src;
+    __m128i x0, x1, x2, x3;
+
+    /* align the destination, the source is read by unaligned load */
+    while (((rt_ubase_t)d & SSE2_MASK) && count)
+    {
+        *d++ = *s++;
+        count --;
+    }
+
+    while (count >= SSE2_SIZE * 4)
+    {
+        x0 = _mm_loadu_si128((const __m128i *)s + 0);
+        x1 = _mm_loadu_si128((const __m128i *)s + 1);
+        x2 = _mm_loadu_si128((const __m128i *)s + 2);
+        x3 = _mm_loadu_si128((const __m128i *)s + 3);
+        _mm_store_si128((__m128i *)d + 0, x0);
+        _mm_store_si128((__m128i *)d + 1, x1);
+        _mm_store_si128((__m128i *)d + 2, x2);
+        _mm_store_si128((__m128i *)d + 3, x3);
+        d += SSE2_SIZE * 4;
+        s += SSE2_SIZE * 4;
+        count -= SSE2_SIZE * 4;
+    }
+
+    while (count >= SSE2_SIZE)
+    {
+        _mm_store_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+        d += SSE2_SIZE;
+        s += SSE2_SIZE;
+        count -= SSE2_SIZE;
+    }
+
+    while (count--)
+        *d++ = *s++;
+
+    return dst;
+}
+
+void *rt_hw_memset(void *s, int c, rt_ubase_t count)
+{
+    rt_uint8_t *m = (rt_uint8_t *)s;
+    __m128i x;
+
+    while (((rt_ubase_t)m & SSE2_MASK) && count)
+    {
+        *m++ = (rt_uint8_t)c;
+        count --;
+    }
+
+    x = _mm_set1_epi8((char)c);
+    while (count >= SSE2_SIZE * 4)
+    {
+        _mm_store_si128((__m128i *)m + 0, x);
+        _mm_store_si128((__m128i *)m + 1, x);
+        _mm_store_si128((__m128i *)m + 2, x);
+        _mm_store_si128((__m128i *)m + 3, x);
+        m += SSE2_SIZE * 4;
+        count -= SSE2_SIZE * 4;
+    }
+
+    while (count >= SSE2_SIZE)
+    {
+        _mm_store_si128((__m128i *)m, x);
+        m += SSE2_SIZE;
+        count -= SSE2_SIZE;
+    }
+
+    while (count--)
+        *m++ = (rt_uint8_t)c;
+
+    return s;
+}
+#endif
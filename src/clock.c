@@ -26,6 +26,10 @@
  * 2010-05-20     Bernard      fix the tick exceeds the maximum limits
  * 2010-07-13     Bernard      fix rt_tick_from_millisecond issue found by kuronca
  * 2011-06-26     Bernard      add rt_tick_set function.
+ * 2017-06-22     agent        add rt_tick_compensate for tickless idle.
+ * 2017-06-24     agent        the tick of each cpu on SMP.
+ * 2017-07-03     agent        add the default cycle counter of OS tick.
+ * 2017-07-06     agent        account the budget of deadline thread.
  */
 
 #include <rthw.h>
@@ -79,12 +83,18 @@ void rt_tick_set(rt_tick_t tick)
 /**
  * This function will notify kernel there is one tick passed. Normally,
  * this function is invoked by clock ISR.
+ *
+ * @note On SMP, it's invoked by the tick ISR of each cpu, and the global tick
+ * and timers are handled by the first cpu.
  */
 void rt_tick_increase(void)
 {
     struct rt_thread *thread;
 
     /* increase the global tick */
+#ifdef RT_USING_SMP
+    if (rt_hw_cpu_id() == 0)
+#endif
     ++ rt_tick;
 
     /* check time slice */
@@ -100,10 +110,38 @@ void rt_tick_increase(void)
         rt_thread_yield();
     }
 
+#ifdef RT_USING_DEADLINE
+    /* account the budget of deadline thread */
+    if (thread->deadline.period != 0)
+        rt_thread_deadline_tick(thread);
+#endif
+
     /* check timer */
+#ifdef RT_USING_SMP
+    if (rt_hw_cpu_id() == 0)
+#endif
     rt_timer_check();
 }
 
+#ifdef RT_USING_TICKLESS
+/**
+ * This function will notify kernel there are ticks passed without tick
+ * interrupt. It's invoked by the idle thread after a tickless sleep to fix up
+ * the system tick, with the interrupt disabled. The timeout timers are checked
+ * by the caller after enabling the interrupt.
+ *
+ * @param ticks the passed ticks which are not reported by rt_tick_increase
+ */
+void rt_tick_compensate(rt_tick_t ticks)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    rt_tick += ticks;
+    rt_hw_interrupt_enable(level);
+}
+#endif
+
 /**
  * This function will calculate the tick from millisecond.
  *
@@ -118,5 +156,23 @@ rt_tick_t rt_tick_from_millisecond(rt_uint32_t ms)
 }
 RTM_EXPORT(rt_tick_from_millisecond);
 
+/*
+ * The default cycle counter is the OS tick. The CPU port overrides them with a
+ * counter of high resolution.
+ */
+WEAK void rt_hw_cycle_init(void)
+{
+}
+
+WEAK rt_uint32_t rt_hw_cycle_get(void)
+{
+    return rt_tick;
+}
+
+WEAK rt_uint32_t rt_hw_cycle_frequency(void)
+{
+    return RT_TICK_PER_SECOND;
+}
+
 /**@}*/
 
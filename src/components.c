@@ -28,6 +28,7 @@
  * 2015-05-04     Bernard      Rename it to components.c because compiling issue
  *                             in some IDEs.
  * 2015-07-29     Arda.Fu      Add support to use RT_USING_USER_MAIN with IAR
+ * 2017-07-04     agent        Add interrupt thread initialization
  */
 
 #include <rthw.h>
@@ -237,6 +238,11 @@ int rtthread_startup(void)
     /* timer thread initialization */
     rt_system_timer_thread_init();
 
+#ifdef RT_USING_IRQ_THREAD
+    /* interrupt thread initialization */
+    rt_system_irq_thread_init();
+#endif
+
     /* idle thread initialization */
     rt_thread_idle_init();
 
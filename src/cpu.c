@@ -0,0 +1,125 @@
+/*
+ * File      : cpu.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2006 - 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-06-24     agent        the first version
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+
+#ifdef RT_USING_SMP
+static struct rt_cpu rt_cpus[RT_CPUS_NR];
+
+/* the kernel lock shared by all CPUs */
+rt_hw_spinlock_t _cpus_lock;
+
+/**
+ * @addtogroup Kernel
+ */
+
+/**@{*/
+
+/**
+ * This function will return the structure of current cpu.
+ *
+ * @return the structure of current cpu
+ *
+ * @note the caller shall disable local interrupt, or the thread may be
+ * migrated to other cpu.
+ */
+struct rt_cpu *rt_cpu_self(void)
+{
+    return &rt_cpus[rt_hw_cpu_id()];
+}
+
+/**
+ * This function will return the structure of the specified cpu.
+ *
+ * @param index the index of cpu
+ *
+ * @return the structure of cpu
+ */
+struct rt_cpu *rt_cpu_index(int index)
+{
+    return &rt_cpus[index];
+}
+
+/**
+ * This function will disable local interrupt and take the kernel lock. The
+ * kernel lock is recursive, the nest is recorded in the current thread.
+ *
+ * @return the local interrupt level
+ */
+rt_base_t rt_cpus_lock(void)
+{
+    rt_base_t level;
+    struct rt_cpu *pcpu;
+
+    level = rt_hw_local_irq_disable();
+
+    pcpu = rt_cpu_self();
+    if (pcpu->current_thread != RT_NULL)
+    {
+        if (pcpu->current_thread->cpus_lock_nest ++ == 0)
+            rt_hw_spin_lock(&_cpus_lock);
+    }
+
+    return level;
+}
+
+/**
+ * This function will release the kernel lock and restore local interrupt.
+ *
+ * @param level the local interrupt level returned by rt_cpus_lock
+ */
+void rt_cpus_unlock(rt_base_t level)
+{
+    struct rt_cpu *pcpu = rt_cpu_self();
+
+    if (pcpu->current_thread != RT_NULL)
+    {
+        if (-- pcpu->current_thread->cpus_lock_nest == 0)
+            rt_hw_spin_unlock(&_cpus_lock);
+    }
+
+    rt_hw_local_irq_enable(level);
+}
+
+/**
+ * This function will set the switched thread as the current thread of cpu
+ * and pass the kernel lock to it. It's invoked by the port in the context of
+ * the new thread after thread switch.
+ *
+ * @param thread the new thread
+ */
+void rt_cpus_lock_status_restore(struct rt_thread *thread)
+{
+    struct rt_cpu *pcpu = rt_cpu_self();
+
+    pcpu->current_thread = thread;
+
+    /* the thread is running for the first time, which doesn't hold the lock */
+    if (thread->cpus_lock_nest == 0)
+        rt_hw_spin_unlock(&_cpus_lock);
+}
+
+/**@}*/
+#endif
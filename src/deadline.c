@@ -0,0 +1,368 @@
+/*
+ * File      : deadline.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2006 - 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-07-06     agent        the first version
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+
+#ifdef RT_USING_DEADLINE
+/*
+ * The deadline threads run in the priority band of RT_DEADLINE_PRIORITY, the
+ * ready threads of this priority are sorted by the absolute deadline of their
+ * current jobs, so the earliest deadline first among them. The threads of
+ * higher priority still preempt the deadline threads, and the lower priority
+ * threads run when all of jobs are done.
+ *
+ * A thread is admitted when the sum of budget/deadline of the deadline threads
+ * on its cpu is not more than RT_DEADLINE_UTILIZATION, which is sufficient for
+ * EDF when the deadline is not less than period. On SMP, the deadline thread
+ * is bound to the cpu it's admitted on, which is partitioned EDF.
+ *
+ * The budget is accounted in ticks. A job running out of its budget is
+ * throttled until the next period, it won't disturb the other jobs.
+ */
+
+#ifdef RT_USING_SMP
+#define DEADLINE_CPUS_NR    RT_CPUS_NR
+#else
+#define DEADLINE_CPUS_NR    1
+#endif
+
+/* the admitted density of each cpu, in permille */
+static rt_uint32_t rt_deadline_density[DEADLINE_CPUS_NR];
+
+/* release a job of the thread in each period */
+static void _rt_deadline_release(void *parameter)
+{
+    register rt_base_t level;
+    struct rt_thread *thread;
+    struct rt_deadline *dl;
+
+    thread = (struct rt_thread *)parameter;
+    dl = &(thread->deadline);
+
+    level = rt_hw_interrupt_disable();
+
+    /* the current job is not done before the next release */
+    if (dl->completed != dl->released)
+        dl->misses ++;
+
+    dl->released ++;
+    dl->abs_deadline = rt_tick_get() + dl->deadline;
+    dl->remaining    = dl->budget;
+
+    if (dl->flag & (RT_DEADLINE_FLAG_THROTTLED | RT_DEADLINE_FLAG_WAITING))
+    {
+        dl->flag &= ~(RT_DEADLINE_FLAG_THROTTLED | RT_DEADLINE_FLAG_WAITING);
+        rt_thread_resume(thread);
+    }
+    else if (thread->stat == RT_THREAD_READY)
+    {
+        /* the deadline is changed, sort it in the ready queue again */
+        rt_schedule_remove_thread(thread);
+        rt_schedule_insert_thread(thread);
+    }
+
+    rt_hw_interrupt_enable(level);
+
+    rt_schedule();
+}
+
+/**
+ * @addtogroup Thread
+ */
+
+/**@{*/
+
+/**
+ * This function will set the deadline scheduling parameters of a thread which
+ * is not started. The thread is admitted if its cpu has enough utilization,
+ * and its priority is set to RT_DEADLINE_PRIORITY.
+ *
+ * @param thread the thread not started
+ * @param period the period of jobs in ticks
+ * @param budget the execution budget of each job in ticks
+ * @param deadline the relative deadline of each job in ticks
+ *
+ * @return RT_EOK on OK, -RT_EFULL if the thread is not admitted, -RT_ERROR
+ * on the wrong parameters.
+ */
+rt_err_t rt_thread_deadline_set(rt_thread_t thread,
+                                rt_tick_t   period,
+                                rt_tick_t   budget,
+                                rt_tick_t   deadline)
+{
+    register rt_base_t level;
+    rt_uint32_t density;
+    int cpu = 0;
+
+    RT_ASSERT(thread != RT_NULL);
+
+    if (budget == 0 || budget > deadline || deadline > period ||
+        period >= RT_TICK_MAX / 2)
+        return -RT_ERROR;
+
+    /* round up, the admission shall not be optimistic */
+    density = (budget * 1000 + deadline - 1) / deadline;
+
+    level = rt_hw_interrupt_disable();
+
+    if (thread->stat != RT_THREAD_INIT || thread->deadline.period != 0)
+    {
+        rt_hw_interrupt_enable(level);
+
+        return -RT_ERROR;
+    }
+
+#ifdef RT_USING_SMP
+    if (thread->bind_cpu != RT_CPUS_NR)
+        cpu = thread->bind_cpu;
+    else
+    {
+        int index;
+
+        /* the least loaded cpu */
+        for (index = 1; index < RT_CPUS_NR; index ++)
+        {
+            if (rt_deadline_density[index] < rt_deadline_density[cpu])
+                cpu = index;
+        }
+    }
+#endif
+
+    if (rt_deadline_density[cpu] + density > RT_DEADLINE_UTILIZATION * 10)
+    {
+        rt_hw_interrupt_enable(level);
+
+        return -RT_EFULL;
+    }
+    rt_deadline_density[cpu] += density;
+
+    thread->deadline.period   = period;
+    thread->deadline.budget   = budget;
+    thread->deadline.deadline = deadline;
+    thread->deadline.density  = density;
+#ifdef RT_USING_SMP
+    thread->deadline.cpu = cpu;
+    thread->bind_cpu     = cpu;
+#endif
+    thread->init_priority = RT_DEADLINE_PRIORITY;
+
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_thread_deadline_set);
+
+#ifdef RT_USING_HEAP
+/**
+ * This function will create a deadline thread, which is admitted and in the
+ * priority of RT_DEADLINE_PRIORITY.
+ *
+ * @param name the name of thread
+ * @param entry the entry function of thread
+ * @param parameter the parameter of thread enter function
+ * @param stack_size the size of thread stack
+ * @param period the period of jobs in ticks
+ * @param budget the execution budget of each job in ticks
+ * @param deadline the relative deadline of each job in ticks
+ *
+ * @return the created thread object, RT_NULL if it's not admitted
+ */
+rt_thread_t rt_thread_deadline_create(const char *name,
+                                      void (*entry)(void *parameter),
+                                      void       *parameter,
+                                      rt_uint32_t stack_size,
+                                      rt_tick_t   period,
+                                      rt_tick_t   budget,
+                                      rt_tick_t   deadline)
+{
+    rt_thread_t thread;
+
+    /* the jobs of same deadline run in turn of budget */
+    thread = rt_thread_create(name, entry, parameter, stack_size,
+                              RT_DEADLINE_PRIORITY, budget == 0 ? 1 : budget);
+    if (thread == RT_NULL)
+        return RT_NULL;
+
+    if (rt_thread_deadline_set(thread, period, budget, deadline) != RT_EOK)
+    {
+        rt_thread_delete(thread);
+
+        return RT_NULL;
+    }
+
+    return thread;
+}
+RTM_EXPORT(rt_thread_deadline_create);
+#endif
+
+/**
+ * This function will complete the current job of deadline thread, and
+ * suspend the thread until the next job is released. It returns at once if
+ * there is a released job not done.
+ *
+ * @return RT_EOK on OK, -RT_ERROR if it's not a deadline thread
+ */
+rt_err_t rt_thread_deadline_wait(void)
+{
+    register rt_base_t level;
+    struct rt_thread *thread;
+    struct rt_deadline *dl;
+
+    thread = rt_thread_self();
+    dl = &(thread->deadline);
+    if (dl->period == 0)
+        return -RT_ERROR;
+
+    level = rt_hw_interrupt_disable();
+
+    dl->completed ++;
+    if (dl->completed != dl->released)
+    {
+        /* the miss of late job has been counted in its release */
+        rt_hw_interrupt_enable(level);
+
+        return RT_EOK;
+    }
+
+    if ((rt_int32_t)(rt_tick_get() - dl->abs_deadline) > 0)
+        dl->misses ++;
+
+    dl->flag |= RT_DEADLINE_FLAG_WAITING;
+    rt_thread_suspend(thread);
+
+    rt_hw_interrupt_enable(level);
+
+    rt_schedule();
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_thread_deadline_wait);
+
+/**
+ * This function will get the admitted utilization of deadline threads on cpu.
+ *
+ * @param cpu the cpu index, 0 on single cpu
+ *
+ * @return the utilization in permille
+ */
+rt_uint32_t rt_deadline_utilization(int cpu)
+{
+    if (cpu < 0 || cpu >= DEADLINE_CPUS_NR)
+        return 0;
+
+    return rt_deadline_density[cpu];
+}
+RTM_EXPORT(rt_deadline_utilization);
+
+/**@}*/
+
+/*
+ * This function will release the first job of deadline thread, it's invoked
+ * when the thread is started.
+ */
+void rt_thread_deadline_start(struct rt_thread *thread)
+{
+    struct rt_deadline *dl = &(thread->deadline);
+
+    dl->released     = 1;
+    dl->completed    = 0;
+    dl->misses       = 0;
+    dl->throttled    = 0;
+    dl->flag         = 0;
+    dl->abs_deadline = rt_tick_get() + dl->deadline;
+    dl->remaining    = dl->budget;
+
+    rt_timer_init(&(dl->timer), thread->name, _rt_deadline_release, thread,
+                  dl->period, RT_TIMER_FLAG_PERIODIC | RT_TIMER_FLAG_HARD_TIMER);
+    rt_timer_start(&(dl->timer));
+}
+
+/*
+ * This function will stop releasing the jobs and give back the utilization,
+ * it's invoked when the thread is closed.
+ */
+void rt_thread_deadline_close(struct rt_thread *thread)
+{
+    register rt_base_t level;
+    struct rt_deadline *dl = &(thread->deadline);
+    int cpu = 0;
+
+    level = rt_hw_interrupt_disable();
+
+    if (dl->period == 0)
+    {
+        rt_hw_interrupt_enable(level);
+
+        return;
+    }
+
+    if (thread->stat != RT_THREAD_INIT)
+        rt_timer_detach(&(dl->timer));
+
+#ifdef RT_USING_SMP
+    cpu = dl->cpu;
+#endif
+    rt_deadline_density[cpu] -= dl->density;
+    dl->period = 0;
+    dl->flag   = 0;
+
+    rt_hw_interrupt_enable(level);
+}
+
+/*
+ * This function will account the budget of running deadline thread in each
+ * tick, the thread is throttled when its budget runs out.
+ */
+void rt_thread_deadline_tick(struct rt_thread *thread)
+{
+    register rt_base_t level;
+    struct rt_deadline *dl = &(thread->deadline);
+
+    level = rt_hw_interrupt_disable();
+
+    if (thread->stat != RT_THREAD_READY || dl->remaining == 0)
+    {
+        rt_hw_interrupt_enable(level);
+
+        return;
+    }
+
+    dl->remaining --;
+    if (dl->remaining == 0)
+    {
+        dl->flag |= RT_DEADLINE_FLAG_THROTTLED;
+        dl->throttled ++;
+        rt_thread_suspend(thread);
+
+        rt_hw_interrupt_enable(level);
+
+        rt_schedule();
+
+        return;
+    }
+
+    rt_hw_interrupt_enable(level);
+}
+#endif
@@ -25,6 +25,8 @@
  * 2013-12-21     Grissiom     let rt_thread_idle_excute loop until there is no
  *                             dead thread.
  * 2016-08-09     ArdaFu       add method to get the handler of the idle thread.
+ * 2017-06-22     agent        add tickless idle.
+ * 2017-06-24     agent        add idle thread for each cpu on SMP.
  */
 
 #include <rthw.h>
@@ -44,9 +46,25 @@
 #endif
 #endif
 
+#ifdef RT_USING_SMP
+static struct rt_thread idle[RT_CPUS_NR];
+ALIGN(RT_ALIGN_SIZE)
+static rt_uint8_t rt_thread_stack[RT_CPUS_NR][IDLE_THREAD_STACK_SIZE];
+
+/*
+ * The cleanup of defunct thread may be blocked on the heap lock held by the
+ * thread on other cpu, but the idle thread shall never be blocked. So the
+ * cleanup is done by the defunct thread, which is woken up by idle threads.
+ */
+static struct rt_thread defunct;
+ALIGN(RT_ALIGN_SIZE)
+static rt_uint8_t defunct_stack[IDLE_THREAD_STACK_SIZE];
+static struct rt_semaphore defunct_sem;
+#else
 static struct rt_thread idle;
 ALIGN(RT_ALIGN_SIZE)
 static rt_uint8_t rt_thread_stack[IDLE_THREAD_STACK_SIZE];
+#endif
 
 extern rt_list_t rt_thread_defunct;
 
@@ -110,6 +128,25 @@ void rt_thread_idle_excute(void)
             thread = rt_list_entry(rt_thread_defunct.next,
                                    struct rt_thread,
                                    tlist);
+#ifdef RT_USING_SMP
+            /* the thread is still running on other cpu, clean it up later */
+            if (thread->oncpu != RT_CPU_DETACHED)
+            {
+                rt_hw_interrupt_enable(lock);
+
+                return;
+            }
+#endif
+#ifdef RT_USING_SLAB_CACHE
+            if (thread->heap_cache != RT_NULL)
+            {
+                rt_hw_interrupt_enable(lock);
+
+                /* the thread is off cpu, give back its cached memory */
+                rt_slab_cache_flush(thread);
+                continue;
+            }
+#endif
 #ifdef RT_USING_MODULE
             /* get thread's parent module */
             module = (rt_module_t)thread->module_id;
@@ -181,6 +218,71 @@ void rt_thread_idle_excute(void)
     }
 }
 
+#ifdef RT_USING_TICKLESS
+#ifndef RT_TICKLESS_THRESHOLD
+#define RT_TICKLESS_THRESHOLD   2
+#endif
+
+/*
+ * Stop the periodic tick and sleep until the next timer timeout, then fix up
+ * the system tick with the ticks passed during the sleep.
+ */
+static void rt_thread_idle_tickless(void)
+{
+    rt_base_t level;
+    rt_tick_t timeout, ticks = 0;
+
+    level = rt_hw_interrupt_disable();
+
+    /*
+     * There are other threads with the idle priority ready, they need the
+     * tick to do round-robin scheduling.
+     */
+    if (idle.tlist.next != idle.tlist.prev)
+    {
+        rt_hw_interrupt_enable(level);
+        return;
+    }
+
+    timeout = rt_timer_next_timeout_tick();
+    if (timeout != RT_TICK_MAX)
+    {
+        timeout = timeout - rt_tick_get();
+        /* the timer is timeout already */
+        if (timeout >= RT_TICK_MAX / 2)
+            timeout = 0;
+    }
+
+    if (timeout >= RT_TICKLESS_THRESHOLD)
+    {
+#ifdef RT_USING_CPU_USAGE
+        rt_cpu_usage_sleep_enter();
+#endif
+        /* the port may wake up earlier on other interrupts */
+        ticks = rt_hw_tickless_sleep(timeout);
+    }
+
+    if (ticks != 0)
+    {
+        rt_tick_compensate(ticks);
+#ifdef RT_USING_CPU_USAGE
+        /* the cycle counter may wrap in a long sleep */
+        rt_cpu_usage_sleep_leave(ticks);
+#endif
+        /* lock scheduler to handle all timeout timers before switching */
+        rt_enter_critical();
+    }
+
+    rt_hw_interrupt_enable(level);
+
+    if (ticks != 0)
+    {
+        rt_timer_check();
+        rt_exit_critical();
+    }
+}
+#endif
+
 static void rt_thread_idle_entry(void *parameter)
 {
     while (1)
@@ -192,9 +294,38 @@ static void rt_thread_idle_entry(void *parameter)
         }
     #endif
 
+#ifdef RT_USING_SMP
+        if (_has_defunct_thread())
+        {
+            rt_base_t level;
+
+            /* wake up the defunct thread */
+            level = rt_hw_interrupt_disable();
+            if (RT_SEM_VALUE(&defunct_sem) == 0)
+                rt_sem_release(&defunct_sem);
+            rt_hw_interrupt_enable(level);
+        }
+#else
+        rt_thread_idle_excute();
+#endif
+
+#ifdef RT_USING_TICKLESS
+        rt_thread_idle_tickless();
+#endif
+    }
+}
+
+#ifdef RT_USING_SMP
+static void rt_thread_defunct_entry(void *parameter)
+{
+    while (1)
+    {
+        rt_sem_take(&defunct_sem, RT_WAITING_FOREVER);
+
         rt_thread_idle_excute();
     }
 }
+#endif
 
 /**
  * @ingroup SystemInit
@@ -205,6 +336,42 @@ static void rt_thread_idle_entry(void *parameter)
  */
 void rt_thread_idle_init(void)
 {
+#ifdef RT_USING_SMP
+    rt_uint8_t cpu;
+    char name[RT_NAME_MAX];
+
+    for (cpu = 0; cpu < RT_CPUS_NR; cpu ++)
+    {
+        rt_snprintf(name, sizeof(name), "tidle%d", cpu);
+
+        /* initialize thread */
+        rt_thread_init(&idle[cpu],
+                       name,
+                       rt_thread_idle_entry,
+                       RT_NULL,
+                       &rt_thread_stack[cpu][0],
+                       sizeof(rt_thread_stack[cpu]),
+                       RT_THREAD_PRIORITY_MAX - 1,
+                       32);
+
+        /* each cpu has its own idle thread */
+        rt_thread_control(&idle[cpu], RT_THREAD_CTRL_BIND_CPU, &cpu);
+
+        /* startup */
+        rt_thread_startup(&idle[cpu]);
+    }
+
+    rt_sem_init(&defunct_sem, "defunct", 0, RT_IPC_FLAG_FIFO);
+    rt_thread_init(&defunct,
+                   "defunct",
+                   rt_thread_defunct_entry,
+                   RT_NULL,
+                   &defunct_stack[0],
+                   sizeof(defunct_stack),
+                   RT_THREAD_PRIORITY_MAX - 1,
+                   32);
+    rt_thread_startup(&defunct);
+#else
     /* initialize thread */
     rt_thread_init(&idle,
                    "tidle",
@@ -217,6 +384,7 @@ void rt_thread_idle_init(void)
 
     /* startup */
     rt_thread_startup(&idle);
+#endif
 }
 
 /**
@@ -227,5 +395,10 @@ void rt_thread_idle_init(void)
  */
 rt_thread_t rt_thread_idle_gethandler(void)
 {
+#ifdef RT_USING_SMP
+    /* the idle thread of current cpu */
+    return (rt_thread_t)(&idle[rt_hw_cpu_id()]);
+#else
     return (rt_thread_t)(&idle);
+#endif
 }
@@ -46,6 +46,10 @@
  * 2010-11-10     Bernard      add IPC reset command implementation.
  * 2011-12-18     Bernard      add more parameter checking in message queue
  * 2013-09-14     Grissiom     add an option check in rt_event_recv
+ * 2017-06-29     agent        add zero-copy interface of message queue
+ * 2017-07-05     agent        add lock-free fast path of semaphore and mutex,
+ *                             and transitive priority inheritance of mutex
+ * 2017-07-10     agent        allocate message pool in fast memory region.
  */
 
 #include <rtthread.h>
@@ -222,7 +226,7 @@ rt_err_t rt_sem_init(rt_sem_t    sem,
     rt_ipc_object_init(&(sem->parent));
 
     /* set init value */
-    sem->value = value;
+    sem->value = value & ~RT_SEM_WAITERS;
 
     /* set parent */
     sem->parent.parent.flag = flag;
@@ -281,7 +285,7 @@ rt_sem_t rt_sem_create(const char *name, rt_uint32_t value, rt_uint8_t flag)
     rt_ipc_object_init(&(sem->parent));
 
     /* set init value */
-    sem->value = value;
+    sem->value = value & ~RT_SEM_WAITERS;
 
     /* set parent */
     sem->parent.parent.flag = flag;
@@ -329,23 +333,48 @@ rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time)
 {
     register rt_base_t temp;
     struct rt_thread *thread;
+    rt_uint32_t value, newval;
 
     RT_ASSERT(sem != RT_NULL);
 
     RT_OBJECT_HOOK_CALL(rt_object_trytake_hook, (&(sem->parent.parent)));
 
+    /* semaphore is available and no thread is waiting, take it directly */
+    value = sem->value;
+    if (value != 0 && !(value & RT_SEM_WAITERS) &&
+        rt_hw_cas(&(sem->value), value, value - 1))
+    {
+        RT_OBJECT_HOOK_CALL(rt_object_take_hook, (&(sem->parent.parent)));
+
+        return RT_EOK;
+    }
+
     /* disable interrupt */
     temp = rt_hw_interrupt_disable();
 
     RT_DEBUG_LOG(RT_DEBUG_IPC, ("thread %s take sem:%s, which value is: %d\n",
                                 rt_thread_self()->name,
                                 ((struct rt_object *)sem)->name,
-                                sem->value));
+                                RT_SEM_VALUE(sem)));
+
+    /*
+     * The value may be changed by the lock-free path of others, set the
+     * waiters flag before suspend, which forces the release to resume us.
+     */
+    do
+    {
+        value = sem->value;
+        if (value & ~RT_SEM_WAITERS)
+            newval = value - 1;
+        else if (time == 0)
+            break;
+        else
+            newval = value | RT_SEM_WAITERS;
+    } while (!rt_hw_cas(&(sem->value), value, newval));
 
-    if (sem->value > 0)
+    if (value & ~RT_SEM_WAITERS)
     {
         /* semaphore is available */
-        sem->value --;
 
         /* enable interrupt */
         rt_hw_interrupt_enable(temp);
@@ -436,9 +465,16 @@ rt_err_t rt_sem_release(rt_sem_t sem)
 {
     register rt_base_t temp;
     register rt_bool_t need_schedule;
+    rt_uint32_t value;
 
     RT_OBJECT_HOOK_CALL(rt_object_put_hook, (&(sem->parent.parent)));
 
+    /* no thread is waiting, increase value directly */
+    value = sem->value;
+    if (!(value & RT_SEM_WAITERS) &&
+        rt_hw_cas(&(sem->value), value, value + 1))
+        return RT_EOK;
+
     need_schedule = RT_FALSE;
 
     /* disable interrupt */
@@ -447,16 +483,26 @@ rt_err_t rt_sem_release(rt_sem_t sem)
     RT_DEBUG_LOG(RT_DEBUG_IPC, ("thread %s releases sem:%s, which value is: %d\n",
                                 rt_thread_self()->name,
                                 ((struct rt_object *)sem)->name,
-                                sem->value));
+                                RT_SEM_VALUE(sem)));
 
     if (!rt_list_isempty(&sem->parent.suspend_thread))
     {
         /* resume the suspended thread */
         rt_ipc_list_resume(&(sem->parent.suspend_thread));
         need_schedule = RT_TRUE;
+
+        /* the value is not changed by others when waiters flag is set */
+        if (rt_list_isempty(&sem->parent.suspend_thread))
+            sem->value &= ~RT_SEM_WAITERS;
     }
     else
-        sem->value ++; /* increase value */
+    {
+        /* increase value, and clear the flag left by the timeout threads */
+        do
+        {
+            value = sem->value;
+        } while (!rt_hw_cas(&(sem->value), value, (value & ~RT_SEM_WAITERS) + 1));
+    }
 
     /* enable interrupt */
     rt_hw_interrupt_enable(temp);
@@ -495,8 +541,8 @@ rt_err_t rt_sem_control(rt_sem_t sem, rt_uint8_t cmd, void *arg)
         /* resume all waiting thread */
         rt_ipc_list_resume_all(&sem->parent.suspend_thread);
 
-        /* set new value */
-        sem->value = (rt_uint16_t)value;
+        /* set new value, there is no waiting thread now */
+        sem->value = value & ~RT_SEM_WAITERS;
 
         /* enable interrupt */
         rt_hw_interrupt_enable(level);
@@ -536,6 +582,7 @@ rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag)
     mutex->owner = RT_NULL;
     mutex->original_priority = 0xFF;
     mutex->hold  = 0;
+    mutex->lock  = 0;
 
     /* set flag */
     mutex->parent.parent.flag = flag;
@@ -596,6 +643,7 @@ rt_mutex_t rt_mutex_create(const char *name, rt_uint8_t flag)
     mutex->owner              = RT_NULL;
     mutex->original_priority  = 0xFF;
     mutex->hold               = 0;
+    mutex->lock               = 0;
 
     /* set flag */
     mutex->parent.parent.flag = flag;
@@ -630,10 +678,163 @@ rt_err_t rt_mutex_delete(rt_mutex_t mutex)
 RTM_EXPORT(rt_mutex_delete);
 #endif
 
+/*
+ * This function will set the owner of mutex, it's invoked by the owner thread
+ * after the lock word is taken, or by the releasing thread which hands the
+ * mutex over to a waiting thread.
+ *
+ * The original priority is got before the lock word is taken: the owner may
+ * be preempted once the lock word is published, and raised by a waiting
+ * thread before it sets the owner.
+ */
+rt_inline void _rt_mutex_set_owner(rt_mutex_t mutex, struct rt_thread *thread,
+                                   rt_uint8_t priority)
+{
+    mutex->value             = 0;
+    mutex->owner             = thread;
+    mutex->original_priority = priority;
+    mutex->hold              = 1;
+}
+
+rt_inline void _rt_mutex_clear_owner(rt_mutex_t mutex)
+{
+    mutex->value             = 1;
+    mutex->owner             = RT_NULL;
+    mutex->original_priority = 0xff;
+    mutex->hold              = 0;
+}
+
+/*
+ * This function will raise the priority of owner thread to the priority of
+ * waiting thread, and the owners of the mutexes which the owners are waiting
+ * for along the chain. It's invoked with interrupt disabled.
+ */
+static void _rt_mutex_inherit_priority(struct rt_thread *owner, rt_uint8_t priority)
+{
+    int depth;
+    struct rt_mutex *mutex;
+
+    for (depth = 0; depth < RT_MUTEX_PI_DEPTH && owner != RT_NULL; depth ++)
+    {
+        /* the rest of chain has been raised by the owner when it waits */
+        if (priority >= owner->current_priority)
+            break;
+
+        /* change the owner thread priority */
+        rt_thread_control(owner, RT_THREAD_CTRL_CHANGE_PRIORITY, &priority);
+
+        mutex = owner->pending_mutex;
+        if (mutex == RT_NULL)
+            break;
+        owner = (struct rt_thread *)(mutex->lock & ~RT_MUTEX_WAITERS);
+    }
+}
+
+/*
+ * This function will take a mutex held by other thread, or wait for it.
+ */
+static rt_err_t _rt_mutex_take_wait(rt_mutex_t mutex,
+                                    struct rt_thread *thread,
+                                    rt_int32_t time)
+{
+    register rt_base_t temp;
+    rt_uint32_t lock, newlock;
+
+    /* disable interrupt */
+    temp = rt_hw_interrupt_disable();
+
+    RT_DEBUG_LOG(RT_DEBUG_IPC,
+                 ("mutex_take: current thread %s, mutex value: %d, hold: %d\n",
+                  thread->name, mutex->value, mutex->hold));
+
+    /*
+     * The mutex may be released by the lock-free path of owner, set the
+     * waiters flag before suspend, which forces the owner to resume us.
+     */
+    do
+    {
+        lock = mutex->lock;
+        if (lock == 0)
+            newlock = (rt_uint32_t)thread;
+        else if (time == 0)
+            break;
+        else
+            newlock = lock | RT_MUTEX_WAITERS;
+    } while (!rt_hw_cas(&(mutex->lock), lock, newlock));
+
+    if (lock == 0)
+    {
+        /* mutex is available */
+        _rt_mutex_set_owner(mutex, thread, thread->current_priority);
+
+        /* enable interrupt */
+        rt_hw_interrupt_enable(temp);
+
+        return RT_EOK;
+    }
+
+    /* no waiting, return with timeout */
+    if (time == 0)
+    {
+        /* set error as timeout */
+        thread->error = -RT_ETIMEOUT;
+
+        /* enable interrupt */
+        rt_hw_interrupt_enable(temp);
+
+        return -RT_ETIMEOUT;
+    }
+
+    /* mutex is unavailable, push to suspend list */
+    RT_DEBUG_LOG(RT_DEBUG_IPC, ("mutex_take: suspend thread: %s\n",
+                                thread->name));
+
+    /* change the owner thread priority of mutex */
+    _rt_mutex_inherit_priority((struct rt_thread *)(lock & ~RT_MUTEX_WAITERS),
+                               thread->current_priority);
+
+    /* suspend current thread */
+    thread->pending_mutex = mutex;
+    rt_ipc_list_suspend(&(mutex->parent.suspend_thread),
+                        thread,
+                        mutex->parent.parent.flag);
+
+    /* has waiting time, start thread timer */
+    if (time > 0)
+    {
+        RT_DEBUG_LOG(RT_DEBUG_IPC,
+                     ("mutex_take: start the timer of thread:%s\n",
+                      thread->name));
+
+        /* reset the timeout of thread timer and start it */
+        rt_timer_control(&(thread->thread_timer),
+                         RT_TIMER_CTRL_SET_TIME,
+                         &time);
+        rt_timer_start(&(thread->thread_timer));
+    }
+
+    /* enable interrupt */
+    rt_hw_interrupt_enable(temp);
+
+    /* do schedule */
+    rt_schedule();
+
+    /* the mutex is handed over by owner, or it's timeout */
+    temp = rt_hw_interrupt_disable();
+    thread->pending_mutex = RT_NULL;
+    rt_hw_interrupt_enable(temp);
+
+    return thread->error;
+}
+
 /**
  * This function will take a mutex, if the mutex is unavailable, the
  * thread shall wait for a specified time.
  *
+ * The mutex is taken by compare and swap of the lock word without interrupt
+ * disabled if it's free, the owner thread is raised to the priority of the
+ * waiting thread otherwise.
+ *
  * @param mutex the mutex object
  * @param time the waiting time
  *
@@ -641,120 +842,43 @@ RTM_EXPORT(rt_mutex_delete);
  */
 rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
 {
-    register rt_base_t temp;
     struct rt_thread *thread;
+    rt_uint32_t lock;
+    rt_uint8_t priority;
+    rt_err_t result;
 
     /* this function must not be used in interrupt even if time = 0 */
     RT_DEBUG_IN_THREAD_CONTEXT;
 
     RT_ASSERT(mutex != RT_NULL);
 
-    /* disable interrupt */
-    temp = rt_hw_interrupt_disable();
-
     /* get current thread */
     thread = rt_thread_self();
 
     RT_OBJECT_HOOK_CALL(rt_object_trytake_hook, (&(mutex->parent.parent)));
 
-    RT_DEBUG_LOG(RT_DEBUG_IPC,
-                 ("mutex_take: current thread %s, mutex value: %d, hold: %d\n",
-                  thread->name, mutex->value, mutex->hold));
-
     /* reset thread error */
     thread->error = RT_EOK;
 
-    if (mutex->owner == thread)
+    lock = mutex->lock;
+    priority = thread->current_priority;
+    if ((lock & ~RT_MUTEX_WAITERS) == (rt_uint32_t)thread)
     {
         /* it's the same thread */
         mutex->hold ++;
     }
+    else if (lock == 0 && rt_hw_cas(&(mutex->lock), 0, (rt_uint32_t)thread))
+    {
+        /* mutex is available, set mutex owner and original priority */
+        _rt_mutex_set_owner(mutex, thread, priority);
+    }
     else
     {
-        /* The value of mutex is 1 in initial status. Therefore, if the
-         * value is great than 0, it indicates the mutex is avaible.
-         */
-        if (mutex->value > 0)
-        {
-            /* mutex is available */
-            mutex->value --;
-
-            /* set mutex owner and original priority */
-            mutex->owner             = thread;
-            mutex->original_priority = thread->current_priority;
-            mutex->hold ++;
-        }
-        else
-        {
-            /* no waiting, return with timeout */
-            if (time == 0)
-            {
-                /* set error as timeout */
-                thread->error = -RT_ETIMEOUT;
-
-                /* enable interrupt */
-                rt_hw_interrupt_enable(temp);
-
-                return -RT_ETIMEOUT;
-            }
-            else
-            {
-                /* mutex is unavailable, push to suspend list */
-                RT_DEBUG_LOG(RT_DEBUG_IPC, ("mutex_take: suspend thread: %s\n",
-                                            thread->name));
-
-                /* change the owner thread priority of mutex */
-                if (thread->current_priority < mutex->owner->current_priority)
-                {
-                    /* change the owner thread priority */
-                    rt_thread_control(mutex->owner,
-                                      RT_THREAD_CTRL_CHANGE_PRIORITY,
-                                      &thread->current_priority);
-                }
-
-                /* suspend current thread */
-                rt_ipc_list_suspend(&(mutex->parent.suspend_thread),
-                                    thread,
-                                    mutex->parent.parent.flag);
-
-                /* has waiting time, start thread timer */
-                if (time > 0)
-                {
-                    RT_DEBUG_LOG(RT_DEBUG_IPC,
-                                 ("mutex_take: start the timer of thread:%s\n",
-                                  thread->name));
-
-                    /* reset the timeout of thread timer and start it */
-                    rt_timer_control(&(thread->thread_timer),
-                                     RT_TIMER_CTRL_SET_TIME,
-                                     &time);
-                    rt_timer_start(&(thread->thread_timer));
-                }
-
-                /* enable interrupt */
-                rt_hw_interrupt_enable(temp);
-
-                /* do schedule */
-                rt_schedule();
-
-                if (thread->error != RT_EOK)
-                {
-                    /* return error */
-                    return thread->error;
-                }
-                else
-                {
-                    /* the mutex is taken successfully. */
-                    /* disable interrupt */
-                    temp = rt_hw_interrupt_disable();
-                }
-            }
-        }
+        result = _rt_mutex_take_wait(mutex, thread, time);
+        if (result != RT_EOK)
+            return result;
     }
 
-    /* enable interrupt */
-    rt_hw_interrupt_enable(temp);
-
     RT_OBJECT_HOOK_CALL(rt_object_take_hook, (&(mutex->parent.parent)));
 
     return RT_EOK;
@@ -774,6 +898,7 @@ rt_err_t rt_mutex_release(rt_mutex_t mutex)
     register rt_base_t temp;
     struct rt_thread *thread;
     rt_bool_t need_schedule;
+    rt_uint8_t priority;
 
     need_schedule = RT_FALSE;
 
@@ -783,9 +908,6 @@ rt_err_t rt_mutex_release(rt_mutex_t mutex)
     /* get current thread */
     thread = rt_thread_self();
 
-    /* disable interrupt */
-    temp = rt_hw_interrupt_disable();
-
     RT_DEBUG_LOG(RT_DEBUG_IPC,
                  ("mutex_release:current thread %s, mutex value: %d, hold: %d\n",
                   thread->name, mutex->value, mutex->hold));
@@ -793,59 +915,77 @@ rt_err_t rt_mutex_release(rt_mutex_t mutex)
     RT_OBJECT_HOOK_CALL(rt_object_put_hook, (&(mutex->parent.parent)));
 
     /* mutex only can be released by owner */
-    if (thread != mutex->owner)
+    if ((mutex->lock & ~RT_MUTEX_WAITERS) != (rt_uint32_t)thread)
     {
         thread->error = -RT_ERROR;
 
-        /* enable interrupt */
-        rt_hw_interrupt_enable(temp);
-
         return -RT_ERROR;
     }
 
     /* decrease hold */
     mutex->hold --;
-    /* if no hold */
-    if (mutex->hold == 0)
+    if (mutex->hold > 0)
+        return RT_EOK;
+
+    /* no thread is waiting and the priority is not raised, free it directly */
+    priority = mutex->original_priority;
+    if (mutex->lock == (rt_uint32_t)thread &&
+        priority == thread->current_priority)
     {
-        /* change the owner thread to original priority */
-        if (mutex->original_priority != mutex->owner->current_priority)
-        {
-            rt_thread_control(mutex->owner,
-                              RT_THREAD_CTRL_CHANGE_PRIORITY,
-                              &(mutex->original_priority));
-        }
+        _rt_mutex_clear_owner(mutex);
+        if (rt_hw_cas(&(mutex->lock), (rt_uint32_t)thread, 0))
+            return RT_EOK;
+
+        /* a thread is waiting now, it's released with interrupt disabled */
+        mutex->value             = 0;
+        mutex->owner             = thread;
+        mutex->original_priority = priority;
+    }
 
-        /* wakeup suspended thread */
-        if (!rt_list_isempty(&mutex->parent.suspend_thread))
-        {
-            /* get suspended thread */
-            thread = rt_list_entry(mutex->parent.suspend_thread.next,
-                                   struct rt_thread,
-                                   tlist);
+    /* disable interrupt */
+    temp = rt_hw_interrupt_disable();
 
-            RT_DEBUG_LOG(RT_DEBUG_IPC, ("mutex_release: resume thread: %s\n",
-                                        thread->name));
+    /* change the owner thread to original priority */
+    if (mutex->original_priority != thread->current_priority)
+    {
+        rt_thread_control(thread,
+                          RT_THREAD_CTRL_CHANGE_PRIORITY,
+                          &(mutex->original_priority));
+    }
 
-            /* set new owner and priority */
-            mutex->owner             = thread;
-            mutex->original_priority = thread->current_priority;
-            mutex->hold ++;
+    /* wakeup suspended thread */
+    if (!rt_list_isempty(&mutex->parent.suspend_thread))
+    {
+        /* get suspended thread */
+        thread = rt_list_entry(mutex->parent.suspend_thread.next,
+                               struct rt_thread,
+                               tlist);
 
-            /* resume thread */
-            rt_ipc_list_resume(&(mutex->parent.suspend_thread));
+        RT_DEBUG_LOG(RT_DEBUG_IPC, ("mutex_release: resume thread: %s\n",
+                                    thread->name));
 
-            need_schedule = RT_TRUE;
-        }
+        /* set new owner and priority */
+        _rt_mutex_set_owner(mutex, thread, thread->current_priority);
+
+        /* resume thread */
+        rt_ipc_list_resume(&(mutex->parent.suspend_thread));
+
+        /*
+         * Hand the lock word over to it, which is not changed by others
+         * when the waiters flag is set.
+         */
+        if (rt_list_isempty(&mutex->parent.suspend_thread))
+            mutex->lock = (rt_uint32_t)thread;
         else
-        {
-            /* increase value */
-            mutex->value ++;
+            mutex->lock = (rt_uint32_t)thread | RT_MUTEX_WAITERS;
 
-            /* clear owner */
-            mutex->owner             = RT_NULL;
-            mutex->original_priority = 0xff;
-        }
+        need_schedule = RT_TRUE;
+    }
+    else
+    {
+        /* clear owner, and the flag left by the timeout threads */
+        _rt_mutex_clear_owner(mutex);
+        mutex->lock = 0;
     }
 
     /* enable interrupt */
@@ -1849,7 +1989,12 @@ rt_mq_t rt_mq_create(const char *name,
     mq->max_msgs = max_msgs;
 
     /* allocate message pool */
+#if defined(RT_USING_MEMHEAP_REGION) && defined(RT_MQ_POOL_FAST)
+    mq->msg_pool = rt_malloc_region((mq->msg_size + sizeof(struct rt_mq_message))* mq->max_msgs,
+                                    RT_MEM_FAST);
+#else
     mq->msg_pool = RT_KERNEL_MALLOC((mq->msg_size + sizeof(struct rt_mq_message))* mq->max_msgs);
+#endif
     if (mq->msg_pool == RT_NULL)
     {
         rt_mq_delete(mq);
@@ -1913,54 +2058,48 @@ rt_err_t rt_mq_delete(rt_mq_t mq)
 RTM_EXPORT(rt_mq_delete);
 #endif
 
-/**
- * This function will send a message to message queue object, if there are
- * threads suspended on message queue object, it will be waked up.
- *
- * @param mq the message queue object
- * @param buffer the message
- * @param size the size of buffer
- *
- * @return the error code
- */
-rt_err_t rt_mq_send(rt_mq_t mq, void *buffer, rt_size_t size)
+/* get a free message, RT_NULL when the message queue is full */
+static struct rt_mq_message *_rt_mq_message_alloc(rt_mq_t mq)
 {
     register rt_ubase_t temp;
     struct rt_mq_message *msg;
 
-    RT_ASSERT(mq != RT_NULL);
-    RT_ASSERT(buffer != RT_NULL);
-    RT_ASSERT(size != 0);
-
-    /* greater than one message size */
-    if (size > mq->msg_size)
-        return -RT_ERROR;
-
-    RT_OBJECT_HOOK_CALL(rt_object_put_hook, (&(mq->parent.parent)));
-
     /* disable interrupt */
     temp = rt_hw_interrupt_disable();
 
     /* get a free list, there must be an empty item */
-    msg = (struct rt_mq_message*)mq->msg_queue_free;
-    /* message queue is full */
-    if (msg == RT_NULL)
-    {
-        /* enable interrupt */
-        rt_hw_interrupt_enable(temp);
-
-        return -RT_EFULL;
-    }
+    msg = (struct rt_mq_message *)mq->msg_queue_free;
     /* move free list pointer */
-    mq->msg_queue_free = msg->next;
+    if (msg != RT_NULL)
+        mq->msg_queue_free = msg->next;
 
     /* enable interrupt */
     rt_hw_interrupt_enable(temp);
 
+    return msg;
+}
+
+/* put a message to free list */
+static void _rt_mq_message_free(rt_mq_t mq, struct rt_mq_message *msg)
+{
+    register rt_ubase_t temp;
+
+    /* disable interrupt */
+    temp = rt_hw_interrupt_disable();
+    /* put message to free list */
+    msg->next = (struct rt_mq_message *)mq->msg_queue_free;
+    mq->msg_queue_free = msg;
+    /* enable interrupt */
+    rt_hw_interrupt_enable(temp);
+}
+
+/* link a message to the tail of message queue and wake up the receiver */
+static void _rt_mq_message_post(rt_mq_t mq, struct rt_mq_message *msg)
+{
+    register rt_ubase_t temp;
+
     /* the msg is the new tailer of list, the next shall be NULL */
     msg->next = RT_NULL;
-    /* copy buffer */
-    rt_memcpy(msg + 1, buffer, size);
 
     /* disable interrupt */
     temp = rt_hw_interrupt_disable();
@@ -1990,11 +2129,46 @@ rt_err_t rt_mq_send(rt_mq_t mq, void *buffer, rt_size_t size)
 
         rt_schedule();
 
-        return RT_EOK;
+        return;
     }
 
     /* enable interrupt */
     rt_hw_interrupt_enable(temp);
+}
+
+/**
+ * This function will send a message to message queue object, if there are
+ * threads suspended on message queue object, it will be waked up.
+ *
+ * @param mq the message queue object
+ * @param buffer the message
+ * @param size the size of buffer
+ *
+ * @return the error code
+ */
+rt_err_t rt_mq_send(rt_mq_t mq, void *buffer, rt_size_t size)
+{
+    struct rt_mq_message *msg;
+
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(buffer != RT_NULL);
+    RT_ASSERT(size != 0);
+
+    /* greater than one message size */
+    if (size > mq->msg_size)
+        return -RT_ERROR;
+
+    RT_OBJECT_HOOK_CALL(rt_object_put_hook, (&(mq->parent.parent)));
+
+    msg = _rt_mq_message_alloc(mq);
+    /* message queue is full */
+    if (msg == RT_NULL)
+        return -RT_EFULL;
+
+    /* copy buffer */
+    rt_memcpy(msg + 1, buffer, size);
+
+    _rt_mq_message_post(mq, msg);
 
     return RT_EOK;
 }
@@ -2082,32 +2256,16 @@ rt_err_t rt_mq_urgent(rt_mq_t mq, void *buffer, rt_size_t size)
 }
 RTM_EXPORT(rt_mq_urgent);
 
-/**
- * This function will receive a message from message queue object, if there is
- * no message in message queue object, the thread shall wait for a specified
- * time.
- *
- * @param mq the message queue object
- * @param buffer the received message will be saved in
- * @param size the size of buffer
- * @param timeout the waiting time
- *
- * @return the error code
- */
-rt_err_t rt_mq_recv(rt_mq_t    mq,
-                    void      *buffer,
-                    rt_size_t  size,
-                    rt_int32_t timeout)
+/* take the message at the head of message queue, wait for it if it's empty */
+static rt_err_t _rt_mq_message_take(rt_mq_t                mq,
+                                    struct rt_mq_message **message,
+                                    rt_int32_t             timeout)
 {
     struct rt_thread *thread;
     register rt_ubase_t temp;
     struct rt_mq_message *msg;
     rt_uint32_t tick_delta;
 
-    RT_ASSERT(mq != RT_NULL);
-    RT_ASSERT(buffer != RT_NULL);
-    RT_ASSERT(size != 0);
-
     /* initialize delta tick */
     tick_delta = 0;
     /* get current thread */
@@ -2193,6 +2351,7 @@ rt_err_t rt_mq_recv(rt_mq_t    mq,
 
     /* get message from queue */
     msg = (struct rt_mq_message *)mq->msg_queue_head;
+    *message = msg;
 
     /* move message queue head */
     mq->msg_queue_head = msg->next;
@@ -2206,16 +2365,41 @@ rt_err_t rt_mq_recv(rt_mq_t    mq,
     /* enable interrupt */
     rt_hw_interrupt_enable(temp);
 
+    return RT_EOK;
+}
+
+/**
+ * This function will receive a message from message queue object, if there is
+ * no message in message queue object, the thread shall wait for a specified
+ * time.
+ *
+ * @param mq the message queue object
+ * @param buffer the received message will be saved in
+ * @param size the size of buffer
+ * @param timeout the waiting time
+ *
+ * @return the error code
+ */
+rt_err_t rt_mq_recv(rt_mq_t    mq,
+                    void      *buffer,
+                    rt_size_t  size,
+                    rt_int32_t timeout)
+{
+    rt_err_t result;
+    struct rt_mq_message *msg;
+
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(buffer != RT_NULL);
+    RT_ASSERT(size != 0);
+
+    result = _rt_mq_message_take(mq, &msg, timeout);
+    if (result != RT_EOK)
+        return result;
+
     /* copy message */
     rt_memcpy(buffer, msg + 1, size > mq->msg_size ? mq->msg_size : size);
 
-    /* disable interrupt */
-    temp = rt_hw_interrupt_disable();
-    /* put message to free list */
-    msg->next = (struct rt_mq_message *)mq->msg_queue_free;
-    mq->msg_queue_free = msg;
-    /* enable interrupt */
-    rt_hw_interrupt_enable(temp);
+    _rt_mq_message_free(mq, msg);
 
     RT_OBJECT_HOOK_CALL(rt_object_take_hook, (&(mq->parent.parent)));
 
@@ -2223,6 +2407,126 @@ rt_err_t rt_mq_recv(rt_mq_t    mq,
 }
 RTM_EXPORT(rt_mq_recv);
 
+/*
+ * The zero-copy interface of message queue. The sender reserves a message
+ * and fills it in place, then commits it to the queue; the receiver borrows
+ * the message at the head of queue and releases it after used. The message
+ * buffer is msg_size bytes, and it's owned by the sender or the receiver
+ * until it's committed or released.
+ */
+
+/* get the message from the buffer of message */
+rt_inline struct rt_mq_message *_rt_mq_buffer_message(rt_mq_t mq, void *buffer)
+{
+    struct rt_mq_message *msg;
+
+    msg = (struct rt_mq_message *)buffer - 1;
+    RT_ASSERT((rt_uint8_t *)msg >= (rt_uint8_t *)mq->msg_pool);
+    RT_ASSERT((rt_uint8_t *)msg < (rt_uint8_t *)mq->msg_pool +
+              (mq->msg_size + sizeof(struct rt_mq_message)) * mq->max_msgs);
+
+    return msg;
+}
+
+/**
+ * This function will reserve a message buffer in message queue object, which
+ * shall be committed by rt_mq_commit after filled, or given back by
+ * rt_mq_release.
+ *
+ * @param mq the message queue object
+ * @param buffer the reserved message buffer of msg_size bytes
+ *
+ * @return the error code, -RT_EFULL if there is no free message
+ */
+rt_err_t rt_mq_reserve(rt_mq_t mq, void **buffer)
+{
+    struct rt_mq_message *msg;
+
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(buffer != RT_NULL);
+
+    msg = _rt_mq_message_alloc(mq);
+    /* message queue is full */
+    if (msg == RT_NULL)
+        return -RT_EFULL;
+
+    *buffer = msg + 1;
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_mq_reserve);
+
+/**
+ * This function will commit a reserved message to message queue object
+ * without copy, if there are threads suspended on message queue object, it
+ * will be waked up.
+ *
+ * @param mq the message queue object
+ * @param buffer the message buffer reserved by rt_mq_reserve
+ *
+ * @return the error code
+ */
+rt_err_t rt_mq_commit(rt_mq_t mq, void *buffer)
+{
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(buffer != RT_NULL);
+
+    RT_OBJECT_HOOK_CALL(rt_object_put_hook, (&(mq->parent.parent)));
+
+    _rt_mq_message_post(mq, _rt_mq_buffer_message(mq, buffer));
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_mq_commit);
+
+/**
+ * This function will borrow the message at the head of message queue object
+ * without copy, if there is no message in message queue object, the thread
+ * shall wait for a specified time. The message shall be given back by
+ * rt_mq_release.
+ *
+ * @param mq the message queue object
+ * @param buffer the borrowed message buffer
+ * @param timeout the waiting time
+ *
+ * @return the error code
+ */
+rt_err_t rt_mq_borrow(rt_mq_t mq, void **buffer, rt_int32_t timeout)
+{
+    rt_err_t result;
+    struct rt_mq_message *msg;
+
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(buffer != RT_NULL);
+
+    result = _rt_mq_message_take(mq, &msg, timeout);
+    if (result != RT_EOK)
+        return result;
+
+    *buffer = msg + 1;
+
+    RT_OBJECT_HOOK_CALL(rt_object_take_hook, (&(mq->parent.parent)));
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_mq_borrow);
+
+/**
+ * This function will give back a message buffer borrowed by rt_mq_borrow,
+ * or a reserved message buffer which is not committed.
+ *
+ * @param mq the message queue object
+ * @param buffer the message buffer
+ */
+void rt_mq_release(rt_mq_t mq, void *buffer)
+{
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(buffer != RT_NULL);
+
+    _rt_mq_message_free(mq, _rt_mq_buffer_message(mq, buffer));
+}
+RTM_EXPORT(rt_mq_release);
+
 /**
  * This function can get or set some extra attributions of a message queue
  * object.
@@ -22,6 +22,9 @@
  * 2006-02-24     Bernard      first version
  * 2006-05-03     Bernard      add IRQ_DEBUG
  * 2016-08-09     ArdaFu       add interrupt enter and leave hook.
+ * 2017-06-24     agent        add interrupt nest of each cpu on SMP.
+ * 2017-07-03     agent        add cycle accounting of interrupt.
+ * 2017-07-04     agent        add deferred interrupt source and interrupt threads.
  */
 
 #include <rthw.h>
@@ -29,8 +32,8 @@
 
 #ifdef RT_USING_HOOK
 
-static void (*rt_interrupt_enter_hook)(void);
-static void (*rt_interrupt_leave_hook)(void);
+void (*rt_interrupt_enter_hook)(void);
+void (*rt_interrupt_leave_hook)(void);
 
 /**
  * @ingroup Hook
@@ -62,7 +65,9 @@ void rt_interrupt_leave_sethook(void (*hook)(void))
 
 /**@{*/
 
+#ifndef RT_USING_SMP
 volatile rt_uint8_t rt_interrupt_nest;
+#endif
 
 /**
  * This function will be invoked by BSP, when enter interrupt service routine
@@ -75,13 +80,29 @@ void rt_interrupt_enter(void)
 {
     rt_base_t level;
 
+#ifdef RT_USING_SMP
+    /* the interrupt nest belongs to current cpu, no kernel lock is needed */
+    level = rt_hw_local_irq_disable();
+    rt_cpu_self()->irq_nest ++;
+#ifdef RT_USING_CPU_USAGE
+    if (rt_cpu_self()->irq_nest == 1)
+        rt_cpu_usage_irq_enter();
+#endif
+    RT_OBJECT_HOOK_CALL(rt_interrupt_enter_hook,());
+    rt_hw_local_irq_enable(level);
+#else
     RT_DEBUG_LOG(RT_DEBUG_IRQ, ("irq coming..., irq nest:%d\n",
                                 rt_interrupt_nest));
 
     level = rt_hw_interrupt_disable();
     rt_interrupt_nest ++;
+#ifdef RT_USING_CPU_USAGE
+    if (rt_interrupt_nest == 1)
+        rt_cpu_usage_irq_enter();
+#endif
     RT_OBJECT_HOOK_CALL(rt_interrupt_enter_hook,());
     rt_hw_interrupt_enable(level);
+#endif
 }
 RTM_EXPORT(rt_interrupt_enter);
 
@@ -96,13 +117,28 @@ void rt_interrupt_leave(void)
 {
     rt_base_t level;
 
+#ifdef RT_USING_SMP
+    level = rt_hw_local_irq_disable();
+#ifdef RT_USING_CPU_USAGE
+    if (rt_cpu_self()->irq_nest == 1)
+        rt_cpu_usage_irq_leave();
+#endif
+    rt_cpu_self()->irq_nest --;
+    RT_OBJECT_HOOK_CALL(rt_interrupt_leave_hook,());
+    rt_hw_local_irq_enable(level);
+#else
     RT_DEBUG_LOG(RT_DEBUG_IRQ, ("irq leave, irq nest:%d\n",
                                 rt_interrupt_nest));
 
     level = rt_hw_interrupt_disable();
+#ifdef RT_USING_CPU_USAGE
+    if (rt_interrupt_nest == 1)
+        rt_cpu_usage_irq_leave();
+#endif
     rt_interrupt_nest --;
     RT_OBJECT_HOOK_CALL(rt_interrupt_leave_hook,());
     rt_hw_interrupt_enable(level);
+#endif
 }
 RTM_EXPORT(rt_interrupt_leave);
 
@@ -116,7 +152,18 @@ RTM_EXPORT(rt_interrupt_leave);
  */
 rt_uint8_t rt_interrupt_get_nest(void)
 {
+#ifdef RT_USING_SMP
+    rt_base_t level;
+    rt_uint8_t irq_nest;
+
+    level = rt_hw_local_irq_disable();
+    irq_nest = rt_cpu_self()->irq_nest;
+    rt_hw_local_irq_enable(level);
+
+    return irq_nest;
+#else
     return rt_interrupt_nest;
+#endif
 }
 RTM_EXPORT(rt_interrupt_get_nest);
 
@@ -125,3 +172,247 @@ RTM_EXPORT(rt_hw_interrupt_enable);
 
 /**@}*/
 
+#ifdef RT_USING_IRQ_THREAD
+/*
+ * Deferred interrupt handling.
+ *
+ * The interrupt of a source is split into the top half, which runs in the
+ * interrupt and only acknowledges the device and takes the urgent data, and
+ * the bottom half, which runs in one of RT_IRQ_THREAD_NR interrupt threads.
+ * The thread of level 0 has the highest priority RT_IRQ_THREAD_PRIORITY.
+ *
+ * A raised source is put to the pending list of its level once; the events
+ * raised again before its bottom half runs are merged into the pending ones.
+ * So an interrupt storm costs one list insertion and a wakeup of the thread
+ * for each batch, not for each interrupt. With RT_IRQ_SOURCE_FLAG_ONESHOT,
+ * the vector is masked when the source is raised and unmasked after the
+ * bottom half, which stops a level-triggered storm at the device.
+ */
+struct rt_irq_level
+{
+    rt_list_t pending;                              /* raised sources */
+    struct rt_semaphore sem;                        /* wakeup of the thread */
+    struct rt_thread thread;
+};
+
+static struct rt_irq_level irq_levels[RT_IRQ_THREAD_NR];
+ALIGN(RT_ALIGN_SIZE)
+static rt_uint8_t irq_thread_stack[RT_IRQ_THREAD_NR][RT_IRQ_THREAD_STACK_SIZE];
+static rt_uint8_t irq_thread_inited = 0;
+
+static void rt_irq_thread_entry(void *parameter)
+{
+    rt_base_t level;
+    rt_uint32_t events;
+    struct rt_irq_source *source;
+    struct rt_irq_level *irq_level = (struct rt_irq_level *)parameter;
+
+    while (1)
+    {
+        rt_sem_take(&(irq_level->sem), RT_WAITING_FOREVER);
+
+        /* handle all of the pending sources in a batch */
+        level = rt_hw_interrupt_disable();
+        while (!rt_list_isempty(&(irq_level->pending)))
+        {
+            source = rt_list_entry(irq_level->pending.next,
+                                   struct rt_irq_source, list);
+            rt_list_remove(&(source->list));
+            events = source->events;
+            source->events  = 0;
+            source->pending = 0;
+            source->handled ++;
+            rt_hw_interrupt_enable(level);
+
+            source->bottom_half(events, source->param);
+
+            if ((source->flag & RT_IRQ_SOURCE_FLAG_ONESHOT) && source->vector >= 0)
+                rt_hw_interrupt_umask(source->vector);
+
+            level = rt_hw_interrupt_disable();
+        }
+        rt_hw_interrupt_enable(level);
+    }
+}
+
+/* the interrupt service routine installed for source */
+static void rt_irq_source_isr(int vector, void *param)
+{
+    rt_uint32_t events = 1;
+    struct rt_irq_source *source = (struct rt_irq_source *)param;
+
+    if (source->top_half != RT_NULL)
+        events = source->top_half(vector, source->param);
+
+    if (events != 0)
+        rt_irq_source_raise(source, events);
+}
+
+/**
+ * @ingroup SystemInit
+ *
+ * This function will initialize the interrupt threads, which run the bottom
+ * halves of deferred interrupt sources.
+ */
+void rt_system_irq_thread_init(void)
+{
+    int index;
+    char name[RT_NAME_MAX];
+
+    if (irq_thread_inited)
+        return;
+    irq_thread_inited = 1;
+
+    for (index = 0; index < RT_IRQ_THREAD_NR; index ++)
+    {
+        rt_snprintf(name, sizeof(name), "tirq%d", index);
+
+        rt_list_init(&(irq_levels[index].pending));
+        rt_sem_init(&(irq_levels[index].sem), name, 0, RT_IPC_FLAG_FIFO);
+        rt_thread_init(&(irq_levels[index].thread),
+                       name,
+                       rt_irq_thread_entry,
+                       &irq_levels[index],
+                       &irq_thread_stack[index][0],
+                       RT_IRQ_THREAD_STACK_SIZE,
+                       RT_IRQ_THREAD_PRIORITY + index,
+                       10);
+        rt_thread_startup(&(irq_levels[index].thread));
+    }
+}
+
+/**
+ * @addtogroup IRQThread
+ */
+
+/**@{*/
+
+/**
+ * This function will initialize a deferred interrupt source.
+ *
+ * @param source the interrupt source
+ * @param name the name of source
+ * @param top_half the top half invoked in interrupt, it returns the events to
+ *        be handled by bottom half, or 0 if nothing to do. RT_NULL raises the
+ *        event 1 on each interrupt.
+ * @param bottom_half the bottom half invoked in interrupt thread with the
+ *        merged events
+ * @param param the parameter of top half and bottom half
+ * @param level the level of interrupt thread, 0 is the highest priority
+ * @param flag the flags of source, RT_IRQ_SOURCE_FLAG_ONESHOT
+ *
+ * @return RT_EOK on successful, -RT_ERROR on invalid parameter
+ */
+rt_err_t rt_irq_source_init(struct rt_irq_source *source,
+                            const char           *name,
+                            rt_uint32_t (*top_half)(int vector, void *param),
+                            void (*bottom_half)(rt_uint32_t events, void *param),
+                            void                 *param,
+                            rt_uint8_t            level,
+                            rt_uint8_t            flag)
+{
+    RT_ASSERT(source != RT_NULL);
+
+    if (bottom_half == RT_NULL || level >= RT_IRQ_THREAD_NR)
+        return -RT_ERROR;
+
+    rt_list_init(&(source->list));
+    source->name        = name;
+    source->top_half    = top_half;
+    source->bottom_half = bottom_half;
+    source->param       = param;
+    source->vector      = -1;
+    source->level       = level;
+    source->flag        = flag;
+    source->pending     = 0;
+    source->events      = 0;
+    source->raised      = 0;
+    source->handled     = 0;
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_irq_source_init);
+
+/**
+ * This function will install the interrupt source on an interrupt vector,
+ * then the top half is invoked on the interrupt of vector.
+ *
+ * @param source the interrupt source
+ * @param vector the interrupt vector
+ */
+void rt_irq_source_install(struct rt_irq_source *source, int vector)
+{
+    RT_ASSERT(source != RT_NULL);
+
+    source->vector = vector;
+    rt_hw_interrupt_install(vector, rt_irq_source_isr, source, (char *)source->name);
+    rt_hw_interrupt_umask(vector);
+}
+RTM_EXPORT(rt_irq_source_install);
+
+/**
+ * This function will detach an interrupt source. The vector is masked and the
+ * pending events are dropped.
+ *
+ * @param source the interrupt source
+ */
+void rt_irq_source_detach(struct rt_irq_source *source)
+{
+    rt_base_t level;
+
+    RT_ASSERT(source != RT_NULL);
+
+    if (source->vector >= 0)
+        rt_hw_interrupt_mask(source->vector);
+
+    level = rt_hw_interrupt_disable();
+    rt_list_remove(&(source->list));
+    source->pending = 0;
+    source->events  = 0;
+    rt_hw_interrupt_enable(level);
+}
+RTM_EXPORT(rt_irq_source_detach);
+
+/**
+ * This function will raise events of an interrupt source, its bottom half is
+ * invoked in interrupt thread later. It's invoked by the installed interrupt
+ * service routine, or by the one of driver. It could be invoked in thread too.
+ *
+ * @param source the interrupt source
+ * @param events the events to be handled
+ */
+void rt_irq_source_raise(struct rt_irq_source *source, rt_uint32_t events)
+{
+    int wakeup = 0;
+    rt_base_t level;
+    struct rt_irq_level *irq_level;
+
+    RT_ASSERT(source != RT_NULL);
+    RT_ASSERT(irq_thread_inited);
+
+    irq_level = &irq_levels[source->level];
+
+    level = rt_hw_interrupt_disable();
+    source->events |= events;
+    source->raised ++;
+    if (!source->pending)
+    {
+        source->pending = 1;
+        if ((source->flag & RT_IRQ_SOURCE_FLAG_ONESHOT) && source->vector >= 0)
+            rt_hw_interrupt_mask(source->vector);
+
+        /* the thread is woken up once for the sources raised in a batch */
+        wakeup = rt_list_isempty(&(irq_level->pending)) &&
+                 RT_SEM_VALUE(&(irq_level->sem)) == 0;
+        rt_list_insert_before(&(irq_level->pending), &(source->list));
+    }
+    rt_hw_interrupt_enable(level);
+
+    if (wakeup)
+        rt_sem_release(&(irq_level->sem));
+}
+RTM_EXPORT(rt_irq_source_raise);
+
+/**@}*/
+#endif
+
@@ -31,6 +31,9 @@
  * 2013-06-24     Bernard      remove rt_kprintf if RT_USING_CONSOLE is not defined.
  * 2013-09-24     aozima       make sure the device is in STREAM mode when used by rt_kprintf.
  * 2015-07-06     Bernard      Add rt_assert_handler routine.
+ * 2017-06-25     agent        use the compiler builtin in __rt_ffs on GCC.
+ * 2017-07-01     agent        copy, set, compare and strlen by words, and the
+ *                             vector memcpy/memset hook of CPU port.
  */
 
 #include <rtthread.h>
@@ -124,6 +127,102 @@ int *_rt_errno(void)
 }
 RTM_EXPORT(_rt_errno);
 
+/*
+ * The memory and string routines work on the native word (rt_ubase_t) when
+ * the addresses can be aligned, and copy or set four words in each loop.
+ * The blocks which are not less than RT_HW_MEMCPY_THRESHOLD bytes are
+ * handed to the vector routines of CPU port with RT_USING_CPU_MEMCPY.
+ */
+#define RT_WORD_SIZE        (sizeof(rt_ubase_t))
+#define RT_WORD_MASK        (RT_WORD_SIZE - 1)
+#define RT_WORD_ONES        (~(rt_ubase_t)0 / 0xff)     /* 0x0101...01 */
+#define RT_WORD_HIGHS       (RT_WORD_ONES << 7)         /* 0x8080...80 */
+#define RT_WORD_UNALIGNED(x)    ((rt_ubase_t)(x) & RT_WORD_MASK)
+/* there is a zero byte in the word */
+#define RT_WORD_HAS_ZERO(w) (((w) - RT_WORD_ONES) & ~(w) & RT_WORD_HIGHS)
+
+/*
+ * Merge two aligned source words to one destination word, when the source
+ * and destination are not aligned in the same way. The byte order shall be
+ * known by compiler.
+ */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define RT_WORD_MERGE(lo, hi, shift) \
+    (((lo) >> (shift)) | ((hi) << (RT_WORD_SIZE * 8 - (shift))))
+#elif defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define RT_WORD_MERGE(lo, hi, shift) \
+    (((lo) << (shift)) | ((hi) >> (RT_WORD_SIZE * 8 - (shift))))
+#endif
+
+#ifndef RT_TINY_SIZE
+/* copy memory from low address to high address */
+static void _rt_memcpy_forward(rt_uint8_t *d, const rt_uint8_t *s, rt_ubase_t count)
+{
+    rt_ubase_t *wd;
+    const rt_ubase_t *ws;
+
+    if (count >= RT_WORD_SIZE * 2)
+    {
+        /* align the destination */
+        while (RT_WORD_UNALIGNED(d))
+        {
+            *d++ = *s++;
+            count --;
+        }
+
+        wd = (rt_ubase_t *)d;
+        if (!RT_WORD_UNALIGNED(s))
+        {
+            ws = (const rt_ubase_t *)s;
+
+            while (count >= RT_WORD_SIZE * 4)
+            {
+                wd[0] = ws[0];
+                wd[1] = ws[1];
+                wd[2] = ws[2];
+                wd[3] = ws[3];
+                wd += 4;
+                ws += 4;
+                count -= RT_WORD_SIZE * 4;
+            }
+            while (count >= RT_WORD_SIZE)
+            {
+                *wd++ = *ws++;
+                count -= RT_WORD_SIZE;
+            }
+            s = (const rt_uint8_t *)ws;
+        }
+#ifdef RT_WORD_MERGE
+        else
+        {
+            rt_ubase_t lo, hi;
+            int shift = RT_WORD_UNALIGNED(s) * 8;
+
+            /*
+             * read the aligned source words, the last word read holds the
+             * last byte of destination word, so no word beyond the source
+             * end is read.
+             */
+            ws = (const rt_ubase_t *)((rt_ubase_t)s & ~RT_WORD_MASK);
+            lo = *ws++;
+            while (count >= RT_WORD_SIZE)
+            {
+                hi = *ws++;
+                *wd++ = RT_WORD_MERGE(lo, hi, shift);
+                lo = hi;
+                count -= RT_WORD_SIZE;
+                s += RT_WORD_SIZE;
+            }
+        }
+#endif
+        d = (rt_uint8_t *)wd;
+    }
+
+    while (count--)
+        *d++ = *s++;
+}
+#endif
+
 /**
  * This function will set the content of memory to specified value
  *
@@ -143,65 +242,52 @@ void *rt_memset(void *s, int c, rt_ubase_t count)
 
     return s;
 #else
-#define LBLOCKSIZE      (sizeof(rt_int32_t))
-#define UNALIGNED(X)    ((rt_int32_t)X & (LBLOCKSIZE - 1))
-#define TOO_SMALL(LEN)  ((LEN) < LBLOCKSIZE)
+    rt_uint8_t *m = (rt_uint8_t *)s;
+    rt_ubase_t *aligned_addr;
+    rt_ubase_t buffer;
 
-    int i;
-    char *m = (char *)s;
-    rt_uint32_t buffer;
-    rt_uint32_t *aligned_addr;
-    rt_uint32_t d = c & 0xff;
+#ifdef RT_USING_CPU_MEMCPY
+    if (count >= RT_HW_MEMCPY_THRESHOLD && rt_hw_memset(s, c, count) != RT_NULL)
+        return s;
+#endif
 
-    if (!TOO_SMALL(count) && !UNALIGNED(s))
+    if (count >= RT_WORD_SIZE * 2)
     {
-        /* If we get this far, we know that n is large and m is word-aligned. */
-        aligned_addr = (rt_uint32_t *)s;
-
-        /* Store D into each char sized location in BUFFER so that
-         * we can set large blocks quickly.
-         */
-        if (LBLOCKSIZE == 4)
+        /* align the address */
+        while (RT_WORD_UNALIGNED(m))
         {
-            buffer = (d << 8) | d;
-            buffer |= (buffer << 16);
-        }
-        else
-        {
-            buffer = 0;
-            for (i = 0; i < LBLOCKSIZE; i ++)
-                buffer = (buffer << 8) | d;
+            *m++ = (rt_uint8_t)c;
+            count --;
         }
 
-        while (count >= LBLOCKSIZE * 4)
+        /* store the byte into each byte of word */
+        buffer = RT_WORD_ONES * (rt_uint8_t)c;
+        aligned_addr = (rt_ubase_t *)m;
+
+        while (count >= RT_WORD_SIZE * 4)
         {
-            *aligned_addr++ = buffer;
-            *aligned_addr++ = buffer;
-            *aligned_addr++ = buffer;
-            *aligned_addr++ = buffer;
-            count -= 4 * LBLOCKSIZE;
+            aligned_addr[0] = buffer;
+            aligned_addr[1] = buffer;
+            aligned_addr[2] = buffer;
+            aligned_addr[3] = buffer;
+            aligned_addr += 4;
+            count -= RT_WORD_SIZE * 4;
         }
 
-        while (count >= LBLOCKSIZE)
+        while (count >= RT_WORD_SIZE)
         {
             *aligned_addr++ = buffer;
-            count -= LBLOCKSIZE;
+            count -= RT_WORD_SIZE;
         }
 
         /* Pick up the remainder with a bytewise loop. */
-        m = (char *)aligned_addr;
+        m = (rt_uint8_t *)aligned_addr;
     }
 
     while (count--)
-    {
-        *m++ = (char)d;
-    }
+        *m++ = (rt_uint8_t)c;
 
     return s;
-
-#undef LBLOCKSIZE
-#undef UNALIGNED
-#undef TOO_SMALL
 #endif
 }
 RTM_EXPORT(rt_memset);
@@ -226,57 +312,14 @@ void *rt_memcpy(void *dst, const void *src, rt_ubase_t count)
 
     return dst;
 #else
+#ifdef RT_USING_CPU_MEMCPY
+    if (count >= RT_HW_MEMCPY_THRESHOLD && rt_hw_memcpy(dst, src, count) != RT_NULL)
+        return dst;
+#endif
 
-#define UNALIGNED(X, Y)                                               \
-                        (((rt_int32_t)X & (sizeof(rt_int32_t) - 1)) | \
-                         ((rt_int32_t)Y & (sizeof(rt_int32_t) - 1)))
-#define BIGBLOCKSIZE    (sizeof(rt_int32_t) << 2)
-#define LITTLEBLOCKSIZE (sizeof(rt_int32_t))
-#define TOO_SMALL(LEN)  ((LEN) < BIGBLOCKSIZE)
-
-    char *dst_ptr = (char *)dst;
-    char *src_ptr = (char *)src;
-    rt_int32_t *aligned_dst;
-    rt_int32_t *aligned_src;
-    int len = count;
-
-    /* If the size is small, or either SRC or DST is unaligned,
-    then punt into the byte copy loop.  This should be rare. */
-    if (!TOO_SMALL(len) && !UNALIGNED(src_ptr, dst_ptr))
-    {
-        aligned_dst = (rt_int32_t *)dst_ptr;
-        aligned_src = (rt_int32_t *)src_ptr;
-
-        /* Copy 4X long words at a time if possible. */
-        while (len >= BIGBLOCKSIZE)
-        {
-            *aligned_dst++ = *aligned_src++;
-            *aligned_dst++ = *aligned_src++;
-            *aligned_dst++ = *aligned_src++;
-            *aligned_dst++ = *aligned_src++;
-            len -= BIGBLOCKSIZE;
-        }
-
-        /* Copy one long word at a time if possible. */
-        while (len >= LITTLEBLOCKSIZE)
-        {
-            *aligned_dst++ = *aligned_src++;
-            len -= LITTLEBLOCKSIZE;
-        }
-
-        /* Pick up any residual with a byte copier. */
-        dst_ptr = (char *)aligned_dst;
-        src_ptr = (char *)aligned_src;
-    }
-
-    while (len--)
-        *dst_ptr++ = *src_ptr++;
+    _rt_memcpy_forward((rt_uint8_t *)dst, (const rt_uint8_t *)src, count);
 
     return dst;
-#undef UNALIGNED
-#undef BIGBLOCKSIZE
-#undef LITTLEBLOCKSIZE
-#undef TOO_SMALL
 #endif
 }
 RTM_EXPORT(rt_memcpy);
@@ -300,13 +343,38 @@ void *rt_memmove(void *dest, const void *src, rt_ubase_t n)
         tmp += n;
         s += n;
 
+#ifndef RT_TINY_SIZE
+        /* copy backward by words when they are aligned in the same way */
+        if (n >= RT_WORD_SIZE * 2 && !RT_WORD_UNALIGNED(tmp - s))
+        {
+            while (RT_WORD_UNALIGNED(tmp))
+            {
+                *(--tmp) = *(--s);
+                n --;
+            }
+
+            while (n >= RT_WORD_SIZE)
+            {
+                tmp -= RT_WORD_SIZE;
+                s   -= RT_WORD_SIZE;
+                *(rt_ubase_t *)tmp = *(rt_ubase_t *)s;
+                n -= RT_WORD_SIZE;
+            }
+        }
+#endif
+
         while (n--)
             *(--tmp) = *(--s);
     }
     else
     {
+#ifdef RT_TINY_SIZE
         while (n--)
             *tmp++ = *s++;
+#else
+        /* the forward copy reads each source word before it's overwritten */
+        _rt_memcpy_forward((rt_uint8_t *)tmp, (const rt_uint8_t *)s, n);
+#endif
     }
 
     return dest;
@@ -327,7 +395,33 @@ rt_int32_t rt_memcmp(const void *cs, const void *ct, rt_ubase_t count)
     const unsigned char *su1, *su2;
     int res = 0;
 
-    for (su1 = cs, su2 = ct; 0 < count; ++su1, ++su2, count--)
+    su1 = cs;
+    su2 = ct;
+
+#ifndef RT_TINY_SIZE
+    /* skip the equal words, the different one is compared by bytes */
+    if (count >= RT_WORD_SIZE * 2 && !RT_WORD_UNALIGNED((rt_ubase_t)su1 - (rt_ubase_t)su2))
+    {
+        while (RT_WORD_UNALIGNED(su1))
+        {
+            if ((res = *su1 - *su2) != 0)
+                return res;
+            su1 ++;
+            su2 ++;
+            count --;
+        }
+
+        while (count >= RT_WORD_SIZE &&
+               *(const rt_ubase_t *)su1 == *(const rt_ubase_t *)su2)
+        {
+            su1 += RT_WORD_SIZE;
+            su2 += RT_WORD_SIZE;
+            count -= RT_WORD_SIZE;
+        }
+    }
+#endif
+
+    for (; 0 < count; ++su1, ++su2, count--)
         if ((res = *su1 - *su2) != 0)
             break;
 
@@ -493,8 +587,27 @@ rt_size_t rt_strnlen(const char *s, rt_ubase_t maxlen)
 rt_size_t rt_strlen(const char *s)
 {
     const char *sc;
+#ifndef RT_TINY_SIZE
+    const rt_ubase_t *ws;
 
-    for (sc = s; *sc != '\0'; ++sc) /* nothing */
+    for (sc = s; RT_WORD_UNALIGNED(sc); ++sc)
+    {
+        if (*sc == '\0')
+            return sc - s;
+    }
+
+    /*
+     * check a word at a time, the aligned word never crosses the page, so
+     * it's safe to read the bytes after the null character in this word.
+     */
+    for (ws = (const rt_ubase_t *)sc; !RT_WORD_HAS_ZERO(*ws); ++ws) /* nothing */
+        ;
+    sc = (const char *)ws;
+#else
+    sc = s;
+#endif
+
+    for (; *sc != '\0'; ++sc) /* nothing */
         ;
 
     return sc - s;
@@ -1235,6 +1348,7 @@ RTM_EXPORT(rt_free_align);
 #endif
 
 #ifndef RT_USING_CPU_FFS
+#ifndef __GNUC__
 const rt_uint8_t __lowest_bit_bitmap[] =
 {
     /* 00 */ 0, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0,
@@ -1255,6 +1369,8 @@ const rt_uint8_t __lowest_bit_bitmap[] =
     /* F0 */ 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0
 };
 
+#endif
+
 /**
  * This function finds the first bit set (beginning with the least significant bit)
  * in value and return the index of that bit.
@@ -1265,8 +1381,12 @@ const rt_uint8_t __lowest_bit_bitmap[] =
  * @return return the index of the first bit set. If value is 0, then this function
  * shall return 0.
  */
-rt_ubase_t __rt_ffs(rt_ubase_t value)
+int __rt_ffs(int value)
 {
+#ifdef __GNUC__
+    /* the builtin is the find first set instruction of CPU if it has */
+    return __builtin_ffs(value);
+#else
     if (value == 0) return 0;
 
     if (value & 0xff)
@@ -1278,7 +1398,8 @@ rt_ubase_t __rt_ffs(rt_ubase_t value)
     if (value & 0xff0000)
         return __lowest_bit_bitmap[(value & 0xff0000) >> 16] + 17;
 
-    return __lowest_bit_bitmap[(value & 0xff000000) >> 24] + 25;
+    return __lowest_bit_bitmap[((rt_uint32_t)value & 0xff000000) >> 24] + 25;
+#endif
 }
 #endif
 
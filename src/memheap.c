@@ -27,6 +27,8 @@
  * 2013-05-24     Bernard      fix the rt_memheap_realloc issue.
  * 2013-07-11     Grissiom     fix the memory block splitting issue.
  * 2013-07-15     Grissiom     optimize rt_memheap_realloc
+ * 2017-06-26     agent        add rt_memory_info for memheap as system heap.
+ * 2017-07-10     agent        add memory region of memheap and rt_malloc_region.
  */
 
 #include <rthw.h>
@@ -123,6 +125,10 @@ rt_err_t rt_memheap_init(struct rt_memheap *memheap,
     /* initialize semaphore lock */
     rt_sem_init(&(memheap->lock), name, 1, RT_IPC_FLAG_FIFO);
 
+#ifdef RT_USING_MEMHEAP_REGION
+    memheap->region = RT_MEM_DEFAULT;
+#endif
+
     RT_DEBUG_LOG(RT_DEBUG_MEMHEAP,
                  ("memory heap: start addr 0x%08x, size %d, free list header 0x%08x\n",
                   start_addr, size, &(memheap->free_header)));
@@ -608,6 +614,208 @@ void rt_system_heap_init(void *begin_addr, void *end_addr)
                     (rt_uint32_t)end_addr - (rt_uint32_t)begin_addr);
 }
 
+#ifdef RT_USING_MEMHEAP_REGION
+/*
+ * The fallback region and statistics of each memory region. The fast and
+ * large memory fall back to the default one, and the default memory falls
+ * back to the large one, like the allocation on other memheaps before. The
+ * DMA memory doesn't fall back, the cacheable memory is not safe for DMA.
+ */
+struct rt_memory_region
+{
+    rt_uint8_t  fallback;
+
+    rt_uint32_t alloc_count;
+    rt_uint32_t fallback_count;
+    rt_uint32_t fail_count;
+};
+
+static struct rt_memory_region _regions[RT_MEM_REGION_NR] =
+{
+    {RT_MEM_LARGE},                         /* RT_MEM_DEFAULT */
+    {RT_MEM_DEFAULT},                       /* RT_MEM_FAST */
+    {RT_MEM_DEFAULT},                       /* RT_MEM_LARGE */
+    {RT_MEM_NONE},                          /* RT_MEM_DMA */
+};
+
+/**
+ * This function tags a memory heap with a memory region, the system heap is
+ * in the default region and the other heaps are in the default region until
+ * they are tagged.
+ *
+ * @param heap the memory heap
+ * @param region the memory region, such as RT_MEM_FAST
+ */
+void rt_memheap_set_region(struct rt_memheap *heap, rt_uint8_t region)
+{
+    RT_ASSERT(heap != RT_NULL);
+    RT_ASSERT(region < RT_MEM_REGION_NR);
+
+    heap->region = region;
+}
+RTM_EXPORT(rt_memheap_set_region);
+
+/**
+ * This function sets the region to try when a region is exhausted. The
+ * fallback region falls back to its fallback region as well, until a region
+ * is tried again.
+ *
+ * @param region the memory region
+ * @param fallback the fallback region, RT_MEM_NONE for no fallback
+ *
+ * @return RT_EOK on success, -RT_ERROR on a wrong region
+ */
+rt_err_t rt_memory_region_set_fallback(rt_uint8_t region, rt_uint8_t fallback)
+{
+    if (region >= RT_MEM_REGION_NR ||
+        (fallback >= RT_MEM_REGION_NR && fallback != RT_MEM_NONE))
+        return -RT_ERROR;
+
+    _regions[region].fallback = fallback;
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_memory_region_set_fallback);
+
+/* allocate on the heaps of region, the system heap is the first one */
+static void *_memory_region_alloc(rt_uint8_t region, rt_size_t size)
+{
+    void *ptr = RT_NULL;
+    struct rt_object *object;
+    struct rt_list_node *node;
+    struct rt_memheap *heap;
+    struct rt_object_information *information;
+    extern struct rt_object_information rt_object_container[];
+
+    if (_heap.region == region)
+    {
+        ptr = rt_memheap_alloc(&_heap, size);
+        if (ptr != RT_NULL)
+            return ptr;
+    }
+
+    information = &rt_object_container[RT_Object_Class_MemHeap];
+    for (node  = information->object_list.next;
+         node != &(information->object_list);
+         node  = node->next)
+    {
+        object = rt_list_entry(node, struct rt_object, list);
+        heap   = (struct rt_memheap *)object;
+
+        if (heap == &_heap || heap->region != region)
+            continue;
+
+        ptr = rt_memheap_alloc(heap, size);
+        if (ptr != RT_NULL)
+            break;
+    }
+
+    return ptr;
+}
+
+/**
+ * This function allocates a memory block in a memory region, or in its
+ * fallback regions when the region is exhausted.
+ *
+ * @param size the size of memory block
+ * @param flag the memory region, such as RT_MEM_FAST, or'ed with
+ *        RT_MEM_NOFALLBACK to allocate only in the region
+ *
+ * @return the allocated memory block, RT_NULL on failure
+ */
+void *rt_malloc_region(rt_size_t size, rt_uint32_t flag)
+{
+    void *ptr;
+    rt_base_t level;
+    rt_uint32_t tried = 0;
+    rt_uint8_t region, request;
+
+    request = region = flag & RT_MEM_REGION_MASK;
+    if (region >= RT_MEM_REGION_NR)
+        return RT_NULL;
+
+    while (1)
+    {
+        tried |= 1 << region;
+
+        ptr = _memory_region_alloc(region, size);
+        if (ptr != RT_NULL || (flag & RT_MEM_NOFALLBACK))
+            break;
+
+        /* no more region to try */
+        region = _regions[region].fallback;
+        if (region == RT_MEM_NONE || (tried & (1 << region)))
+            break;
+    }
+
+    level = rt_hw_interrupt_disable();
+    _regions[request].alloc_count ++;
+    if (ptr == RT_NULL)
+        _regions[request].fail_count ++;
+    else if (region != request)
+        _regions[request].fallback_count ++;
+    rt_hw_interrupt_enable(level);
+
+    return ptr;
+}
+RTM_EXPORT(rt_malloc_region);
+
+/**
+ * This function gets the statistics of a memory region.
+ *
+ * @param region the memory region
+ * @param info the statistics of region
+ *
+ * @return RT_EOK on success, -RT_ERROR on a wrong region
+ */
+rt_err_t rt_memory_region_info(rt_uint8_t region, struct rt_memory_region_info *info)
+{
+    rt_base_t level;
+    struct rt_object *object;
+    struct rt_list_node *node;
+    struct rt_memheap *heap;
+    struct rt_object_information *information;
+    extern struct rt_object_information rt_object_container[];
+
+    RT_ASSERT(info != RT_NULL);
+
+    if (region >= RT_MEM_REGION_NR)
+        return -RT_ERROR;
+
+    rt_memset(info, 0, sizeof(struct rt_memory_region_info));
+
+    information = &rt_object_container[RT_Object_Class_MemHeap];
+    for (node  = information->object_list.next;
+         node != &(information->object_list);
+         node  = node->next)
+    {
+        object = rt_list_entry(node, struct rt_object, list);
+        heap   = (struct rt_memheap *)object;
+
+        if (heap->region != region)
+            continue;
+
+        info->total    += heap->pool_size;
+        info->used     += heap->pool_size - heap->available_size;
+        info->max_used += heap->max_used_size;
+    }
+
+    level = rt_hw_interrupt_disable();
+    info->alloc_count    = _regions[region].alloc_count;
+    info->fallback_count = _regions[region].fallback_count;
+    info->fail_count     = _regions[region].fail_count;
+    info->fallback       = _regions[region].fallback;
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_memory_region_info);
+
+void *rt_malloc(rt_size_t size)
+{
+    return rt_malloc_region(size, RT_MEM_DEFAULT);
+}
+#else
 void *rt_malloc(rt_size_t size)
 {
     void* ptr;
@@ -643,6 +851,7 @@ void *rt_malloc(rt_size_t size)
 
     return ptr;
 }
+#endif
 RTM_EXPORT(rt_malloc);
 
 void rt_free(void *rmem)
@@ -667,7 +876,11 @@ void *rt_realloc(void *rmem, rt_size_t newsize)
     if (new_ptr == RT_NULL && newsize != 0)
     {
         /* allocate memory block from other memheap */
+#ifdef RT_USING_MEMHEAP_REGION
+        new_ptr = rt_malloc_region(newsize, header_ptr->pool_ptr->region);
+#else
         new_ptr = rt_malloc(newsize);
+#endif
         if (new_ptr != RT_NULL && rmem != RT_NULL)
         {
             rt_size_t oldsize;
@@ -702,6 +915,19 @@ void *rt_calloc(rt_size_t count, rt_size_t size)
 }
 RTM_EXPORT(rt_calloc);
 
+void rt_memory_info(rt_uint32_t *total,
+                    rt_uint32_t *used,
+                    rt_uint32_t *max_used)
+{
+    /* the information of the default system heap */
+    if (total != RT_NULL)
+        *total = _heap.pool_size;
+    if (used  != RT_NULL)
+        *used = _heap.pool_size - _heap.available_size;
+    if (max_used != RT_NULL)
+        *max_used = _heap.max_used_size;
+}
+
 #endif
 
 #endif
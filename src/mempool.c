@@ -28,6 +28,7 @@
  * 2010-10-26     yi.qiu       add module support in rt_mp_delete
  * 2011-01-24     Bernard      add object allocation check.
  * 2012-03-22     Bernard      fix align issue in rt_mp_init and rt_mp_create.
+ * 2017-06-28     agent        add lock-free memory pool for interrupt.
  */
 
 #include <rthw.h>
@@ -465,6 +466,162 @@ void rt_mp_free(void *block)
 }
 RTM_EXPORT(rt_mp_free);
 
+/*
+ * The free blocks of lock-free memory pool are linked by index. The head of
+ * free list is the index (beginning with 1, 0 is the end of list) of the first
+ * free block in the low 16 bits, and a tag in the high 16 bits which is
+ * increased on each update of the head, so the compare and swap of the head
+ * fails when the list is changed even if the first block is same (ABA).
+ */
+#define LFPOOL_INDEX_MASK       0xffff
+#define LFPOOL_TAG_STEP         0x10000
+#define LFPOOL_TAG_MASK         0xffff0000
+
+#define LFPOOL_HEAD(head, index) \
+    ((((head) + LFPOOL_TAG_STEP) & LFPOOL_TAG_MASK) | (index))
+
+/**
+ * This function will initialize a lock-free memory pool. The pool has no
+ * suspended thread and no object, the allocation and release are safe in
+ * interrupt service routine.
+ *
+ * @param pool the lock-free memory pool
+ * @param start the star address of memory pool
+ * @param size the total size of memory pool
+ * @param block_size the size for each block
+ *
+ * @return RT_EOK
+ */
+rt_err_t rt_lfpool_init(rt_lfpool_t pool,
+                        void       *start,
+                        rt_size_t   size,
+                        rt_size_t   block_size)
+{
+    rt_size_t index;
+    rt_uint8_t *block_ptr;
+
+    /* parameter check */
+    RT_ASSERT(pool != RT_NULL);
+
+    /* the block holds the index of next free block */
+    if (block_size < sizeof(rt_uint32_t))
+        block_size = sizeof(rt_uint32_t);
+    block_size = RT_ALIGN(block_size, RT_ALIGN_SIZE);
+
+    pool->start_address     = (rt_uint8_t *)start;
+    pool->block_size        = block_size;
+    pool->block_total_count = size / block_size;
+    if (pool->block_total_count > LFPOOL_INDEX_MASK)
+        pool->block_total_count = LFPOOL_INDEX_MASK;
+
+    /* initialize free block list, the index of last block's next is 0 */
+    block_ptr = pool->start_address;
+    for (index = 1; index <= pool->block_total_count; index ++)
+    {
+        *(rt_uint32_t *)block_ptr =
+            index < pool->block_total_count ? index + 1 : 0;
+        block_ptr += block_size;
+    }
+
+    pool->head = pool->block_total_count ? 1 : 0;
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_lfpool_init);
+
+/**
+ * This function will allocate a block from lock-free memory pool. It never
+ * blocks, so it could be invoked in interrupt service routine.
+ *
+ * @param pool the lock-free memory pool
+ *
+ * @return the allocated memory block or RT_NULL if there is no free block
+ */
+void *rt_lfpool_alloc(rt_lfpool_t pool)
+{
+    rt_uint32_t head, index;
+    rt_uint8_t *block_ptr;
+#ifdef RT_HW_USING_CAS
+    do
+    {
+        head  = pool->head;
+        index = head & LFPOOL_INDEX_MASK;
+        if (index == 0)
+            return RT_NULL;
+
+        /*
+         * The block may be allocated by others and the next index read is
+         * invalid, then the tag of head has been changed and the swap fails.
+         */
+        block_ptr = pool->start_address + (index - 1) * pool->block_size;
+        index     = *(volatile rt_uint32_t *)block_ptr;
+    } while (!rt_hw_cas(&pool->head, head, LFPOOL_HEAD(head, index)));
+#else
+    register rt_base_t level;
+
+    /* disable interrupt */
+    level = rt_hw_interrupt_disable();
+
+    head  = pool->head;
+    index = head & LFPOOL_INDEX_MASK;
+    if (index == 0)
+    {
+        /* enable interrupt */
+        rt_hw_interrupt_enable(level);
+
+        return RT_NULL;
+    }
+
+    block_ptr  = pool->start_address + (index - 1) * pool->block_size;
+    pool->head = LFPOOL_HEAD(head, *(rt_uint32_t *)block_ptr);
+
+    /* enable interrupt */
+    rt_hw_interrupt_enable(level);
+#endif
+
+    return block_ptr;
+}
+RTM_EXPORT(rt_lfpool_alloc);
+
+/**
+ * This function will release a block to lock-free memory pool. It could be
+ * invoked in interrupt service routine.
+ *
+ * @param pool the lock-free memory pool
+ * @param block the address of memory block to be released
+ */
+void rt_lfpool_free(rt_lfpool_t pool, void *block)
+{
+    rt_uint32_t head, index;
+#ifndef RT_HW_USING_CAS
+    register rt_base_t level;
+#endif
+
+    RT_ASSERT((rt_uint8_t *)block >= pool->start_address);
+
+    index = ((rt_uint8_t *)block - pool->start_address) / pool->block_size + 1;
+    RT_ASSERT(index <= pool->block_total_count);
+
+#ifdef RT_HW_USING_CAS
+    do
+    {
+        head = pool->head;
+        *(volatile rt_uint32_t *)block = head & LFPOOL_INDEX_MASK;
+    } while (!rt_hw_cas(&pool->head, head, LFPOOL_HEAD(head, index)));
+#else
+    /* disable interrupt */
+    level = rt_hw_interrupt_disable();
+
+    head = pool->head;
+    *(rt_uint32_t *)block = head & LFPOOL_INDEX_MASK;
+    pool->head = LFPOOL_HEAD(head, index);
+
+    /* enable interrupt */
+    rt_hw_interrupt_enable(level);
+#endif
+}
+RTM_EXPORT(rt_lfpool_free);
+
 /**@}*/
 
 #endif
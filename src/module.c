@@ -27,6 +27,9 @@
  * 2012-11-23     Bernard      using RT_DEBUG_LOG instead of rt_kprintf.
  * 2012-11-28     Bernard      remove rt_current_module and user
  *                             can use rt_module_unload to remove a module.
+ * 2017-06-30     agent        clear the name hash of module object container.
+ * 2017-07-11     agent        add hash index of kernel and module symbol table,
+ *                             and resolve each symbol once in relocation.
  */
 
 #include <rthw.h>
@@ -91,6 +94,104 @@ static struct rt_semaphore mod_sem;
 static struct rt_module_symtab *_rt_module_symtab_begin = RT_NULL;
 static struct rt_module_symtab *_rt_module_symtab_end   = RT_NULL;
 
+#ifdef RT_USING_MODULE_SYMHASH
+/*
+ * The hash index of a symbol table. It's built when the table is known, the
+ * kernel symbol table on module system initialization and the module symbol
+ * table on loading. The index is an array of rt_uint16_t:
+ *
+ * +--------------------------+-----------------------+
+ * | bucket[0 .. nbucket - 1] | chain[0 .. nsym - 1]  |
+ * +--------------------------+-----------------------+
+ *
+ * bucket[hash & (nbucket - 1)] is the first symbol in the bucket plus one,
+ * chain[index] is the next symbol in the same bucket plus one, 0 for the end.
+ * The nbucket is the power of two not less than half of nsym.
+ */
+static rt_uint16_t *_rt_module_symtab_hash = RT_NULL;
+
+/* the hash function of GNU hash section */
+rt_inline rt_uint32_t _rt_module_symhash(const char *name)
+{
+    rt_uint32_t hash = 5381;
+
+    while (*name)
+        hash = hash * 33 + (rt_uint8_t)*name++;
+
+    return hash;
+}
+
+rt_inline rt_uint32_t _rt_module_symhash_nbucket(rt_uint32_t nsym)
+{
+    rt_uint32_t nbucket = 1;
+
+    while (nbucket * 2 < nsym)
+        nbucket <<= 1;
+
+    return nbucket;
+}
+
+static rt_uint16_t *_rt_module_symhash_build(struct rt_module_symtab *symtab,
+                                             rt_uint32_t              nsym)
+{
+    rt_uint32_t index, nbucket, bucket;
+    rt_uint16_t *hash;
+
+    /* look up by the linear search */
+    if (nsym == 0 || nsym >= 0xFFFF)
+        return RT_NULL;
+
+    nbucket = _rt_module_symhash_nbucket(nsym);
+    hash = (rt_uint16_t *)rt_malloc((nbucket + nsym) * sizeof(rt_uint16_t));
+    if (hash == RT_NULL)
+        return RT_NULL;
+    rt_memset(hash, 0, nbucket * sizeof(rt_uint16_t));
+
+    /* the first symbol of same name is found first, as the linear search */
+    for (index = nsym; index > 0; index --)
+    {
+        bucket = _rt_module_symhash(symtab[index - 1].name) & (nbucket - 1);
+        hash[nbucket + index - 1] = hash[bucket];
+        hash[bucket] = index;
+    }
+
+    return hash;
+}
+#endif
+
+static struct rt_module_symtab *_rt_module_symtab_find(struct rt_module_symtab *symtab,
+                                                       rt_uint32_t              nsym,
+                                                       rt_uint16_t             *hash,
+                                                       const char              *name)
+{
+    rt_uint32_t index;
+
+#ifdef RT_USING_MODULE_SYMHASH
+    if (hash != RT_NULL)
+    {
+        rt_uint32_t nbucket = _rt_module_symhash_nbucket(nsym);
+
+        for (index = hash[_rt_module_symhash(name) & (nbucket - 1)];
+             index != 0;
+             index = hash[nbucket + index - 1])
+        {
+            if (rt_strcmp(symtab[index - 1].name, name) == 0)
+                return &symtab[index - 1];
+        }
+
+        return RT_NULL;
+    }
+#endif
+
+    for (index = 0; index < nsym; index ++)
+    {
+        if (rt_strcmp(symtab[index].name, name) == 0)
+            return &symtab[index];
+    }
+
+    return RT_NULL;
+}
+
 #if defined(__IAR_SYSTEMS_ICC__) /* for IAR compiler */
     #pragma section="RTMSymTab"
 #endif
@@ -119,6 +220,12 @@ int rt_system_module_init(void)
     _rt_module_symtab_end   = __section_begin("RTMSymTab");
 #endif
 
+#ifdef RT_USING_MODULE_SYMHASH
+    /* the kernel symbol table is fixed after link */
+    _rt_module_symtab_hash = _rt_module_symhash_build(_rt_module_symtab_begin,
+                                                      _rt_module_symtab_end - _rt_module_symtab_begin);
+#endif
+
 #ifdef RT_USING_SLAB
     /* initialize heap semaphore */
     rt_sem_init(&mod_sem, "module", 1, RT_IPC_FLAG_FIFO);
@@ -149,19 +256,51 @@ MSH_CMD_EXPORT(list_symbol, list symbol for module);
 static rt_uint32_t rt_module_symbol_find(const char *sym_str)
 {
     /* find in kernel symbol table */
-    struct rt_module_symtab *index;
+    struct rt_module_symtab *symbol;
+    rt_uint16_t *hash = RT_NULL;
 
-    for (index = _rt_module_symtab_begin;
-         index != _rt_module_symtab_end;
-         index ++)
-    {
-        if (rt_strcmp(index->name, sym_str) == 0)
-            return (rt_uint32_t)index->addr;
-    }
+#ifdef RT_USING_MODULE_SYMHASH
+    hash = _rt_module_symtab_hash;
+#endif
+    symbol = _rt_module_symtab_find(_rt_module_symtab_begin,
+                                    _rt_module_symtab_end - _rt_module_symtab_begin,
+                                    hash, sym_str);
+    if (symbol != RT_NULL)
+        return (rt_uint32_t)symbol->addr;
 
     return 0;
 }
 
+/**
+ * This function will find a symbol in the symbol table of a module, or in the
+ * kernel symbol table.
+ *
+ * @param module the module, RT_NULL for the kernel symbol table
+ * @param name the symbol name
+ *
+ * @return the address of symbol, RT_NULL if it's not found
+ */
+void *rt_module_find_symbol(rt_module_t module, const char *name)
+{
+    struct rt_module_symtab *symbol;
+    rt_uint16_t *hash = RT_NULL;
+
+    RT_ASSERT(name != RT_NULL);
+
+    if (module == RT_NULL)
+        return (void *)rt_module_symbol_find(name);
+
+#ifdef RT_USING_MODULE_SYMHASH
+    hash = module->symhash;
+#endif
+    symbol = _rt_module_symtab_find(module->symtab, module->nsym, hash, name);
+    if (symbol != RT_NULL)
+        return symbol->addr;
+
+    return RT_NULL;
+}
+RTM_EXPORT(rt_module_find_symbol);
+
 /**
  * This function will return self module object
  *
@@ -291,6 +430,11 @@ void rt_module_init_object_container(struct rt_module *module)
 {
     RT_ASSERT(module != RT_NULL);
 
+#ifdef RT_USING_OBJECT_HASH
+    /* the module is allocated from heap, clear the name hash buckets */
+    rt_memset(module->module_object, 0, sizeof(module->module_object));
+#endif
+
     /* initialize object container - thread */
     rt_list_init(&(module->module_object[RT_Object_Class_Thread].object_list));
     module->module_object[RT_Object_Class_Thread].object_size = sizeof(struct rt_thread);
@@ -483,6 +627,9 @@ static struct rt_module *_load_shared_object(const char *name,
     module->vstart_addr = vstart_addr;
 
     module->nref = 0;
+#ifdef RT_USING_MODULE_SYMHASH
+    module->symhash = RT_NULL;
+#endif
 
     /* allocate module space */
     module->module_space = rt_malloc(module_size);
@@ -514,9 +661,10 @@ static struct rt_module *_load_shared_object(const char *name,
     /* handle relocation section */
     for (index = 0; index < elf_module->e_shnum; index ++)
     {
-        rt_uint32_t i, nr_reloc;
+        rt_uint32_t i, nr_reloc, nr_sym;
         Elf32_Sym *symtab;
         Elf32_Rel *rel;
+        Elf32_Addr *resolved;
         rt_uint8_t *strtab;
         static rt_bool_t unsolved = RT_FALSE;
 
@@ -533,6 +681,15 @@ static struct rt_module *_load_shared_object(const char *name,
             shdr[shdr[shdr[index].sh_link].sh_link].sh_offset;
         nr_reloc = (rt_uint32_t)(shdr[index].sh_size / sizeof(Elf32_Rel));
 
+        /*
+         * a symbol is referenced by many relocations, the address is found in
+         * kernel symbol table once and kept for the others.
+         */
+        nr_sym   = (rt_uint32_t)(shdr[shdr[index].sh_link].sh_size / sizeof(Elf32_Sym));
+        resolved = (Elf32_Addr *)rt_malloc(nr_sym * sizeof(Elf32_Addr));
+        if (resolved != RT_NULL)
+            rt_memset(resolved, 0, nr_sym * sizeof(Elf32_Addr));
+
         /* relocate every items */
         for (i = 0; i < nr_reloc; i ++)
         {
@@ -558,7 +715,18 @@ static struct rt_module *_load_shared_object(const char *name,
                                                strtab + sym->st_name));
 
                 /* need to resolve symbol in kernel symbol table */
-                addr = rt_module_symbol_find((const char *)(strtab + sym->st_name));
+                if (resolved != RT_NULL && ELF32_R_SYM(rel->r_info) < nr_sym &&
+                    resolved[ELF32_R_SYM(rel->r_info)] != 0)
+                {
+                    addr = resolved[ELF32_R_SYM(rel->r_info)];
+                }
+                else
+                {
+                    addr = rt_module_symbol_find((const char *)(strtab + sym->st_name));
+                    if (resolved != RT_NULL && ELF32_R_SYM(rel->r_info) < nr_sym)
+                        resolved[ELF32_R_SYM(rel->r_info)] = addr;
+                }
+
                 if (addr == 0)
                 {
                     rt_kprintf("Module: can't find %s in kernel symbol table\n",
@@ -571,6 +739,9 @@ static struct rt_module *_load_shared_object(const char *name,
             rel ++;
         }
 
+        if (resolved != RT_NULL)
+            rt_free(resolved);
+
         if (unsolved)
         {
             rt_object_delete(&(module->parent));
@@ -629,6 +800,11 @@ static struct rt_module *_load_shared_object(const char *name,
                       length);
             count ++;
         }
+
+#ifdef RT_USING_MODULE_SYMHASH
+        /* for dlsym on the module */
+        module->symhash = _rt_module_symhash_build(module->symtab, module->nsym);
+#endif
     }
 
     return module;
@@ -679,6 +855,9 @@ static struct rt_module* _load_relocated_object(const char *name,
         return RT_NULL;
 
     module->vstart_addr = 0;
+#ifdef RT_USING_MODULE_SYMHASH
+    module->symhash = RT_NULL;
+#endif
 
     /* allocate module space */
     module->module_space = rt_malloc(module_size);
@@ -1454,6 +1633,10 @@ rt_err_t rt_module_destroy(rt_module_t module)
     }
     if (module->symtab != RT_NULL)
         rt_free(module->symtab);
+#ifdef RT_USING_MODULE_SYMHASH
+    if (module->symhash != RT_NULL)
+        rt_free(module->symhash);
+#endif
 
 #ifdef RT_USING_SLAB
     if (module->page_array != RT_NULL)
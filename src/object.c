@@ -25,6 +25,7 @@
  * 2006-08-03     Bernard      add hook support
  * 2007-01-28     Bernard      rename RT_OBJECT_Class_Static to RT_Object_Class_Static
  * 2010-10-26     yi.qiu       add module support in rt_object_allocate and rt_object_free
+ * 2017-06-30     agent        add name hash index of object container
  */
 
 #include <rtthread.h>
@@ -32,50 +33,96 @@
 
 #define _OBJ_CONTAINER_LIST_INIT(c)     \
     {&(rt_object_container[c].object_list), &(rt_object_container[c].object_list)}
+#ifdef RT_USING_OBJECT_HASH
+/* the empty buckets of name hash */
+#define _OBJ_CONTAINER_HASH_INIT        , {RT_NULL}
+#else
+#define _OBJ_CONTAINER_HASH_INIT
+#endif
 struct rt_object_information rt_object_container[RT_Object_Class_Unknown] =
 {
     /* initialize object container - thread */
-    {RT_Object_Class_Thread, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_Thread), sizeof(struct rt_thread)},
+    {RT_Object_Class_Thread, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_Thread), sizeof(struct rt_thread) _OBJ_CONTAINER_HASH_INIT},
 #ifdef RT_USING_SEMAPHORE
     /* initialize object container - semaphore */
-    {RT_Object_Class_Semaphore, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_Semaphore), sizeof(struct rt_semaphore)},
+    {RT_Object_Class_Semaphore, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_Semaphore), sizeof(struct rt_semaphore) _OBJ_CONTAINER_HASH_INIT},
 #endif
 #ifdef RT_USING_MUTEX
     /* initialize object container - mutex */
-    {RT_Object_Class_Mutex, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_Mutex), sizeof(struct rt_mutex)},
+    {RT_Object_Class_Mutex, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_Mutex), sizeof(struct rt_mutex) _OBJ_CONTAINER_HASH_INIT},
 #endif
 #ifdef RT_USING_EVENT
     /* initialize object container - event */
-    {RT_Object_Class_Event, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_Event), sizeof(struct rt_event)},
+    {RT_Object_Class_Event, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_Event), sizeof(struct rt_event) _OBJ_CONTAINER_HASH_INIT},
 #endif
 #ifdef RT_USING_MAILBOX
     /* initialize object container - mailbox */
-    {RT_Object_Class_MailBox, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_MailBox), sizeof(struct rt_mailbox)},
+    {RT_Object_Class_MailBox, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_MailBox), sizeof(struct rt_mailbox) _OBJ_CONTAINER_HASH_INIT},
 #endif
 #ifdef RT_USING_MESSAGEQUEUE
     /* initialize object container - message queue */
-    {RT_Object_Class_MessageQueue, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_MessageQueue), sizeof(struct rt_messagequeue)},
+    {RT_Object_Class_MessageQueue, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_MessageQueue), sizeof(struct rt_messagequeue) _OBJ_CONTAINER_HASH_INIT},
 #endif
 #ifdef RT_USING_MEMHEAP
     /* initialize object container - memory heap */
-    {RT_Object_Class_MemHeap, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_MemHeap), sizeof(struct rt_memheap)},
+    {RT_Object_Class_MemHeap, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_MemHeap), sizeof(struct rt_memheap) _OBJ_CONTAINER_HASH_INIT},
 #endif
 #ifdef RT_USING_MEMPOOL
     /* initialize object container - memory pool */
-    {RT_Object_Class_MemPool, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_MemPool), sizeof(struct rt_mempool)},
+    {RT_Object_Class_MemPool, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_MemPool), sizeof(struct rt_mempool) _OBJ_CONTAINER_HASH_INIT},
 #endif
 #ifdef RT_USING_DEVICE
     /* initialize object container - device */
-    {RT_Object_Class_Device, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_Device), sizeof(struct rt_device)},
+    {RT_Object_Class_Device, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_Device), sizeof(struct rt_device) _OBJ_CONTAINER_HASH_INIT},
 #endif
     /* initialize object container - timer */
-    {RT_Object_Class_Timer, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_Timer), sizeof(struct rt_timer)},
+    {RT_Object_Class_Timer, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_Timer), sizeof(struct rt_timer) _OBJ_CONTAINER_HASH_INIT},
 #ifdef RT_USING_MODULE
     /* initialize object container - module */
-    {RT_Object_Class_Module, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_Module), sizeof(struct rt_module)},
+    {RT_Object_Class_Module, _OBJ_CONTAINER_LIST_INIT(RT_Object_Class_Module), sizeof(struct rt_module) _OBJ_CONTAINER_HASH_INIT},
 #endif
 };
 
+#ifdef RT_USING_OBJECT_HASH
+/* the name is not terminated when it's RT_NAME_MAX long */
+rt_inline rt_uint32_t _rt_object_hash(const char *name)
+{
+    int index;
+    rt_uint32_t hash = 0;
+
+    for (index = 0; index < RT_NAME_MAX && name[index] != '\0'; index ++)
+        hash = hash * 31 + (rt_uint8_t)name[index];
+
+    return (hash ^ (hash >> 8)) & (RT_OBJECT_HASH_SIZE - 1);
+}
+
+/* shall be invoked with interrupt disabled */
+static void _rt_object_hash_insert(struct rt_object_information *information,
+                                   struct rt_object             *object)
+{
+    struct rt_object **bucket;
+
+    bucket = &(information->object_hash[_rt_object_hash(object->name)]);
+
+    object->hash_next  = *bucket;
+    object->hash_pprev = bucket;
+    if (*bucket != RT_NULL)
+        (*bucket)->hash_pprev = &(object->hash_next);
+    *bucket = object;
+}
+
+/* shall be invoked with interrupt disabled */
+static void _rt_object_hash_remove(struct rt_object *object)
+{
+    *(object->hash_pprev) = object->hash_next;
+    if (object->hash_next != RT_NULL)
+        object->hash_next->hash_pprev = object->hash_pprev;
+
+    object->hash_next  = RT_NULL;
+    object->hash_pprev = RT_NULL;
+}
+#endif
+
 #ifdef RT_USING_HOOK
 static void (*rt_object_attach_hook)(struct rt_object *object);
 static void (*rt_object_detach_hook)(struct rt_object *object);
@@ -232,6 +279,9 @@ void rt_object_init(struct rt_object         *object,
 
     /* insert object into information object list */
     rt_list_insert_after(&(information->object_list), &(object->list));
+#ifdef RT_USING_OBJECT_HASH
+    _rt_object_hash_insert(information, object);
+#endif
 
     /* unlock interrupt */
     rt_hw_interrupt_enable(temp);
@@ -257,6 +307,9 @@ void rt_object_detach(rt_object_t object)
 
     /* remove from old list */
     rt_list_remove(&(object->list));
+#ifdef RT_USING_OBJECT_HASH
+    _rt_object_hash_remove(object);
+#endif
 
     /* unlock interrupt */
     rt_hw_interrupt_enable(temp);
@@ -324,6 +377,9 @@ rt_object_t rt_object_allocate(enum rt_object_class_type type, const char *name)
 
     /* insert object into information object list */
     rt_list_insert_after(&(information->object_list), &(object->list));
+#ifdef RT_USING_OBJECT_HASH
+    _rt_object_hash_insert(information, object);
+#endif
 
     /* unlock interrupt */
     rt_hw_interrupt_enable(temp);
@@ -352,6 +408,9 @@ void rt_object_delete(rt_object_t object)
 
     /* remove from old list */
     rt_list_remove(&(object->list));
+#ifdef RT_USING_OBJECT_HASH
+    _rt_object_hash_remove(object);
+#endif
 
     /* unlock interrupt */
     rt_hw_interrupt_enable(temp);
@@ -402,7 +461,9 @@ rt_bool_t rt_object_is_systemobject(rt_object_t object)
 rt_object_t rt_object_find(const char *name, rt_uint8_t type)
 {
     struct rt_object *object = RT_NULL;
+#ifdef RT_USING_MODULE
     struct rt_list_node *node = RT_NULL;
+#endif
     struct rt_object_information *information = RT_NULL;
 
     /* parameter check */
@@ -474,22 +535,56 @@ rt_object_t rt_object_find(const char *name, rt_uint8_t type)
 
     /* try to find object */
     if (information == RT_NULL) information = &rt_object_container[type];
+    object = rt_object_lookup(information, name);
+
+    /* leave critical */
+    rt_exit_critical();
+
+    return object;
+}
+
+/**
+ * This function will find specified name object in an object container.
+ * With RT_USING_OBJECT_HASH, only the objects in the same name hash bucket
+ * are compared, otherwise the whole object list is walked.
+ *
+ * @param information the object container.
+ * @param name the specified name of object.
+ *
+ * @return the found object or RT_NULL if there is no this object
+ * in object container.
+ *
+ * @note the caller shall lock the scheduler or interrupt.
+ */
+rt_object_t rt_object_lookup(struct rt_object_information *information,
+                             const char                   *name)
+{
+    struct rt_object *object;
+#ifndef RT_USING_OBJECT_HASH
+    struct rt_list_node *node;
+#endif
+
+    RT_ASSERT(information != RT_NULL);
+    RT_ASSERT(name != RT_NULL);
+
+#ifdef RT_USING_OBJECT_HASH
+    for (object  = information->object_hash[_rt_object_hash(name)];
+         object != RT_NULL;
+         object  = object->hash_next)
+    {
+        if (rt_strncmp(object->name, name, RT_NAME_MAX) == 0)
+            return object;
+    }
+#else
     for (node  = information->object_list.next;
          node != &(information->object_list);
          node  = node->next)
     {
         object = rt_list_entry(node, struct rt_object, list);
         if (rt_strncmp(object->name, name, RT_NAME_MAX) == 0)
-        {
-            /* leave critical */
-            rt_exit_critical();
-
             return object;
-        }
     }
-
-    /* leave critical */
-    rt_exit_critical();
+#endif
 
     return RT_NULL;
 }
@@ -35,14 +35,21 @@
  * 2010-12-13     Bernard      add defunct list initialization even if not use heap.
  * 2011-05-10     Bernard      clean scheduler debug log.
  * 2013-12-21     Grissiom     add rt_critical_level
+ * 2017-06-24     agent        add SMP scheduler with per-cpu ready queue
+ * 2017-06-25     agent        use the inlined rt_hw_ffs to get highest priority
+ * 2017-07-03     agent        add cycle accounting of thread, interrupt and idle
+ * 2017-07-06     agent        sort the ready deadline threads by deadline
  */
 
 #include <rtthread.h>
 #include <rthw.h>
 
+#ifdef RT_USING_SMP
+/* the kernel lock shared by all CPUs */
+extern rt_hw_spinlock_t _cpus_lock;
+#else
 static rt_int16_t rt_scheduler_lock_nest;
 extern volatile rt_uint8_t rt_interrupt_nest;
-extern int __rt_ffs(int value);
 
 rt_list_t rt_thread_priority_table[RT_THREAD_PRIORITY_MAX];
 struct rt_thread *rt_current_thread;
@@ -58,10 +65,29 @@ rt_uint8_t rt_thread_ready_table[32];
 rt_uint32_t rt_thread_ready_priority_group;
 #endif
 
+/*
+ * Get the highest ready priority, the ready queue shall not be empty. For 256
+ * priority levels, it's two lookups: the group of 8 priorities in the 32bit
+ * group bitmap, then the priority in the 8bit bitmap of that group.
+ */
+rt_inline rt_ubase_t _rt_scheduler_highest_priority(void)
+{
+#if RT_THREAD_PRIORITY_MAX > 32
+    register rt_ubase_t number;
+
+    number = rt_hw_ffs(rt_thread_ready_priority_group) - 1;
+
+    return (number << 3) + rt_hw_ffs(rt_thread_ready_table[number]) - 1;
+#else
+    return rt_hw_ffs(rt_thread_ready_priority_group) - 1;
+#endif
+}
+#endif
+
 rt_list_t rt_thread_defunct;
 
 #ifdef RT_USING_HOOK
-static void (*rt_scheduler_hook)(struct rt_thread *from, struct rt_thread *to);
+void (*rt_scheduler_hook)(struct rt_thread *from, struct rt_thread *to);
 
 /**
  * @addtogroup Hook
@@ -84,6 +110,219 @@ rt_scheduler_sethook(void (*hook)(struct rt_thread *from, struct rt_thread *to))
 /**@}*/
 #endif
 
+#ifdef RT_USING_CPU_USAGE
+/*
+ * The cpu usage is accounted in cycles of rt_hw_cycle_get(). The cycles from
+ * the last accounting are charged to the running thread when it's switched
+ * out, and to the interrupt when leaving the outermost interrupt. Leaving the
+ * interrupt also charges the running thread, so the delta of each accounting
+ * is not longer than a tick and the 32 bits counter may wrap safely, except
+ * the tickless sleep of idle thread. The sleep is charged by the compensated
+ * ticks, in which the counter may wrap or stop.
+ *
+ * The cost is one read of cycle counter and several 64 bits additions on each
+ * thread switch and each interrupt.
+ */
+#ifndef RT_USING_SMP
+static struct rt_cpu_usage _cpu_usage;
+#endif
+
+rt_inline struct rt_cpu_usage *_rt_cpu_usage_self(void)
+{
+#ifdef RT_USING_SMP
+    return &(rt_cpu_self()->usage);
+#else
+    return &_cpu_usage;
+#endif
+}
+
+/* charge the cycles from the last accounting to the thread */
+rt_inline void _rt_cpu_usage_charge(struct rt_cpu_usage *usage,
+                                    struct rt_thread   *thread,
+                                    rt_uint32_t         cycle)
+{
+    rt_uint32_t delta;
+
+    delta = cycle - usage->last_cycle;
+    usage->last_cycle = cycle;
+
+    thread->cycles += delta;
+    usage->total   += delta;
+    if (thread == usage->idle_thread)
+        usage->idle += delta;
+}
+
+/* account the thread switched out, the interrupt is accounted on leaving */
+static void _rt_cpu_usage_switch(struct rt_thread *from_thread, int in_irq)
+{
+    struct rt_cpu_usage *usage = _rt_cpu_usage_self();
+
+    if (in_irq)
+        _rt_cpu_usage_charge(usage, from_thread, usage->irq_cycle);
+    else
+        _rt_cpu_usage_charge(usage, from_thread, rt_hw_cycle_get());
+}
+
+/* start the accounting of current cpu */
+static void _rt_cpu_usage_start(void)
+{
+    struct rt_cpu_usage *usage = _rt_cpu_usage_self();
+
+    usage->total = usage->irq = usage->idle = 0;
+    usage->last_cycle  = rt_hw_cycle_get();
+    usage->idle_thread = rt_thread_idle_gethandler();
+}
+
+/*
+ * This function is invoked by rt_interrupt_enter when entering the outermost
+ * interrupt, with the interrupt of current cpu disabled.
+ */
+void rt_cpu_usage_irq_enter(void)
+{
+    _rt_cpu_usage_self()->irq_cycle = rt_hw_cycle_get();
+}
+
+/*
+ * This function is invoked by rt_interrupt_leave when leaving the outermost
+ * interrupt, with the interrupt of current cpu disabled.
+ */
+void rt_cpu_usage_irq_leave(void)
+{
+    rt_uint32_t cycle, delta;
+    struct rt_thread *thread;
+    struct rt_cpu_usage *usage = _rt_cpu_usage_self();
+
+    /* the scheduler is not started */
+    thread = rt_thread_self();
+    if (usage->idle_thread == RT_NULL || thread == RT_NULL)
+        return;
+
+    /* the thread running before the interrupt, or the one switched in */
+    _rt_cpu_usage_charge(usage, thread, usage->irq_cycle);
+
+    cycle = rt_hw_cycle_get();
+    delta = cycle - usage->irq_cycle;
+    usage->last_cycle = cycle;
+    usage->irq   += delta;
+    usage->total += delta;
+}
+
+/* account the running thread of current cpu to now */
+static void _rt_cpu_usage_update(void)
+{
+    struct rt_thread *thread;
+    struct rt_cpu_usage *usage = _rt_cpu_usage_self();
+
+    thread = rt_thread_self();
+    if (usage->idle_thread == RT_NULL || thread == RT_NULL ||
+        rt_interrupt_get_nest() != 0)
+        return;
+
+    _rt_cpu_usage_charge(usage, thread, rt_hw_cycle_get());
+}
+
+#ifdef RT_USING_TICKLESS
+/*
+ * This function is invoked by the idle thread before the tickless sleep, with
+ * interrupt disabled.
+ */
+void rt_cpu_usage_sleep_enter(void)
+{
+    _rt_cpu_usage_update();
+}
+
+/*
+ * This function is invoked by the idle thread after the tickless sleep and
+ * the compensation of ticks, with interrupt disabled. The delta of counter is
+ * taken if it's within a tick of the slept ticks, otherwise the counter has
+ * stopped in sleep and the slept ticks are charged.
+ */
+void rt_cpu_usage_sleep_leave(rt_tick_t ticks)
+{
+    rt_uint32_t cycle, tick_cycles;
+    rt_int32_t diff;
+    rt_uint64_t delta;
+    struct rt_cpu_usage *usage = _rt_cpu_usage_self();
+
+    if (usage->idle_thread == RT_NULL)
+        return;
+
+    cycle = rt_hw_cycle_get();
+    tick_cycles = rt_hw_cycle_frequency() / RT_TICK_PER_SECOND;
+    delta = (rt_uint64_t)ticks * tick_cycles;
+
+    /* the 32 bits delta of counter is the lower bits of the 64 bits one */
+    diff = (rt_int32_t)((cycle - usage->last_cycle) - (rt_uint32_t)delta);
+    if (diff > -(rt_int32_t)tick_cycles && diff < (rt_int32_t)tick_cycles)
+        delta += diff;
+    usage->last_cycle = cycle;
+
+    usage->idle_thread->cycles += delta;
+    usage->total += delta;
+    usage->idle  += delta;
+}
+#endif
+
+/**
+ * This function will get the usage of a cpu, in cycles of rt_hw_cycle_get()
+ * from the scheduler starting. The running thread of current cpu is accounted
+ * to now, the one of other cpus is accounted to its last switch or interrupt.
+ *
+ * @param cpu the index of cpu, 0 on single cpu
+ * @param usage the usage to be filled
+ *
+ * @return RT_EOK on successful, -RT_ERROR if the cpu doesn't exist
+ */
+rt_err_t rt_cpu_usage_get(int cpu, struct rt_cpu_usage *usage)
+{
+    rt_base_t level;
+
+#ifdef RT_USING_SMP
+    if (cpu < 0 || cpu >= RT_CPUS_NR)
+        return -RT_ERROR;
+#else
+    if (cpu != 0)
+        return -RT_ERROR;
+#endif
+
+    level = rt_hw_interrupt_disable();
+    _rt_cpu_usage_update();
+#ifdef RT_USING_SMP
+    *usage = rt_cpu_index(cpu)->usage;
+#else
+    *usage = _cpu_usage;
+#endif
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_cpu_usage_get);
+
+/**
+ * This function will get the cycles of rt_hw_cycle_get() which the thread has
+ * run from the scheduler starting, the time in interrupt is not included.
+ *
+ * @param thread the thread
+ *
+ * @return the cycles of thread
+ */
+rt_uint64_t rt_thread_cycles_get(rt_thread_t thread)
+{
+    rt_base_t level;
+    rt_uint64_t cycles;
+
+    RT_ASSERT(thread != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    _rt_cpu_usage_update();
+    cycles = thread->cycles;
+    rt_hw_interrupt_enable(level);
+
+    return cycles;
+}
+RTM_EXPORT(rt_thread_cycles_get);
+#endif
+
 #ifdef RT_USING_OVERFLOW_CHECK
 static void _rt_scheduler_stack_check(struct rt_thread *thread)
 {
@@ -114,6 +353,348 @@ static void _rt_scheduler_stack_check(struct rt_thread *thread)
 }
 #endif
 
+#ifdef RT_USING_DEADLINE
+/* the job of thread has earlier deadline than the job of other thread */
+rt_inline rt_bool_t _rt_deadline_before(struct rt_thread *thread,
+                                        struct rt_thread *other)
+{
+    if (thread->deadline.period == 0 ||
+        thread->current_priority != RT_DEADLINE_PRIORITY)
+        return RT_FALSE;
+    if (other->deadline.period == 0 ||
+        other->current_priority != RT_DEADLINE_PRIORITY)
+        return RT_TRUE;
+
+    return (rt_int32_t)(other->deadline.abs_deadline -
+                        thread->deadline.abs_deadline) > 0;
+}
+
+/*
+ * Get the position in ready list to insert the thread before. The deadline
+ * threads in the deadline priority are sorted by the absolute deadline ahead
+ * of the other threads of same priority, the same deadline in FIFO.
+ */
+static rt_list_t *_rt_ready_list_position(rt_list_t *list, struct rt_thread *thread)
+{
+    struct rt_list_node *node;
+
+    if (thread->deadline.period == 0 ||
+        thread->current_priority != RT_DEADLINE_PRIORITY)
+        return list;
+
+    for (node = list->next; node != list; node = node->next)
+    {
+        if (_rt_deadline_before(thread, rt_list_entry(node, struct rt_thread, tlist)))
+            break;
+    }
+
+    return node;
+}
+#else
+#define _rt_ready_list_position(list, thread)   (list)
+#endif
+
+#ifdef RT_USING_SMP
+/*
+ * On SMP, each cpu has its own ready queue. The running thread is kept in the
+ * ready queue of its cpu as the uniprocessor scheduler does, so a cpu always
+ * picks the thread from its own queue. The unbound thread is put to the queue
+ * of the cpu where it can run at once when it's woken up or preempted, and the
+ * cpu going to idle steals the waiting thread from other CPUs.
+ *
+ * All of the ready queues are protected by the kernel lock.
+ */
+
+/* get the highest ready priority of cpu, RT_THREAD_PRIORITY_MAX if no thread */
+rt_inline rt_ubase_t _rt_scheduler_highest_priority(struct rt_cpu *pcpu)
+{
+    register rt_ubase_t number;
+
+    if (pcpu->ready_priority_group == 0)
+        return RT_THREAD_PRIORITY_MAX;
+
+    number = rt_hw_ffs(pcpu->ready_priority_group) - 1;
+#if RT_THREAD_PRIORITY_MAX > 32
+    return (number << 3) + rt_hw_ffs(pcpu->ready_table[number]) - 1;
+#else
+    return number;
+#endif
+}
+
+static void _rt_ready_queue_insert(int cpu_id, struct rt_thread *thread)
+{
+    struct rt_cpu *pcpu = rt_cpu_index(cpu_id);
+
+    /* insert thread to ready list */
+    rt_list_insert_before(_rt_ready_list_position(&(pcpu->priority_table[thread->current_priority]),
+                                                  thread),
+                          &(thread->tlist));
+
+    /* set priority mask */
+#if RT_THREAD_PRIORITY_MAX > 32
+    pcpu->ready_table[thread->number] |= thread->high_mask;
+#endif
+    pcpu->ready_priority_group |= thread->number_mask;
+
+    thread->ready_cpu = cpu_id;
+}
+
+static void _rt_ready_queue_remove(struct rt_thread *thread)
+{
+    struct rt_cpu *pcpu;
+
+    /* remove thread from ready list */
+    rt_list_remove(&(thread->tlist));
+
+    /* the thread has never been put to a ready queue */
+    if (thread->ready_cpu == RT_CPU_DETACHED)
+        return;
+
+    pcpu = rt_cpu_index(thread->ready_cpu);
+    if (rt_list_isempty(&(pcpu->priority_table[thread->current_priority])))
+    {
+#if RT_THREAD_PRIORITY_MAX > 32
+        pcpu->ready_table[thread->number] &= ~thread->high_mask;
+        if (pcpu->ready_table[thread->number] == 0)
+        {
+            pcpu->ready_priority_group &= ~thread->number_mask;
+        }
+#else
+        pcpu->ready_priority_group &= ~thread->number_mask;
+#endif
+    }
+}
+
+/*
+ * Select the ready queue for an unbound thread which is not running. It's the
+ * last cpu of thread if the thread can run there at once, otherwise the cpu
+ * with the lowest priority ready thread.
+ */
+static int _rt_scheduler_select_cpu(struct rt_thread *thread)
+{
+    int index, last, cpu_id;
+    rt_ubase_t priority, lowest;
+
+    last = thread->ready_cpu;
+    if (last == RT_CPU_DETACHED)
+        last = rt_hw_cpu_id();
+
+    lowest = _rt_scheduler_highest_priority(rt_cpu_index(last));
+    if (lowest > thread->current_priority)
+        return last;
+
+    cpu_id = last;
+    for (index = 0; index < RT_CPUS_NR; index ++)
+    {
+        priority = _rt_scheduler_highest_priority(rt_cpu_index(index));
+        if (priority > lowest)
+        {
+            lowest = priority;
+            cpu_id = index;
+        }
+    }
+
+    /* no cpu can run it at once, keep it on the last cpu */
+    if (lowest <= thread->current_priority)
+        return last;
+
+    return cpu_id;
+}
+
+/* ask the cpu to schedule if the thread can preempt the running thread */
+static void _rt_scheduler_kick(int cpu_id, struct rt_thread *thread)
+{
+    struct rt_thread *current_thread;
+
+    if (cpu_id == rt_hw_cpu_id())
+        return;
+
+    current_thread = rt_cpu_index(cpu_id)->current_thread;
+    if (current_thread != RT_NULL &&
+        (thread->current_priority < current_thread->current_priority
+#ifdef RT_USING_DEADLINE
+         || (thread->current_priority == current_thread->current_priority &&
+             _rt_deadline_before(thread, current_thread))
+#endif
+        ))
+    {
+        rt_hw_ipi_send(RT_SCHEDULE_IPI, 1 << cpu_id);
+    }
+}
+
+static void _rt_schedule_insert(struct rt_thread *thread)
+{
+    int cpu_id;
+
+    if (thread->oncpu != RT_CPU_DETACHED)
+        /* the running thread stays on its cpu */
+        cpu_id = thread->oncpu;
+    else if (thread->bind_cpu != RT_CPUS_NR)
+        cpu_id = thread->bind_cpu;
+    else
+        cpu_id = _rt_scheduler_select_cpu(thread);
+
+    _rt_ready_queue_insert(cpu_id, thread);
+    _rt_scheduler_kick(cpu_id, thread);
+}
+
+/*
+ * Steal the highest priority thread, which is neither running nor bound and
+ * not lower than the priority limit, from the ready queue of the victim cpu.
+ */
+static struct rt_thread *_rt_scheduler_steal_from(struct rt_cpu *victim,
+                                                  rt_ubase_t    limit)
+{
+    rt_ubase_t priority;
+    struct rt_list_node *node;
+    struct rt_thread *thread;
+
+    for (priority = 0; priority <= limit && priority < RT_THREAD_PRIORITY_MAX; priority ++)
+    {
+        /* skip the empty priority group */
+#if RT_THREAD_PRIORITY_MAX > 32
+        if ((victim->ready_priority_group & (1ul << (priority >> 3))) == 0)
+        {
+            priority |= 0x07;
+            continue;
+        }
+#else
+        if ((victim->ready_priority_group & (1ul << priority)) == 0)
+            continue;
+#endif
+
+        for (node  = victim->priority_table[priority].next;
+             node != &(victim->priority_table[priority]);
+             node  = node->next)
+        {
+            thread = rt_list_entry(node, struct rt_thread, tlist);
+            if (thread->oncpu == RT_CPU_DETACHED && thread->bind_cpu == RT_CPUS_NR)
+                return thread;
+        }
+    }
+
+    return RT_NULL;
+}
+
+static struct rt_thread *_rt_scheduler_steal(int cpu_id, rt_ubase_t limit)
+{
+    int index;
+    struct rt_thread *thread, *stolen = RT_NULL;
+
+    for (index = 1; index < RT_CPUS_NR; index ++)
+    {
+        thread = _rt_scheduler_steal_from(rt_cpu_index((cpu_id + index) % RT_CPUS_NR),
+                                          limit);
+        if (thread != RT_NULL)
+        {
+            stolen = thread;
+
+            /* only the higher priority thread on other cpu is better */
+            if (thread->current_priority == 0)
+                break;
+            limit = thread->current_priority - 1;
+        }
+    }
+
+    return stolen;
+}
+
+/*
+ * Get the thread to run on the cpu. The current thread bound to other cpu is
+ * migrated, and the cpu steals thread from other CPUs instead of going to idle.
+ */
+static struct rt_thread *_rt_scheduler_get_thread(int cpu_id,
+                                                  struct rt_thread *current_thread)
+{
+    rt_ubase_t highest_ready_priority;
+    struct rt_thread *to_thread, *stolen;
+    struct rt_cpu *pcpu = rt_cpu_index(cpu_id);
+
+    if (current_thread != RT_NULL &&
+        current_thread->stat == RT_THREAD_READY &&
+        current_thread->bind_cpu != RT_CPUS_NR &&
+        current_thread->bind_cpu != cpu_id)
+    {
+        /*
+         * The thread is still running here, however the other cpu can't pick
+         * it up before its context is saved, because the kernel lock is held
+         * until the switch is finished.
+         */
+        _rt_ready_queue_remove(current_thread);
+        current_thread->oncpu = RT_CPU_DETACHED;
+        _rt_ready_queue_insert(current_thread->bind_cpu, current_thread);
+        rt_hw_ipi_send(RT_SCHEDULE_IPI, 1 << current_thread->bind_cpu);
+    }
+
+    highest_ready_priority = _rt_scheduler_highest_priority(pcpu);
+    to_thread = rt_list_entry(pcpu->priority_table[highest_ready_priority].next,
+                              struct rt_thread,
+                              tlist);
+
+    if (to_thread == rt_thread_idle_gethandler())
+    {
+        /* the cpu is going to idle, steal the waiting thread of other cpu */
+        stolen = _rt_scheduler_steal(cpu_id, highest_ready_priority);
+        if (stolen != RT_NULL)
+        {
+            RT_DEBUG_LOG(RT_DEBUG_SCHEDULER,
+                         ("cpu%d steals thread:%.*s from cpu%d\n",
+                          cpu_id, RT_NAME_MAX, stolen->name, stolen->ready_cpu));
+
+            _rt_ready_queue_remove(stolen);
+            _rt_ready_queue_insert(cpu_id, stolen);
+            to_thread = stolen;
+        }
+    }
+
+    return to_thread;
+}
+
+/* update the scheduling state before switching from the thread to another */
+static void _rt_scheduler_switch_prepare(int               cpu_id,
+                                         struct rt_thread *from_thread,
+                                         struct rt_thread *to_thread)
+{
+    int cpu;
+
+    rt_cpu_index(cpu_id)->current_priority = to_thread->current_priority;
+    from_thread->oncpu = RT_CPU_DETACHED;
+    to_thread->oncpu   = cpu_id;
+
+    /* the preempted thread may run on other cpu with lower priority thread */
+    if (from_thread->stat == RT_THREAD_READY &&
+        from_thread->bind_cpu == RT_CPUS_NR)
+    {
+        cpu = _rt_scheduler_select_cpu(from_thread);
+        if (cpu != cpu_id)
+        {
+            _rt_ready_queue_remove(from_thread);
+            _rt_ready_queue_insert(cpu, from_thread);
+            _rt_scheduler_kick(cpu, from_thread);
+        }
+    }
+
+#ifdef RT_USING_CPU_USAGE
+    _rt_cpu_usage_switch(from_thread, 0);
+#endif
+
+    RT_OBJECT_HOOK_CALL(rt_scheduler_hook, (from_thread, to_thread));
+
+    /* switch to new thread */
+    RT_DEBUG_LOG(RT_DEBUG_SCHEDULER,
+                 ("[cpu%d]switch to priority#%d "
+                  "thread:%.*s(sp:0x%p), "
+                  "from thread:%.*s(sp: 0x%p)\n",
+                  cpu_id, to_thread->current_priority,
+                  RT_NAME_MAX, to_thread->name, to_thread->sp,
+                  RT_NAME_MAX, from_thread->name, from_thread->sp));
+
+#ifdef RT_USING_OVERFLOW_CHECK
+    _rt_scheduler_stack_check(to_thread);
+#endif
+}
+#endif
+
 /**
  * @ingroup SystemInit
  * This function will initialize the system scheduler
@@ -121,12 +702,41 @@ static void _rt_scheduler_stack_check(struct rt_thread *thread)
 void rt_system_scheduler_init(void)
 {
     register rt_base_t offset;
-
-    rt_scheduler_lock_nest = 0;
+#ifdef RT_USING_SMP
+    int cpu;
+    struct rt_cpu *pcpu;
+#endif
 
     RT_DEBUG_LOG(RT_DEBUG_SCHEDULER, ("start scheduler: max priority 0x%02x\n",
                                       RT_THREAD_PRIORITY_MAX));
 
+#ifdef RT_USING_SMP
+    for (cpu = 0; cpu < RT_CPUS_NR; cpu ++)
+    {
+        pcpu = rt_cpu_index(cpu);
+
+        for (offset = 0; offset < RT_THREAD_PRIORITY_MAX; offset ++)
+        {
+            rt_list_init(&pcpu->priority_table[offset]);
+        }
+
+        pcpu->current_priority    = RT_THREAD_PRIORITY_MAX - 1;
+        pcpu->current_thread      = RT_NULL;
+        pcpu->irq_nest            = 0;
+        pcpu->irq_switch_flag     = 0;
+        pcpu->scheduler_lock_nest = 0;
+
+        /* initialize ready priority group */
+        pcpu->ready_priority_group = 0;
+
+#if RT_THREAD_PRIORITY_MAX > 32
+        /* initialize ready table */
+        rt_memset(pcpu->ready_table, 0, sizeof(pcpu->ready_table));
+#endif
+    }
+#else
+    rt_scheduler_lock_nest = 0;
+
     for (offset = 0; offset < RT_THREAD_PRIORITY_MAX; offset ++)
     {
         rt_list_init(&rt_thread_priority_table[offset]);
@@ -141,6 +751,7 @@ void rt_system_scheduler_init(void)
 #if RT_THREAD_PRIORITY_MAX > 32
     /* initialize ready table */
     rt_memset(rt_thread_ready_table, 0, sizeof(rt_thread_ready_table));
+#endif
 #endif
 
     /* initialize thread defunct */
@@ -151,21 +762,38 @@ void rt_system_scheduler_init(void)
  * @ingroup SystemInit
  * This function will startup scheduler. It will select one thread
  * with the highest priority level, then switch to it.
+ *
+ * @note On SMP, it's invoked by each cpu to start the scheduling on it.
  */
 void rt_system_scheduler_start(void)
 {
     register struct rt_thread *to_thread;
-    register rt_ubase_t highest_ready_priority;
+#ifdef RT_USING_SMP
+    int cpu_id;
 
-#if RT_THREAD_PRIORITY_MAX > 32
-    register rt_ubase_t number;
+    /* the kernel lock is passed to the first thread */
+    rt_hw_local_irq_disable();
+    rt_hw_spin_lock(&_cpus_lock);
 
-    number = __rt_ffs(rt_thread_ready_priority_group) - 1;
-    highest_ready_priority = (number << 3) + __rt_ffs(rt_thread_ready_table[number]) - 1;
-#else
-    highest_ready_priority = __rt_ffs(rt_thread_ready_priority_group) - 1;
+    cpu_id = rt_hw_cpu_id();
+    to_thread = _rt_scheduler_get_thread(cpu_id, RT_NULL);
+
+    rt_cpu_index(cpu_id)->current_priority = to_thread->current_priority;
+    to_thread->oncpu = cpu_id;
+
+    /* the cycle counter is used by the accounting and the benchmarks */
+    rt_hw_cycle_init();
+#ifdef RT_USING_CPU_USAGE
+    _rt_cpu_usage_start();
 #endif
 
+    /* switch to new thread */
+    rt_hw_context_switch_to((rt_uint32_t)&to_thread->sp, to_thread);
+#else
+    register rt_ubase_t highest_ready_priority;
+
+    highest_ready_priority = _rt_scheduler_highest_priority();
+
     /* get switch to thread */
     to_thread = rt_list_entry(rt_thread_priority_table[highest_ready_priority].next,
                               struct rt_thread,
@@ -173,8 +801,15 @@ void rt_system_scheduler_start(void)
 
     rt_current_thread = to_thread;
 
+    /* the cycle counter is used by the accounting and the benchmarks */
+    rt_hw_cycle_init();
+#ifdef RT_USING_CPU_USAGE
+    _rt_cpu_usage_start();
+#endif
+
     /* switch to new thread */
     rt_hw_context_switch_to((rt_uint32_t)&to_thread->sp);
+#endif
 
     /* never come back */
 }
@@ -185,6 +820,102 @@ void rt_system_scheduler_start(void)
 
 /**@{*/
 
+#ifdef RT_USING_SMP
+/**
+ * This function will perform one schedule on current cpu. It will select one
+ * thread with the highest priority level in the ready queue of cpu, then switch
+ * to it. In interrupt, the switch is delayed to the leaving of interrupt.
+ */
+void rt_schedule(void)
+{
+    rt_base_t level;
+    int cpu_id;
+    struct rt_cpu *pcpu;
+    struct rt_thread *to_thread;
+    struct rt_thread *current_thread;
+
+    /* disable interrupt */
+    level = rt_hw_interrupt_disable();
+
+    cpu_id = rt_hw_cpu_id();
+    pcpu   = rt_cpu_index(cpu_id);
+    current_thread = pcpu->current_thread;
+
+    if (pcpu->irq_nest)
+    {
+        /* switch thread when leaving the interrupt */
+        pcpu->irq_switch_flag = 1;
+    }
+    else if (pcpu->scheduler_lock_nest == 0 && current_thread != RT_NULL)
+    {
+        pcpu->irq_switch_flag = 0;
+
+        to_thread = _rt_scheduler_get_thread(cpu_id, current_thread);
+        if (to_thread != current_thread)
+        {
+            _rt_scheduler_switch_prepare(cpu_id, current_thread, to_thread);
+
+            rt_hw_context_switch((rt_uint32_t)&current_thread->sp,
+                                 (rt_uint32_t)&to_thread->sp, to_thread);
+        }
+    }
+
+    /* enable interrupt */
+    rt_hw_interrupt_enable(level);
+}
+
+/**
+ * This function will perform the thread switch requested in interrupt. It's
+ * invoked by the port when leaving the outermost interrupt.
+ *
+ * @param context the context of interrupted thread
+ */
+void rt_scheduler_do_irq_switch(void *context)
+{
+    rt_base_t level;
+    int cpu_id;
+    struct rt_cpu *pcpu;
+    struct rt_thread *to_thread;
+    struct rt_thread *current_thread;
+
+    /* disable interrupt */
+    level = rt_hw_interrupt_disable();
+
+    cpu_id = rt_hw_cpu_id();
+    pcpu   = rt_cpu_index(cpu_id);
+    current_thread = pcpu->current_thread;
+
+    if (pcpu->irq_switch_flag && pcpu->irq_nest == 0 &&
+        pcpu->scheduler_lock_nest == 0 && current_thread != RT_NULL)
+    {
+        pcpu->irq_switch_flag = 0;
+
+        to_thread = _rt_scheduler_get_thread(cpu_id, current_thread);
+        if (to_thread != current_thread)
+        {
+            _rt_scheduler_switch_prepare(cpu_id, current_thread, to_thread);
+
+            RT_DEBUG_LOG(RT_DEBUG_SCHEDULER, ("switch in interrupt\n"));
+
+            rt_hw_context_switch_interrupt(context,
+                                           (rt_uint32_t)&current_thread->sp,
+                                           (rt_uint32_t)&to_thread->sp, to_thread);
+        }
+    }
+
+    /* enable interrupt */
+    rt_hw_interrupt_enable(level);
+}
+
+/**
+ * This function is the handler of RT_SCHEDULE_IPI, which is sent when a thread
+ * put to the ready queue of other cpu can preempt the running thread there.
+ */
+void rt_scheduler_ipi_handler(int vector, void *param)
+{
+    rt_schedule();
+}
+#else
 /**
  * This function will perform one schedule. It will select one thread
  * with the highest priority level, then switch to it.
@@ -203,14 +934,7 @@ void rt_schedule(void)
     {
         register rt_ubase_t highest_ready_priority;
 
-#if RT_THREAD_PRIORITY_MAX <= 32
-        highest_ready_priority = __rt_ffs(rt_thread_ready_priority_group) - 1;
-#else
-        register rt_ubase_t number;
-
-        number = __rt_ffs(rt_thread_ready_priority_group) - 1;
-        highest_ready_priority = (number << 3) + __rt_ffs(rt_thread_ready_table[number]) - 1;
-#endif
+        highest_ready_priority = _rt_scheduler_highest_priority();
 
         /* get switch to thread */
         to_thread = rt_list_entry(rt_thread_priority_table[highest_ready_priority].next,
@@ -224,6 +948,10 @@ void rt_schedule(void)
             from_thread         = rt_current_thread;
             rt_current_thread   = to_thread;
 
+#ifdef RT_USING_CPU_USAGE
+            _rt_cpu_usage_switch(from_thread, rt_interrupt_nest);
+#endif
+
             RT_OBJECT_HOOK_CALL(rt_scheduler_hook, (from_thread, to_thread));
 
             /* switch to new thread */
@@ -257,6 +985,7 @@ void rt_schedule(void)
     /* enable interrupt */
     rt_hw_interrupt_enable(level);
 }
+#endif
 
 /*
  * This function will insert a thread to system ready queue. The state of
@@ -277,9 +1006,15 @@ void rt_schedule_insert_thread(struct rt_thread *thread)
     /* change stat */
     thread->stat = RT_THREAD_READY;
 
+#ifdef RT_USING_SMP
+    /* insert thread to the ready queue of cpu */
+    _rt_schedule_insert(thread);
+#else
     /* insert thread to ready list */
-    rt_list_insert_before(&(rt_thread_priority_table[thread->current_priority]),
+    rt_list_insert_before(_rt_ready_list_position(&(rt_thread_priority_table[thread->current_priority]),
+                                                  thread),
                           &(thread->tlist));
+#endif
 
     /* set priority mask */
 #if RT_THREAD_PRIORITY_MAX <= 32
@@ -295,10 +1030,12 @@ void rt_schedule_insert_thread(struct rt_thread *thread)
                   thread->high_mask));
 #endif
 
+#ifndef RT_USING_SMP
 #if RT_THREAD_PRIORITY_MAX > 32
     rt_thread_ready_table[thread->number] |= thread->high_mask;
 #endif
     rt_thread_ready_priority_group |= thread->number_mask;
+#endif
 
     /* enable interrupt */
     rt_hw_interrupt_enable(temp);
@@ -334,6 +1071,13 @@ void rt_schedule_remove_thread(struct rt_thread *thread)
                   thread->high_mask));
 #endif
 
+#ifdef RT_USING_SMP
+    _rt_ready_queue_remove(thread);
+
+    /* the thread is running on other cpu, which shall switch it out */
+    if (thread->oncpu != RT_CPU_DETACHED && thread->oncpu != rt_hw_cpu_id())
+        rt_hw_ipi_send(RT_SCHEDULE_IPI, 1 << thread->oncpu);
+#else
     /* remove thread from ready list */
     rt_list_remove(&(thread->tlist));
     if (rt_list_isempty(&(rt_thread_priority_table[thread->current_priority])))
@@ -348,11 +1092,81 @@ void rt_schedule_remove_thread(struct rt_thread *thread)
         rt_thread_ready_priority_group &= ~thread->number_mask;
 #endif
     }
+#endif
 
     /* enable interrupt */
     rt_hw_interrupt_enable(temp);
 }
 
+#ifdef RT_USING_SMP
+/**
+ * This function will lock the thread scheduler of current cpu.
+ *
+ * @note On SMP, the critical section holds the kernel lock, which keeps the
+ * mutual exclusion of critical section between CPUs.
+ */
+void rt_enter_critical(void)
+{
+    register rt_base_t level;
+
+    /* the kernel lock is released in rt_exit_critical */
+    level = rt_hw_interrupt_disable();
+
+    rt_cpu_self()->scheduler_lock_nest ++;
+
+    /* enable local interrupt */
+    rt_hw_local_irq_enable(level);
+}
+RTM_EXPORT(rt_enter_critical);
+
+/**
+ * This function will unlock the thread scheduler of current cpu.
+ */
+void rt_exit_critical(void)
+{
+    register rt_base_t level;
+    struct rt_cpu *pcpu;
+
+    /* disable local interrupt */
+    level = rt_hw_local_irq_disable();
+
+    pcpu = rt_cpu_self();
+    pcpu->scheduler_lock_nest --;
+
+    if (pcpu->scheduler_lock_nest <= 0)
+    {
+        pcpu->scheduler_lock_nest = 0;
+        /* release the kernel lock of rt_enter_critical */
+        rt_hw_interrupt_enable(level);
+
+        rt_schedule();
+    }
+    else
+    {
+        /* release the kernel lock of rt_enter_critical */
+        rt_hw_interrupt_enable(level);
+    }
+}
+RTM_EXPORT(rt_exit_critical);
+
+/**
+ * Get the scheduler lock level of current cpu
+ *
+ * @return the level of the scheduler lock. 0 means unlocked.
+ */
+rt_uint16_t rt_critical_level(void)
+{
+    register rt_base_t level;
+    rt_uint16_t critical_level;
+
+    level = rt_hw_local_irq_disable();
+    critical_level = rt_cpu_self()->scheduler_lock_nest;
+    rt_hw_local_irq_enable(level);
+
+    return critical_level;
+}
+RTM_EXPORT(rt_critical_level);
+#else
 /**
  * This function will lock the thread scheduler.
  */
@@ -412,5 +1226,5 @@ rt_uint16_t rt_critical_level(void)
     return rt_scheduler_lock_nest;
 }
 RTM_EXPORT(rt_critical_level);
+#endif
 /**@}*/
-
@@ -23,6 +23,7 @@
  * 2010-07-13     Bernard      fix RT_ALIGN issue found by kuronca
  * 2010-10-23     yi.qiu       add module memory allocator
  * 2010-12-18     yi.qiu       fix zone release bug
+ * 2017-06-27     agent        add per-thread magazine caches and slab stats
  */
 
 /*
@@ -202,6 +203,11 @@ typedef struct slab_zone
 static slab_zone *zone_array[NZONES];   /* linked list of zones NFree > 0 */
 static slab_zone *zone_free;            /* whole zones that have become free */
 
+#ifdef RT_MEM_STATS
+static rt_uint32_t zone_count[NZONES];  /* number of zones in use */
+static rt_uint32_t zone_used[NZONES];   /* chunks allocated out of zones */
+#endif
+
 static int zone_free_cnt;
 static int zone_size;
 static int zone_limit;
@@ -468,89 +474,26 @@ rt_inline int zoneindex(rt_uint32_t *bytes)
     return 0;
 }
 
-/**
- * @addtogroup MM
- */
-
-/**@{*/
-
-/**
- * This function will allocate a block from system heap memory.
- * - If the nbytes is less than zero,
- * or
- * - If there is no nbytes sized memory valid in system,
- * the RT_NULL is returned.
- *
- * @param size the size of memory to be allocated
+/*
+ * Allocate a chunk out of the zones of zi, the heap lock shall be held.
  *
- * @return the allocated memory
+ * The heap lock is released when a zone is allocated from page allocator,
+ * and it's held again when returns.
  */
-void *rt_malloc(rt_size_t size)
+static slab_chunk *slab_zone_alloc(rt_int32_t zi, rt_uint32_t size)
 {
     slab_zone *z;
-    rt_int32_t zi;
     slab_chunk *chunk;
     struct memusage *kup;
 
-    /* zero size, return RT_NULL */
-    if (size == 0)
-        return RT_NULL;
-
-#ifdef RT_USING_MODULE
-    if (rt_module_self() != RT_NULL)
-        return rt_module_malloc(size);
-#endif
-
-    /*
-     * Handle large allocations directly.  There should not be very many of
-     * these so performance is not a big issue.
-     */
-    if (size >= zone_limit)
-    {
-        size = RT_ALIGN(size, RT_MM_PAGE_SIZE);
-
-        chunk = rt_page_alloc(size >> RT_MM_PAGE_BITS);
-        if (chunk == RT_NULL)
-            return RT_NULL;
-
-        /* set kup */
-        kup = btokup(chunk);
-        kup->type = PAGE_TYPE_LARGE;
-        kup->size = size >> RT_MM_PAGE_BITS;
-
-        RT_DEBUG_LOG(RT_DEBUG_SLAB,
-                     ("malloc a large memory 0x%x, page cnt %d, kup %d\n",
-                      size,
-                      size >> RT_MM_PAGE_BITS,
-                      ((rt_uint32_t)chunk - heap_start) >> RT_MM_PAGE_BITS));
-
-        /* lock heap */
-        rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
-
-#ifdef RT_MEM_STATS
-        used_mem += size;
-        if (used_mem > max_mem)
-            max_mem = used_mem;
-#endif
-        goto done;
-    }
-
-    /* lock heap */
-    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+    RT_DEBUG_LOG(RT_DEBUG_SLAB, ("try to malloc 0x%x on zone: %d\n", size, zi));
 
     /*
      * Attempt to allocate out of an existing zone.  First try the free list,
      * then allocate out of unallocated space.  If we find a good zone move
      * it to the head of the list so later allocations find it quickly
      * (we might have thousands of zones in the list).
-     *
-     * Note: zoneindex() will panic of size is too large.
      */
-    zi = zoneindex(&size);
-    RT_ASSERT(zi < NZONES);
-
-    RT_DEBUG_LOG(RT_DEBUG_SLAB, ("try to malloc 0x%x on zone: %d\n", size, zi));
-
     if ((z = zone_array[zi]) != RT_NULL)
     {
         RT_ASSERT(z->z_nfree > 0);
@@ -581,25 +524,17 @@ void *rt_malloc(rt_size_t size)
             /* remove this chunk from list */
             z->z_freechunk = z->z_freechunk->c_next;
         }
-
-#ifdef RT_MEM_STATS
-        used_mem += z->z_chunksize;
-        if (used_mem > max_mem)
-            max_mem = used_mem;
-#endif
-
-        goto done;
     }
-
-    /*
-     * If all zones are exhausted we need to allocate a new zone for this
-     * index.
-     *
-     * At least one subsystem, the tty code (see CROUND) expects power-of-2
-     * allocations to be power-of-2 aligned.  We maintain compatibility by
-     * adjusting the base offset below.
-     */
+    else
     {
+        /*
+         * If all zones are exhausted we need to allocate a new zone for this
+         * index.
+         *
+         * At least one subsystem, the tty code (see CROUND) expects power-of-2
+         * allocations to be power-of-2 aligned.  We maintain compatibility by
+         * adjusting the base offset below.
+         */
         rt_int32_t off;
 
         if ((z = zone_free) != RT_NULL)
@@ -615,12 +550,13 @@ void *rt_malloc(rt_size_t size)
 
             /* allocate a zone from page */
             z = rt_page_alloc(zone_size / RT_MM_PAGE_SIZE);
-            if (z == RT_NULL)
-                goto fail;
 
             /* lock heap */
             rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
 
+            if (z == RT_NULL)
+                return RT_NULL;
+
             RT_DEBUG_LOG(RT_DEBUG_SLAB, ("alloc a new zone: 0x%x\n",
                                          (rt_uint32_t)z));
 
@@ -664,12 +600,453 @@ void *rt_malloc(rt_size_t size)
         zone_array[zi] = z;
 
 #ifdef RT_MEM_STATS
-        used_mem += z->z_chunksize;
+        zone_count[zi] ++;
+#endif
+    }
+
+#ifdef RT_MEM_STATS
+    zone_used[zi] ++;
+    used_mem += z->z_chunksize;
+    if (used_mem > max_mem)
+        max_mem = used_mem;
+#endif
+
+    return chunk;
+}
+
+/*
+ * Release a chunk to its zone, the heap lock shall be held.
+ *
+ * It returns the zone which shall be released to page allocator after the
+ * heap lock is released, or RT_NULL.
+ */
+static slab_zone *slab_zone_free(slab_zone *z, void *ptr)
+{
+    slab_chunk *chunk;
+    struct memusage *kup;
+
+    chunk          = (slab_chunk *)ptr;
+    chunk->c_next  = z->z_freechunk;
+    z->z_freechunk = chunk;
+
+#ifdef RT_MEM_STATS
+    zone_used[z->z_zoneindex] --;
+    used_mem -= z->z_chunksize;
+#endif
+
+    /*
+     * Bump the number of free chunks.  If it becomes non-zero the zone
+     * must be added back onto the appropriate list.
+     */
+    if (z->z_nfree++ == 0)
+    {
+        z->z_next = zone_array[z->z_zoneindex];
+        zone_array[z->z_zoneindex] = z;
+    }
+
+    /*
+     * If the zone becomes totally free, and there are other zones we
+     * can allocate from, move this zone to the FreeZones list.  Since
+     * this code can be called from an IPI callback, do *NOT* try to mess
+     * with kernel_map here.  Hysteresis will be performed at malloc() time.
+     */
+    if (z->z_nfree == z->z_nmax &&
+        (z->z_next || zone_array[z->z_zoneindex] != z))
+    {
+        slab_zone **pz;
+
+        RT_DEBUG_LOG(RT_DEBUG_SLAB, ("free zone 0x%x\n",
+                                     (rt_uint32_t)z, z->z_zoneindex));
+
+        /* remove zone from zone array list */
+        for (pz = &zone_array[z->z_zoneindex]; z != *pz; pz = &(*pz)->z_next)
+            ;
+        *pz = z->z_next;
+
+#ifdef RT_MEM_STATS
+        zone_count[z->z_zoneindex] --;
+#endif
+
+        /* reset zone */
+        z->z_magic = -1;
+
+        /* insert to free zone list */
+        z->z_next = zone_free;
+        zone_free = z;
+
+        ++ zone_free_cnt;
+
+        /* release zone to page allocator */
+        if (zone_free_cnt > ZONE_RELEASE_THRESH)
+        {
+            register rt_base_t i;
+
+            z         = zone_free;
+            zone_free = z->z_next;
+            -- zone_free_cnt;
+
+            /* set message usage */
+            for (i = 0, kup = btokup(z); i < zone_page_cnt; i ++)
+            {
+                kup->type = PAGE_TYPE_FREE;
+                kup->size = 0;
+                kup ++;
+            }
+
+            return z;
+        }
+    }
+
+    return RT_NULL;
+}
+
+#ifdef RT_USING_SLAB_CACHE
+/*
+ * Per-thread magazine caches
+ *
+ * Each thread holds a magazine of free chunks for each zone of the chunk size
+ * up to RT_SLAB_CACHE_SIZE.  The allocation and release of small chunks are
+ * served from the magazine of current thread without the heap lock, and the
+ * zones are the depot of magazines: an empty magazine is refilled with half
+ * of its capacity, and a full magazine is flushed by half, in one holding of
+ * the heap lock.
+ *
+ * The magazines are created on the first use in the thread, and flushed back
+ * to the zones by rt_slab_cache_flush() when the thread exits, or when it's
+ * detached or deleted and is not running on any cpu.  The chunks in the
+ * magazines are counted as used memory.
+ */
+#ifndef RT_SLAB_CACHE_SIZE
+#define RT_SLAB_CACHE_SIZE      256
+#endif
+#ifndef RT_SLAB_MAGAZINE_SIZE
+#define RT_SLAB_MAGAZINE_SIZE   512
+#endif
+
+/* the number of cached zones, follows zoneindex() */
+#if RT_SLAB_CACHE_SIZE <= 128
+#define SLAB_CACHE_ZONES        ((RT_SLAB_CACHE_SIZE + 7) / 8)
+#elif RT_SLAB_CACHE_SIZE <= 256
+#define SLAB_CACHE_ZONES        ((RT_SLAB_CACHE_SIZE + 15) / 16 + 8)
+#elif RT_SLAB_CACHE_SIZE <= 512
+#define SLAB_CACHE_ZONES        ((RT_SLAB_CACHE_SIZE + 31) / 32 + 16)
+#else
+#error "RT_SLAB_CACHE_SIZE shall not be larger than 512"
+#endif
+
+/* the number of chunks in a magazine */
+#define SLAB_MAGAZINE_MIN       4
+#define SLAB_MAGAZINE_MAX       32
+
+struct slab_magazine
+{
+    rt_uint16_t count;          /* number of chunks in magazine */
+    rt_uint16_t capacity;       /* maximal number of chunks */
+
+    void *rounds[1];            /* the chunks */
+};
+
+struct slab_cache
+{
+    struct slab_magazine *magazines[SLAB_CACHE_ZONES];
+
+    rt_uint32_t hit;            /* served by magazine */
+    rt_uint32_t miss;           /* served by zones */
+};
+
+/* the statistics of the caches have been flushed */
+static rt_uint32_t cache_hit, cache_miss;
+
+/* allocate a chunk out of zones, the caches are bypassed */
+static void *slab_alloc_nocache(rt_uint32_t size)
+{
+    rt_int32_t zi;
+    slab_chunk *chunk;
+
+    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+    zi = zoneindex(&size);
+    chunk = slab_zone_alloc(zi, size);
+    rt_sem_release(&heap_sem);
+
+    return chunk;
+}
+
+/* release a chunk to zones, the caches are bypassed */
+static void slab_free_nocache(void *ptr)
+{
+    slab_zone *z;
+    struct memusage *kup;
+
+    kup = btokup((rt_uint32_t)ptr & ~RT_MM_PAGE_MASK);
+    z = (slab_zone *)(((rt_uint32_t)ptr & ~RT_MM_PAGE_MASK) -
+                      kup->size * RT_MM_PAGE_SIZE);
+    RT_ASSERT(z->z_magic == ZALLOC_SLAB_MAGIC);
+
+    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+    z = slab_zone_free(z, ptr);
+    rt_sem_release(&heap_sem);
+
+    if (z != RT_NULL)
+        rt_page_free(z, zone_size / RT_MM_PAGE_SIZE);
+}
+
+/* get the cache of current thread, and create it on first use */
+static struct slab_cache *slab_cache_get(void)
+{
+    rt_thread_t thread;
+    struct slab_cache *cache;
+
+    /* there is no cache in interrupt or before the scheduler starts */
+    if (rt_interrupt_get_nest() != 0)
+        return RT_NULL;
+    thread = rt_thread_self();
+    if (thread == RT_NULL)
+        return RT_NULL;
+
+    cache = (struct slab_cache *)thread->heap_cache;
+    if (cache == RT_NULL)
+    {
+        cache = slab_alloc_nocache(sizeof(struct slab_cache));
+        if (cache == RT_NULL)
+            return RT_NULL;
+
+        rt_memset(cache, 0, sizeof(struct slab_cache));
+        thread->heap_cache = cache;
+    }
+
+    return cache;
+}
+
+/* get the magazine of zone, and create it on first use */
+static struct slab_magazine *slab_magazine_get(struct slab_cache *cache,
+                                               rt_int32_t zi,
+                                               rt_uint32_t chunksize)
+{
+    rt_uint32_t capacity;
+    struct slab_magazine *mag;
+
+    mag = cache->magazines[zi];
+    if (mag == RT_NULL)
+    {
+        /* the magazine holds about RT_SLAB_MAGAZINE_SIZE bytes of chunks */
+        capacity = RT_SLAB_MAGAZINE_SIZE / chunksize;
+        if (capacity < SLAB_MAGAZINE_MIN)
+            capacity = SLAB_MAGAZINE_MIN;
+        if (capacity > SLAB_MAGAZINE_MAX)
+            capacity = SLAB_MAGAZINE_MAX;
+
+        mag = slab_alloc_nocache(sizeof(struct slab_magazine) +
+                                 (capacity - 1) * sizeof(void *));
+        if (mag == RT_NULL)
+            return RT_NULL;
+
+        mag->count    = 0;
+        mag->capacity = capacity;
+        cache->magazines[zi] = mag;
+    }
+
+    return mag;
+}
+
+/* flush the chunks in magazine to zones until keep chunks are left */
+static void slab_magazine_flush(struct slab_magazine *mag, rt_uint32_t keep)
+{
+    slab_zone *z;
+    void *chunk;
+    struct memusage *kup;
+
+    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+    while (mag->count > keep)
+    {
+        chunk = mag->rounds[mag->count - 1];
+        mag->count --;
+
+        kup = btokup((rt_uint32_t)chunk & ~RT_MM_PAGE_MASK);
+        z = (slab_zone *)(((rt_uint32_t)chunk & ~RT_MM_PAGE_MASK) -
+                          kup->size * RT_MM_PAGE_SIZE);
+        RT_ASSERT(z->z_magic == ZALLOC_SLAB_MAGIC);
+
+        z = slab_zone_free(z, chunk);
+        if (z != RT_NULL)
+        {
+            rt_sem_release(&heap_sem);
+            rt_page_free(z, zone_size / RT_MM_PAGE_SIZE);
+            rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+        }
+    }
+    rt_sem_release(&heap_sem);
+}
+
+static void *slab_cache_alloc(rt_uint32_t size)
+{
+    rt_int32_t zi;
+    slab_chunk *chunk;
+    struct slab_cache *cache;
+    struct slab_magazine *mag;
+
+    cache = slab_cache_get();
+    if (cache == RT_NULL)
+        return RT_NULL;
+
+    zi = zoneindex(&size);
+    mag = slab_magazine_get(cache, zi, size);
+    if (mag == RT_NULL)
+        return RT_NULL;
+
+    if (mag->count == 0)
+    {
+        cache->miss ++;
+
+        /* refill half of the magazine from zones */
+        rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+        while (mag->count < mag->capacity / 2)
+        {
+            chunk = slab_zone_alloc(zi, size);
+            if (chunk == RT_NULL)
+                break;
+
+            mag->rounds[mag->count] = chunk;
+            mag->count ++;
+        }
+        rt_sem_release(&heap_sem);
+
+        if (mag->count == 0)
+            return RT_NULL;
+    }
+    else
+    {
+        cache->hit ++;
+    }
+
+    mag->count --;
+
+    return mag->rounds[mag->count];
+}
+
+static rt_err_t slab_cache_free(slab_zone *z, void *ptr)
+{
+    struct slab_cache *cache;
+    struct slab_magazine *mag;
+
+    cache = slab_cache_get();
+    if (cache == RT_NULL)
+        return -RT_ERROR;
+
+    mag = slab_magazine_get(cache, z->z_zoneindex, z->z_chunksize);
+    if (mag == RT_NULL)
+        return -RT_ERROR;
+
+    if (mag->count == mag->capacity)
+    {
+        cache->miss ++;
+
+        /* flush half of the magazine to zones */
+        slab_magazine_flush(mag, mag->capacity / 2);
+    }
+    else
+    {
+        cache->hit ++;
+    }
+
+    mag->rounds[mag->count] = ptr;
+    mag->count ++;
+
+    return RT_EOK;
+}
+
+#endif
+
+/**
+ * @addtogroup MM
+ */
+
+/**@{*/
+
+/**
+ * This function will allocate a block from system heap memory.
+ * - If the nbytes is less than zero,
+ * or
+ * - If there is no nbytes sized memory valid in system,
+ * the RT_NULL is returned.
+ *
+ * @param size the size of memory to be allocated
+ *
+ * @return the allocated memory
+ */
+void *rt_malloc(rt_size_t size)
+{
+    rt_int32_t zi;
+    slab_chunk *chunk;
+    struct memusage *kup;
+
+    /* zero size, return RT_NULL */
+    if (size == 0)
+        return RT_NULL;
+
+#ifdef RT_USING_MODULE
+    if (rt_module_self() != RT_NULL)
+        return rt_module_malloc(size);
+#endif
+
+    /*
+     * Handle large allocations directly.  There should not be very many of
+     * these so performance is not a big issue.
+     */
+    if (size >= zone_limit)
+    {
+        size = RT_ALIGN(size, RT_MM_PAGE_SIZE);
+
+        chunk = rt_page_alloc(size >> RT_MM_PAGE_BITS);
+        if (chunk == RT_NULL)
+            return RT_NULL;
+
+        /* set kup */
+        kup = btokup(chunk);
+        kup->type = PAGE_TYPE_LARGE;
+        kup->size = size >> RT_MM_PAGE_BITS;
+
+        RT_DEBUG_LOG(RT_DEBUG_SLAB,
+                     ("malloc a large memory 0x%x, page cnt %d, kup %d\n",
+                      size,
+                      size >> RT_MM_PAGE_BITS,
+                      ((rt_uint32_t)chunk - heap_start) >> RT_MM_PAGE_BITS));
+
+        /* lock heap */
+        rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+
+#ifdef RT_MEM_STATS
+        used_mem += size;
         if (used_mem > max_mem)
             max_mem = used_mem;
 #endif
+        goto done;
     }
 
+#ifdef RT_USING_SLAB_CACHE
+    /* try the magazine of current thread without heap lock */
+    if (size <= RT_SLAB_CACHE_SIZE)
+    {
+        chunk = slab_cache_alloc(size);
+        if (chunk != RT_NULL)
+        {
+            RT_OBJECT_HOOK_CALL(rt_malloc_hook, ((char *)chunk, size));
+
+            return chunk;
+        }
+    }
+#endif
+
+    /* lock heap */
+    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+
+    /* Note: zoneindex() will panic of size is too large. */
+    zi = zoneindex(&size);
+    RT_ASSERT(zi < NZONES);
+
+    chunk = slab_zone_alloc(zi, size);
+    if (chunk == RT_NULL)
+        goto fail;
+
 done:
     rt_sem_release(&heap_sem);
 
@@ -793,7 +1170,6 @@ RTM_EXPORT(rt_calloc);
 void rt_free(void *ptr)
 {
     slab_zone *z;
-    slab_chunk *chunk;
     struct memusage *kup;
 
     /* free a RT_NULL pointer */
@@ -850,90 +1226,80 @@ void rt_free(void *ptr)
         return;
     }
 
-    /* lock heap */
-    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
-
     /* zone case. get out zone. */
     z = (slab_zone *)(((rt_uint32_t)ptr & ~RT_MM_PAGE_MASK) -
                       kup->size * RT_MM_PAGE_SIZE);
     RT_ASSERT(z->z_magic == ZALLOC_SLAB_MAGIC);
 
-    chunk          = (slab_chunk *)ptr;
-    chunk->c_next  = z->z_freechunk;
-    z->z_freechunk = chunk;
-
-#ifdef RT_MEM_STATS
-    used_mem -= z->z_chunksize;
+#ifdef RT_USING_SLAB_CACHE
+    /* try the magazine of current thread without heap lock */
+    if (z->z_zoneindex < SLAB_CACHE_ZONES && slab_cache_free(z, ptr) == RT_EOK)
+        return;
 #endif
 
-    /*
-     * Bump the number of free chunks.  If it becomes non-zero the zone
-     * must be added back onto the appropriate list.
-     */
-    if (z->z_nfree++ == 0)
-    {
-        z->z_next = zone_array[z->z_zoneindex];
-        zone_array[z->z_zoneindex] = z;
-    }
+    /* lock heap */
+    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+    z = slab_zone_free(z, ptr);
+    /* unlock heap */
+    rt_sem_release(&heap_sem);
 
-    /*
-     * If the zone becomes totally free, and there are other zones we
-     * can allocate from, move this zone to the FreeZones list.  Since
-     * this code can be called from an IPI callback, do *NOT* try to mess
-     * with kernel_map here.  Hysteresis will be performed at malloc() time.
-     */
-    if (z->z_nfree == z->z_nmax &&
-        (z->z_next || zone_array[z->z_zoneindex] != z))
-    {
-        slab_zone **pz;
+    /* release pages of the free zone */
+    if (z != RT_NULL)
+        rt_page_free(z, zone_size / RT_MM_PAGE_SIZE);
+}
+RTM_EXPORT(rt_free);
 
-        RT_DEBUG_LOG(RT_DEBUG_SLAB, ("free zone 0x%x\n",
-                                     (rt_uint32_t)z, z->z_zoneindex));
+#ifdef RT_USING_SLAB_CACHE
+/**
+ * This function will flush the slab cache of a thread back to the system
+ * heap, and release the cache. It's invoked when the thread is detached,
+ * deleted or exits, and it could be used to give back the memory cached by
+ * a thread which will not allocate small blocks for a long time.
+ *
+ * The cache is used without lock by its thread, so it shall be invoked by the
+ * thread itself, or when the thread is not running on any cpu.
+ *
+ * @param thread the thread of slab cache
+ */
+void rt_slab_cache_flush(rt_thread_t thread)
+{
+    int zi;
+    rt_base_t level;
+    struct slab_cache *cache;
 
-        /* remove zone from zone array list */
-        for (pz = &zone_array[z->z_zoneindex]; z != *pz; pz = &(*pz)->z_next)
-            ;
-        *pz = z->z_next;
+    RT_ASSERT(thread != RT_NULL);
 
-        /* reset zone */
-        z->z_magic = -1;
+    /* the heap lock can not be taken in interrupt, the cache is leaked */
+    if (rt_interrupt_get_nest() != 0)
+        return;
 
-        /* insert to free zone list */
-        z->z_next = zone_free;
-        zone_free = z;
+    level = rt_hw_interrupt_disable();
+    cache = (struct slab_cache *)thread->heap_cache;
+    thread->heap_cache = RT_NULL;
+    rt_hw_interrupt_enable(level);
 
-        ++ zone_free_cnt;
+    if (cache == RT_NULL)
+        return;
 
-        /* release zone to page allocator */
-        if (zone_free_cnt > ZONE_RELEASE_THRESH)
+    for (zi = 0; zi < SLAB_CACHE_ZONES; zi ++)
+    {
+        if (cache->magazines[zi] != RT_NULL)
         {
-            register rt_base_t i;
-
-            z         = zone_free;
-            zone_free = z->z_next;
-            -- zone_free_cnt;
-
-            /* set message usage */
-            for (i = 0, kup = btokup(z); i < zone_page_cnt; i ++)
-            {
-                kup->type = PAGE_TYPE_FREE;
-                kup->size = 0;
-                kup ++;
-            }
-
-            /* unlock heap */
-            rt_sem_release(&heap_sem);
-
-            /* release pages */
-            rt_page_free(z, zone_size / RT_MM_PAGE_SIZE);
-
-            return;
+            slab_magazine_flush(cache->magazines[zi], 0);
+            slab_free_nocache(cache->magazines[zi]);
         }
     }
-    /* unlock heap */
+
+    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+    cache_hit  += cache->hit;
+    cache_miss += cache->miss;
     rt_sem_release(&heap_sem);
+
+    slab_free_nocache(cache);
 }
-RTM_EXPORT(rt_free);
+RTM_EXPORT(rt_slab_cache_flush);
+
+#endif
 
 #ifdef RT_MEM_STATS
 void rt_memory_info(rt_uint32_t *total,
@@ -960,6 +1326,138 @@ void list_mem(void)
     rt_kprintf("maximum allocated memory: %d\n", max_mem);
 }
 FINSH_FUNCTION_EXPORT(list_mem, list memory usage information)
+
+#ifdef RT_USING_SLAB_CACHE
+/* the statistics of a thread cache, it's taken with the heap locked */
+struct slab_cache_sample
+{
+    char name[RT_NAME_MAX];
+    rt_uint32_t hit;
+    rt_uint32_t miss;
+};
+
+static rt_uint32_t slab_cache_rate(rt_uint32_t hit, rt_uint32_t miss)
+{
+    if (hit == 0 && miss == 0)
+        return 0;
+
+    return (rt_uint32_t)((rt_uint64_t)hit * 100 / ((rt_uint64_t)hit + miss));
+}
+#endif
+
+void list_slab(void)
+{
+    int zi;
+    rt_uint32_t size, used, cached;
+#ifdef RT_USING_SLAB_CACHE
+    rt_uint32_t index, count, hit, miss;
+    rt_uint32_t zone_cached[SLAB_CACHE_ZONES], zone_taken[SLAB_CACHE_ZONES];
+    struct rt_thread *thread;
+    struct slab_cache *cache;
+    struct slab_cache_sample *samples;
+    struct rt_list_node *node;
+    struct rt_list_node *list;
+    extern struct rt_object_information rt_object_container[];
+
+    list = &rt_object_container[RT_Object_Class_Thread].object_list;
+
+    /* the threads created in the meantime are not listed */
+    count = 0;
+    rt_enter_critical();
+    for (node = list->next; node != list; node = node->next)
+        count ++;
+    rt_exit_critical();
+
+    samples = (struct slab_cache_sample *)rt_malloc(count * sizeof(struct slab_cache_sample));
+    if (samples == RT_NULL)
+        count = 0;
+
+    /*
+     * The caches are released by rt_slab_cache_flush() of other threads, and
+     * the magazines are freed to zones with the heap locked.
+     */
+    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+    rt_enter_critical();
+    for (zi = 0; zi < SLAB_CACHE_ZONES; zi ++)
+    {
+        zone_cached[zi] = 0;
+        zone_taken[zi]  = zone_used[zi];
+    }
+    hit  = cache_hit;
+    miss = cache_miss;
+    index = 0;
+    for (node = list->next; node != list; node = node->next)
+    {
+        thread = rt_list_entry(node, struct rt_thread, list);
+        cache = (struct slab_cache *)thread->heap_cache;
+        if (cache == RT_NULL)
+            continue;
+
+        for (zi = 0; zi < SLAB_CACHE_ZONES; zi ++)
+        {
+            if (cache->magazines[zi] != RT_NULL)
+                zone_cached[zi] += cache->magazines[zi]->count;
+        }
+
+        if (index < count)
+        {
+            rt_strncpy(samples[index].name, thread->name, RT_NAME_MAX);
+            samples[index].hit  = cache->hit;
+            samples[index].miss = cache->miss;
+            index ++;
+        }
+        hit  += cache->hit;
+        miss += cache->miss;
+    }
+    count = index;
+    rt_exit_critical();
+    rt_sem_release(&heap_sem);
+#endif
+
+    rt_kprintf("chunk  zones  used     cached\n");
+    rt_kprintf("------ ------ -------- --------\n");
+    for (zi = 0; zi < NZONES; zi ++)
+    {
+        if (zone_count[zi] == 0)
+            continue;
+
+        /* the chunk size of zone, follows zoneindex() */
+        if (zi < 16)
+            size = (zi + 1) * 8;
+        else
+            size = ((zi - 15) % 8 + 8) << ((zi - 15) / 8 + 4);
+
+        used   = zone_used[zi];
+        cached = 0;
+#ifdef RT_USING_SLAB_CACHE
+        if (zi < SLAB_CACHE_ZONES)
+        {
+            used   = zone_taken[zi];
+            cached = zone_cached[zi];
+        }
+#endif
+
+        rt_kprintf("%6d %6d %8d %8d\n", size, zone_count[zi],
+                   used - cached, cached);
+    }
+
+#ifdef RT_USING_SLAB_CACHE
+    rt_kprintf("\nthread   hit      miss     rate\n");
+    rt_kprintf("-------- -------- -------- ----\n");
+    for (index = 0; index < count; index ++)
+    {
+        rt_kprintf("%-*.*s %8d %8d %3d%%\n", RT_NAME_MAX, RT_NAME_MAX,
+                   samples[index].name, samples[index].hit, samples[index].miss,
+                   slab_cache_rate(samples[index].hit, samples[index].miss));
+    }
+    rt_kprintf("%-*.*s %8d %8d %3d%%\n", RT_NAME_MAX, RT_NAME_MAX,
+               "total", hit, miss, slab_cache_rate(hit, miss));
+
+    if (samples != RT_NULL)
+        rt_free(samples);
+#endif
+}
+FINSH_FUNCTION_EXPORT(list_slab, list slab zones and cache usage information)
 #endif
 #endif
 
@@ -38,13 +38,23 @@
  * 2016-08-09     ArdaFu       add thread suspend and resume hook.
  * 2017-04-10     armink       fixed the rt_thread_delete and rt_thread_detach
                                bug when thread has not startup.
+ * 2017-06-24     agent        add SMP support and cpu binding of thread.
+ * 2017-06-27     agent        flush the slab cache of thread when it's closed.
+ * 2017-06-30     agent        find thread by rt_object_lookup.
+ * 2017-07-03     agent        clear the cycles of thread on initialization.
+ * 2017-07-05     agent        clear the pending mutex of thread on initialization.
+ * 2017-07-06     agent        release the jobs of deadline thread.
+ * 2017-07-07     agent        release the FPU ownership of closed thread.
+ * 2017-07-10     agent        allocate thread stack in fast memory region.
  */
 
 #include <rtthread.h>
 #include <rthw.h>
 
+#ifndef RT_USING_SMP
 extern rt_list_t rt_thread_priority_table[RT_THREAD_PRIORITY_MAX];
 extern struct rt_thread *rt_current_thread;
+#endif
 extern rt_list_t rt_thread_defunct;
 
 #ifdef RT_USING_HOOK
@@ -98,7 +108,22 @@ void rt_thread_exit(void)
     register rt_base_t level;
 
     /* get current thread */
-    thread = rt_current_thread;
+    thread = rt_thread_self();
+
+#ifdef RT_USING_SLAB_CACHE
+    /* give back the cached memory */
+    rt_slab_cache_flush(thread);
+#endif
+
+#ifdef RT_USING_DEADLINE
+    /* stop the jobs and give back the utilization */
+    rt_thread_deadline_close(thread);
+#endif
+
+#ifdef RT_USING_LAZY_FPU
+    /* the FPU context of closed thread is not saved any more */
+    rt_hw_fpu_thread_close(thread);
+#endif
 
     /* disable interrupt */
     level = rt_hw_interrupt_disable();
@@ -163,6 +188,14 @@ static rt_err_t _rt_thread_init(struct rt_thread *thread,
     thread->init_tick      = tick;
     thread->remaining_tick = tick;
 
+#ifdef RT_USING_SMP
+    /* not bound to any cpu, and not on any cpu */
+    thread->bind_cpu       = RT_CPUS_NR;
+    thread->oncpu          = RT_CPU_DETACHED;
+    thread->ready_cpu      = RT_CPU_DETACHED;
+    thread->cpus_lock_nest = 0;
+#endif
+
     /* error and flags */
     thread->error = RT_EOK;
     thread->stat  = RT_THREAD_INIT;
@@ -171,6 +204,28 @@ static rt_err_t _rt_thread_init(struct rt_thread *thread,
     thread->cleanup   = 0;
     thread->user_data = 0;
 
+#ifdef RT_USING_SLAB_CACHE
+    thread->heap_cache = RT_NULL;
+#endif
+
+#ifdef RT_USING_CPU_USAGE
+    thread->cycles = 0;
+#endif
+
+#ifdef RT_USING_MUTEX
+    thread->pending_mutex = RT_NULL;
+#endif
+
+#ifdef RT_USING_DEADLINE
+    /* not a deadline thread */
+    rt_memset(&(thread->deadline), 0, sizeof(thread->deadline));
+#endif
+
+#ifdef RT_USING_LAZY_FPU
+    /* no FPU context */
+    thread->fpu_flag = 0;
+#endif
+
     /* init thread timer */
     rt_timer_init(&(thread->thread_timer),
                   thread->name,
@@ -239,7 +294,19 @@ RTM_EXPORT(rt_thread_init);
  */
 rt_thread_t rt_thread_self(void)
 {
+#ifdef RT_USING_SMP
+    rt_base_t level;
+    rt_thread_t self;
+
+    /* the thread may migrate to other cpu, get it with local irq disabled */
+    level = rt_hw_local_irq_disable();
+    self = rt_cpu_self()->current_thread;
+    rt_hw_local_irq_enable(level);
+
+    return self;
+#else
     return rt_current_thread;
+#endif
 }
 RTM_EXPORT(rt_thread_self);
 
@@ -270,6 +337,12 @@ rt_err_t rt_thread_startup(rt_thread_t thread)
 
     RT_DEBUG_LOG(RT_DEBUG_THREAD, ("startup a thread:%s with priority:%d\n",
                                    thread->name, thread->init_priority));
+#ifdef RT_USING_DEADLINE
+    /* release the first job */
+    if (thread->deadline.period != 0)
+        rt_thread_deadline_start(thread);
+#endif
+
     /* change thread stat */
     thread->stat = RT_THREAD_SUSPEND;
     /* then resume it */
@@ -299,6 +372,22 @@ rt_err_t rt_thread_detach(rt_thread_t thread)
     /* thread check */
     RT_ASSERT(thread != RT_NULL);
 
+#ifdef RT_USING_SLAB_CACHE
+    /* the cache of other thread is in use until it's off cpu */
+    if (thread == rt_thread_self())
+        rt_slab_cache_flush(thread);
+#endif
+
+#ifdef RT_USING_DEADLINE
+    /* stop the jobs and give back the utilization */
+    rt_thread_deadline_close(thread);
+#endif
+
+#ifdef RT_USING_LAZY_FPU
+    /* the FPU context of closed thread is not saved any more */
+    rt_hw_fpu_thread_close(thread);
+#endif
+
     if (thread->stat != RT_THREAD_INIT)
     {
         /* remove from schedule */
@@ -325,6 +414,16 @@ rt_err_t rt_thread_detach(rt_thread_t thread)
         /* enable interrupt */
         rt_hw_interrupt_enable(lock);
     }
+#ifdef RT_USING_SLAB_CACHE
+    else if (thread != rt_thread_self())
+    {
+#ifdef RT_USING_SMP
+        /* wait for it to be switched out on the other cpu */
+        while (*(volatile rt_uint8_t *)&thread->oncpu != RT_CPU_DETACHED);
+#endif
+        rt_slab_cache_flush(thread);
+    }
+#endif
 
     return RT_EOK;
 }
@@ -360,7 +459,12 @@ rt_thread_t rt_thread_create(const char *name,
     if (thread == RT_NULL)
         return RT_NULL;
 
+#if defined(RT_USING_MEMHEAP_REGION) && defined(RT_THREAD_STACK_FAST)
+    /* the stack is accessed in each function call */
+    stack_start = (void *)rt_malloc_region(stack_size, RT_MEM_FAST);
+#else
     stack_start = (void *)RT_KERNEL_MALLOC(stack_size);
+#endif
     if (stack_start == RT_NULL)
     {
         /* allocate stack failure */
@@ -397,6 +501,16 @@ rt_err_t rt_thread_delete(rt_thread_t thread)
     /* thread check */
     RT_ASSERT(thread != RT_NULL);
 
+#ifdef RT_USING_DEADLINE
+    /* stop the jobs and give back the utilization */
+    rt_thread_deadline_close(thread);
+#endif
+
+#ifdef RT_USING_LAZY_FPU
+    /* the FPU context of closed thread is not saved any more */
+    rt_hw_fpu_thread_close(thread);
+#endif
+
     if (thread->stat != RT_THREAD_INIT)
     {
         /* remove from schedule */
@@ -439,18 +553,24 @@ rt_err_t rt_thread_yield(void)
     level = rt_hw_interrupt_disable();
 
     /* set to current thread */
-    thread = rt_current_thread;
+    thread = rt_thread_self();
 
     /* if the thread stat is READY and on ready queue list */
     if (thread->stat == RT_THREAD_READY &&
         thread->tlist.next != thread->tlist.prev)
     {
+#if defined(RT_USING_SMP) || defined(RT_USING_DEADLINE)
+        /* put thread to end of the ready queue, or by its deadline */
+        rt_schedule_remove_thread(thread);
+        rt_schedule_insert_thread(thread);
+#else
         /* remove thread from thread list */
         rt_list_remove(&(thread->tlist));
 
         /* put thread to end of ready queue */
         rt_list_insert_before(&(rt_thread_priority_table[thread->current_priority]),
                               &(thread->tlist));
+#endif
 
         /* enable interrupt */
         rt_hw_interrupt_enable(level);
@@ -482,7 +602,7 @@ rt_err_t rt_thread_sleep(rt_tick_t tick)
     /* disable interrupt */
     temp = rt_hw_interrupt_disable();
     /* set to current thread */
-    thread = rt_current_thread;
+    thread = rt_thread_self();
     RT_ASSERT(thread != RT_NULL);
 
     /* suspend thread */
@@ -584,6 +704,48 @@ rt_err_t rt_thread_control(rt_thread_t thread, rt_uint8_t cmd, void *arg)
     case RT_THREAD_CTRL_STARTUP:
         return rt_thread_startup(thread);
 
+#ifdef RT_USING_SMP
+    case RT_THREAD_CTRL_BIND_CPU:
+    {
+        rt_uint8_t cpu;
+
+        /* RT_CPUS_NR means the thread is not bound to any cpu */
+        cpu = *(rt_uint8_t *)arg;
+        if (cpu > RT_CPUS_NR)
+            return -RT_ERROR;
+
+        /* disable interrupt */
+        temp = rt_hw_interrupt_disable();
+
+        thread->bind_cpu = cpu;
+        if (thread->stat == RT_THREAD_READY && cpu != RT_CPUS_NR)
+        {
+            if (thread->oncpu == RT_CPU_DETACHED)
+            {
+                /* move the thread to the ready queue of bound cpu */
+                rt_schedule_remove_thread(thread);
+                rt_schedule_insert_thread(thread);
+            }
+            else if (thread->oncpu != cpu)
+            {
+                /* let the running cpu migrate the thread */
+                if (thread->oncpu == rt_hw_cpu_id())
+                {
+                    rt_hw_interrupt_enable(temp);
+                    rt_schedule();
+
+                    return RT_EOK;
+                }
+                rt_hw_ipi_send(RT_SCHEDULE_IPI, 1 << thread->oncpu);
+            }
+        }
+
+        /* enable interrupt */
+        rt_hw_interrupt_enable(temp);
+        break;
+    }
+#endif
+
 #ifdef RT_USING_HEAP
     case RT_THREAD_CTRL_CLOSE:
         return rt_thread_delete(thread);
@@ -616,17 +778,20 @@ rt_err_t rt_thread_suspend(rt_thread_t thread)
 
     RT_DEBUG_LOG(RT_DEBUG_THREAD, ("thread suspend:  %s\n", thread->name));
 
+    /* disable interrupt */
+    temp = rt_hw_interrupt_disable();
+
     if (thread->stat != RT_THREAD_READY)
     {
         RT_DEBUG_LOG(RT_DEBUG_THREAD, ("thread suspend: thread disorder, %d\n",
                                        thread->stat));
 
+        /* enable interrupt */
+        rt_hw_interrupt_enable(temp);
+
         return -RT_ERROR;
     }
 
-    /* disable interrupt */
-    temp = rt_hw_interrupt_disable();
-
     /* change thread stat */
     thread->stat = RT_THREAD_SUSPEND;
     rt_schedule_remove_thread(thread);
@@ -658,28 +823,31 @@ rt_err_t rt_thread_resume(rt_thread_t thread)
 
     RT_DEBUG_LOG(RT_DEBUG_THREAD, ("thread resume:  %s\n", thread->name));
 
+    /* disable interrupt */
+    temp = rt_hw_interrupt_disable();
+
     if (thread->stat != RT_THREAD_SUSPEND)
     {
         RT_DEBUG_LOG(RT_DEBUG_THREAD, ("thread resume: thread disorder, %d\n",
                                        thread->stat));
 
+        /* enable interrupt */
+        rt_hw_interrupt_enable(temp);
+
         return -RT_ERROR;
     }
 
-    /* disable interrupt */
-    temp = rt_hw_interrupt_disable();
-
     /* remove from suspend list */
     rt_list_remove(&(thread->tlist));
 
     rt_timer_stop(&thread->thread_timer);
 
-    /* enable interrupt */
-    rt_hw_interrupt_enable(temp);
-
     /* insert to schedule ready list */
     rt_schedule_insert_thread(thread);
 
+    /* enable interrupt */
+    rt_hw_interrupt_enable(temp);
+
     RT_OBJECT_HOOK_CALL(rt_thread_resume_hook,(thread));
     return RT_EOK;
 }
@@ -694,11 +862,25 @@ RTM_EXPORT(rt_thread_resume);
 void rt_thread_timeout(void *parameter)
 {
     struct rt_thread *thread;
+    register rt_base_t temp;
 
     thread = (struct rt_thread *)parameter;
 
     /* thread check */
     RT_ASSERT(thread != RT_NULL);
+
+    /* disable interrupt */
+    temp = rt_hw_interrupt_disable();
+
+#ifdef RT_USING_SMP
+    /* the thread may be resumed by other cpu before the timeout handling */
+    if (thread->stat != RT_THREAD_SUSPEND)
+    {
+        rt_hw_interrupt_enable(temp);
+
+        return;
+    }
+#endif
     RT_ASSERT(thread->stat == RT_THREAD_SUSPEND);
 
     /* set error number */
@@ -710,6 +892,9 @@ void rt_thread_timeout(void *parameter)
     /* insert to schedule ready list */
     rt_schedule_insert_thread(thread);
 
+    /* enable interrupt */
+    rt_hw_interrupt_enable(temp);
+
     /* do schedule */
     rt_schedule();
 }
@@ -728,7 +913,6 @@ rt_thread_t rt_thread_find(char *name)
 {
     struct rt_object_information *information;
     struct rt_object *object;
-    struct rt_list_node *node;
 
     extern struct rt_object_information rt_object_container[];
 
@@ -738,27 +922,13 @@ rt_thread_t rt_thread_find(char *name)
 
     /* try to find device object */
     information = &rt_object_container[RT_Object_Class_Thread];
-    for (node  = information->object_list.next;
-         node != &(information->object_list);
-         node  = node->next)
-    {
-        object = rt_list_entry(node, struct rt_object, list);
-        if (rt_strncmp(object->name, name, RT_NAME_MAX) == 0)
-        {
-            /* leave critical */
-            if (rt_thread_self() != RT_NULL)
-                rt_exit_critical();
-
-            return (rt_thread_t)object;
-        }
-    }
+    object = rt_object_lookup(information, name);
 
     /* leave critical */
     if (rt_thread_self() != RT_NULL)
         rt_exit_critical();
 
-    /* not found */
-    return RT_NULL;
+    return (rt_thread_t)object;
 }
 RTM_EXPORT(rt_thread_find);
 
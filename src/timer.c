@@ -30,13 +30,44 @@
  * 2012-12-15     Bernard      fix the next timeout issue in soft timer
  * 2014-07-12     Bernard      does not lock scheduler when invoking soft-timer 
  *                             timeout function.
+ * 2017-06-20     agent        add hierarchical timing wheel as timer backend.
  */
 
 #include <rtthread.h>
 #include <rthw.h>
 
+#ifdef RT_USING_TIMER_WHEEL
+/*
+ * The hierarchical timing wheel keeps the armed timers in RT_TIMER_WHEEL_LEVEL
+ * levels of RT_TIMER_WHEEL_SIZE slots. Level 0 has one slot per tick, each
+ * slot of level n covers RT_TIMER_WHEEL_SIZE^n ticks. Starting and stopping a
+ * timer is O(1); the timers in a higher level slot are cascaded down to the
+ * lower levels when the wheel reaches that slot.
+ */
+#ifndef RT_TIMER_WHEEL_BITS
+#define RT_TIMER_WHEEL_BITS             6
+#endif
+
+#define RT_TIMER_WHEEL_SIZE             (1UL << RT_TIMER_WHEEL_BITS)
+#define RT_TIMER_WHEEL_MASK             (RT_TIMER_WHEEL_SIZE - 1)
+/* the number of levels to cover the whole range of rt_tick_t */
+#define RT_TIMER_WHEEL_LEVEL            ((sizeof(rt_tick_t) * 8 + RT_TIMER_WHEEL_BITS - 1) / \
+                                         RT_TIMER_WHEEL_BITS)
+
+struct rt_timer_wheel
+{
+    rt_tick_t   tick;                                   /**< the next tick to be processed */
+    rt_uint32_t count;                                  /**< the number of timers on wheel */
+
+    rt_list_t   slot[RT_TIMER_WHEEL_LEVEL][RT_TIMER_WHEEL_SIZE];
+};
+
+/* hard timer wheel */
+static struct rt_timer_wheel rt_timer_wheel;
+#else
 /* hard timer list */
 static rt_list_t rt_timer_list[RT_TIMER_SKIP_LIST_LEVEL];
+#endif
 
 #ifdef RT_USING_TIMER_SOFT
 #ifndef RT_TIMER_THREAD_STACK_SIZE
@@ -47,8 +78,13 @@ static rt_list_t rt_timer_list[RT_TIMER_SKIP_LIST_LEVEL];
 #define RT_TIMER_THREAD_PRIO           0
 #endif
 
+#ifdef RT_USING_TIMER_WHEEL
+/* soft timer wheel */
+static struct rt_timer_wheel rt_soft_timer_wheel;
+#else
 /* soft timer list */
 static rt_list_t rt_soft_timer_list[RT_TIMER_SKIP_LIST_LEVEL];
+#endif
 static struct rt_thread timer_thread;
 ALIGN(RT_ALIGN_SIZE)
 static rt_uint8_t timer_thread_stack[RT_TIMER_THREAD_STACK_SIZE];
@@ -57,7 +93,7 @@ static rt_uint8_t timer_thread_stack[RT_TIMER_THREAD_STACK_SIZE];
 #ifdef RT_USING_HOOK
 extern void (*rt_object_take_hook)(struct rt_object *object);
 extern void (*rt_object_put_hook)(struct rt_object *object);
-static void (*rt_timer_timeout_hook)(struct rt_timer *timer);
+void (*rt_timer_timeout_hook)(struct rt_timer *timer);
 
 /**
  * @addtogroup Hook
@@ -106,6 +142,238 @@ static void _rt_timer_init(rt_timer_t timer,
     }
 }
 
+#ifdef RT_USING_TIMER_WHEEL
+rt_inline struct rt_timer_wheel *_rt_timer_get_wheel(rt_timer_t timer)
+{
+#ifdef RT_USING_TIMER_SOFT
+    if (timer->parent.flag & RT_TIMER_FLAG_SOFT_TIMER)
+        return &rt_soft_timer_wheel;
+#endif
+
+    return &rt_timer_wheel;
+}
+
+static void rt_timer_wheel_init(struct rt_timer_wheel *wheel)
+{
+    int level, index;
+
+    wheel->tick  = 0;
+    wheel->count = 0;
+
+    for (level = 0; level < RT_TIMER_WHEEL_LEVEL; level++)
+    {
+        for (index = 0; index < RT_TIMER_WHEEL_SIZE; index++)
+        {
+            rt_list_init(&(wheel->slot[level][index]));
+        }
+    }
+}
+
+/*
+ * put the timer into the slot of its timeout tick, the timer is linked with
+ * row[0]. It shall be invoked with interrupt disabled.
+ */
+static void _rt_timer_wheel_place(struct rt_timer_wheel *wheel, rt_timer_t timer)
+{
+    int level;
+    rt_tick_t delta;
+    rt_list_t *slot;
+
+    delta = timer->timeout_tick - wheel->tick;
+    if (delta >= RT_TICK_MAX / 2)
+    {
+        /* already timeout, let it be processed at the next wheel tick */
+        slot = &(wheel->slot[0][wheel->tick & RT_TIMER_WHEEL_MASK]);
+    }
+    else
+    {
+        for (level = 0; level < RT_TIMER_WHEEL_LEVEL - 1; level++)
+        {
+            if ((delta >> (RT_TIMER_WHEEL_BITS * (level + 1))) == 0)
+                break;
+        }
+
+        slot = &(wheel->slot[level][(timer->timeout_tick >> (RT_TIMER_WHEEL_BITS * level)) &
+                                    RT_TIMER_WHEEL_MASK]);
+    }
+
+    /* insert to the tail, the timer inserted early will be called early */
+    rt_list_insert_before(slot, &(timer->row[0]));
+}
+
+/* It shall be invoked with interrupt disabled. */
+static void _rt_timer_wheel_insert(struct rt_timer_wheel *wheel, rt_timer_t timer)
+{
+    if (wheel->count == 0)
+    {
+        /* the wheel may stop ticking when it's empty, synchronize it */
+        wheel->tick = rt_tick_get() + 1;
+    }
+
+    _rt_timer_wheel_place(wheel, timer);
+    wheel->count ++;
+}
+
+/* move all timers in the list from to the empty list to */
+rt_inline void _rt_timer_list_splice(rt_list_t *from, rt_list_t *to)
+{
+    if (rt_list_isempty(from))
+        return;
+
+    to->next = from->next;
+    to->prev = from->prev;
+    to->next->prev = to;
+    to->prev->next = to;
+
+    rt_list_init(from);
+}
+
+/*
+ * process one tick of the wheel: cascade the higher level slots when the
+ * lower level wraps, then move the timeout timers of this tick to the list
+ * expired. It shall be invoked with interrupt disabled.
+ */
+static void _rt_timer_wheel_advance(struct rt_timer_wheel *wheel,
+                                    rt_list_t             *expired)
+{
+    int level;
+    rt_uint32_t index;
+    rt_list_t cascade;
+    struct rt_timer *t;
+
+    if ((wheel->tick & RT_TIMER_WHEEL_MASK) == 0)
+    {
+        for (level = 1; level < RT_TIMER_WHEEL_LEVEL; level++)
+        {
+            index = (wheel->tick >> (RT_TIMER_WHEEL_BITS * level)) & RT_TIMER_WHEEL_MASK;
+
+            rt_list_init(&cascade);
+            _rt_timer_list_splice(&(wheel->slot[level][index]), &cascade);
+            while (!rt_list_isempty(&cascade))
+            {
+                t = rt_list_entry(cascade.next, struct rt_timer, row[0]);
+                rt_list_remove(&(t->row[0]));
+                _rt_timer_wheel_place(wheel, t);
+            }
+
+            if (index != 0)
+                break;
+        }
+    }
+
+    _rt_timer_list_splice(&(wheel->slot[0][wheel->tick & RT_TIMER_WHEEL_MASK]), expired);
+    wheel->tick ++;
+}
+
+/*
+ * move the wheel to the next tick on which there are timeout timers or timers
+ * to be cascaded, but not beyond the tick to. It returns RT_FALSE when there
+ * is nothing to do until the tick to, and the wheel is moved after it. It
+ * shall be invoked with interrupt disabled.
+ */
+static rt_bool_t _rt_timer_wheel_skip(struct rt_timer_wheel *wheel, rt_tick_t to)
+{
+    int level;
+    rt_uint32_t index, offset;
+    rt_tick_t step, delta, next;
+    rt_bool_t found = RT_FALSE;
+
+    next = to - wheel->tick;
+    for (level = 0; level < RT_TIMER_WHEEL_LEVEL; level++)
+    {
+        /* the slots of this level are cascaded every step ticks */
+        step  = (rt_tick_t)1 << (RT_TIMER_WHEEL_BITS * level);
+        delta = (0 - wheel->tick) & (step - 1);
+        index = ((wheel->tick + delta) >> (RT_TIMER_WHEEL_BITS * level)) & RT_TIMER_WHEEL_MASK;
+
+        for (offset = 0; offset < RT_TIMER_WHEEL_SIZE && delta <= next; offset++)
+        {
+            if (!rt_list_isempty(&(wheel->slot[level][(index + offset) & RT_TIMER_WHEEL_MASK])))
+            {
+                next  = delta;
+                found = RT_TRUE;
+                break;
+            }
+
+            delta += step;
+        }
+    }
+
+    if (found == RT_TRUE)
+        wheel->tick += next;
+    else
+        wheel->tick = to + 1;
+
+    return found;
+}
+
+/*
+ * get the earliest timeout tick of the timers in slot, the timeout is updated
+ * only when there is an earlier one.
+ */
+static rt_bool_t _rt_timer_slot_next_timeout(rt_list_t *slot,
+                                             rt_bool_t  found,
+                                             rt_tick_t *timeout)
+{
+    rt_list_t *n;
+    struct rt_timer *t;
+    register rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    for (n = slot->next; n != slot; n = n->next)
+    {
+        t = rt_list_entry(n, struct rt_timer, row[0]);
+
+        if (found == RT_FALSE || (*timeout - t->timeout_tick) < RT_TICK_MAX / 2)
+        {
+            *timeout = t->timeout_tick;
+            found = RT_TRUE;
+        }
+    }
+    rt_hw_interrupt_enable(level);
+
+    return found;
+}
+
+static rt_tick_t rt_timer_wheel_next_timeout(struct rt_timer_wheel *wheel)
+{
+    int level;
+    rt_uint32_t index, offset;
+    rt_list_t *slot;
+    rt_bool_t found = RT_FALSE;
+    rt_tick_t timeout = RT_TICK_MAX;
+
+    if (wheel->count == 0)
+        return RT_TICK_MAX;
+
+    for (level = 0; level < RT_TIMER_WHEEL_LEVEL; level++)
+    {
+        index = (wheel->tick >> (RT_TIMER_WHEEL_BITS * level)) & RT_TIMER_WHEEL_MASK;
+
+        /*
+         * The current slot of level 0 holds the timers of the next tick, which
+         * are the earliest ones. The current slot of a higher level holds both
+         * the timers to be cascaded on the next tick and the timers one round
+         * later, so check it besides the first non-empty slot after it.
+         */
+        found = _rt_timer_slot_next_timeout(&(wheel->slot[level][index]), found, &timeout);
+        if (level == 0 && found == RT_TRUE)
+            break;
+
+        for (offset = 1; offset < RT_TIMER_WHEEL_SIZE; offset++)
+        {
+            slot = &(wheel->slot[level][(index + offset) & RT_TIMER_WHEEL_MASK]);
+            if (!rt_list_isempty(slot))
+            {
+                found = _rt_timer_slot_next_timeout(slot, found, &timeout);
+                break;
+            }
+        }
+    }
+
+    return timeout;
+}
+#else
 /* the fist timer always in the last row */
 static rt_tick_t rt_timer_list_next_timeout(rt_list_t timer_list[])
 {
@@ -119,18 +387,24 @@ static rt_tick_t rt_timer_list_next_timeout(rt_list_t timer_list[])
 
     return timer->timeout_tick;
 }
+#endif
 
 rt_inline void _rt_timer_remove(rt_timer_t timer)
 {
     int i;
 
+#ifdef RT_USING_TIMER_WHEEL
+    if (!rt_list_isempty(&timer->row[0]))
+        _rt_timer_get_wheel(timer)->count --;
+#endif
+
     for (i = 0; i < RT_TIMER_SKIP_LIST_LEVEL; i++)
     {
         rt_list_remove(&timer->row[i]);
     }
 }
 
-#if RT_DEBUG_TIMER
+#if RT_DEBUG_TIMER && !defined(RT_USING_TIMER_WHEEL)
 static int rt_timer_count_height(struct rt_timer *timer)
 {
     int i, cnt = 0;
@@ -293,12 +567,14 @@ RTM_EXPORT(rt_timer_delete);
  */
 rt_err_t rt_timer_start(rt_timer_t timer)
 {
+    register rt_base_t level;
+#ifndef RT_USING_TIMER_WHEEL
     unsigned int row_lvl;
     rt_list_t *timer_list;
-    register rt_base_t level;
     rt_list_t *row_head[RT_TIMER_SKIP_LIST_LEVEL];
     unsigned int tst_nr;
     static unsigned int random_nr;
+#endif
 
     /* timer check */
     RT_ASSERT(timer != RT_NULL);
@@ -323,6 +599,10 @@ rt_err_t rt_timer_start(rt_timer_t timer)
     /* disable interrupt */
     level = rt_hw_interrupt_disable();
 
+#ifdef RT_USING_TIMER_WHEEL
+    /* insert timer to the slot of timer wheel */
+    _rt_timer_wheel_insert(_rt_timer_get_wheel(timer), timer);
+#else
 #ifdef RT_USING_TIMER_SOFT
     if (timer->parent.flag & RT_TIMER_FLAG_SOFT_TIMER)
     {
@@ -386,6 +666,7 @@ rt_err_t rt_timer_start(rt_timer_t timer)
          * bits. */
         tst_nr >>= (RT_TIMER_SKIP_LIST_MASK+1)>>1;
     }
+#endif
 
     timer->parent.flag |= RT_TIMER_FLAG_ACTIVATED;
 
@@ -485,6 +766,81 @@ RTM_EXPORT(rt_timer_control);
  *
  * @note this function shall be invoked in operating system timer interrupt.
  */
+#ifdef RT_USING_TIMER_WHEEL
+void rt_timer_check(void)
+{
+    struct rt_timer *t;
+    rt_tick_t current_tick;
+    rt_list_t expired;
+    register rt_base_t level;
+
+    RT_DEBUG_LOG(RT_DEBUG_TIMER, ("timer check enter\n"));
+
+    current_tick = rt_tick_get();
+
+    /* disable interrupt */
+    level = rt_hw_interrupt_disable();
+
+    /* process each tick until the wheel catches up with the system tick */
+    while ((current_tick - rt_timer_wheel.tick) < RT_TICK_MAX / 2)
+    {
+        if (rt_timer_wheel.count == 0)
+        {
+            /* no timer on wheel, skip the empty ticks */
+            rt_timer_wheel.tick = current_tick + 1;
+            break;
+        }
+
+        /* skip the empty ticks, such as the ticks compensated after sleep */
+        if (_rt_timer_wheel_skip(&rt_timer_wheel, current_tick) == RT_FALSE)
+            break;
+
+        /* take all timeout timers of this tick at once */
+        rt_list_init(&expired);
+        _rt_timer_wheel_advance(&rt_timer_wheel, &expired);
+
+        while (!rt_list_isempty(&expired))
+        {
+            t = rt_list_entry(expired.next, struct rt_timer, row[0]);
+
+            RT_OBJECT_HOOK_CALL(rt_timer_timeout_hook, (t));
+
+            /* remove timer from timer list firstly */
+            _rt_timer_remove(t);
+
+            /* call timeout function */
+            t->timeout_func(t->parameter);
+
+            /* re-get tick */
+            current_tick = rt_tick_get();
+
+            RT_DEBUG_LOG(RT_DEBUG_TIMER, ("current tick: %d\n", current_tick));
+
+            if ((t->parent.flag & RT_TIMER_FLAG_PERIODIC) &&
+                (t->parent.flag & RT_TIMER_FLAG_ACTIVATED))
+            {
+                /* start it */
+                t->parent.flag &= ~RT_TIMER_FLAG_ACTIVATED;
+                rt_timer_start(t);
+            }
+            else
+            {
+                /* stop timer */
+                t->parent.flag &= ~RT_TIMER_FLAG_ACTIVATED;
+            }
+        }
+
+        /* let the pending interrupts in between two wheel ticks */
+        rt_hw_interrupt_enable(level);
+        level = rt_hw_interrupt_disable();
+    }
+
+    /* enable interrupt */
+    rt_hw_interrupt_enable(level);
+
+    RT_DEBUG_LOG(RT_DEBUG_TIMER, ("timer check leave\n"));
+}
+#else
 void rt_timer_check(void)
 {
     struct rt_timer *t;
@@ -544,6 +900,7 @@ void rt_timer_check(void)
 
     RT_DEBUG_LOG(RT_DEBUG_TIMER, ("timer check leave\n"));
 }
+#endif
 
 /**
  * This function will return the next timeout tick in the system.
@@ -552,7 +909,11 @@ void rt_timer_check(void)
  */
 rt_tick_t rt_timer_next_timeout_tick(void)
 {
+#ifdef RT_USING_TIMER_WHEEL
+    return rt_timer_wheel_next_timeout(&rt_timer_wheel);
+#else
     return rt_timer_list_next_timeout(rt_timer_list);
+#endif
 }
 
 #ifdef RT_USING_TIMER_SOFT
@@ -560,6 +921,93 @@ rt_tick_t rt_timer_next_timeout_tick(void)
  * This function will check timer list, if a timeout event happens, the
  * corresponding timeout function will be invoked.
  */
+#ifdef RT_USING_TIMER_WHEEL
+void rt_soft_timer_check(void)
+{
+    rt_tick_t current_tick;
+    rt_list_t expired;
+    struct rt_timer *t;
+    register rt_base_t level;
+
+    RT_DEBUG_LOG(RT_DEBUG_TIMER, ("software timer check enter\n"));
+
+    current_tick = rt_tick_get();
+
+    /* lock scheduler */
+    rt_enter_critical();
+
+    while ((current_tick - rt_soft_timer_wheel.tick) < RT_TICK_MAX / 2)
+    {
+        rt_list_init(&expired);
+
+        level = rt_hw_interrupt_disable();
+        if (rt_soft_timer_wheel.count == 0)
+        {
+            /* no timer on wheel, skip the empty ticks */
+            rt_soft_timer_wheel.tick = current_tick + 1;
+            rt_hw_interrupt_enable(level);
+            break;
+        }
+
+        /* skip the empty ticks, such as the ticks compensated after sleep */
+        if (_rt_timer_wheel_skip(&rt_soft_timer_wheel, current_tick) == RT_FALSE)
+        {
+            rt_hw_interrupt_enable(level);
+            break;
+        }
+        _rt_timer_wheel_advance(&rt_soft_timer_wheel, &expired);
+        rt_hw_interrupt_enable(level);
+
+        while (!rt_list_isempty(&expired))
+        {
+            level = rt_hw_interrupt_disable();
+            if (rt_list_isempty(&expired))
+            {
+                /* the rest timers are stopped by timeout function */
+                rt_hw_interrupt_enable(level);
+                break;
+            }
+            t = rt_list_entry(expired.next, struct rt_timer, row[0]);
+            /* remove timer from timer list firstly */
+            _rt_timer_remove(t);
+            rt_hw_interrupt_enable(level);
+
+            RT_OBJECT_HOOK_CALL(rt_timer_timeout_hook, (t));
+
+            /* not lock scheduler when performing timeout function */
+            rt_exit_critical();
+            /* call timeout function */
+            t->timeout_func(t->parameter);
+
+            /* re-get tick */
+            current_tick = rt_tick_get();
+
+            RT_DEBUG_LOG(RT_DEBUG_TIMER, ("current tick: %d\n", current_tick));
+
+            /* lock scheduler */
+            rt_enter_critical();
+
+            if ((t->parent.flag & RT_TIMER_FLAG_PERIODIC) &&
+                (t->parent.flag & RT_TIMER_FLAG_ACTIVATED))
+            {
+                /* start it */
+                t->parent.flag &= ~RT_TIMER_FLAG_ACTIVATED;
+                rt_timer_start(t);
+            }
+            else
+            {
+                /* stop timer */
+                t->parent.flag &= ~RT_TIMER_FLAG_ACTIVATED;
+            }
+        }
+    }
+
+    /* unlock scheduler */
+    rt_exit_critical();
+
+    RT_DEBUG_LOG(RT_DEBUG_TIMER, ("software timer check leave\n"));
+}
+#else
 void rt_soft_timer_check(void)
 {
     rt_tick_t current_tick;
@@ -626,6 +1074,7 @@ void rt_soft_timer_check(void)
 
     RT_DEBUG_LOG(RT_DEBUG_TIMER, ("software timer check leave\n"));
 }
+#endif
 
 /* system timer thread entry */
 static void rt_thread_timer_entry(void *parameter)
@@ -635,7 +1084,11 @@ static void rt_thread_timer_entry(void *parameter)
     while (1)
     {
         /* get the next timeout tick */
+#ifdef RT_USING_TIMER_WHEEL
+        next_timeout = rt_timer_wheel_next_timeout(&rt_soft_timer_wheel);
+#else
         next_timeout = rt_timer_list_next_timeout(rt_soft_timer_list);
+#endif
         if (next_timeout == RT_TICK_MAX)
         {
             /* no software timer exist, suspend self. */
@@ -670,12 +1123,16 @@ static void rt_thread_timer_entry(void *parameter)
  */
 void rt_system_timer_init(void)
 {
+#ifdef RT_USING_TIMER_WHEEL
+    rt_timer_wheel_init(&rt_timer_wheel);
+#else
     int i;
 
     for (i = 0; i < sizeof(rt_timer_list)/sizeof(rt_timer_list[0]); i++)
     {
         rt_list_init(rt_timer_list+i);
     }
+#endif
 }
 
 /**
@@ -686,6 +1143,9 @@ void rt_system_timer_init(void)
 void rt_system_timer_thread_init(void)
 {
 #ifdef RT_USING_TIMER_SOFT
+#ifdef RT_USING_TIMER_WHEEL
+    rt_timer_wheel_init(&rt_soft_timer_wheel);
+#else
     int i;
 
     for (i = 0;
@@ -694,6 +1154,7 @@ void rt_system_timer_thread_init(void)
     {
         rt_list_init(rt_soft_timer_list+i);
     }
+#endif
 
     /* start software timer thread */
     rt_thread_init(&timer_thread,
@@ -0,0 +1,641 @@
+/*
+ * File      : tlsf.c
+ * This file is part of RT-Thread RTOS
+ * COPYRIGHT (C) 2006 - 2017, RT-Thread Development Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2017-06-26     agent        the first version
+ */
+
+/*
+ * TLSF (Two-Level Segregated Fit) memory management.
+ *
+ * The free blocks are kept in the segregated free lists of two levels: the
+ * first level is the power of two of block size, and the second level divides
+ * each power of two range into TLSF_SL_COUNT linear ranges. The non-empty
+ * lists are marked in two bitmaps, so a free block large enough is found by
+ * two find first set operations. The allocation and release never walk the
+ * heap, the latency of them is bounded whatever the fragmentation is.
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+
+#ifndef RT_USING_MEMHEAP_AS_HEAP
+
+#define RT_MEM_STATS
+
+#if defined (RT_USING_HEAP) && defined (RT_USING_TLSF)
+#ifdef RT_USING_HOOK
+static void (*rt_malloc_hook)(void *ptr, rt_size_t size);
+static void (*rt_free_hook)(void *ptr);
+
+/**
+ * @addtogroup Hook
+ */
+
+/**@{*/
+
+/**
+ * This function will set a hook function, which will be invoked when a memory
+ * block is allocated from heap memory.
+ *
+ * @param hook the hook function
+ */
+void rt_malloc_sethook(void (*hook)(void *ptr, rt_size_t size))
+{
+    rt_malloc_hook = hook;
+}
+
+/**
+ * This function will set a hook function, which will be invoked when a memory
+ * block is released to heap memory.
+ *
+ * @param hook the hook function
+ */
+void rt_free_sethook(void (*hook)(void *ptr))
+{
+    rt_free_hook = hook;
+}
+
+/**@}*/
+
+#endif
+
+/* the number of second level lists in each power of two is 2^TLSF_SL_SHIFT */
+#ifndef RT_TLSF_SL_SHIFT
+#define RT_TLSF_SL_SHIFT        4
+#endif
+#define TLSF_SL_SHIFT           RT_TLSF_SL_SHIFT
+#define TLSF_SL_COUNT           (1 << TLSF_SL_SHIFT)
+
+#if RT_ALIGN_SIZE > 8
+#define TLSF_ALIGN_SHIFT        4
+#elif RT_ALIGN_SIZE > 4
+#define TLSF_ALIGN_SHIFT        3
+#else
+#define TLSF_ALIGN_SHIFT        2
+#endif
+#define TLSF_ALIGN              (1 << TLSF_ALIGN_SHIFT)
+
+/* the small blocks are in the linear lists of the first level 0 */
+#define TLSF_FL_SHIFT           (TLSF_SL_SHIFT + TLSF_ALIGN_SHIFT)
+#define TLSF_SMALL_BLOCK        (1 << TLSF_FL_SHIFT)
+
+/* the size of block shall be less than 2^TLSF_FL_MAX */
+#define TLSF_FL_MAX             30
+#define TLSF_FL_COUNT           (TLSF_FL_MAX - TLSF_FL_SHIFT + 1)
+
+struct tlsf_block
+{
+    /* the previous block in physical address, RT_NULL for the first block */
+    struct tlsf_block *prev_phys;
+    /* the size of data, and the free flag in the lowest bit */
+    rt_size_t size;
+
+    /* the links of free list, which are in the data of free block */
+    struct tlsf_block *next_free;
+    struct tlsf_block *prev_free;
+};
+
+#define BLOCK_FREE              0x01
+#define BLOCK_SIZE_MASK         (~(rt_size_t)(TLSF_ALIGN - 1))
+
+#define TLSF_HEADER_SIZE        RT_ALIGN(sizeof(struct tlsf_block *) + sizeof(rt_size_t), TLSF_ALIGN)
+#define TLSF_BLOCK_MIN          RT_ALIGN(2 * sizeof(struct tlsf_block *), TLSF_ALIGN)
+
+#define block_size(block)       ((block)->size & BLOCK_SIZE_MASK)
+#define block_is_free(block)    ((block)->size & BLOCK_FREE)
+#define block_next(block)       ((struct tlsf_block *)((rt_uint8_t *)(block) + \
+                                 TLSF_HEADER_SIZE + block_size(block)))
+#define block_to_mem(block)     ((void *)((rt_uint8_t *)(block) + TLSF_HEADER_SIZE))
+#define mem_to_block(mem)       ((struct tlsf_block *)((rt_uint8_t *)(mem) - TLSF_HEADER_SIZE))
+
+/* the bitmaps of non-empty free lists */
+static rt_uint32_t fl_bitmap;
+static rt_uint32_t sl_bitmap[TLSF_FL_COUNT];
+static struct tlsf_block *free_lists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+/** pointer to the heap */
+static rt_uint8_t *heap_ptr;
+/** the last block, which is always used and 0 size */
+static struct tlsf_block *heap_end;
+
+static struct rt_semaphore heap_sem;
+static rt_size_t mem_size_aligned;
+
+#ifdef RT_MEM_STATS
+static rt_size_t used_mem, max_mem;
+#endif
+
+/* find last set, the index of the most significant bit set in value (not 0) */
+rt_inline int tlsf_fls(rt_size_t value)
+{
+#ifdef __GNUC__
+    return (int)(sizeof(unsigned long) * 8 - 1) - __builtin_clzl(value);
+#else
+    int bit = 0;
+
+    if (value & 0xffff0000) { value >>= 16; bit += 16; }
+    if (value & 0xff00)     { value >>= 8;  bit += 8; }
+    if (value & 0xf0)       { value >>= 4;  bit += 4; }
+    if (value & 0x0c)       { value >>= 2;  bit += 2; }
+    if (value & 0x02)       { bit += 1; }
+
+    return bit;
+#endif
+}
+
+/* get the free list of block size */
+static void tlsf_mapping(rt_size_t size, int *fl, int *sl)
+{
+    int bit;
+
+    if (size < TLSF_SMALL_BLOCK)
+    {
+        *fl = 0;
+        *sl = (int)(size >> TLSF_ALIGN_SHIFT);
+    }
+    else
+    {
+        bit = tlsf_fls(size);
+        *sl = (int)(size >> (bit - TLSF_SL_SHIFT)) ^ TLSF_SL_COUNT;
+        *fl = bit - TLSF_FL_SHIFT + 1;
+    }
+}
+
+/*
+ * Get the free list to search for the size. The size is rounded up to the
+ * next list, so that any block in that list is large enough.
+ */
+static void tlsf_mapping_search(rt_size_t size, int *fl, int *sl)
+{
+    if (size >= TLSF_SMALL_BLOCK)
+        size += ((rt_size_t)1 << (tlsf_fls(size) - TLSF_SL_SHIFT)) - 1;
+
+    tlsf_mapping(size, fl, sl);
+}
+
+static struct tlsf_block *tlsf_find_suitable(int *fl, int *sl)
+{
+    rt_uint32_t map;
+
+    /* the lists of larger size in the same first level */
+    map = sl_bitmap[*fl] & (~(rt_uint32_t)0 << *sl);
+    if (map == 0)
+    {
+        /* the lists in the larger first level */
+        if (*fl + 1 >= TLSF_FL_COUNT)
+            return RT_NULL;
+
+        map = fl_bitmap & (~(rt_uint32_t)0 << (*fl + 1));
+        if (map == 0)
+            return RT_NULL;
+
+        *fl = rt_hw_ffs((int)map) - 1;
+        map = sl_bitmap[*fl];
+    }
+    *sl = rt_hw_ffs((int)map) - 1;
+
+    return free_lists[*fl][*sl];
+}
+
+static void tlsf_insert(struct tlsf_block *block)
+{
+    int fl, sl;
+
+    tlsf_mapping(block_size(block), &fl, &sl);
+
+    block->prev_free = RT_NULL;
+    block->next_free = free_lists[fl][sl];
+    if (block->next_free != RT_NULL)
+        block->next_free->prev_free = block;
+    free_lists[fl][sl] = block;
+
+    fl_bitmap     |= 1ul << fl;
+    sl_bitmap[fl] |= 1ul << sl;
+}
+
+static void tlsf_remove(struct tlsf_block *block)
+{
+    int fl, sl;
+
+    tlsf_mapping(block_size(block), &fl, &sl);
+
+    if (block->next_free != RT_NULL)
+        block->next_free->prev_free = block->prev_free;
+
+    if (block->prev_free != RT_NULL)
+    {
+        block->prev_free->next_free = block->next_free;
+    }
+    else
+    {
+        free_lists[fl][sl] = block->next_free;
+        if (free_lists[fl][sl] == RT_NULL)
+        {
+            /* the list is empty now */
+            sl_bitmap[fl] &= ~(1ul << sl);
+            if (sl_bitmap[fl] == 0)
+                fl_bitmap &= ~(1ul << fl);
+        }
+    }
+}
+
+/* split the tail of used block beyond size as a free block */
+static void tlsf_trim(struct tlsf_block *block, rt_size_t size)
+{
+    struct tlsf_block *rest, *next;
+
+    if (block_size(block) < size + TLSF_HEADER_SIZE + TLSF_BLOCK_MIN)
+        return;
+
+    rest = (struct tlsf_block *)((rt_uint8_t *)block + TLSF_HEADER_SIZE + size);
+    rest->size = block_size(block) - size - TLSF_HEADER_SIZE;
+    rest->prev_phys = block;
+    block->size = size;
+
+    /* merge with the next free block */
+    next = block_next(rest);
+    if (block_is_free(next))
+    {
+        tlsf_remove(next);
+        rest->size += TLSF_HEADER_SIZE + block_size(next);
+        next = block_next(rest);
+    }
+    next->prev_phys = rest;
+
+    rest->size |= BLOCK_FREE;
+    tlsf_insert(rest);
+}
+
+/**
+ * @ingroup SystemInit
+ *
+ * This function will initialize system heap memory.
+ *
+ * @param begin_addr the beginning address of system heap memory.
+ * @param end_addr the end address of system heap memory.
+ */
+void rt_system_heap_init(void *begin_addr, void *end_addr)
+{
+    struct tlsf_block *block;
+    rt_ubase_t begin_align = RT_ALIGN((rt_ubase_t)begin_addr, TLSF_ALIGN);
+    rt_ubase_t end_align = RT_ALIGN_DOWN((rt_ubase_t)end_addr, TLSF_ALIGN);
+
+    RT_DEBUG_NOT_IN_INTERRUPT;
+
+    if ((end_align > begin_align) &&
+        (end_align - begin_align >= 2 * TLSF_HEADER_SIZE + TLSF_BLOCK_MIN))
+    {
+        /* calculate the aligned memory size */
+        mem_size_aligned = end_align - begin_align - 2 * TLSF_HEADER_SIZE;
+    }
+    else
+    {
+        rt_kprintf("mem init, error begin address 0x%x, and end address 0x%x\n",
+                   (rt_uint32_t)begin_addr, (rt_uint32_t)end_addr);
+
+        return;
+    }
+
+    /* the block shall be less than the maximal size of free list */
+    if (mem_size_aligned >= ((rt_size_t)1 << TLSF_FL_MAX))
+        mem_size_aligned = ((rt_size_t)1 << TLSF_FL_MAX) - TLSF_ALIGN;
+
+    heap_ptr = (rt_uint8_t *)begin_align;
+
+    RT_DEBUG_LOG(RT_DEBUG_MEM, ("tlsf init, heap begin address 0x%x, size %d\n",
+                                (rt_uint32_t)heap_ptr, mem_size_aligned));
+
+    rt_memset(free_lists, 0, sizeof(free_lists));
+    rt_memset(sl_bitmap, 0, sizeof(sl_bitmap));
+    fl_bitmap = 0;
+
+    /* the whole heap is one free block */
+    block            = (struct tlsf_block *)heap_ptr;
+    block->prev_phys = RT_NULL;
+    block->size      = mem_size_aligned | BLOCK_FREE;
+
+    /* initialize the end of the heap */
+    heap_end            = block_next(block);
+    heap_end->prev_phys = block;
+    heap_end->size      = 0;
+
+    tlsf_insert(block);
+
+    rt_sem_init(&heap_sem, "heap", 1, RT_IPC_FLAG_FIFO);
+}
+
+/**
+ * @addtogroup MM
+ */
+
+/**@{*/
+
+/**
+ * Allocate a block of memory with a minimum of 'size' bytes.
+ *
+ * @param size is the minimum size of the requested block in bytes.
+ *
+ * @return pointer to allocated memory or NULL if no free memory was found.
+ */
+void *rt_malloc(rt_size_t size)
+{
+    int fl, sl;
+    struct tlsf_block *block;
+
+    RT_DEBUG_NOT_IN_INTERRUPT;
+
+    if (size == 0)
+        return RT_NULL;
+
+    /* alignment size */
+    size = RT_ALIGN(size, TLSF_ALIGN);
+    if (size > mem_size_aligned)
+    {
+        RT_DEBUG_LOG(RT_DEBUG_MEM, ("no memory\n"));
+
+        return RT_NULL;
+    }
+
+    /* every data block must be large enough for the free list links */
+    if (size < TLSF_BLOCK_MIN)
+        size = TLSF_BLOCK_MIN;
+
+    /* take memory semaphore */
+    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+
+    block = RT_NULL;
+    tlsf_mapping_search(size, &fl, &sl);
+    if (fl < TLSF_FL_COUNT)
+        block = tlsf_find_suitable(&fl, &sl);
+    if (block == RT_NULL)
+    {
+        /* the first block in the list of size may be large enough */
+        tlsf_mapping(size, &fl, &sl);
+        block = free_lists[fl][sl];
+        if (block != RT_NULL && block_size(block) < size)
+            block = RT_NULL;
+    }
+    if (block == RT_NULL)
+    {
+        rt_sem_release(&heap_sem);
+        RT_DEBUG_LOG(RT_DEBUG_MEM, ("no memory for %d bytes\n", size));
+
+        return RT_NULL;
+    }
+
+    tlsf_remove(block);
+    block->size &= ~BLOCK_FREE;
+    tlsf_trim(block, size);
+
+#ifdef RT_MEM_STATS
+    used_mem += block_size(block) + TLSF_HEADER_SIZE;
+    if (max_mem < used_mem)
+        max_mem = used_mem;
+#endif
+
+    rt_sem_release(&heap_sem);
+
+    RT_DEBUG_LOG(RT_DEBUG_MEM,
+                 ("allocate memory at 0x%x, size: %d\n",
+                  (rt_uint32_t)block_to_mem(block), block_size(block)));
+
+    RT_OBJECT_HOOK_CALL(rt_malloc_hook, (block_to_mem(block), size));
+
+    return block_to_mem(block);
+}
+RTM_EXPORT(rt_malloc);
+
+/**
+ * This function will change the previously allocated memory block.
+ *
+ * @param rmem pointer to memory allocated by rt_malloc
+ * @param newsize the required new size
+ *
+ * @return the changed memory block address
+ */
+void *rt_realloc(void *rmem, rt_size_t newsize)
+{
+    rt_size_t size;
+    struct tlsf_block *block, *next;
+    void *nmem;
+
+    RT_DEBUG_NOT_IN_INTERRUPT;
+
+    /* allocate a new memory block */
+    if (rmem == RT_NULL)
+        return rt_malloc(newsize);
+
+    if (newsize == 0)
+    {
+        rt_free(rmem);
+
+        return RT_NULL;
+    }
+
+    /* alignment size */
+    newsize = RT_ALIGN(newsize, TLSF_ALIGN);
+    if (newsize > mem_size_aligned)
+    {
+        RT_DEBUG_LOG(RT_DEBUG_MEM, ("realloc: out of memory\n"));
+
+        return RT_NULL;
+    }
+    if (newsize < TLSF_BLOCK_MIN)
+        newsize = TLSF_BLOCK_MIN;
+
+    if ((rt_uint8_t *)rmem < heap_ptr || (rt_uint8_t *)rmem >= (rt_uint8_t *)heap_end)
+    {
+        /* illegal memory */
+        return rmem;
+    }
+
+    block = mem_to_block(rmem);
+
+    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+
+    RT_ASSERT(!block_is_free(block));
+    size = block_size(block);
+
+    /* expand into the next free block */
+    next = block_next(block);
+    if (newsize > size && block_is_free(next) &&
+        size + TLSF_HEADER_SIZE + block_size(next) >= newsize)
+    {
+        tlsf_remove(next);
+        block->size += TLSF_HEADER_SIZE + block_size(next);
+        block_next(block)->prev_phys = block;
+    }
+
+    if (newsize <= block_size(block))
+    {
+        /* shrink or expanded in place */
+        tlsf_trim(block, newsize);
+
+#ifdef RT_MEM_STATS
+        used_mem = used_mem - size + block_size(block);
+        if (max_mem < used_mem)
+            max_mem = used_mem;
+#endif
+        rt_sem_release(&heap_sem);
+
+        return rmem;
+    }
+    rt_sem_release(&heap_sem);
+
+    /* move to a new memory block */
+    nmem = rt_malloc(newsize);
+    if (nmem != RT_NULL)
+    {
+        rt_memcpy(nmem, rmem, size < newsize ? size : newsize);
+        rt_free(rmem);
+    }
+
+    return nmem;
+}
+RTM_EXPORT(rt_realloc);
+
+/**
+ * This function will contiguously allocate enough space for count objects
+ * that are size bytes of memory each and returns a pointer to the allocated
+ * memory.
+ *
+ * The allocated memory is filled with bytes of value zero.
+ *
+ * @param count number of objects to allocate
+ * @param size size of the objects to allocate
+ *
+ * @return pointer to allocated memory / NULL pointer if there is an error
+ */
+void *rt_calloc(rt_size_t count, rt_size_t size)
+{
+    void *p;
+
+    RT_DEBUG_NOT_IN_INTERRUPT;
+
+    /* allocate 'count' objects of size 'size' */
+    p = rt_malloc(count * size);
+
+    /* zero the memory */
+    if (p)
+        rt_memset(p, 0, count * size);
+
+    return p;
+}
+RTM_EXPORT(rt_calloc);
+
+/**
+ * This function will release the previously allocated memory block by
+ * rt_malloc. The released memory block is taken back to system heap.
+ *
+ * @param rmem the address of memory which will be released
+ */
+void rt_free(void *rmem)
+{
+    struct tlsf_block *block, *prev, *next;
+
+    RT_DEBUG_NOT_IN_INTERRUPT;
+
+    if (rmem == RT_NULL)
+        return;
+    RT_ASSERT((((rt_ubase_t)rmem) & (TLSF_ALIGN - 1)) == 0);
+    RT_ASSERT((rt_uint8_t *)rmem >= heap_ptr &&
+              (rt_uint8_t *)rmem < (rt_uint8_t *)heap_end);
+
+    RT_OBJECT_HOOK_CALL(rt_free_hook, (rmem));
+
+    if ((rt_uint8_t *)rmem < heap_ptr || (rt_uint8_t *)rmem >= (rt_uint8_t *)heap_end)
+    {
+        RT_DEBUG_LOG(RT_DEBUG_MEM, ("illegal memory\n"));
+
+        return;
+    }
+
+    block = mem_to_block(rmem);
+
+    RT_DEBUG_LOG(RT_DEBUG_MEM,
+                 ("release memory 0x%x, size: %d\n",
+                  (rt_uint32_t)rmem, block_size(block)));
+
+    /* protect the heap from concurrent access */
+    rt_sem_take(&heap_sem, RT_WAITING_FOREVER);
+
+    /* the block has to be in a used state */
+    RT_ASSERT(!block_is_free(block));
+
+#ifdef RT_MEM_STATS
+    used_mem -= block_size(block) + TLSF_HEADER_SIZE;
+#endif
+
+    /* merge with the previous free block */
+    prev = block->prev_phys;
+    if (prev != RT_NULL && block_is_free(prev))
+    {
+        tlsf_remove(prev);
+        prev->size += TLSF_HEADER_SIZE + block_size(block);
+        block = prev;
+    }
+
+    /* merge with the next free block */
+    next = block_next(block);
+    if (block_is_free(next))
+    {
+        tlsf_remove(next);
+        block->size += TLSF_HEADER_SIZE + block_size(next);
+    }
+    block_next(block)->prev_phys = block;
+
+    block->size |= BLOCK_FREE;
+    tlsf_insert(block);
+
+    rt_sem_release(&heap_sem);
+}
+RTM_EXPORT(rt_free);
+
+#ifdef RT_MEM_STATS
+void rt_memory_info(rt_uint32_t *total,
+                    rt_uint32_t *used,
+                    rt_uint32_t *max_used)
+{
+    if (total != RT_NULL)
+        *total = mem_size_aligned;
+    if (used  != RT_NULL)
+        *used = used_mem;
+    if (max_used != RT_NULL)
+        *max_used = max_mem;
+}
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+
+void list_mem(void)
+{
+    rt_kprintf("total memory: %d\n", mem_size_aligned);
+    rt_kprintf("used memory : %d\n", used_mem);
+    rt_kprintf("maximum allocated memory: %d\n", max_mem);
+}
+FINSH_FUNCTION_EXPORT(list_mem, list memory usage information)
+#endif
+#endif
+
+/**@}*/
+
+#endif /* end of RT_USING_HEAP */
+#endif /* end of RT_USING_MEMHEAP_AS_HEAP */
@@ -0,0 +1,248 @@
+#
+# File      : ktrace2json.py
+# This file is part of RT-Thread RTOS
+# COPYRIGHT (C) 2006 - 2017, RT-Thread Development Team
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License along
+#  with this program; if not, write to the Free Software Foundation, Inc.,
+#  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+#
+# Change Logs:
+# Date           Author       Notes
+# 2017-07-02     agent        the first version
+#
+# Convert the dump of kernel event tracer (components/utilities/ktrace) to
+# the Chrome trace JSON, which is opened by chrome://tracing or Perfetto UI.
+#
+# Each CPU is a track of the threads running on it, with the interrupts in
+# a track under it. The IPC and timer events are instants on the CPU track,
+# and the time of a thread waiting an IPC object is a slice on the track of
+# thread.
+#
+# Usage: python ktrace2json.py trace.bin [trace.json]
+#
+
+import sys
+import json
+import struct
+
+KTRACE_MAGIC = 0x4352544b
+
+EVENT_SWITCH    = 1
+EVENT_IRQ_ENTER = 2
+EVENT_IRQ_LEAVE = 3
+EVENT_TRYTAKE   = 4
+EVENT_TAKE      = 5
+EVENT_PUT       = 6
+EVENT_TIMER     = 7
+
+CLASS_NAMES = {
+    'T': 'thread',
+    'S': 'sem',
+    'M': 'mutex',
+    'E': 'event',
+    'B': 'mailbox',
+    'Q': 'mq',
+    't': 'timer',
+}
+
+# the process ids in trace
+PID_CPU    = 0
+PID_THREAD = 1
+# the irq track of cpu
+TID_IRQ    = 1000
+
+def read_dump(data):
+    # the byte order of target is known by magic
+    order = '<'
+    if struct.unpack_from('<I', data, 0)[0] != KTRACE_MAGIC:
+        order = '>'
+        if struct.unpack_from('>I', data, 0)[0] != KTRACE_MAGIC:
+            raise ValueError('not a ktrace dump')
+
+    # rt_uint32_t is 64 bits long on the 64 bits simulator, the magic is
+    # followed by zero then.
+    if struct.unpack_from(order + 'I', data, 4)[0] == 0:
+        header_format = order + 'QHH4xQHH4xQQQQ'
+        name_format   = order + 'QB7x'
+        record_format = order + 'QBBBx4xQQ'
+    else:
+        header_format = order + 'IHHIHHIIII'
+        name_format   = order + 'IB3x'
+        record_format = order + 'IBBBxII'
+
+    (magic, version, record_size, frequency, cpus, name_max, name_count,
+     record_count, lost, reserved) = struct.unpack_from(header_format, data, 0)
+    offset = struct.calcsize(header_format)
+
+    names = {}
+    name_size = struct.calcsize(name_format)
+    for index in range(name_count):
+        obj, cls = struct.unpack_from(name_format, data, offset)
+        name = data[offset + name_size:offset + name_size + name_max].split(b'\0')[0]
+        names[obj] = (chr(cls), name.decode('ascii', 'replace'))
+        offset += name_size + name_max
+
+    records = []
+    for index in range(record_count):
+        if offset + record_size > len(data):
+            break
+        record = struct.unpack_from(record_format, data, offset)
+        offset += record_size
+        # the record in writing at dump is dropped
+        if record[1] == 0:
+            continue
+        records.append(record)
+
+    header = {
+        'version': version,
+        'frequency': frequency,
+        'cpus': cpus,
+        'records': len(records),
+        'lost': lost,
+    }
+    return header, names, records
+
+def unwrap_timestamps(records, cpus):
+    # the clock is 32 bits, it's extended by the signed delta of each cpu
+    last = [None] * cpus
+    extended = [0] * cpus
+    result = []
+    for record in records:
+        timestamp, event, cpu = record[0], record[1], record[2]
+        if last[cpu] is None:
+            # the cpus share the clock
+            extended[cpu] = timestamp
+        else:
+            delta = (timestamp - last[cpu]) & 0xffffffff
+            if delta >= 0x80000000:
+                delta -= 0x100000000
+            extended[cpu] += delta
+        last[cpu] = timestamp
+        result.append((extended[cpu],) + tuple(record))
+    # the records of each cpu are in order of slot, sort them by time
+    result.sort(key = lambda r: r[0])
+    return result
+
+def object_name(names, obj):
+    if obj == 0:
+        return 'none'
+    if obj in names:
+        return names[obj][1]
+    return '0x%08x' % obj
+
+def object_label(names, obj, cls):
+    return '%s %s' % (CLASS_NAMES.get(chr(cls), 'object'), object_name(names, obj))
+
+def convert(header, names, records):
+    events = []
+    cpus = header['cpus']
+    scale = 1000000.0 / header['frequency']
+    records = unwrap_timestamps(records, cpus)
+    if records:
+        base = min(r[0] for r in records)
+    else:
+        base = 0
+
+    def us(ticks):
+        return (ticks - base) * scale
+
+    events.append({'name': 'process_name', 'ph': 'M', 'pid': PID_CPU,
+                   'args': {'name': 'CPUs'}})
+    for cpu in range(cpus):
+        events.append({'name': 'thread_name', 'ph': 'M', 'pid': PID_CPU,
+                       'tid': cpu, 'args': {'name': 'CPU %d' % cpu}})
+        events.append({'name': 'thread_name', 'ph': 'M', 'pid': PID_CPU,
+                       'tid': TID_IRQ + cpu, 'args': {'name': 'CPU %d IRQ' % cpu}})
+    events.append({'name': 'process_name', 'ph': 'M', 'pid': PID_THREAD,
+                   'args': {'name': 'Threads'}})
+
+    running = {}        # cpu: (thread, start)
+    waiting = {}        # (thread, object): start
+    threads = set()
+
+    for record in records:
+        ticks, timestamp, event, cpu, cls, obj, thread = record
+        now = us(ticks)
+
+        if event == EVENT_SWITCH:
+            # object is from thread and thread is to thread
+            if cpu in running:
+                prev, start = running[cpu]
+                events.append({'name': object_name(names, prev), 'ph': 'X',
+                               'pid': PID_CPU, 'tid': cpu, 'ts': start,
+                               'dur': now - start})
+            running[cpu] = (thread, now)
+        elif event == EVENT_IRQ_ENTER:
+            events.append({'name': 'irq', 'ph': 'B', 'pid': PID_CPU,
+                           'tid': TID_IRQ + cpu, 'ts': now, 'args': {'nest': cls}})
+        elif event == EVENT_IRQ_LEAVE:
+            events.append({'name': 'irq', 'ph': 'E', 'pid': PID_CPU,
+                           'tid': TID_IRQ + cpu, 'ts': now})
+        elif event in (EVENT_TRYTAKE, EVENT_TAKE, EVENT_PUT, EVENT_TIMER):
+            action = {EVENT_TRYTAKE: 'trytake', EVENT_TAKE: 'take',
+                      EVENT_PUT: 'put', EVENT_TIMER: 'timeout'}[event]
+            events.append({'name': '%s %s' % (action, object_label(names, obj, cls)),
+                           'ph': 'i', 's': 't', 'pid': PID_CPU, 'tid': cpu,
+                           'ts': now, 'args': {'thread': object_name(names, thread)}})
+
+            # the time waiting for the object
+            if event == EVENT_TRYTAKE:
+                waiting[(thread, obj)] = now
+            elif event == EVENT_TAKE and (thread, obj) in waiting:
+                start = waiting.pop((thread, obj))
+                threads.add(thread)
+                events.append({'name': 'wait %s' % object_label(names, obj, cls),
+                               'ph': 'X', 'pid': PID_THREAD, 'tid': thread,
+                               'ts': start, 'dur': now - start})
+
+    # the threads still running at the end of trace
+    if records:
+        end = us(records[-1][0])
+        for cpu in running:
+            thread, start = running[cpu]
+            events.append({'name': object_name(names, thread), 'ph': 'X',
+                           'pid': PID_CPU, 'tid': cpu, 'ts': start,
+                           'dur': end - start})
+
+    for thread in threads:
+        events.append({'name': 'thread_name', 'ph': 'M', 'pid': PID_THREAD,
+                       'tid': thread, 'args': {'name': object_name(names, thread)}})
+
+    return {'traceEvents': events, 'displayTimeUnit': 'ns',
+            'otherData': {'ktrace': header}}
+
+def main():
+    if len(sys.argv) < 2:
+        print('Usage: %s trace.bin [trace.json]' % sys.argv[0])
+        return 1
+
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+
+    header, names, records = read_dump(data)
+    trace = convert(header, names, records)
+
+    if len(sys.argv) > 2:
+        with open(sys.argv[2], 'w') as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+
+    sys.stderr.write('%d records, %d lost, %d cpus, %d Hz\n' %
+                     (header['records'], header['lost'], header['cpus'],
+                      header['frequency']))
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())